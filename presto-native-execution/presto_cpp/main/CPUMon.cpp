@@ -12,81 +12,256 @@
  * limitations under the License.
  */
 #include "presto_cpp/main/CPUMon.h"
+#include <algorithm>
 #include <cinttypes>
-#include "folly/File.h"
+#include <cmath>
+#include <thread>
 #include "folly/FileUtil.h"
+#include "folly/String.h"
+#include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/common/Utils.h"
+#include "velox/common/base/StatsReporter.h"
 
 namespace facebook::presto {
+namespace {
 
-static bool readProcStat(std::vector<uint64_t>& counters) {
-  auto cpuStatFile = folly::File("/proc/stat", O_RDONLY);
-  // Enough storage for the /proc/stat CPU data needed below
-  std::array<char, 320> buf;
-  if (folly::readNoInt(cpuStatFile.fd(), buf.data(), buf.size()) !=
-      static_cast<ssize_t>(buf.size())) {
-    return false;
+std::optional<std::string> readFile(const std::string& path) {
+  std::string contents;
+  if (!folly::readFile(path.c_str(), contents)) {
+    return std::nullopt;
   }
+  return contents;
+}
+
+std::vector<folly::StringPiece> splitLines(const std::string& contents) {
+  std::vector<folly::StringPiece> lines;
+  folly::split('\n', contents, lines, true);
+  return lines;
+}
+
+// Busy percentage of the time between 'prev' and 'cur'.
+double loadPct(
+    const std::array<uint64_t, 8>& prev,
+    const std::array<uint64_t, 8>& cur) {
+  /**
+   * The values in the /proc/stat is the CPU time since boot.
+   * Columns [0, 1, ... 9] map to [user, nice, system, idle, iowait, irq,
+   * softirq, steal, guest, guest_nice]. Guest related fields are not used
+   * for the cpu util calculation. The total CPU time in the last
+   * window is delta busy time over delta total time.
+   */
+  const auto curUtil =
+      cur[0] + cur[1] + cur[2] + cur[4] + cur[5] + cur[6] + cur[7];
+  const auto prevUtil =
+      prev[0] + prev[1] + prev[2] + prev[4] + prev[5] + prev[6] + prev[7];
+  const auto utilDiff = static_cast<double>(curUtil - prevUtil);
+  const auto totalDiff = utilDiff + cur[3] - prev[3];
+
+  /**
+   * Corner case: If CPU didn't change or the proc/stat didn't get
+   * updated or ticks didn't increase, set the cpuUtil to 0.
+   */
+  if (totalDiff < 0.001 || curUtil < prevUtil) {
+    return 0.0;
+  }
+  // Corner case: The max of CPU utilization can be at most 100%.
+  return std::min((utilDiff / totalDiff) * 100, 100.0);
+}
+
+uint64_t delta(uint64_t cur, uint64_t prev) {
+  return cur - std::min(cur, prev);
+}
+
+std::optional<uint64_t> delta(
+    const std::optional<uint64_t>& cur,
+    const std::optional<uint64_t>& prev) {
+  if (!cur.has_value() || !prev.has_value()) {
+    return std::nullopt;
+  }
+  return delta(cur.value(), prev.value());
+}
+} // namespace
 
-  const static char* fmt = "cpu %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+CPUMon::CPUMon(std::string procPath, std::string cgroupPath)
+    : procPath_(std::move(procPath)), cgroupPath_(std::move(cgroupPath)) {}
+
+std::optional<std::vector<CPUMon::CoreTicks>> CPUMon::readProcStat() const {
+  const auto contents = readFile(procPath_ + "/stat");
+  if (!contents.has_value()) {
+    return std::nullopt;
+  }
+
+  const static char* fmt = "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
                            " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64;
-  if (sscanf(
-          buf.data(),
-          fmt,
-          &counters[0],
-          &counters[1],
-          &counters[2],
-          &counters[3],
-          &counters[4],
-          &counters[5],
-          &counters[6],
-          &counters[7]) != static_cast<int>(counters.size())) {
-    return false;
-  }
-
-  return true;
+  std::vector<CoreTicks> ticks;
+  for (auto line : splitLines(contents.value())) {
+    // The cpu lines come first: the aggregate 'cpu' then 'cpu0', 'cpu1'...
+    if (!line.removePrefix("cpu")) {
+      break;
+    }
+    const bool aggregate = line.startsWith(' ');
+    if (aggregate != ticks.empty()) {
+      return std::nullopt;
+    }
+    // Skip the core number.
+    while (!line.empty() && line.front() != ' ') {
+      line.advance(1);
+    }
+    CoreTicks counters;
+    if (sscanf(
+            line.str().c_str(),
+            fmt,
+            &counters[0],
+            &counters[1],
+            &counters[2],
+            &counters[3],
+            &counters[4],
+            &counters[5],
+            &counters[6],
+            &counters[7]) != static_cast<int>(counters.size())) {
+      return std::nullopt;
+    }
+    ticks.push_back(counters);
+  }
+  if (ticks.empty()) {
+    return std::nullopt;
+  }
+  return ticks;
 }
 
-void CPUMon::update() {
+std::optional<CPUMon::CgroupCounters> CPUMon::readCgroupCounters() const {
+  const auto stat = readFile(processCgroupPath_.value() + "/cpu.stat");
+  if (!stat.has_value()) {
+    return std::nullopt;
+  }
+  const auto usageUs = util::keyValueStat(stat.value(), "usage_usec");
+  if (!usageUs.has_value()) {
+    return std::nullopt;
+  }
+  CgroupCounters counters;
+  counters.usageUs = usageUs.value();
+  // The throttling stats are present only if the cpu controller is enabled.
+  counters.numThrottledPeriods =
+      util::keyValueStat(stat.value(), "nr_throttled").value_or(0);
+  counters.throttledUs =
+      util::keyValueStat(stat.value(), "throttled_usec").value_or(0);
+
+  const auto pressure = readFile(processCgroupPath_.value() + "/cpu.pressure");
+  if (pressure.has_value()) {
+    counters.someStalledUs =
+        util::pressureStallTotalUs(pressure.value(), "some");
+    counters.fullStalledUs =
+        util::pressureStallTotalUs(pressure.value(), "full");
+  }
+  return counters;
+}
+
+double CPUMon::readCgroupCpuLimit(size_t numCores) const {
+  // cpu.max is '<quota> <period>' or 'max <period>' if there is no limit.
+  const auto contents = readFile(processCgroupPath_.value() + "/cpu.max");
+  if (contents.has_value()) {
+    std::vector<folly::StringPiece> parts;
+    folly::split(' ', folly::trimWhitespace(contents.value()), parts);
+    if (parts.size() == 2) {
+      const auto quota = folly::tryTo<double>(parts[0]);
+      const auto period = folly::tryTo<double>(parts[1]);
+      if (quota.hasValue() && period.hasValue() && period.value() > 0) {
+        return std::min<double>(quota.value() / period.value(), numCores);
+      }
+    }
+  }
+  return numCores;
+}
+
+void CPUMon::update(std::chrono::steady_clock::time_point now) {
   // We do this only for linux, other OS don't have this mechanism.
   // If needed, another mechanism can be added for other OS.
 #ifdef __linux__
-  double cpuUtil = 0.0;
-
-  // Corner case: When parsing /proc/stat fails, set the cpuUtil to 0.
-  std::vector<uint64_t> cur(8);
-  if (readProcStat(cur)) {
-    if (not firstTime_) {
-      /**
-       * The values in the /proc/stat is the CPU time since boot.
-       * Columns [0, 1, ... 9] map to [user, nice, system, idle, iowait, irq,
-       * softirq, steal, guest, guest_nice]. Guest related fields are not used
-       * for the cpu util calculation. The total CPU time in the last
-       * window is delta busy time over delta total time.
-       */
-      auto curUtil =
-          cur[0] + cur[1] + cur[2] + cur[4] + cur[5] + cur[6] + cur[7];
-      auto prevUtil = prev_[0] + prev_[1] + prev_[2] + prev_[4] + prev_[5] +
-          prev_[6] + prev_[7];
-      auto utilDiff = static_cast<double>(curUtil - prevUtil);
-      auto totalDiff = utilDiff + cur[3] - prev_[3];
-
-      /**
-       * Corner case: If CPU didn't change or the proc/stat didn't get
-       * updated or ticks didn't increase, set the cpuUtil to 0.
-       */
-      if (totalDiff < 0.001 || curUtil < prevUtil) {
-        cpuUtil = 0.0;
-      } else {
-        // Corner case: The max of CPU utilization can be at most 100%.
-        cpuUtil = std::min((utilDiff / totalDiff) * 100, 100.0);
+  Stats stats;
+
+  // Corner case: When parsing /proc/stat fails, set the loads to 0.
+  auto cur = readProcStat();
+  if (cur.has_value()) {
+    if (!firstTime_ && prev_.size() == cur->size()) {
+      stats.cpuLoadPct = loadPct(prev_[0], cur.value()[0]);
+      stats.coreLoadPct.reserve(cur->size() - 1);
+      for (size_t i = 1; i < cur->size(); ++i) {
+        stats.coreLoadPct.push_back(loadPct(prev_[i], cur.value()[i]));
+      }
+    }
+    prev_ = std::move(cur.value());
+  }
+
+  if (firstTime_) {
+    processCgroupPath_ =
+        util::findProcessCgroupPath("cpu.stat", procPath_, cgroupPath_);
+  }
+  if (processCgroupPath_.has_value()) {
+    auto cgroup = readCgroupCounters();
+    if (cgroup.has_value() && prevCgroup_.has_value() && !firstTime_) {
+      const auto numCores = std::max<size_t>(
+          prev_.size() > 1 ? prev_.size() - 1
+                           : std::thread::hardware_concurrency(),
+          1);
+      const auto wallUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                              now - prevTime_)
+                              .count();
+      CgroupStats cgroupStats;
+      cgroupStats.cpuLimit = readCgroupCpuLimit(numCores);
+      if (wallUs > 0 && cgroupStats.cpuLimit > 0) {
+        cgroupStats.cpuLoadPct = std::min(
+            100.0 * delta(cgroup->usageUs, prevCgroup_->usageUs) /
+                (wallUs * cgroupStats.cpuLimit),
+            100.0);
       }
-    } else {
-      firstTime_ = false;
+      cgroupStats.numThrottledPeriods = delta(
+          cgroup->numThrottledPeriods, prevCgroup_->numThrottledPeriods);
+      cgroupStats.throttledUs =
+          delta(cgroup->throttledUs, prevCgroup_->throttledUs);
+      cgroupStats.someStalledUs =
+          delta(cgroup->someStalledUs, prevCgroup_->someStalledUs);
+      cgroupStats.fullStalledUs =
+          delta(cgroup->fullStalledUs, prevCgroup_->fullStalledUs);
+      stats.cgroup = cgroupStats;
     }
-    prev_ = std::move(cur);
+    prevCgroup_ = std::move(cgroup);
   }
-  cpuLoadPct_.store(cpuUtil);
+  firstTime_ = false;
+  prevTime_ = now;
+
+  cpuLoadPct_.store(stats.cpuLoadPct);
+  processCpuLoadPct_.store(
+      stats.cgroup.has_value() ? stats.cgroup->cpuLoadPct : stats.cpuLoadPct);
+  reportMetrics(stats);
+  *stats_.wlock() = std::move(stats);
 #endif
 }
 
+void CPUMon::reportMetrics(const Stats& stats) const {
+  RECORD_METRIC_VALUE(kCounterCpuLoadPct, std::lround(stats.cpuLoadPct));
+  if (!stats.coreLoadPct.empty()) {
+    const auto [minCore, maxCore] = std::minmax_element(
+        stats.coreLoadPct.begin(), stats.coreLoadPct.end());
+    RECORD_METRIC_VALUE(kCounterCpuMinCoreLoadPct, std::lround(*minCore));
+    RECORD_METRIC_VALUE(kCounterCpuMaxCoreLoadPct, std::lround(*maxCore));
+  }
+  if (!stats.cgroup.has_value()) {
+    return;
+  }
+  const auto& cgroup = stats.cgroup.value();
+  RECORD_METRIC_VALUE(
+      kCounterCgroupCpuLoadPct, std::lround(cgroup.cpuLoadPct));
+  RECORD_METRIC_VALUE(
+      kCounterCgroupCpuNumThrottledPeriods, cgroup.numThrottledPeriods);
+  RECORD_METRIC_VALUE(kCounterCgroupCpuThrottledUs, cgroup.throttledUs);
+  if (cgroup.someStalledUs.has_value()) {
+    RECORD_METRIC_VALUE(
+        kCounterCgroupCpuSomeStalledUs, cgroup.someStalledUs.value());
+  }
+  if (cgroup.fullStalledUs.has_value()) {
+    RECORD_METRIC_VALUE(
+        kCounterCgroupCpuFullStalledUs, cgroup.fullStalledUs.value());
+  }
+}
+
 } // namespace facebook::presto
@@ -13,26 +13,113 @@
  */
 #pragma once
 
+#include <folly/Synchronized.h>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
 #include <vector>
 
 namespace facebook::presto {
 
-/// Used to keep track of the system's CPU usage.
+/// Used to keep track of the system's CPU usage: the load of the host and of
+/// each of its cores from /proc/stat and, when the process runs in a cgroup
+/// v2, the load of the cgroup relative to its CPU limit, its CFS throttling
+/// and its CPU pressure stall information (PSI).
 class CPUMon {
  public:
+  /// CPU usage of the cgroup of the process since the previous update.
+  struct CgroupStats {
+    /// CPU time used by the cgroup as a percentage of its CPU limit, or of
+    /// the number of cores if the cgroup has no limit.
+    double cpuLoadPct{0};
+    /// Max number of cores the cgroup may use, from cpu.max.
+    double cpuLimit{0};
+    /// Number of CFS periods in which the cgroup was throttled.
+    uint64_t numThrottledPeriods{0};
+    /// Time the cgroup was throttled in microseconds.
+    uint64_t throttledUs{0};
+    /// Time in microseconds some, resp. all, of the runnable tasks of the
+    /// cgroup were stalled waiting for a CPU, from cpu.pressure. Not set if
+    /// PSI is not enabled in the kernel.
+    std::optional<uint64_t> someStalledUs;
+    std::optional<uint64_t> fullStalledUs;
+  };
+
+  struct Stats {
+    /// Load of the host.
+    double cpuLoadPct{0};
+    /// Load of each core of the host, in the order of /proc/stat.
+    std::vector<double> coreLoadPct;
+    /// Set if the process runs in a cgroup v2 with the cpu controller.
+    std::optional<CgroupStats> cgroup;
+  };
+
+  /// 'procPath' and 'cgroupPath' are the mount points of procfs and of the
+  /// cgroup v2 hierarchy. Overridden by tests.
+  explicit CPUMon(
+      std::string procPath = "/proc",
+      std::string cgroupPath = "/sys/fs/cgroup");
+
   /// Call this periodically to update the CPU load. Not thread-safe.
-  void update();
+  void update() {
+    update(std::chrono::steady_clock::now());
+  }
 
-  /// Returns the current (latest) CPU load. Thread-safe.
+  /// Same as above with the time of the update. Used by tests.
+  void update(std::chrono::steady_clock::time_point now);
+
+  /// Returns the current (latest) CPU load of the host. Thread-safe.
   inline double getCPULoadPct() {
     return cpuLoadPct_.load();
   }
 
+  /// Returns the current (latest) CPU load of the process' cgroup, or of the
+  /// host if the process does not run in a cgroup v2. Thread-safe.
+  inline double getProcessCPULoadPct() {
+    return processCpuLoadPct_.load();
+  }
+
+  /// Returns the stats of the latest update. Thread-safe.
+  Stats stats() const {
+    return *stats_.rlock();
+  }
+
  private:
-  std::vector<uint64_t> prev_{8};
+  // Columns [0, 1, ... 7] of a cpu line of /proc/stat: user, nice, system,
+  // idle, iowait, irq, softirq and steal.
+  using CoreTicks = std::array<uint64_t, 8>;
+
+  struct CgroupCounters {
+    uint64_t usageUs{0};
+    uint64_t numThrottledPeriods{0};
+    uint64_t throttledUs{0};
+    std::optional<uint64_t> someStalledUs;
+    std::optional<uint64_t> fullStalledUs;
+  };
+
+  // Returns the ticks of the 'cpu' line followed by the 'cpuN' lines.
+  std::optional<std::vector<CoreTicks>> readProcStat() const;
+
+  std::optional<CgroupCounters> readCgroupCounters() const;
+
+  // Returns the number of cores the cgroup may use.
+  double readCgroupCpuLimit(size_t numCores) const;
+
+  void reportMetrics(const Stats& stats) const;
+
+  const std::string procPath_;
+  const std::string cgroupPath_;
+  // Cgroup v2 directory of the process, resolved on the first update.
+  std::optional<std::string> processCgroupPath_;
   bool firstTime_{true};
+  std::vector<CoreTicks> prev_;
+  std::optional<CgroupCounters> prevCgroup_;
+  std::chrono::steady_clock::time_point prevTime_;
   std::atomic<double> cpuLoadPct_{0.0};
+  std::atomic<double> processCpuLoadPct_{0.0};
+  folly::Synchronized<Stats> stats_;
 };
 
 } // namespace facebook::presto
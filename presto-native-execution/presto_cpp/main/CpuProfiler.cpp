@@ -0,0 +1,373 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/CpuProfiler.h"
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fmt/format.h>
+#include <folly/Demangle.h>
+#include <folly/String.h>
+#include <folly/Synchronized.h>
+#include <folly/container/F14Map.h>
+#include <glog/logging.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/process/ThreadDebugInfo.h"
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+namespace facebook::presto {
+namespace {
+
+constexpr int32_t kMaxDepth{48};
+constexpr size_t kNumSlots{8'192};
+constexpr size_t kThreadNameSize{16};
+constexpr size_t kTaskIdSize{128};
+// The innermost frames of a sample are the signal handler and the signal
+// trampoline.
+constexpr int32_t kNumSkippedFrames{2};
+// Max number of distinct stacks of a profile. The samples of the other stacks
+// are counted under kTruncatedStack.
+constexpr size_t kMaxStacks{100'000};
+constexpr std::string_view kTruncatedStack{"[truncated]"};
+// Interval at which an on-demand profile drains the ring buffer.
+constexpr std::chrono::milliseconds kCollectInterval{100};
+
+// A stack sampled by the signal handler. 'ready' is set once the sample is
+// complete and reset once it has been collected.
+struct Slot {
+  std::atomic<bool> ready{false};
+  int32_t depth{0};
+  void* frames[kMaxDepth];
+  char threadName[kThreadNameSize];
+  char taskId[kTaskIdSize];
+};
+
+// Multi-producer, single-consumer ring of samples. The signal handlers claim
+// the slot at 'head' if the ring is not full. The consumer advances 'tail'
+// under the lock of the profiler state. The slots are allocated on the first
+// start of the timer and never freed.
+struct RingBuffer {
+  std::atomic<Slot*> slots{nullptr};
+  std::atomic<uint64_t> head{0};
+  std::atomic<uint64_t> tail{0};
+  std::atomic<uint64_t> numDropped{0};
+};
+
+RingBuffer& ringBuffer() {
+  static RingBuffer ring;
+  return ring;
+}
+
+struct Profile {
+  std::map<std::string, uint64_t> stackCounts;
+};
+
+struct State {
+  int32_t backgroundHz{0};
+  // Frequency of the on-demand profile in progress, 0 if none.
+  int32_t profileHz{0};
+  std::optional<Profile> profile;
+  // Number of dropped samples when the on-demand profile started.
+  uint64_t profileNumDroppedBefore{0};
+  Profile background;
+  bool handlerInstalled{false};
+  folly::F14FastMap<void*, std::string> symbols;
+};
+
+folly::Synchronized<State, std::mutex>& state() {
+  static folly::Synchronized<State, std::mutex> state;
+  return state;
+}
+
+void copyTaskId(char* taskId) {
+  // The debug info is set by the driver for the time it runs on the thread.
+  const auto* debugInfo = velox::process::GetThreadDebugInfo();
+  if (debugInfo == nullptr) {
+    taskId[0] = '\0';
+    return;
+  }
+  const auto size = std::min(debugInfo->taskId_.size(), kTaskIdSize - 1);
+  memcpy(taskId, debugInfo->taskId_.data(), size);
+  taskId[size] = '\0';
+}
+
+// Must be async signal safe: no allocation and no locks, except for the ones
+// the unwinder of backtrace() may take, see CpuProfiler.
+void onProfilingSignal(int /*signum*/, siginfo_t* /*info*/, void* /*ctx*/) {
+  const auto savedErrno = errno;
+  auto& ring = ringBuffer();
+  auto* slots = ring.slots.load(std::memory_order_acquire);
+  auto head = ring.head.load(std::memory_order_relaxed);
+  do {
+    if (head - ring.tail.load(std::memory_order_acquire) >= kNumSlots) {
+      ring.numDropped.fetch_add(1, std::memory_order_relaxed);
+      errno = savedErrno;
+      return;
+    }
+  } while (!ring.head.compare_exchange_weak(head, head + 1));
+
+  auto& slot = slots[head % kNumSlots];
+  slot.depth = backtrace(slot.frames, kMaxDepth);
+#ifdef __linux__
+  if (prctl(PR_GET_NAME, slot.threadName) != 0) {
+    slot.threadName[0] = '\0';
+  }
+#else
+  slot.threadName[0] = '\0';
+#endif
+  copyTaskId(slot.taskId);
+  slot.ready.store(true, std::memory_order_release);
+  errno = savedErrno;
+}
+
+void installHandler() {
+  // backtrace() loads libgcc on its first call, which is not async signal
+  // safe.
+  void* frames[1];
+  backtrace(frames, 1);
+  ringBuffer().slots.store(new Slot[kNumSlots], std::memory_order_release);
+
+  struct sigaction action {};
+  action.sa_sigaction = onProfilingSignal;
+  action.sa_flags = SA_RESTART | SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  VELOX_CHECK_EQ(
+      sigaction(SIGPROF, &action, nullptr),
+      0,
+      "Failed to install the SIGPROF handler: {}",
+      folly::errnoStr(errno));
+}
+
+// Runs the timer at the highest requested frequency or stops it.
+void updateTimer(State& state) {
+  const auto frequencyHz = std::max(state.backgroundHz, state.profileHz);
+  if (frequencyHz > 0 && !state.handlerInstalled) {
+    installHandler();
+    state.handlerInstalled = true;
+  }
+  itimerval timer{};
+  if (frequencyHz > 0) {
+    const auto intervalUs = 1'000'000 / frequencyHz;
+    timer.it_interval.tv_sec = intervalUs / 1'000'000;
+    timer.it_interval.tv_usec = intervalUs % 1'000'000;
+    timer.it_value = timer.it_interval;
+  }
+  VELOX_CHECK_EQ(
+      setitimer(ITIMER_PROF, &timer, nullptr),
+      0,
+      "Failed to set the profiling timer: {}",
+      folly::errnoStr(errno));
+  if (frequencyHz == 0) {
+    state.symbols.clear();
+  }
+}
+
+const std::string& symbolize(
+    void* address,
+    folly::F14FastMap<void*, std::string>& symbols) {
+  auto it = symbols.find(address);
+  if (it != symbols.end()) {
+    return it->second;
+  }
+  std::string name;
+  Dl_info info;
+  if (dladdr(address, &info) != 0 && info.dli_sname != nullptr) {
+    name = folly::demangle(info.dli_sname).toStdString();
+    // ';' separates the frames of a folded stack.
+    std::replace(name.begin(), name.end(), ';', ':');
+  } else {
+    name = fmt::format("{:#x}", reinterpret_cast<uintptr_t>(address));
+  }
+  return symbols.emplace(address, std::move(name)).first->second;
+}
+
+// Returns the name of the thread without its trailing digits, e.g. 'Driver'
+// for 'Driver12'.
+std::string_view threadPoolName(const char* threadName) {
+  std::string_view name(threadName, strnlen(threadName, kThreadNameSize));
+  const auto end = name.find_last_not_of("0123456789");
+  return end == std::string_view::npos ? name : name.substr(0, end + 1);
+}
+
+std::string foldedStack(
+    const Slot& slot,
+    folly::F14FastMap<void*, std::string>& symbols) {
+  std::string stack(threadPoolName(slot.threadName));
+  if (slot.taskId[0] != '\0') {
+    stack += ';';
+    stack += slot.taskId;
+  }
+  for (auto i = slot.depth - 1; i >= kNumSkippedFrames; --i) {
+    // Except for the interrupted one, the frames are return addresses which
+    // may point past the end of the calling function.
+    auto* address = i == kNumSkippedFrames
+        ? slot.frames[i]
+        : static_cast<char*>(slot.frames[i]) - 1;
+    stack += ';';
+    stack += symbolize(address, symbols);
+  }
+  return stack;
+}
+
+void addSample(Profile& profile, const std::string& stack) {
+  if (profile.stackCounts.size() >= kMaxStacks &&
+      profile.stackCounts.count(stack) == 0) {
+    ++profile.stackCounts[std::string(kTruncatedStack)];
+    return;
+  }
+  ++profile.stackCounts[stack];
+}
+
+std::string toFolded(const Profile& profile) {
+  std::string folded;
+  for (const auto& [stack, count] : profile.stackCounts) {
+    folded += fmt::format("{} {}\n", stack, count);
+  }
+  return folded;
+}
+
+void collectLocked(State& state) {
+  auto& ring = ringBuffer();
+  auto* slots = ring.slots.load(std::memory_order_acquire);
+  if (slots == nullptr) {
+    return;
+  }
+  const auto head = ring.head.load(std::memory_order_acquire);
+  for (auto tail = ring.tail.load(std::memory_order_relaxed); tail < head;
+       ++tail) {
+    auto& slot = slots[tail % kNumSlots];
+    // The handler which claimed the slot is still running.
+    if (!slot.ready.load(std::memory_order_acquire)) {
+      break;
+    }
+    const auto stack = foldedStack(slot, state.symbols);
+    if (state.profile.has_value()) {
+      addSample(state.profile.value(), stack);
+    }
+    if (state.backgroundHz > 0) {
+      addSample(state.background, stack);
+    }
+    slot.ready.store(false, std::memory_order_relaxed);
+    ring.tail.store(tail + 1, std::memory_order_release);
+  }
+}
+
+void checkFrequency(int32_t frequencyHz) {
+  VELOX_USER_CHECK_LE(
+      frequencyHz,
+      CpuProfiler::kMaxFrequencyHz,
+      "CPU profiler frequency is too high");
+}
+} // namespace
+
+// static
+void CpuProfiler::startProfile(int32_t frequencyHz) {
+  VELOX_USER_CHECK_GT(frequencyHz, 0, "CPU profiler frequency must be > 0");
+  checkFrequency(frequencyHz);
+  state().withLock([&](auto& state) {
+    VELOX_USER_CHECK(
+        !state.profile.has_value(), "A CPU profile is already in progress");
+    state.profile.emplace();
+    state.profileHz = frequencyHz;
+    state.profileNumDroppedBefore = numDroppedSamples();
+    updateTimer(state);
+  });
+}
+
+// static
+std::string CpuProfiler::finishProfile(
+    std::chrono::steady_clock::time_point deadline) {
+  for (auto now = std::chrono::steady_clock::now(); now < deadline;
+       now = std::chrono::steady_clock::now()) {
+    std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+        kCollectInterval, deadline - now));
+    collect();
+  }
+
+  uint64_t numDroppedBefore;
+  auto folded = state().withLock([&](auto& state) {
+    VELOX_CHECK(state.profile.has_value(), "No CPU profile is in progress");
+    collectLocked(state);
+    auto folded = toFolded(state.profile.value());
+    state.profile.reset();
+    state.profileHz = 0;
+    numDroppedBefore = state.profileNumDroppedBefore;
+    updateTimer(state);
+    return folded;
+  });
+  const auto numDropped = numDroppedSamples() - numDroppedBefore;
+  LOG_IF(WARNING, numDropped > 0)
+      << "CPU profiler dropped " << numDropped << " samples";
+  return folded;
+}
+
+// static
+std::string CpuProfiler::profile(
+    std::chrono::milliseconds duration,
+    int32_t frequencyHz) {
+  startProfile(frequencyHz);
+  return finishProfile(std::chrono::steady_clock::now() + duration);
+}
+
+// static
+void CpuProfiler::setBackgroundFrequency(int32_t frequencyHz) {
+  VELOX_USER_CHECK_GE(frequencyHz, 0, "CPU profiler frequency must be >= 0");
+  checkFrequency(frequencyHz);
+  state().withLock([&](auto& state) {
+    collectLocked(state);
+    if (frequencyHz == 0) {
+      state.background.stackCounts.clear();
+    }
+    state.backgroundHz = frequencyHz;
+    updateTimer(state);
+  });
+}
+
+// static
+bool CpuProfiler::backgroundEnabled() {
+  return state().withLock([](auto& state) { return state.backgroundHz > 0; });
+}
+
+// static
+std::string CpuProfiler::backgroundProfile() {
+  return state().withLock([](auto& state) {
+    collectLocked(state);
+    auto folded = toFolded(state.background);
+    state.background.stackCounts.clear();
+    return folded;
+  });
+}
+
+// static
+void CpuProfiler::collect() {
+  state().withLock([](auto& state) { collectLocked(state); });
+}
+
+// static
+uint64_t CpuProfiler::numDroppedSamples() {
+  return ringBuffer().numDropped.load(std::memory_order_relaxed);
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,87 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace facebook::presto {
+
+/// Sampling CPU profiler of the process. An ITIMER_PROF timer raises SIGPROF
+/// every 1 / frequency seconds of CPU time used by the process. The signal
+/// handler records the stack of the interrupted thread, its name and the id
+/// of the Velox task it runs a driver of, if any, into a preallocated
+/// lock-free ring buffer. The samples are symbolized and aggregated outside of
+/// the handler into folded stacks: one 'thread;task;frame;...;frame count'
+/// line per distinct stack, which is the input of flamegraph.pl and
+/// speedscope. The thread name is stripped of its trailing digits so that the
+/// threads of a pool are merged.
+///
+/// There are two modes which may run at the same time: an on-demand profile
+/// of a number of seconds and an always-on background mode at a low frequency
+/// whose samples accumulate until they are fetched. The timer runs at the
+/// highest of the two frequencies. The profiler owns SIGPROF and cannot be
+/// used together with another SIGPROF based profiler.
+///
+/// The stacks are unwound in the signal handler with backtrace(), which is not
+/// async signal safe. With glibc 2.35 or later and the libgcc of GCC 12 or
+/// later, the unwinder finds the unwind tables through the lock-free
+/// _dl_find_object(). With older versions it takes the dynamic loader lock
+/// through dl_iterate_phdr(), and a sample interrupting a thread which holds
+/// that lock, e.g. in dlopen() or while it throws an exception, deadlocks the
+/// thread. Both modes are therefore off by default, see
+/// 'cpu-profiler-background-frequency-hz' and 'cpu-profiler-on-demand-enabled'.
+class CpuProfiler {
+ public:
+  /// Max sampling frequency.
+  static constexpr int32_t kMaxFrequencyHz{1'000};
+
+  /// Starts an on-demand profile at 'frequencyHz'. Throws if another
+  /// on-demand profile is in progress.
+  static void startProfile(int32_t frequencyHz);
+
+  /// Samples until 'deadline', then stops the on-demand profile started by
+  /// startProfile() and returns its folded stacks. Blocks the calling thread
+  /// until 'deadline'.
+  static std::string finishProfile(
+      std::chrono::steady_clock::time_point deadline);
+
+  /// Samples the process for 'duration' at 'frequencyHz' and returns the
+  /// folded stacks. Blocks the calling thread for 'duration'. Throws if
+  /// another on-demand profile is in progress.
+  static std::string profile(
+      std::chrono::milliseconds duration,
+      int32_t frequencyHz);
+
+  /// Starts the background mode at 'frequencyHz', or stops it if 0.
+  static void setBackgroundFrequency(int32_t frequencyHz);
+
+  /// Returns true if the background mode is on.
+  static bool backgroundEnabled();
+
+  /// Returns the folded stacks sampled by the background mode since the
+  /// previous call.
+  static std::string backgroundProfile();
+
+  /// Moves the samples from the ring buffer to the profiles. Must be invoked
+  /// periodically while the background mode is on, the ring buffer drops the
+  /// samples when it is full.
+  static void collect();
+
+  /// Number of samples dropped because the ring buffer was full.
+  static uint64_t numDroppedSamples();
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,355 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/InstrumentedExecutor.h"
+#include <fmt/format.h>
+#include <folly/FileUtil.h>
+#include <folly/ScopeGuard.h>
+#include <folly/String.h>
+#include <pthread.h>
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+#include "presto_cpp/main/QueryTraceRecorder.h"
+#include "velox/common/base/StatsReporter.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace facebook::presto {
+namespace {
+
+folly::Synchronized<std::map<std::string, std::shared_ptr<ExecutorStats>>>&
+statsRegistry() {
+  static folly::Synchronized<
+      std::map<std::string, std::shared_ptr<ExecutorStats>>>
+      registry;
+  return registry;
+}
+
+std::vector<std::shared_ptr<ExecutorStats>> allStats() {
+  std::vector<std::shared_ptr<ExecutorStats>> stats;
+  statsRegistry().withRLock([&](const auto& registry) {
+    stats.reserve(registry.size());
+    for (const auto& [name, poolStats] : registry) {
+      stats.push_back(poolStats);
+    }
+  });
+  return stats;
+}
+
+uint64_t cpuTimeNanos(clockid_t clockId) {
+  timespec ts;
+  if (clock_gettime(clockId, &ts) != 0) {
+    return 0;
+  }
+  return ts.tv_sec * 1'000'000'000ULL + ts.tv_nsec;
+}
+
+uint64_t delta(uint64_t cur, uint64_t prev) {
+  return cur - std::min(cur, prev);
+}
+
+uint64_t elapsedUs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - since)
+      .count();
+}
+} // namespace
+
+std::atomic<uint32_t> ExecutorStats::taskSampleRate_{0};
+
+ExecutorStats::ExecutorStats(const std::string& name)
+    : name_(name),
+      queueWaitUsMetric_(metricName("queue_wait_us")),
+      runTimeUsMetric_(metricName("run_time_us")),
+      runQueueDelayUsMetric_(metricName("run_queue_delay_us")),
+      busyThreadsMetric_(metricName("busy_threads")),
+      cpuUtilizationPctMetric_(metricName("cpu_utilization_pct")),
+      maxThreadCpuUtilizationPctMetric_(
+          metricName("max_thread_cpu_utilization_pct")),
+      runQueueDelayPctMetric_(metricName("run_queue_delay_pct")),
+      voluntaryContextSwitchesMetric_(
+          metricName("voluntary_context_switches")),
+      involuntaryContextSwitchesMetric_(
+          metricName("involuntary_context_switches")) {}
+
+// static
+std::shared_ptr<ExecutorStats> ExecutorStats::get(const std::string& name) {
+  return statsRegistry().withWLock([&](auto& registry) {
+    auto& stats = registry[name];
+    if (stats == nullptr) {
+      stats = std::make_shared<ExecutorStats>(name);
+    }
+    return stats;
+  });
+}
+
+std::string ExecutorStats::metricName(std::string_view stat) const {
+  std::string pool = name_;
+  std::transform(pool.begin(), pool.end(), pool.begin(), [](unsigned char c) {
+    return std::tolower(c);
+  });
+  return fmt::format("presto_cpp.thread_pool.{}.{}", pool, stat);
+}
+
+// static
+void ExecutorStats::registerMetrics() {
+  for (const auto& stats : allStats()) {
+    DEFINE_HISTOGRAM_METRIC(
+        stats->queueWaitUsMetric_, 1'000, 0, 1'000'000, 50, 90, 99, 100);
+    DEFINE_HISTOGRAM_METRIC(
+        stats->runTimeUsMetric_, 1'000, 0, 1'000'000, 50, 90, 99, 100);
+    DEFINE_METRIC(stats->busyThreadsMetric_, velox::StatType::AVG);
+    DEFINE_METRIC(stats->cpuUtilizationPctMetric_, velox::StatType::AVG);
+    DEFINE_METRIC(
+        stats->maxThreadCpuUtilizationPctMetric_, velox::StatType::AVG);
+    DEFINE_HISTOGRAM_METRIC(
+        stats->runQueueDelayUsMetric_, 10'000, 0, 2'000'000, 50, 90, 99, 100);
+    DEFINE_METRIC(stats->runQueueDelayPctMetric_, velox::StatType::AVG);
+    DEFINE_METRIC(stats->voluntaryContextSwitchesMetric_, velox::StatType::SUM);
+    DEFINE_METRIC(
+        stats->involuntaryContextSwitchesMetric_, velox::StatType::SUM);
+  }
+}
+
+// static
+void ExecutorStats::reportMetrics() {
+  for (const auto& stats : allStats()) {
+    const auto sample = stats->sample();
+    RECORD_METRIC_VALUE(
+        folly::StringPiece(stats->busyThreadsMetric_), sample.numBusyThreads);
+    RECORD_METRIC_VALUE(
+        folly::StringPiece(stats->cpuUtilizationPctMetric_),
+        std::lround(sample.cpuUtilizationPct));
+    RECORD_METRIC_VALUE(
+        folly::StringPiece(stats->maxThreadCpuUtilizationPctMetric_),
+        std::lround(sample.maxThreadCpuUtilizationPct));
+    for (const auto delayUs : sample.threadRunQueueDelayUs) {
+      RECORD_HISTOGRAM_METRIC_VALUE(
+          folly::StringPiece(stats->runQueueDelayUsMetric_), delayUs);
+    }
+    RECORD_METRIC_VALUE(
+        folly::StringPiece(stats->runQueueDelayPctMetric_),
+        std::lround(sample.runQueueDelayPct));
+    RECORD_METRIC_VALUE(
+        folly::StringPiece(stats->voluntaryContextSwitchesMetric_),
+        sample.numVoluntaryContextSwitches);
+    RECORD_METRIC_VALUE(
+        folly::StringPiece(stats->involuntaryContextSwitchesMetric_),
+        sample.numInvoluntaryContextSwitches);
+  }
+}
+
+// static
+void ExecutorStats::setTaskSampleRate(uint32_t sampleRate) {
+  taskSampleRate_.store(sampleRate, std::memory_order_relaxed);
+}
+
+folly::Func ExecutorStats::wrap(folly::Func func) {
+  const auto sampleRate = taskSampleRate();
+  if (sampleRate == 0 && !QueryTraceRecorder::enabled()) {
+    return func;
+  }
+  // Counted per adding thread to keep the adds of different threads off a
+  // shared cache line.
+  thread_local uint32_t numAdded{0};
+  const bool sampled = sampleRate > 0 && ++numAdded % sampleRate == 0;
+  const auto enqueueTime = sampled ? std::chrono::steady_clock::now()
+                                   : std::chrono::steady_clock::time_point{};
+  return [this,
+          func = std::move(func),
+          sampleRate,
+          sampled,
+          enqueueTime]() mutable {
+    if (sampled) {
+      RECORD_HISTOGRAM_METRIC_VALUE(
+          folly::StringPiece(queueWaitUsMetric_), elapsedUs(enqueueTime));
+    }
+    // The clock is read only if the run is timed or traced.
+    const bool traced = QueryTraceRecorder::enabled();
+    const auto startTime = sampled || traced
+        ? std::chrono::steady_clock::now()
+        : std::chrono::steady_clock::time_point{};
+    if (sampleRate > 0) {
+      ++numBusyThreads_;
+    }
+    SCOPE_EXIT {
+      if (sampleRate > 0) {
+        --numBusyThreads_;
+      }
+      if (sampled) {
+        RECORD_HISTOGRAM_METRIC_VALUE(
+            folly::StringPiece(runTimeUsMetric_), elapsedUs(startTime));
+      }
+      if (traced) {
+        QueryTraceRecorder::recordRun(
+            name_.c_str(), startTime, std::chrono::steady_clock::now());
+      }
+    };
+    func();
+  };
+}
+
+uint64_t ExecutorStats::addThread() {
+  Thread thread;
+#ifdef __linux__
+  // The clock of the thread can be read by the sampling thread while the
+  // thread is registered.
+  clockid_t clockId;
+  if (pthread_getcpuclockid(pthread_self(), &clockId) == 0) {
+    thread.clockId = clockId;
+    thread.lastCpuNanos = cpuTimeNanos(clockId);
+  }
+  const auto osThreadId = static_cast<pid_t>(syscall(SYS_gettid));
+  if (auto schedStats = readSchedStats(osThreadId)) {
+    thread.osThreadId = osThreadId;
+    thread.lastSchedStats = schedStats.value();
+  }
+#endif
+  return threads_.withWLock([&](auto& threads) {
+    const auto id = threads.nextId++;
+    threads.threads.emplace(id, thread);
+    return id;
+  });
+}
+
+void ExecutorStats::removeThread(uint64_t id) {
+  threads_.withWLock([&](auto& threads) {
+    auto it = threads.threads.find(id);
+    if (it == threads.threads.end()) {
+      return;
+    }
+    if (it->second.clockId.has_value()) {
+      const auto cpuNanos = cpuTimeNanos(CLOCK_THREAD_CPUTIME_ID);
+      threads.exitedCpuNanos +=
+          cpuNanos - std::min(cpuNanos, it->second.lastCpuNanos);
+    }
+    threads.threads.erase(it);
+  });
+}
+
+ExecutorStats::Sample ExecutorStats::sample() {
+  Sample sample;
+  sample.numBusyThreads = numBusyThreads_;
+  threads_.withWLock([&](auto& threads) {
+    const auto now = std::chrono::steady_clock::now();
+    const auto wallNanos =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - threads.lastSampleTime)
+            .count();
+    threads.lastSampleTime = now;
+
+    uint64_t cpuNanos = threads.exitedCpuNanos;
+    uint64_t maxThreadCpuNanos = 0;
+    uint64_t runNanos = 0;
+    uint64_t waitNanos = 0;
+    threads.exitedCpuNanos = 0;
+    for (auto& [id, thread] : threads.threads) {
+      if (thread.clockId.has_value()) {
+        const auto threadCpuNanos = cpuTimeNanos(thread.clockId.value());
+        const auto cpuDelta = delta(threadCpuNanos, thread.lastCpuNanos);
+        thread.lastCpuNanos = threadCpuNanos;
+        cpuNanos += cpuDelta;
+        maxThreadCpuNanos = std::max(maxThreadCpuNanos, cpuDelta);
+      }
+
+      if (!thread.osThreadId.has_value()) {
+        continue;
+      }
+      const auto schedStats = readSchedStats(thread.osThreadId.value());
+      if (!schedStats.has_value()) {
+        continue;
+      }
+      const auto& last = thread.lastSchedStats;
+      const auto threadWaitNanos = delta(schedStats->waitNanos, last.waitNanos);
+      runNanos += delta(schedStats->runNanos, last.runNanos);
+      waitNanos += threadWaitNanos;
+      sample.threadRunQueueDelayUs.push_back(threadWaitNanos / 1'000);
+      sample.numVoluntaryContextSwitches += delta(
+          schedStats->numVoluntaryContextSwitches,
+          last.numVoluntaryContextSwitches);
+      sample.numInvoluntaryContextSwitches += delta(
+          schedStats->numInvoluntaryContextSwitches,
+          last.numInvoluntaryContextSwitches);
+      thread.lastSchedStats = schedStats.value();
+    }
+    if (runNanos + waitNanos > 0) {
+      sample.runQueueDelayPct = 100.0 * waitNanos / (runNanos + waitNanos);
+    }
+
+    sample.numThreads = threads.threads.size();
+    if (wallNanos > 0 && sample.numThreads > 0) {
+      sample.cpuUtilizationPct =
+          100.0 * cpuNanos / (wallNanos * sample.numThreads);
+      sample.maxThreadCpuUtilizationPct =
+          100.0 * maxThreadCpuNanos / wallNanos;
+    }
+  });
+  return sample;
+}
+
+// static
+std::optional<ExecutorStats::SchedStats> ExecutorStats::readSchedStats(
+    pid_t osThreadId) {
+  const auto taskPath = fmt::format("/proc/self/task/{}", osThreadId);
+  std::string contents;
+  // '<run time ns> <run-queue wait time ns> <number of time slices>'.
+  if (!folly::readFile((taskPath + "/schedstat").c_str(), contents)) {
+    return std::nullopt;
+  }
+  SchedStats stats;
+  if (sscanf(
+          contents.c_str(),
+          "%" SCNu64 " %" SCNu64,
+          &stats.runNanos,
+          &stats.waitNanos) != 2) {
+    return std::nullopt;
+  }
+
+  if (!folly::readFile((taskPath + "/status").c_str(), contents)) {
+    return stats;
+  }
+  std::vector<folly::StringPiece> lines;
+  folly::split('\n', contents, lines, true);
+  for (auto line : lines) {
+    if (line.removePrefix("voluntary_ctxt_switches:")) {
+      stats.numVoluntaryContextSwitches =
+          folly::tryTo<uint64_t>(folly::trimWhitespace(line)).value_or(0);
+    } else if (line.removePrefix("nonvoluntary_ctxt_switches:")) {
+      stats.numInvoluntaryContextSwitches =
+          folly::tryTo<uint64_t>(folly::trimWhitespace(line)).value_or(0);
+    }
+  }
+  return stats;
+}
+
+InstrumentedThreadFactory::InstrumentedThreadFactory(const std::string& name)
+    : NamedThreadFactory(name), stats_(ExecutorStats::get(name)) {}
+
+std::thread InstrumentedThreadFactory::newThread(folly::Func&& func) {
+  return folly::NamedThreadFactory::newThread(
+      [stats = stats_, func = std::move(func)]() mutable {
+        const auto id = stats->addThread();
+        SCOPE_EXIT {
+          stats->removeThread(id);
+        };
+        func();
+      });
+}
+
+} // namespace facebook::presto
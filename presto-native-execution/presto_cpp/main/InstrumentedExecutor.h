@@ -0,0 +1,204 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Synchronized.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <sys/types.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Utilization of the threads of a thread pool. If the task stats are
+/// enabled by setTaskSampleRate(), the tasks added to the pool through
+/// InstrumentedExecutor count their thread as busy while they run, and 1 in
+/// every N of them records the time it waited in the queue and its run time.
+/// The threads created by InstrumentedThreadFactory are sampled for their CPU
+/// time, which also covers the work the IO pools run directly on their event
+/// bases.
+///
+/// On Linux, the scheduler stats of the threads are read from
+/// /proc/self/task/<tid>/schedstat and status: the time the threads were
+/// runnable but waiting for a CPU, i.e. their run-queue delay, and their
+/// context switches.
+///
+/// The metrics of a pool are named
+/// presto_cpp.thread_pool.<pool>.{queue_wait_us,run_time_us,busy_threads,
+/// cpu_utilization_pct,max_thread_cpu_utilization_pct,run_queue_delay_us,
+/// run_queue_delay_pct,voluntary_context_switches,
+/// involuntary_context_switches}, where <pool> is the lower case thread name
+/// prefix.
+class ExecutorStats {
+ public:
+  /// Utilization of the pool since the previous sample.
+  struct Sample {
+    int32_t numThreads{0};
+    int32_t numBusyThreads{0};
+    /// CPU time of all the threads as a percentage of the wall time times
+    /// the number of threads.
+    double cpuUtilizationPct{0};
+    /// CPU time of the busiest thread as a percentage of the wall time. A
+    /// value close to 100 means a saturated event loop in an IO pool.
+    double maxThreadCpuUtilizationPct{0};
+    /// Run-queue delay of each thread in microseconds.
+    std::vector<uint64_t> threadRunQueueDelayUs;
+    /// Run-queue delay of all the threads as a percentage of the time they
+    /// were runnable, i.e. running or waiting for a CPU.
+    double runQueueDelayPct{0};
+    uint64_t numVoluntaryContextSwitches{0};
+    uint64_t numInvoluntaryContextSwitches{0};
+  };
+
+  explicit ExecutorStats(const std::string& name);
+
+  /// Returns the stats of the pool with thread name prefix 'name', creating
+  /// them on first use. The stats are never freed.
+  static std::shared_ptr<ExecutorStats> get(const std::string& name);
+
+  /// Registers the metrics of all the pools created so far.
+  static void registerMetrics();
+
+  /// Records the gauges of all the pools. Invoked periodically.
+  static void reportMetrics();
+
+  /// Enables the task stats of all the pools for 1 in every 'sampleRate'
+  /// tasks. 0 disables them.
+  static void setTaskSampleRate(uint32_t sampleRate);
+
+  static uint32_t taskSampleRate() {
+    return taskSampleRate_.load(std::memory_order_relaxed);
+  }
+
+  const std::string& name() const {
+    return name_;
+  }
+
+  /// Wraps 'func' to count its thread as busy while it runs and, if sampled,
+  /// to record its queue wait and run time. Returns 'func' as is if the task
+  /// stats are disabled and no query is traced.
+  folly::Func wrap(folly::Func func);
+
+  /// Invoked on a new thread of the pool before it runs any task. Returns the
+  /// id to pass to removeThread() when the thread exits.
+  uint64_t addThread();
+
+  /// Invoked on the thread 'id' right before it exits.
+  void removeThread(uint64_t id);
+
+  /// Returns the utilization since the previous call.
+  Sample sample();
+
+ private:
+  struct SchedStats {
+    uint64_t runNanos{0};
+    uint64_t waitNanos{0};
+    uint64_t numVoluntaryContextSwitches{0};
+    uint64_t numInvoluntaryContextSwitches{0};
+  };
+
+  static std::optional<SchedStats> readSchedStats(pid_t osThreadId);
+
+  struct Thread {
+    std::optional<clockid_t> clockId;
+    uint64_t lastCpuNanos{0};
+    // Linux thread id, set if the scheduler stats of the thread are
+    // readable.
+    std::optional<pid_t> osThreadId;
+    SchedStats lastSchedStats;
+  };
+
+  struct Threads {
+    uint64_t nextId{0};
+    std::map<uint64_t, Thread> threads;
+    // CPU time of the threads which exited since the last sample.
+    uint64_t exitedCpuNanos{0};
+    std::chrono::steady_clock::time_point lastSampleTime{
+        std::chrono::steady_clock::now()};
+  };
+
+  std::string metricName(std::string_view stat) const;
+
+  static std::atomic<uint32_t> taskSampleRate_;
+
+  const std::string name_;
+  // The metric keys are built once. They are recorded as folly::StringPiece,
+  // so that the reporter finds them by their interned address instead of
+  // hashing them on every record.
+  const std::string queueWaitUsMetric_;
+  const std::string runTimeUsMetric_;
+  const std::string runQueueDelayUsMetric_;
+  const std::string busyThreadsMetric_;
+  const std::string cpuUtilizationPctMetric_;
+  const std::string maxThreadCpuUtilizationPctMetric_;
+  const std::string runQueueDelayPctMetric_;
+  const std::string voluntaryContextSwitchesMetric_;
+  const std::string involuntaryContextSwitchesMetric_;
+  std::atomic<int32_t> numBusyThreads_{0};
+  folly::Synchronized<Threads> threads_;
+};
+
+/// Names the threads like folly::NamedThreadFactory and tracks their CPU time
+/// in the ExecutorStats of the name prefix.
+class InstrumentedThreadFactory : public folly::NamedThreadFactory {
+ public:
+  explicit InstrumentedThreadFactory(const std::string& name);
+
+  std::thread newThread(folly::Func&& func) override;
+
+  const std::shared_ptr<ExecutorStats>& stats() const {
+    return stats_;
+  }
+
+ private:
+  const std::shared_ptr<ExecutorStats> stats_;
+};
+
+/// A folly thread pool executor whose tasks are instrumented by the
+/// ExecutorStats of its thread factory. Constructed with the arguments of
+/// 'Executor' with the thread factory moved to the front, e.g.
+/// InstrumentedExecutor<folly::CPUThreadPoolExecutor>(factory, numThreads).
+template <typename Executor>
+class InstrumentedExecutor : public Executor {
+ public:
+  template <typename... Args>
+  InstrumentedExecutor(
+      std::shared_ptr<InstrumentedThreadFactory> threadFactory,
+      size_t numThreads,
+      Args&&... args)
+      : Executor(numThreads, std::forward<Args>(args)..., threadFactory),
+        stats_(threadFactory->stats().get()) {}
+
+  using Executor::add;
+
+  void add(folly::Func func) override {
+    Executor::add(stats_->wrap(std::move(func)));
+  }
+
+  void addWithPriority(folly::Func func, int8_t priority) override {
+    Executor::addWithPriority(stats_->wrap(std::move(func)), priority);
+  }
+
+ private:
+  // Owned by the thread factory and the registry of the stats.
+  ExecutorStats* const stats_;
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,133 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/LongPollTimer.h"
+#include <glog/logging.h>
+#include "velox/common/base/Exceptions.h"
+
+namespace facebook::presto {
+
+LongPollTimer::LongPollTimer(
+    folly::Executor* executor,
+    std::chrono::milliseconds tick)
+    : executor_(executor),
+      tickMicros_(
+          std::chrono::duration_cast<std::chrono::microseconds>(tick).count()),
+      eventBaseThread_("LongPollTimer") {
+  VELOX_CHECK_NOT_NULL(executor_);
+  VELOX_CHECK_GT(tickMicros_, 0);
+}
+
+LongPollTimer::~LongPollTimer() {
+  // The buckets must be cancelled on the event base thread.
+  std::vector<folly::Function<void()>> callbacks;
+  eventBaseThread_.getEventBase()->runInEventBaseThreadAndWait([&]() {
+    auto buckets = buckets_.wlock();
+    for (auto& [_, bucket] : *buckets) {
+      for (auto& callback : bucket->callbacks) {
+        callbacks.push_back(std::move(callback));
+      }
+    }
+    buckets->clear();
+  });
+  numPendingCallbacks_ -= callbacks.size();
+  // Expire the pending callbacks early rather than dropping them, which would
+  // break the promises of the long-polls waiting for them. They run inline as
+  // the executor may be shutting down too.
+  runCallbacks(callbacks);
+}
+
+// static
+void LongPollTimer::runCallbacks(
+    std::vector<folly::Function<void()>>& callbacks) {
+  for (auto& callback : callbacks) {
+    try {
+      callback();
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Long-poll expiry callback failed: " << e.what();
+    }
+  }
+}
+
+uint64_t LongPollTimer::nowMicros() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void LongPollTimer::schedule(
+    std::chrono::microseconds timeout,
+    folly::Function<void()> callback) {
+  const uint64_t deadlineMicros =
+      nowMicros() + std::max<int64_t>(0, timeout.count());
+  // Round up so that the callback never runs before its timeout.
+  const uint64_t tick = (deadlineMicros + tickMicros_ - 1) / tickMicros_;
+
+  bool newBucket{false};
+  buckets_.withWLock([&](auto& buckets) {
+    auto& bucket = buckets[tick];
+    if (bucket == nullptr) {
+      bucket = std::make_unique<Bucket>(this, tick);
+      newBucket = true;
+    }
+    bucket->callbacks.push_back(std::move(callback));
+  });
+  ++numPendingCallbacks_;
+
+  if (newBucket) {
+    eventBaseThread_.getEventBase()->runInEventBaseThread(
+        [this, tick]() { arm(tick); });
+  }
+}
+
+folly::Future<folly::Unit> LongPollTimer::sleep(
+    std::chrono::microseconds timeout) {
+  auto [promise, future] = folly::makePromiseContract<folly::Unit>();
+  schedule(timeout, [promise = std::move(promise)]() mutable {
+    promise.setValue();
+  });
+  return std::move(future).via(executor_);
+}
+
+void LongPollTimer::arm(uint64_t tick) {
+  const auto now = nowMicros();
+  const auto deadlineMicros = tick * tickMicros_;
+  const auto delay = std::chrono::ceil<std::chrono::milliseconds>(
+      std::chrono::microseconds(
+          deadlineMicros > now ? deadlineMicros - now : 0));
+  auto buckets = buckets_.wlock();
+  auto it = buckets->find(tick);
+  if (it != buckets->end()) {
+    eventBaseThread_.getEventBase()->timer().scheduleTimeout(
+        it->second.get(), delay);
+  }
+}
+
+void LongPollTimer::expire(uint64_t tick) {
+  std::unique_ptr<Bucket> bucket;
+  {
+    auto buckets = buckets_.wlock();
+    auto it = buckets->find(tick);
+    if (it == buckets->end()) {
+      return;
+    }
+    bucket = std::move(it->second);
+    buckets->erase(it);
+  }
+  numPendingCallbacks_ -= bucket->callbacks.size();
+  executor_->add([callbacks = std::move(bucket->callbacks)]() mutable {
+    runCallbacks(callbacks);
+  });
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,141 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Executor.h>
+#include <folly/Function.h>
+#include <folly/Synchronized.h>
+#include <folly/container/F14Map.h>
+#include <folly/futures/Future.h>
+#include <folly/io/async/HHWheelTimer.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+
+namespace facebook::presto {
+
+/// Shared expiry service for long-poll HTTP requests. Installing a folly
+/// timeout per request creates a timer per request, which adds up under heavy
+/// fan-in. Instead, the expiration times are rounded up to a tick and grouped
+/// into buckets. Each bucket arms a single HHWheelTimer timeout on a dedicated
+/// event base thread and, when due, runs all its callbacks as one task on the
+/// executor.
+class LongPollTimer {
+ public:
+  explicit LongPollTimer(
+      folly::Executor* executor,
+      std::chrono::milliseconds tick = std::chrono::milliseconds(10));
+
+  /// Runs the pending callbacks on the calling thread without waiting for
+  /// their timeouts.
+  ~LongPollTimer();
+
+  /// Runs 'callback' on the executor once 'timeout' has elapsed. The callback
+  /// may run up to one tick late.
+  void schedule(
+      std::chrono::microseconds timeout,
+      folly::Function<void()> callback);
+
+  /// Returns a future completed on the executor once 'timeout' has elapsed.
+  folly::Future<folly::Unit> sleep(std::chrono::microseconds timeout);
+
+  /// Returns a future that completes with the result of 'future' or, if that
+  /// does not complete within 'timeout', with the result of 'timeoutFn'.
+  /// Equivalent to folly::Future::onTimeout() without a timer per call.
+  template <typename T, typename F>
+  folly::Future<T> onTimeout(
+      folly::Future<T> future,
+      std::chrono::microseconds timeout,
+      F timeoutFn);
+
+  /// Number of callbacks waiting for their buckets to expire.
+  size_t numPendingCallbacks() const {
+    return numPendingCallbacks_;
+  }
+
+  /// Number of buckets, i.e. armed HHWheelTimer timeouts.
+  size_t numPendingBuckets() const {
+    return buckets_.rlock()->size();
+  }
+
+ private:
+  class Bucket : public folly::HHWheelTimer::Callback {
+   public:
+    Bucket(LongPollTimer* timer, uint64_t tick) : timer_(timer), tick_(tick) {}
+
+    void timeoutExpired() noexcept override {
+      timer_->expire(tick_);
+    }
+
+    std::vector<folly::Function<void()>> callbacks;
+
+   private:
+    LongPollTimer* const timer_;
+    const uint64_t tick_;
+  };
+
+  // Runs 'callbacks', logging their errors.
+  static void runCallbacks(std::vector<folly::Function<void()>>& callbacks);
+
+  uint64_t nowMicros() const;
+
+  // Arms the HHWheelTimer timeout of the bucket expiring at 'tick'. Runs on the
+  // event base thread.
+  void arm(uint64_t tick);
+
+  // Removes the bucket expiring at 'tick' and runs its callbacks on the
+  // executor. Runs on the event base thread.
+  void expire(uint64_t tick);
+
+  folly::Executor* const executor_;
+  const uint64_t tickMicros_;
+  folly::ScopedEventBaseThread eventBaseThread_;
+  std::atomic<size_t> numPendingCallbacks_{0};
+  // Buckets keyed by their expiration time in ticks.
+  folly::Synchronized<folly::F14FastMap<uint64_t, std::unique_ptr<Bucket>>>
+      buckets_;
+};
+
+template <typename T, typename F>
+folly::Future<T> LongPollTimer::onTimeout(
+    folly::Future<T> future,
+    std::chrono::microseconds timeout,
+    F timeoutFn) {
+  // Whichever of 'future' and the timeout comes first fulfills the promise.
+  struct State {
+    explicit State(F _timeoutFn) : timeoutFn(std::move(_timeoutFn)) {}
+
+    folly::Promise<T> promise;
+    std::atomic_bool done{false};
+    F timeoutFn;
+  };
+  auto state = std::make_shared<State>(std::move(timeoutFn));
+  auto result = state->promise.getSemiFuture().via(executor_);
+
+  // The timer holds a weak reference, so that a long-poll which completes
+  // early is not kept alive until its expiration.
+  schedule(timeout, [weakState = std::weak_ptr<State>(state)]() {
+    if (auto state = weakState.lock()) {
+      if (!state->done.exchange(true)) {
+        state->promise.setWith([&]() { return state->timeoutFn(); });
+      }
+    }
+  });
+  std::move(future).thenTry([state](folly::Try<T>&& value) {
+    if (!state->done.exchange(true)) {
+      state->promise.setTry(std::move(value));
+    }
+  });
+  return result;
+}
+
+} // namespace facebook::presto
@@ -13,12 +13,51 @@
  */
 
 #include "presto_cpp/main/PeriodicMemoryChecker.h"
+#include <folly/FileUtil.h>
+#include <cmath>
 #include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/common/Counters.h"
 #include "presto_cpp/main/common/Utils.h"
+#include "velox/common/base/StatsReporter.h"
 #include "velox/common/caching/AsyncDataCache.h"
 #include "velox/common/memory/Memory.h"
 
 namespace facebook::presto {
+namespace {
+
+struct PushbackCounters {
+  folly::StringPiece count;
+  folly::StringPiece freedBytes;
+};
+
+const PushbackCounters& counters(PeriodicMemoryChecker::PushbackAction action) {
+  static const std::array<PushbackCounters, 4> kCounters{{
+      {kCounterMemoryPushbackNumCacheShrinks,
+       kCounterMemoryPushbackCacheShrinkBytes},
+      {kCounterMemoryPushbackNumSpills, kCounterMemoryPushbackSpillBytes},
+      {kCounterMemoryPushbackNumTaskAdmissionPauses, {}},
+      {kCounterMemoryPushbackNumHardLimits,
+       kCounterMemoryPushbackHardLimitBytes},
+  }};
+  return kCounters[static_cast<size_t>(action)];
+}
+} // namespace
+
+// static
+std::string_view PeriodicMemoryChecker::toString(PushbackAction action) {
+  switch (action) {
+    case PushbackAction::kShrinkCache:
+      return "SHRINK_CACHE";
+    case PushbackAction::kSpill:
+      return "SPILL";
+    case PushbackAction::kPauseTaskAdmission:
+      return "PAUSE_TASK_ADMISSION";
+    case PushbackAction::kHardLimit:
+      return "HARD_LIMIT";
+  }
+  VELOX_UNREACHABLE();
+}
+
 PeriodicMemoryChecker::PeriodicMemoryChecker(Config config)
     : config_(std::move(config)) {
   if (config_.systemMemPushbackEnabled) {
@@ -48,6 +87,15 @@ void PeriodicMemoryChecker::start() {
         << velox::succinctBytes(config_.systemMemLimitBytes)
         << ", memory shrink size: "
         << velox::succinctBytes(config_.systemMemShrinkBytes);
+    if (config_.predictivePushbackEnabled) {
+      PRESTO_STARTUP_LOG(INFO)
+          << "Enabling predictive memory pushback, prediction window "
+          << config_.pushbackPredictionWindowMs
+          << "ms, memory pressure stall threshold "
+          << config_.memPressureStallPctThreshold
+          << "%, min consecutive predictions "
+          << config_.pushbackMinConsecutivePredictions;
+    }
   }
 
   if (!config_.mallocMemHeapDumpEnabled) {
@@ -72,9 +120,13 @@ void PeriodicMemoryChecker::start() {
         if (config_.mallocMemHeapDumpEnabled) {
           maybeDumpHeap();
         }
-        if (config_.systemMemPushbackEnabled &&
-            systemUsedMemoryBytes() > config_.systemMemLimitBytes) {
+        if (!config_.systemMemPushbackEnabled) {
+          return;
+        }
+        if (systemUsedMemoryBytes() > config_.systemMemLimitBytes) {
           pushbackMemory();
+        } else if (config_.predictivePushbackEnabled) {
+          predictivePushback(velox::getCurrentTimeMs());
         }
       },
       std::chrono::milliseconds(config_.memoryCheckerIntervalMs),
@@ -200,5 +252,191 @@ void PeriodicMemoryChecker::pushbackMemory() {
   }
 
   LOG(INFO) << "Shrunk " << velox::succinctBytes(freedBytes);
+  recordPushback(
+      velox::getCurrentTimeMs(),
+      PushbackAction::kHardLimit,
+      bytesToShrink,
+      freedBytes);
+}
+
+std::optional<PeriodicMemoryChecker::CgroupMemoryStats>
+PeriodicMemoryChecker::cgroupMemoryStats() {
+  if (!cgroupPathResolved_) {
+    cgroupPath_ = util::findProcessCgroupPath("memory.stat");
+    cgroupPathResolved_ = true;
+  }
+  if (!cgroupPath_.has_value()) {
+    return std::nullopt;
+  }
+  std::string stat;
+  if (!folly::readFile((cgroupPath_.value() + "/memory.stat").c_str(), stat)) {
+    return std::nullopt;
+  }
+  CgroupMemoryStats stats;
+  stats.anonBytes = util::keyValueStat(stat, "anon").value_or(0);
+  stats.fileBytes = util::keyValueStat(stat, "file").value_or(0);
+  std::string pressure;
+  if (folly::readFile(
+          (cgroupPath_.value() + "/memory.pressure").c_str(), pressure)) {
+    stats.someStalledUs = util::pressureStallTotalUs(pressure, "some");
+  }
+  return stats;
+}
+
+void PeriodicMemoryChecker::predictivePushback(uint64_t nowMs) {
+  VELOX_CHECK(config_.predictivePushbackEnabled);
+  const int64_t usedBytes = systemUsedMemoryBytes();
+  const auto cgroupStats = cgroupMemoryStats();
+  // The anonymous memory of the cgroup grows with the heap of the process,
+  // while its page cache is reclaimed by the kernel on its own.
+  const int64_t growthBytes = cgroupStats.has_value()
+      ? static_cast<int64_t>(cgroupStats->anonBytes)
+      : usedBytes;
+  const auto someStalledUs = cgroupStats.has_value()
+      ? cgroupStats->someStalledUs
+      : std::optional<uint64_t>();
+
+  double growthBytesPerSec{0};
+  std::optional<double> stallPct;
+  if (lastCheckTimeMs_ != 0 && nowMs > lastCheckTimeMs_) {
+    const double elapsedSec = (nowMs - lastCheckTimeMs_) / 1'000.0;
+    growthBytesPerSec = (growthBytes - lastGrowthBytes_) / elapsedSec;
+    if (someStalledUs.has_value() && lastSomeStalledUs_.has_value()) {
+      const auto stalledUs = someStalledUs.value() -
+          std::min(someStalledUs.value(), lastSomeStalledUs_.value());
+      stallPct = std::min(100.0, stalledUs / (elapsedSec * 10'000));
+    }
+  }
+  lastCheckTimeMs_ = nowMs;
+  lastGrowthBytes_ = growthBytes;
+  lastSomeStalledUs_ = someStalledUs;
+
+  const int64_t limitBytes = config_.systemMemLimitBytes;
+  const int64_t targetBytes = limitBytes -
+      std::min<int64_t>(config_.systemMemShrinkBytes, limitBytes);
+  const int64_t predictedBytes = usedBytes +
+      std::max(0.0, growthBytesPerSec) * config_.pushbackPredictionWindowMs /
+          1'000;
+  const bool overLimit = predictedBytes > limitBytes;
+  numConsecutivePredictions_ = overLimit ? numConsecutivePredictions_ + 1 : 0;
+  const bool underPressure = stallPct.has_value() &&
+      stallPct.value() >= config_.memPressureStallPctThreshold;
+
+  bool taskAdmissionPaused = pushbackState_.rlock()->taskAdmissionPaused;
+  if (overLimit || underPressure) {
+    // The memory pressure alone only shrinks the cache as it may come from
+    // the page cache of other processes.
+    const uint64_t bytesToFree = overLimit
+        ? predictedBytes - targetBytes
+        : config_.systemMemShrinkBytes;
+    LOG(WARNING) << "System used memory " << velox::succinctBytes(usedBytes)
+                 << " is predicted to reach "
+                 << velox::succinctBytes(predictedBytes) << " with limit "
+                 << velox::succinctBytes(limitBytes) << ", memory stall "
+                 << stallPct.value_or(0) << "%";
+    auto* cache = velox::cache::AsyncDataCache::getInstance();
+    uint64_t freedBytes = cache != nullptr ? cache->shrink(bytesToFree) : 0;
+    recordPushback(
+        nowMs, PushbackAction::kShrinkCache, bytesToFree, freedBytes);
+    if (overLimit && freedBytes < bytesToFree &&
+        numConsecutivePredictions_ >=
+            config_.pushbackMinConsecutivePredictions) {
+      try {
+        const auto spilledBytes = velox::memory::memoryManager()->shrinkPools(
+            bytesToFree - freedBytes,
+            /*allowSpill=*/true,
+            /*allowAbort=*/false);
+        recordPushback(
+            nowMs,
+            PushbackAction::kSpill,
+            bytesToFree - freedBytes,
+            spilledBytes);
+        freedBytes += spilledBytes;
+      } catch (const velox::VeloxException& ex) {
+        LOG(ERROR) << ex.what();
+      }
+      if (freedBytes < bytesToFree && !taskAdmissionPaused) {
+        LOG(WARNING) << "Pausing task admission";
+        pauseTaskAdmission(true);
+        taskAdmissionPaused = true;
+        recordPushback(
+            nowMs,
+            PushbackAction::kPauseTaskAdmission,
+            bytesToFree - freedBytes,
+            0);
+      }
+    }
+  } else if (taskAdmissionPaused && predictedBytes < targetBytes) {
+    LOG(INFO) << "Resuming task admission, system used memory "
+              << velox::succinctBytes(usedBytes);
+    pauseTaskAdmission(false);
+    taskAdmissionPaused = false;
+  }
+
+  RECORD_METRIC_VALUE(kCounterMemoryPushbackPredictedBytes, predictedBytes);
+  RECORD_METRIC_VALUE(
+      kCounterMemoryPushbackGrowthBytesPerSec,
+      std::max<int64_t>(0, growthBytesPerSec));
+  if (stallPct.has_value()) {
+    RECORD_METRIC_VALUE(
+        kCounterMemoryPushbackStallPct, std::lround(stallPct.value()));
+  }
+  RECORD_METRIC_VALUE(
+      kCounterMemoryPushbackTaskAdmissionPaused, taskAdmissionPaused ? 1 : 0);
+
+  pushbackState_.withWLock([&](auto& state) {
+    state.usedBytes = usedBytes;
+    state.predictedBytes = predictedBytes;
+    state.growthBytesPerSec = growthBytesPerSec;
+    state.stallPct = stallPct;
+    state.cgroupStats = cgroupStats;
+    state.taskAdmissionPaused = taskAdmissionPaused;
+  });
+}
+
+void PeriodicMemoryChecker::recordPushback(
+    uint64_t nowMs,
+    PushbackAction action,
+    uint64_t targetBytes,
+    uint64_t freedBytes) {
+  const auto& actionCounters = counters(action);
+  RECORD_METRIC_VALUE(actionCounters.count);
+  if (!actionCounters.freedBytes.empty()) {
+    RECORD_METRIC_VALUE(actionCounters.freedBytes, freedBytes);
+  }
+  pushbackState_.withWLock([&](auto& state) {
+    state.events.push_back({nowMs, action, targetBytes, freedBytes});
+    if (state.events.size() > kMaxPushbackEvents) {
+      state.events.pop_front();
+    }
+  });
+}
+
+folly::dynamic PeriodicMemoryChecker::pushbackState() const {
+  return pushbackState_.withRLock([&](const auto& state) {
+    folly::dynamic events = folly::dynamic::array;
+    for (const auto& event : state.events) {
+      folly::dynamic eventObj = folly::dynamic::object;
+      eventObj["timeMs"] = event.timeMs;
+      eventObj["action"] = std::string(toString(event.action));
+      eventObj["targetBytes"] = event.targetBytes;
+      eventObj["freedBytes"] = event.freedBytes;
+      events.push_back(std::move(eventObj));
+    }
+    folly::dynamic obj = folly::dynamic::object;
+    obj["usedBytes"] = state.usedBytes;
+    obj["predictedBytes"] = state.predictedBytes;
+    obj["growthBytesPerSec"] = state.growthBytesPerSec;
+    obj["stallPct"] = state.stallPct.has_value()
+        ? folly::dynamic(state.stallPct.value())
+        : folly::dynamic(nullptr);
+    if (state.cgroupStats.has_value()) {
+      obj["cgroupAnonBytes"] = state.cgroupStats->anonBytes;
+      obj["cgroupFileBytes"] = state.cgroupStats->fileBytes;
+    }
+    obj["taskAdmissionPaused"] = state.taskAdmissionPaused;
+    obj["events"] = std::move(events);
+    return obj;
+  });
 }
 } // namespace facebook::presto
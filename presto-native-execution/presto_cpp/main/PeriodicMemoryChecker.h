@@ -12,14 +12,25 @@
  * limitations under the License.
  */
 #pragma once
+#include <folly/Synchronized.h>
 #include <folly/experimental/FunctionScheduler.h>
+#include <folly/json/dynamic.h>
 #include <cstdint>
+#include <deque>
+#include <optional>
 #include <queue>
 #include <string>
 
 namespace facebook::presto {
 /// Utility class that spawns a thread which periodically checks the memory
 /// usage and perform the following actions:
+///
+/// The class is abstract: the memory readings and the heap dump are
+/// implemented by a derived class. PrestoServer does not run one by itself. A
+/// derived PrestoServer which does builds the Config with
+/// PrestoServer::memoryCheckerConfig(), forwards pauseTaskAdmission() to
+/// PrestoServer::pauseTaskAdmission() and returns the checker from
+/// PrestoServer::memoryChecker().
 class PeriodicMemoryChecker {
  public:
   struct Config {
@@ -63,6 +74,68 @@ class PeriodicMemoryChecker {
     /// Only applies if 'mallocMemHeapDumpEnabled' is true. Memory (in bytes)
     /// allocated via malloc() that triggers the heap dump. Default is 20GB.
     size_t mallocBytesUsageDumpThreshold{20UL * 1024 * 1024 * 1024};
+
+    /// If true, starts the graduated memory pushback before the system memory
+    /// usage reaches 'systemMemLimitBytes', when the usage is predicted to
+    /// reach the limit within 'pushbackPredictionWindowMs' at its current
+    /// growth rate or when the memory pressure stall of the cgroup exceeds
+    /// 'memPressureStallPctThreshold'. This only applies if
+    /// 'systemMemPushbackEnabled' is true. See predictivePushback().
+    bool predictivePushbackEnabled{false};
+
+    /// Only applies if 'predictivePushbackEnabled' is true. The time ahead
+    /// for which the memory usage is extrapolated.
+    uint64_t pushbackPredictionWindowMs{10'000};
+
+    /// Only applies if 'predictivePushbackEnabled' is true. Percentage of the
+    /// wall time some tasks of the cgroup were stalled on memory, from the
+    /// memory.pressure PSI file, which triggers the cache shrink.
+    double memPressureStallPctThreshold{10};
+
+    /// Only applies if 'predictivePushbackEnabled' is true. Number of
+    /// consecutive checks for which the memory usage must be predicted to
+    /// exceed 'systemMemLimitBytes' before requesting spilling and pausing the
+    /// task admission, so that a single interval of fast growth only shrinks
+    /// the cache.
+    uint32_t pushbackMinConsecutivePredictions{3};
+  };
+
+  /// The actions of the memory pushback, in the order the predictive pushback
+  /// escalates them.
+  enum class PushbackAction {
+    /// Shrinks the memory and SSD cache.
+    kShrinkCache,
+    /// Requests the memory arbitrator to spill the queries.
+    kSpill,
+    /// Stops admitting new tasks until the memory usage is predicted to stay
+    /// below the limit. See pauseTaskAdmission().
+    kPauseTaskAdmission,
+    /// The memory usage exceeded the limit. Shrinks the cache, unmaps the
+    /// allocator pages and optionally aborts the queries.
+    kHardLimit,
+  };
+
+  static std::string_view toString(PushbackAction action);
+
+  /// A pushback action taken, the bytes it tried to free and the bytes it
+  /// freed.
+  struct PushbackEvent {
+    uint64_t timeMs;
+    PushbackAction action;
+    uint64_t targetBytes;
+    uint64_t freedBytes;
+  };
+
+  /// Memory stats of the cgroup v2 of the process.
+  struct CgroupMemoryStats {
+    /// Anonymous memory of the cgroup, i.e. its resident heap, from
+    /// memory.stat.
+    uint64_t anonBytes{0};
+    /// Page cache memory of the cgroup from memory.stat.
+    uint64_t fileBytes{0};
+    /// Total time in microseconds some tasks of the cgroup were stalled on
+    /// memory, from memory.pressure. Not set if PSI is not enabled.
+    std::optional<uint64_t> someStalledUs;
   };
 
   explicit PeriodicMemoryChecker(Config config);
@@ -76,6 +149,11 @@ class PeriodicMemoryChecker {
   /// Stops the 'PeriodicMemoryChecker'.
   void stop();
 
+  /// Returns the state of the memory pushback: the latest memory usage, its
+  /// growth rate and pressure, whether the task admission is paused and the
+  /// most recent pushback actions. Thread-safe.
+  folly::dynamic pushbackState() const;
+
  protected:
   /// Returns current system memory usage. The returned value is used to compare
   /// with 'Config::systemMemLimitBytes'.
@@ -97,6 +175,25 @@ class PeriodicMemoryChecker {
   /// Returns true if dump is successful.
   virtual void removeDumpFile(const std::string& filePath) const = 0;
 
+  /// Returns the memory stats of the cgroup v2 of the process, or nullopt if
+  /// the process does not run in one.
+  virtual std::optional<CgroupMemoryStats> cgroupMemoryStats();
+
+  /// Invoked by the predictive pushback to stop, resp. resume, the admission
+  /// of new tasks, e.g. by making the worker inactive so that the coordinator
+  /// does not schedule new tasks on it. No-op by default.
+  virtual void pauseTaskAdmission(bool /*pause*/) {}
+
+  /// Invoked by the periodic checker when 'Config::predictivePushbackEnabled'
+  /// is true and system memory usage is below 'Config::systemMemLimitBytes'.
+  /// Extrapolates the usage with its growth rate and, if it would exceed the
+  /// limit or the memory pressure is high, shrinks the cache. If that frees
+  /// less than needed to stay 'Config::systemMemShrinkBytes' below the limit
+  /// and the usage was predicted to exceed the limit for
+  /// 'Config::pushbackMinConsecutivePredictions' checks in a row, requests
+  /// spilling and then pauses the task admission.
+  void predictivePushback(uint64_t nowMs);
+
   const Config config_;
 
  private:
@@ -129,6 +226,39 @@ class PeriodicMemoryChecker {
 
   std::string createHeapDumpFilePath() const;
 
+  void recordPushback(
+      uint64_t nowMs,
+      PushbackAction action,
+      uint64_t targetBytes,
+      uint64_t freedBytes);
+
+  static constexpr size_t kMaxPushbackEvents{100};
+
+  // Memory readings and pushback history, written by the checker thread and
+  // read by pushbackState().
+  struct PushbackState {
+    int64_t usedBytes{0};
+    int64_t predictedBytes{0};
+    double growthBytesPerSec{0};
+    std::optional<double> stallPct;
+    std::optional<CgroupMemoryStats> cgroupStats;
+    bool taskAdmissionPaused{false};
+    std::deque<PushbackEvent> events;
+  };
+
+  folly::Synchronized<PushbackState> pushbackState_;
+
+  // The readings of the previous predictive pushback check.
+  uint64_t lastCheckTimeMs_{0};
+  int64_t lastGrowthBytes_{0};
+  std::optional<uint64_t> lastSomeStalledUs_;
+  // Number of consecutive checks the usage was predicted over the limit.
+  uint32_t numConsecutivePredictions_{0};
+  // Cgroup v2 directory of the process, resolved on the first call of
+  // cgroupMemoryStats().
+  bool cgroupPathResolved_{false};
+  std::optional<std::string> cgroupPath_;
+
   std::shared_ptr<folly::FunctionScheduler> scheduler_;
   size_t lastHeapDumpAttemptTimestamp_{0};
   std::priority_queue<
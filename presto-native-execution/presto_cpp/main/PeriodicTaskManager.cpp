@@ -13,13 +13,22 @@
  */
 
 #include "presto_cpp/main/PeriodicTaskManager.h"
+#include <folly/FileUtil.h>
+#include <folly/String.h>
 #include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/InlineExecutor.h>
 #include <folly/stop_watch.h>
+#include "presto_cpp/main/CpuProfiler.h"
+#include "presto_cpp/main/InstrumentedExecutor.h"
 #include "presto_cpp/main/PrestoExchangeSource.h"
 #include "presto_cpp/main/PrestoServer.h"
+#include "presto_cpp/main/QueryTraceRecorder.h"
 #include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/common/Utils.h"
 #include "presto_cpp/main/http/HttpClient.h"
+#include "presto_cpp/main/http/filters/AccessLogWriter.h"
 #include "presto_cpp/main/http/filters/HttpEndpointLatencyFilter.h"
+#include "presto_cpp/main/http/filters/StatsFilter.h"
 #include "velox/common/base/PeriodicStatsReporter.h"
 #include "velox/common/base/StatsReporter.h"
 #include "velox/common/base/SuccinctPrinter.h"
@@ -79,6 +88,9 @@ static constexpr size_t kTaskPeriodGlobalCounters{2'000'000}; // 2 seconds.
 // Every two seconds we export exchange source counters.
 static constexpr size_t kExchangeSourcePeriodGlobalCounters{
     2'000'000}; // 2 seconds.
+// Every ten seconds we export the per-query resource usage.
+static constexpr size_t kQueryResourcePeriodGlobalCounters{
+    10'000'000}; // 10 seconds.
 // Every 1 minute we clean old tasks.
 static constexpr size_t kTaskPeriodCleanOldTasks{60'000'000}; // 60 seconds.
 // Every 1 minute we export connector counters.
@@ -89,6 +101,10 @@ static constexpr size_t kHttpServerPeriodGlobalCounters{
     60'000'000}; // 60 seconds.
 static constexpr size_t kHttpClientPeriodGlobalCounters{
     60'000'000}; // 60 seconds.
+// Every second we collect the samples of the background CPU profiler.
+static constexpr size_t kCpuProfilerPeriodCollect{1'000'000}; // 1 second.
+// Every 50ms we sample the operator stats of the traced queries.
+static constexpr size_t kQueryTracePeriodCollect{50'000}; // 50 milliseconds.
 
 PeriodicTaskManager::PeriodicTaskManager(
     folly::CPUThreadPoolExecutor* driverCPUExecutor,
@@ -128,27 +144,42 @@ void PeriodicTaskManager::start() {
   VELOX_CHECK_NOT_NULL(taskManager_);
   addTaskStatsTask();
 
+  if (taskManager_->queryResourceMetrics() != nullptr) {
+    addQueryResourceStatsTask();
+  }
+
   if (SystemConfig::instance()->enableOldTaskCleanUp()) {
     addOldTaskCleanupTask();
   }
 
+  addQueryTraceTask();
+
   addPrestoExchangeSourceMemoryStatsTask();
 
   addConnectorStatsTask();
 
   addOperatingSystemStatsUpdateTask();
 
-  if (SystemConfig::instance()->enableHttpEndpointLatencyFilter()) {
+  if (SystemConfig::instance()->enableHttpStatsFilter() ||
+      SystemConfig::instance()->enableHttpEndpointLatencyFilter()) {
     addHttpServerStatsTask();
   }
 
   addHttpClientStatsTask();
 
+  if (SystemConfig::instance()->enableHttpAccessLog()) {
+    addHttpAccessLogStatsTask();
+  }
+
   if (server_ && server_->hasCoordinatorDiscoverer()) {
     numDriverThreads_ = server_->numDriverThreads();
     addWatchdogTask();
   }
 
+  if (SystemConfig::instance()->cpuProfilerBackgroundFrequencyHz() > 0) {
+    addCpuProfilerTask();
+  }
+
   oneTimeRunner_.start();
 }
 
@@ -157,6 +188,13 @@ void PeriodicTaskManager::stop() {
   oneTimeRunner_.cancelAllFunctionsAndWait();
   oneTimeRunner_.shutdown();
   repeatedRunner_.stop();
+  // The connection pool is destroyed after the periodic tasks stop.
+  if (connectionPoolStats_.valid()) {
+    connectionPoolStats_.wait();
+  }
+  if (CpuProfiler::backgroundEnabled()) {
+    CpuProfiler::setBackgroundFrequency(0);
+  }
 }
 
 void PeriodicTaskManager::updateExecutorStats() {
@@ -195,6 +233,8 @@ void PeriodicTaskManager::updateExecutorStats() {
           kCounterHTTPExecutorLatencyMs, timer.elapsed().count());
     });
   }
+  // Report the utilization of all the thread pools.
+  ExecutorStats::reportMetrics();
 }
 
 void PeriodicTaskManager::addExecutorStatsTask() {
@@ -245,6 +285,18 @@ void PeriodicTaskManager::addTaskStatsTask() {
       "task_counters");
 }
 
+void PeriodicTaskManager::updateQueryResourceStats() {
+  taskManager_->queryResourceMetrics()->report(
+      taskManager_->getRunningQueryResourceUsage());
+}
+
+void PeriodicTaskManager::addQueryResourceStatsTask() {
+  addTask(
+      [this]() { updateQueryResourceStats(); },
+      kQueryResourcePeriodGlobalCounters,
+      "query_resource_counters");
+}
+
 void PeriodicTaskManager::cleanupOldTask() {
   // Report the number of tasks and drivers in the system.
   if (taskManager_ != nullptr) {
@@ -401,6 +453,90 @@ void PeriodicTaskManager::updateOperatingSystemStats() {
       kCounterOsNumForcedContextSwitches,
       forcedContextSwitches - lastForcedContextSwitches_);
   lastForcedContextSwitches_ = forcedContextSwitches;
+
+#ifdef __linux__
+  updateMemoryPageStats();
+#endif
+}
+
+void PeriodicTaskManager::updateMemoryPageStats() {
+  // The /proc/vmstat counters reported as deltas.
+  static const std::vector<std::pair<std::string_view, folly::StringPiece>>
+      kVmStatCounters{
+          {"numa_pages_migrated", kCounterOsNumNumaPagesMigrated},
+          {"numa_hint_faults", kCounterOsNumNumaHintFaults},
+          {"thp_fault_alloc", kCounterOsNumThpFaultAllocs},
+          {"thp_fault_fallback", kCounterOsNumThpFaultFallbacks},
+          {"thp_collapse_alloc", kCounterOsNumThpCollapseAllocs},
+          {"thp_split_page", kCounterOsNumThpSplitPages}};
+
+  std::string contents;
+  if (folly::readFile("/proc/vmstat", contents)) {
+    for (const auto& [name, counter] : kVmStatCounters) {
+      // The NUMA counters are missing if the kernel has no NUMA support.
+      const auto value = util::keyValueStat(contents, name);
+      if (!value.has_value()) {
+        continue;
+      }
+      auto it = lastVmStats_.find(name);
+      if (it != lastVmStats_.end()) {
+        RECORD_METRIC_VALUE(
+            counter, value.value() - std::min(value.value(), it->second));
+      }
+      lastVmStats_[name] = value.value();
+    }
+  }
+
+  // The huge pages of the cgroup of the process, else of the host. Both are
+  // kept up to date by the kernel, unlike /proc/self/smaps_rollup which walks
+  // all the mappings of the process under its mmap lock.
+  if (!memoryCgroupPathResolved_) {
+    memoryCgroupPath_ = util::findProcessCgroupPath("memory.stat");
+    memoryCgroupPathResolved_ = true;
+  }
+  if (memoryCgroupPath_.has_value() &&
+      folly::readFile(
+          (memoryCgroupPath_.value() + "/memory.stat").c_str(), contents)) {
+    if (const auto bytes = util::keyValueStat(contents, "anon_thp")) {
+      RECORD_METRIC_VALUE(kCounterOsAnonHugePagesBytes, bytes.value());
+      return;
+    }
+  }
+  if (folly::readFile("/proc/meminfo", contents)) {
+    if (const auto kiloBytes = util::keyValueStat(contents, "AnonHugePages:")) {
+      RECORD_METRIC_VALUE(
+          kCounterOsAnonHugePagesBytes, kiloBytes.value() << 10);
+    }
+  }
+}
+
+void PeriodicTaskManager::collectQueryTraces() {
+  if (!QueryTraceRecorder::enabled()) {
+    return;
+  }
+  std::vector<std::shared_ptr<velox::exec::Task>> tasks;
+  for (const auto& [taskId, prestoTask] : taskManager_->tasks()) {
+    if (prestoTask->task != nullptr) {
+      tasks.push_back(prestoTask->task);
+    }
+  }
+  QueryTraceRecorder::collect(tasks);
+}
+
+void PeriodicTaskManager::addQueryTraceTask() {
+  addTask(
+      [this]() { collectQueryTraces(); },
+      kQueryTracePeriodCollect,
+      "query_trace");
+}
+
+void PeriodicTaskManager::addCpuProfilerTask() {
+  CpuProfiler::setBackgroundFrequency(
+      SystemConfig::instance()->cpuProfilerBackgroundFrequencyHz());
+  addTask(
+      []() { CpuProfiler::collect(); },
+      kCpuProfilerPeriodCollect,
+      "cpu_profiler");
 }
 
 void PeriodicTaskManager::addOperatingSystemStatsUpdateTask() {
@@ -411,15 +547,37 @@ void PeriodicTaskManager::addOperatingSystemStatsUpdateTask() {
 }
 
 void PeriodicTaskManager::printHttpServerStats() {
-  const auto latencyMetrics =
-      http::filters::HttpEndpointLatencyFilter::retrieveLatencies();
-  std::ostringstream oss;
-  oss << "Http endpoint latency \n[\n";
-  for (const auto& metrics : latencyMetrics) {
-    oss << metrics.toString() << ",\n";
+  if (SystemConfig::instance()->enableHttpEndpointLatencyFilter()) {
+    const auto latencyMetrics =
+        http::filters::HttpEndpointLatencyFilter::retrieveLatencies();
+    std::ostringstream oss;
+    oss << "Http endpoint latency \n[\n";
+    for (const auto& metrics : latencyMetrics) {
+      oss << metrics.toString() << ",\n";
+    }
+    oss << "]";
+    LOG(INFO) << oss.str();
+    http::filters::HttpEndpointLatencyFilter::reportMetrics(latencyMetrics);
+  }
+
+  if (SystemConfig::instance()->enableHttpStatsFilter()) {
+    const auto inFlightStats = http::filters::StatsFilter::inFlightStats();
+    std::ostringstream oss;
+    oss << "Http endpoint in flight \n[\n";
+    for (const auto& stats : inFlightStats) {
+      if (stats.numRequests != 0) {
+        oss << stats.toString() << ",\n";
+      }
+    }
+    oss << "]\nHttp in-flight response bytes per thread: ";
+    const auto threadBytes =
+        http::filters::StatsFilter::threadInFlightResponseBytes();
+    for (const auto bytes : threadBytes) {
+      oss << velox::succinctBytes(bytes) << " ";
+    }
+    LOG(INFO) << oss.str();
+    http::filters::StatsFilter::reportMetrics(inFlightStats);
   }
-  oss << "]";
-  LOG(INFO) << oss.str();
 }
 
 void PeriodicTaskManager::addHttpServerStatsTask() {
@@ -435,6 +593,91 @@ void PeriodicTaskManager::updateHttpClientStats() {
       kCounterHttpClientNumConnectionsCreated,
       numConnectionsCreated - lastHttpClientNumConnectionsCreated_);
   lastHttpClientNumConnectionsCreated_ = numConnectionsCreated;
+
+  if (server_ != nullptr) {
+    if (auto* pool = server_->exchangeSourceConnectionPool()) {
+      updateConnectionPoolStats(pool);
+    }
+  }
+}
+
+void PeriodicTaskManager::updateConnectionPoolStats(
+    http::HttpClientConnectionPool* pool) {
+  // The sessions are counted on the event bases of the pool. Skip this period
+  // if they have not counted the previous one yet.
+  if (connectionPoolStats_.valid() && !connectionPoolStats_.isReady()) {
+    return;
+  }
+  connectionPoolStats_ =
+      pool->stats()
+          .via(&folly::InlineExecutor::instance())
+          .thenValue([this](
+                         std::vector<http::HttpClientConnectionPool::PoolStats>
+                             poolStats) {
+            // The endpoints are unbounded, so only the totals are exported
+            // and the per endpoint stats are logged at verbose level.
+            uint64_t numActiveSessions{0};
+            uint64_t numIdleSessions{0};
+            uint64_t numSessionsCreated{0};
+            uint64_t numSessionsReused{0};
+            uint64_t numSessionsWarmedUp{0};
+            uint64_t numEventBases{0};
+            uint64_t maxSessionsPerEventBase{0};
+            std::stringstream oss;
+            for (const auto& stats : poolStats) {
+              numActiveSessions += stats.numActiveSessions;
+              numIdleSessions += stats.numIdleSessions;
+              numSessionsCreated += stats.numSessionsCreated;
+              numSessionsReused += stats.numSessionsReused;
+              numSessionsWarmedUp += stats.numSessionsWarmedUp;
+              numEventBases += stats.numEventBases;
+              maxSessionsPerEventBase = std::max(
+                  maxSessionsPerEventBase, stats.maxSessionsPerEventBase);
+              if (VLOG_IS_ON(1)) {
+                oss << "\n  " << stats.endpoint << ": "
+                    << stats.numActiveSessions << " active, "
+                    << stats.numIdleSessions << " idle, "
+                    << stats.numSessionsCreated << " created, "
+                    << stats.numSessionsReused << " reused, "
+                    << stats.numSessionsWarmedUp << " warmed up sessions, "
+                    << velox::succinctBytes(stats.streamWindowSize)
+                    << " stream window";
+              }
+            }
+            RECORD_METRIC_VALUE(
+                kCounterHttpClientNumActiveSessions, numActiveSessions);
+            RECORD_METRIC_VALUE(
+                kCounterHttpClientNumIdleSessions, numIdleSessions);
+            const auto numReused =
+                numSessionsReused - lastHttpClientNumSessionsReused_;
+            const auto numWarmedUp =
+                numSessionsWarmedUp - lastHttpClientNumSessionsWarmedUp_;
+            // The warmed up sessions are created without a request waiting on
+            // them.
+            const auto numMissed = numSessionsCreated -
+                lastHttpClientNumSessionsCreated_ - numWarmedUp;
+            RECORD_METRIC_VALUE(
+                kCounterHttpClientNumSessionsReused, numReused);
+            RECORD_METRIC_VALUE(
+                kCounterHttpClientNumSessionsWarmedUp, numWarmedUp);
+            if (numReused + numMissed > 0) {
+              RECORD_METRIC_VALUE(
+                  kCounterHttpClientSessionPoolHitPct,
+                  numReused * 100 / (numReused + numMissed));
+            }
+            lastHttpClientNumSessionsCreated_ = numSessionsCreated;
+            lastHttpClientNumSessionsReused_ = numSessionsReused;
+            lastHttpClientNumSessionsWarmedUp_ = numSessionsWarmedUp;
+            if (numEventBases > 0) {
+              RECORD_METRIC_VALUE(
+                  kCounterHttpClientAvgSessionsPerEventBase,
+                  (numActiveSessions + numIdleSessions) / numEventBases);
+            }
+            RECORD_METRIC_VALUE(
+                kCounterHttpClientMaxSessionsPerEventBase,
+                maxSessionsPerEventBase);
+            VLOG(1) << "Exchange http client connection pool:" << oss.str();
+          });
 }
 
 void PeriodicTaskManager::addHttpClientStatsTask() {
@@ -444,6 +687,22 @@ void PeriodicTaskManager::addHttpClientStatsTask() {
       "http_client_stats");
 }
 
+void PeriodicTaskManager::updateHttpAccessLogStats() {
+  const auto numDroppedRecords =
+      http::filters::AccessLogWriter::numDroppedRecords();
+  RECORD_METRIC_VALUE(
+      kCounterHttpAccessLogNumDroppedRecords,
+      numDroppedRecords - lastHttpAccessLogNumDroppedRecords_);
+  lastHttpAccessLogNumDroppedRecords_ = numDroppedRecords;
+}
+
+void PeriodicTaskManager::addHttpAccessLogStatsTask() {
+  addTask(
+      [this] { updateHttpAccessLogStats(); },
+      kHttpServerPeriodGlobalCounters,
+      "http_access_log_stats");
+}
+
 void PeriodicTaskManager::addWatchdogTask() {
   addTask(
       [this] {
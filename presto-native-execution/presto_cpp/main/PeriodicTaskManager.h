@@ -15,6 +15,9 @@
 
 #include <folly/experimental/FunctionScheduler.h>
 #include <folly/experimental/ThreadedRepeatingFunctionRunner.h>
+#include <folly/futures/Future.h>
+#include <string_view>
+#include <unordered_map>
 #include "velox/common/memory/Memory.h"
 #include "velox/exec/Task.h"
 
@@ -32,6 +35,9 @@ class AsyncDataCache;
 }
 
 namespace facebook::presto {
+namespace http {
+class HttpClientConnectionPool;
+}
 
 class TaskManager;
 class PrestoServer;
@@ -101,6 +107,9 @@ class PeriodicTaskManager {
   void addTaskStatsTask();
   void updateTaskStats();
 
+  void addQueryResourceStatsTask();
+  void updateQueryResourceStats();
+
   void addOldTaskCleanupTask();
   void cleanupOldTask();
 
@@ -111,15 +120,26 @@ class PeriodicTaskManager {
 
   void addOperatingSystemStatsUpdateTask();
   void updateOperatingSystemStats();
+  // Reports the NUMA and transparent huge page stats. Linux only.
+  void updateMemoryPageStats();
 
   void addHttpServerStatsTask();
   void printHttpServerStats();
 
   void addHttpClientStatsTask();
   void updateHttpClientStats();
+  void updateConnectionPoolStats(http::HttpClientConnectionPool* pool);
+
+  void addHttpAccessLogStatsTask();
+  void updateHttpAccessLogStats();
 
   void addWatchdogTask();
 
+  void addCpuProfilerTask();
+
+  void addQueryTraceTask();
+  void collectQueryTraces();
+
   void detachWorker(const char* reason);
   void maybeAttachWorker();
 
@@ -142,8 +162,20 @@ class PeriodicTaskManager {
   int64_t lastHardPageFaults_{0};
   int64_t lastVoluntaryContextSwitches_{0};
   int64_t lastForcedContextSwitches_{0};
+  // The last values of the /proc/vmstat counters by name.
+  std::unordered_map<std::string_view, uint64_t> lastVmStats_;
+  // The cgroup v2 directory with the memory.stat of the process, if any.
+  bool memoryCgroupPathResolved_{false};
+  std::optional<std::string> memoryCgroupPath_;
 
   int64_t lastHttpClientNumConnectionsCreated_{0};
+  uint64_t lastHttpClientNumSessionsCreated_{0};
+  uint64_t lastHttpClientNumSessionsReused_{0};
+  uint64_t lastHttpClientNumSessionsWarmedUp_{0};
+  // Completes once the sessions of the exchange connection pool are counted.
+  folly::Future<folly::Unit> connectionPoolStats_{
+      folly::Future<folly::Unit>::makeEmpty()};
+  int64_t lastHttpAccessLogNumDroppedRecords_{0};
 
   // NOTE: declare last since the threads access other members of `this`.
   folly::FunctionScheduler oneTimeRunner_;
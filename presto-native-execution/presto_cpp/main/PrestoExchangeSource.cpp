@@ -17,6 +17,7 @@
 #include <folly/SocketAddress.h>
 #include <re2/re2.h>
 #include <sstream>
+#include <unordered_set>
 
 #include "presto_cpp/main/QueryContextManager.h"
 #include "presto_cpp/main/common/Counters.h"
@@ -87,7 +88,11 @@ PrestoExchangeSource::PrestoExchangeSource(
       immediateBufferTransfer_(
           enableBufferCopy_ &&
           SystemConfig::instance()->exchangeImmediateBufferTransfer()),
-      driverExecutor_(driverExecutor) {
+      processOnIoThread_(
+          SystemConfig::instance()->exchangeIoThreadDataPath() &&
+          (!enableBufferCopy_ || immediateBufferTransfer_)),
+      driverExecutor_(driverExecutor),
+      ioEventBase_(ioEventBase) {
   folly::SocketAddress address;
   if (folly::IPAddress::validate(host_)) {
     address = folly::SocketAddress(folly::IPAddress(host_), port_);
@@ -197,6 +202,9 @@ void PrestoExchangeSource::doRequest(
 
   velox::common::testutil::TestValue::adjust(
       "facebook::presto::PrestoExchangeSource::doRequest", this);
+  folly::Executor* responseExecutor = processOnIoThread_
+      ? static_cast<folly::Executor*>(ioEventBase_)
+      : driverExecutor_;
   requestBuilder
       .header(
           protocol::PRESTO_MAX_SIZE_HTTP_HEADER,
@@ -206,16 +214,32 @@ void PrestoExchangeSource::doRequest(
           protocol::Duration(maxWait.count(), protocol::TimeUnit::MICROSECONDS)
               .toString())
       .send(httpClient_.get(), "", delayMs)
-      .via(driverExecutor_)
+      .via(responseExecutor)
       .thenTry(
           [this, path, maxBytes, maxWait, self = getSelfPtr()](
               folly::Try<std::unique_ptr<http::HttpResponse>> responseTry) {
             // self needs to be held for keeping 'this' source alive during
             // processing
+            recordDataResponseHandoff(responseTry);
             handleDataResponse(std::move(responseTry), maxWait, maxBytes, path);
           });
 };
 
+void PrestoExchangeSource::recordDataResponseHandoff(
+    const folly::Try<std::unique_ptr<http::HttpResponse>>& responseTry) {
+  RECORD_METRIC_VALUE(
+      kCounterExchangeDataResponseNumHops,
+      ioEventBase_->isInEventBaseThread() ? 0 : 1);
+  if (responseTry.hasValue()) {
+    RECORD_HISTOGRAM_METRIC_VALUE(
+        kCounterExchangeDataResponseHandoffUs,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() -
+            responseTry.value()->completionTime())
+            .count());
+  }
+}
+
 void PrestoExchangeSource::handleDataResponse(
     folly::Try<std::unique_ptr<http::HttpResponse>> responseTry,
     std::chrono::microseconds maxWait,
@@ -570,6 +594,52 @@ std::shared_ptr<PrestoExchangeSource> PrestoExchangeSource::create(
   return nullptr;
 }
 
+// static
+void PrestoExchangeSource::warmUpConnections(
+    const std::vector<std::string>& locations,
+    folly::IOThreadPoolExecutor* ioExecutor,
+    http::HttpClientConnectionPool* connPool,
+    folly::SSLContextPtr sslContext) {
+  const auto requestTimeoutMs =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          SystemConfig::instance()->exchangeRequestTimeoutMs());
+  const auto connectTimeoutMs =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          SystemConfig::instance()->exchangeConnectTimeoutMs());
+  std::unordered_set<std::string> servers;
+  for (const auto& location : locations) {
+    folly::Uri uri(location);
+    const bool useHttps = uri.scheme() == "https";
+    if ((!useHttps && uri.scheme() != "http") ||
+        (useHttps && sslContext == nullptr)) {
+      continue;
+    }
+    if (!servers.insert(fmt::format("{}:{}", uri.authority(), useHttps))
+             .second) {
+      continue;
+    }
+    // The host is resolved only if the endpoint is not throttled.
+    const auto resolveAddress = [&]() {
+      if (folly::IPAddress::validate(uri.host())) {
+        return folly::SocketAddress(folly::IPAddress(uri.host()), uri.port());
+      }
+      return folly::SocketAddress(uri.host(), uri.port(), true);
+    };
+    try {
+      connPool->warmUp(
+          proxygen::Endpoint(uri.host(), uri.port(), useHttps),
+          resolveAddress,
+          useHttps ? sslContext : nullptr,
+          connectTimeoutMs,
+          requestTimeoutMs,
+          ioExecutor);
+    } catch (const std::exception& e) {
+      VLOG(1) << "Failed to warm up connections to " << uri.authority()
+              << ": " << e.what();
+    }
+  }
+}
+
 void PrestoExchangeSource::updateMemoryUsage(int64_t updateBytes) {
   const int64_t newMemoryBytes =
       currQueuedMemoryBytes().fetch_add(updateBytes) + updateBytes;
@@ -119,6 +119,15 @@ class PrestoExchangeSource : public velox::exec::ExchangeSource {
       http::HttpClientConnectionPool* connPool,
       folly::SSLContextPtr sslContext);
 
+  /// Connects pooled sessions to the workers of the remote split 'locations'
+  /// ahead of the first exchange request to them. See
+  /// HttpClientConnectionPool::warmUp().
+  static void warmUpConnections(
+      const std::vector<std::string>& locations,
+      folly::IOThreadPoolExecutor* ioExecutor,
+      http::HttpClientConnectionPool* connPool,
+      folly::SSLContextPtr sslContext);
+
   /// Completes the future returned by 'request()' if it hasn't completed
   /// already.
   void close() override;
@@ -174,6 +183,11 @@ class PrestoExchangeSource : public velox::exec::ExchangeSource {
       uint32_t maxBytes,
       std::chrono::microseconds maxWait);
 
+  // Records the thread switch and the wait between receiving a data response
+  // and processing it.
+  void recordDataResponseHandoff(
+      const folly::Try<std::unique_ptr<http::HttpResponse>>& responseTry);
+
   // Handles returned http response from the get result request. It dispatches
   // the data handling to corresponding data processing methods.
   //
@@ -263,8 +277,13 @@ class PrestoExchangeSource : public velox::exec::ExchangeSource {
   // context after the http client receives the whole response. This only
   // applies if 'enableBufferCopy_' is true
   const bool immediateBufferTransfer_;
+  // If true, processes the data responses on 'ioEventBase_' which receives
+  // them instead of on 'driverExecutor_'. Set if 'exchange.io-thread-data-path'
+  // is true and the responses need no buffer copy after they are received.
+  const bool processOnIoThread_;
 
   folly::CPUThreadPoolExecutor* const driverExecutor_;
+  folly::EventBase* const ioEventBase_;
 
   std::shared_ptr<http::HttpClient> httpClient_;
   RetryState dataRequestRetryState_;
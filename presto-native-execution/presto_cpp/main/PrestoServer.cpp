@@ -19,16 +19,19 @@
 #include <glog/logging.h>
 #include "CoordinatorDiscoverer.h"
 #include "presto_cpp/main/Announcer.h"
+#include "presto_cpp/main/InstrumentedExecutor.h"
 #include "presto_cpp/main/PeriodicTaskManager.h"
 #include "presto_cpp/main/SignalHandler.h"
 #include "presto_cpp/main/SystemConnector.h"
 #include "presto_cpp/main/TaskResource.h"
 #include "presto_cpp/main/common/ConfigReader.h"
 #include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/common/LabeledStatsReporter.h"
 #include "presto_cpp/main/common/Utils.h"
 #include "presto_cpp/main/http/filters/AccessLogFilter.h"
 #include "presto_cpp/main/http/filters/HttpEndpointLatencyFilter.h"
 #include "presto_cpp/main/http/filters/InternalAuthenticationFilter.h"
+#include "presto_cpp/main/http/filters/ResponseCompressionFilter.h"
 #include "presto_cpp/main/http/filters/StatsFilter.h"
 #include "presto_cpp/main/operators/BroadcastExchangeSource.h"
 #include "presto_cpp/main/operators/BroadcastWrite.h"
@@ -58,6 +61,10 @@
 #include "presto_cpp/main/RemoteFunctionRegisterer.h"
 #endif
 
+#ifdef PRESTO_STATS_REPORTER_TYPE
+#include "presto_cpp/main/runtime-metrics/PrometheusStatsReporter.h"
+#endif
+
 #ifdef __linux__
 // Required by BatchThreadFactory
 #include <pthread.h>
@@ -127,6 +134,26 @@ bool isCachePeriodicFullPersistenceEnabled() {
       std::chrono::seconds::zero();
 }
 
+// Returns the serialized metrics of 'reporter'. Shares the cached
+// serialization of the Prometheus reporter instead of copying it.
+std::unique_ptr<folly::IOBuf> fetchMetricsBody(
+    velox::BaseStatsReporter* reporter) {
+#ifdef PRESTO_STATS_REPORTER_TYPE
+  if (auto* prometheusReporter =
+          dynamic_cast<prometheus::PrometheusStatsReporter*>(reporter)) {
+    auto* metrics = new std::shared_ptr<const std::string>(
+        prometheusReporter->fetchSerializedMetrics());
+    return folly::IOBuf::takeOwnership(
+        const_cast<char*>((*metrics)->data()),
+        (*metrics)->size(),
+        [](void* /*buf*/, void* userData) {
+          delete static_cast<std::shared_ptr<const std::string>*>(userData);
+        },
+        metrics);
+  }
+#endif
+  return folly::IOBuf::fromString(reporter->fetchMetrics());
+}
 } // namespace
 
 std::string nodeState2String(NodeState nodeState) {
@@ -376,6 +403,26 @@ void PrestoServer::run() {
             .sendWithEOM();
       });
 
+  if (const auto broadcastDirectory = systemConfig->broadcastServeDirectory();
+      !broadcastDirectory.empty()) {
+    // Only the broadcast file names are matched, so the requests can not
+    // escape the directory.
+    httpServer_->registerGet(
+        fmt::format(
+            "/v1/broadcast/({})",
+            operators::BroadcastFactory::kFileNamePattern),
+        [broadcastDirectory, executor = httpSrvCpuExecutor_.get()](
+            proxygen::HTTPMessage* /*message*/,
+            const std::vector<std::string>& pathMatch) {
+          return new http::FileRequestHandler(
+              fmt::format("{}/{}", broadcastDirectory, pathMatch[1]),
+              protocol::PRESTO_PAGES_MIME_TYPE,
+              executor);
+        });
+    PRESTO_STARTUP_LOG(INFO)
+        << "Serving broadcast files from " << broadcastDirectory;
+  }
+
   if (systemConfig->enableRuntimeMetricsCollection()) {
     enableWorkerStatsReporting();
     if (folly::Singleton<velox::BaseStatsReporter>::try_get()) {
@@ -384,10 +431,13 @@ void PrestoServer::run() {
           [](proxygen::HTTPMessage* /*message*/,
              const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
              proxygen::ResponseHandler* downstream) {
+            // The serialized metrics can be large, hand them to the response
+            // without a copy.
             http::sendOkResponse(
                 downstream,
-                folly::Singleton<velox::BaseStatsReporter>::try_get()
-                    ->fetchMetrics());
+                fetchMetricsBody(
+                    folly::Singleton<velox::BaseStatsReporter>::try_get()
+                        .get()));
           });
     }
   }
@@ -400,9 +450,10 @@ void PrestoServer::run() {
       systemConfig->exchangeHttpClientNumIoThreadsHwMultiplier() *
           std::thread::hardware_concurrency(),
       1);
-  exchangeHttpIoExecutor_ = std::make_shared<folly::IOThreadPoolExecutor>(
-      numExchangeHttpClientIoThreads,
-      std::make_shared<folly::NamedThreadFactory>("ExchangeIO"));
+  exchangeHttpIoExecutor_ =
+      std::make_shared<InstrumentedExecutor<folly::IOThreadPoolExecutor>>(
+          std::make_shared<InstrumentedThreadFactory>("ExchangeIO"),
+          numExchangeHttpClientIoThreads);
 
   PRESTO_STARTUP_LOG(INFO) << "Exchange Http IO executor '"
                            << exchangeHttpIoExecutor_->getName() << "' has "
@@ -414,9 +465,10 @@ void PrestoServer::run() {
           std::thread::hardware_concurrency(),
       1);
 
-  exchangeHttpCpuExecutor_ = std::make_shared<folly::CPUThreadPoolExecutor>(
-      numExchangeHttpClientCpuThreads,
-      std::make_shared<folly::NamedThreadFactory>("ExchangeCPU"));
+  exchangeHttpCpuExecutor_ =
+      std::make_shared<InstrumentedExecutor<folly::CPUThreadPoolExecutor>>(
+          std::make_shared<InstrumentedThreadFactory>("ExchangeCPU"),
+          numExchangeHttpClientCpuThreads);
 
   PRESTO_STARTUP_LOG(INFO) << "Exchange Http CPU executor '"
                            << exchangeHttpCpuExecutor_->getName() << "' has "
@@ -425,8 +477,24 @@ void PrestoServer::run() {
 
   if (systemConfig->exchangeEnableConnectionPool()) {
     PRESTO_STARTUP_LOG(INFO) << "Enable exchange Http Client connection pool.";
+    http::HttpClientConnectionPool::Options options;
+    options.maxConnectionsPerServer =
+        systemConfig->exchangeHttpClientMaxConnectionsPerServer();
+    options.idleSessionTimeout =
+        std::chrono::duration_cast<std::chrono::seconds>(
+            systemConfig->exchangeHttpClientIdleSessionTimeout());
+    options.streamWindowSize =
+        systemConfig->exchangeHttpClientHttp2StreamWindowSize();
+    options.sessionWindowSize =
+        systemConfig->exchangeHttpClientHttp2SessionWindowSize();
+    options.adaptiveStreamWindow =
+        systemConfig->exchangeHttpClientHttp2AdaptiveStreamWindow();
+    options.maxStreamWindowSize =
+        systemConfig->exchangeHttpClientHttp2MaxStreamWindowSize();
+    options.warmUpConnectionsPerServer =
+        systemConfig->exchangeHttpClientWarmUpConnectionsPerServer();
     exchangeSourceConnectionPool_ =
-        std::make_unique<http::HttpClientConnectionPool>();
+        std::make_unique<http::HttpClientConnectionPool>(std::move(options));
   }
 
   facebook::velox::exec::ExchangeSource::registerFactory(
@@ -476,8 +544,48 @@ void PrestoServer::run() {
         << "Spilling root directory: " << baseSpillDirectory;
   }
 
+  if (exchangeSourceConnectionPool_ != nullptr &&
+      exchangeSourceConnectionPool_->options().warmUpConnectionsPerServer >
+          0) {
+    // Resolving the worker addresses may block, so the warm-up runs off the
+    // task update thread.
+    taskManager_->setRemoteSplitsListener(
+        [this](std::vector<std::string> locations) {
+          exchangeHttpCpuExecutor_->add(
+              [this, locations = std::move(locations)]() {
+                PrestoExchangeSource::warmUpConnections(
+                    locations,
+                    exchangeHttpIoExecutor_.get(),
+                    exchangeSourceConnectionPool_.get(),
+                    sslContext_);
+              });
+        });
+  }
+
+  if (systemConfig->enableRuntimeMetricsCollection() &&
+      systemConfig->runtimeMetricsMaxLabeledQueries() > 0) {
+    if (LabeledStatsReporter::instance() != nullptr) {
+      taskManager_->setQueryResourceMetrics(
+          std::make_shared<QueryResourceMetrics>(
+              systemConfig->runtimeMetricsMaxLabeledQueries()));
+    } else {
+      PRESTO_STARTUP_LOG(WARNING)
+          << "The stats reporter does not support labels, not exporting the "
+             "per-query resource usage";
+    }
+  }
+
+  PriorityRequestExecutor::Options requestExecutorOptions;
+  requestExecutorOptions.maxQueuedRequests = {
+      systemConfig->httpServerMaxQueuedHighPriorityRequests(),
+      systemConfig->httpServerMaxQueuedMediumPriorityRequests(),
+      systemConfig->httpServerMaxQueuedLowPriorityRequests()};
   taskResource_ = std::make_unique<TaskResource>(
-      *taskManager_, pool_.get(), httpSrvCpuExecutor_.get());
+      *taskManager_,
+      pool_.get(),
+      httpSrvCpuExecutor_.get(),
+      std::move(requestExecutorOptions),
+      systemConfig->exchangeIoThreadDataPath());
   taskResource_->registerUris(*httpServer_);
   if (systemConfig->enableSerializedPageChecksum()) {
     enableChecksum();
@@ -502,10 +610,18 @@ void PrestoServer::run() {
   httpServer_->registerGet(
       "/v1/operation/.*",
       [this](
-          proxygen::HTTPMessage* message,
-          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
-          proxygen::ResponseHandler* downstream) {
-        prestoServerOperations_->runOperation(message, downstream);
+          proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::string>& /*pathMatch*/) {
+        return new http::CallbackRequestHandler(
+            [this](
+                proxygen::HTTPMessage* message,
+                std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+                proxygen::ResponseHandler* downstream,
+                std::shared_ptr<http::CallbackRequestHandlerState>
+                    handlerState) {
+              prestoServerOperations_->runOperation(
+                  message, downstream, std::move(handlerState));
+            });
       });
 
   PRESTO_STARTUP_LOG(INFO) << "Driver CPU executor '"
@@ -544,6 +660,16 @@ void PrestoServer::run() {
       this);
   addServerPeriodicTasks();
   addAdditionalPeriodicTasks();
+  if (systemConfig->enableHttpEndpointLatencyFilter()) {
+    // Register before the periodic task reporting the latencies starts.
+    http::filters::HttpEndpointLatencyFilter::registerMetrics(
+        httpServer_->endpoints());
+  }
+  if (systemConfig->enableHttpStatsFilter()) {
+    http::filters::StatsFilter::registerMetrics(httpServer_->endpoints());
+  }
+  // All the thread pools are created at this point.
+  ExecutorStats::registerMetrics();
   periodicTaskManager_->start();
 
   // Start everything. After the return from the following call we are shutting
@@ -673,13 +799,13 @@ void PrestoServer::yieldTasks() {
 }
 
 #ifdef __linux__
-class BatchThreadFactory : public folly::NamedThreadFactory {
+class BatchThreadFactory : public InstrumentedThreadFactory {
  public:
   explicit BatchThreadFactory(const std::string& name)
-      : NamedThreadFactory{name} {}
+      : InstrumentedThreadFactory{name} {}
 
   std::thread newThread(folly::Func&& func) override {
-    return folly::NamedThreadFactory::newThread([_func = std::move(
+    return InstrumentedThreadFactory::newThread([_func = std::move(
                                                      func)]() mutable {
       sched_param param;
       param.sched_priority = 0;
@@ -696,11 +822,13 @@ class BatchThreadFactory : public folly::NamedThreadFactory {
 void PrestoServer::initializeThreadPools() {
   const auto hwConcurrency = std::thread::hardware_concurrency();
   auto* systemConfig = SystemConfig::instance();
+  ExecutorStats::setTaskSampleRate(
+      systemConfig->executorTaskStatsSampleRate());
 
   const auto numDriverCpuThreads = std::max<size_t>(
       systemConfig->driverNumCpuThreadsHwMultiplier() * hwConcurrency, 1);
 
-  std::shared_ptr<folly::NamedThreadFactory> threadFactory;
+  std::shared_ptr<InstrumentedThreadFactory> threadFactory;
   if (systemConfig->driverThreadsBatchSchedulingEnabled()) {
 #ifdef __linux__
     threadFactory = std::make_shared<BatchThreadFactory>("Driver");
@@ -708,28 +836,36 @@ void PrestoServer::initializeThreadPools() {
     VELOX_FAIL("Batch scheduling policy can only be enabled on Linux")
 #endif
   } else {
-    threadFactory = std::make_shared<folly::NamedThreadFactory>("Driver");
+    threadFactory = std::make_shared<InstrumentedThreadFactory>("Driver");
   }
 
-  driverExecutor_ = std::make_shared<folly::CPUThreadPoolExecutor>(
-      numDriverCpuThreads, threadFactory);
+  driverExecutor_ =
+      std::make_shared<InstrumentedExecutor<folly::CPUThreadPoolExecutor>>(
+          threadFactory, numDriverCpuThreads);
 
   const auto numIoThreads = std::max<size_t>(
       systemConfig->httpServerNumIoThreadsHwMultiplier() * hwConcurrency, 1);
-  httpSrvIOExecutor_ = std::make_shared<folly::IOThreadPoolExecutor>(
-      numIoThreads, std::make_shared<folly::NamedThreadFactory>("HTTPSrvIO"));
+  httpSrvIOExecutor_ =
+      std::make_shared<InstrumentedExecutor<folly::IOThreadPoolExecutor>>(
+          std::make_shared<InstrumentedThreadFactory>("HTTPSrvIO"),
+          numIoThreads);
 
   const auto numCpuThreads = std::max<size_t>(
       systemConfig->httpServerNumCpuThreadsHwMultiplier() * hwConcurrency, 1);
-  httpSrvCpuExecutor_ = std::make_shared<folly::CPUThreadPoolExecutor>(
-      numCpuThreads, std::make_shared<folly::NamedThreadFactory>("HTTPSrvCpu"));
+  // One priority per PriorityRequestExecutor::Priority.
+  httpSrvCpuExecutor_ =
+      std::make_shared<InstrumentedExecutor<folly::CPUThreadPoolExecutor>>(
+          std::make_shared<InstrumentedThreadFactory>("HTTPSrvCpu"),
+          numCpuThreads,
+          PriorityRequestExecutor::kNumPriorities);
 
   const auto numSpillerCpuThreads = std::max<size_t>(
       systemConfig->spillerNumCpuThreadsHwMultiplier() * hwConcurrency, 0);
   if (numSpillerCpuThreads > 0) {
-    spillerExecutor_ = std::make_shared<folly::CPUThreadPoolExecutor>(
-        numSpillerCpuThreads,
-        std::make_shared<folly::NamedThreadFactory>("Spiller"));
+    spillerExecutor_ =
+        std::make_shared<InstrumentedExecutor<folly::CPUThreadPoolExecutor>>(
+            std::make_shared<InstrumentedThreadFactory>("Spiller"),
+            numSpillerCpuThreads);
   }
 }
 
@@ -741,7 +877,10 @@ std::unique_ptr<cache::SsdCache> PrestoServer::setupSsdCache() {
   }
 
   constexpr int32_t kNumSsdShards = 16;
-  cacheExecutor_ = std::make_unique<folly::IOThreadPoolExecutor>(kNumSsdShards);
+  cacheExecutor_ =
+      std::make_unique<InstrumentedExecutor<folly::IOThreadPoolExecutor>>(
+          std::make_shared<InstrumentedThreadFactory>("SsdCache"),
+          kNumSsdShards);
   cache::SsdCache::Config cacheConfig(
       systemConfig->asyncCacheSsdPath(),
       systemConfig->asyncCacheSsdGb() << 30,
@@ -902,6 +1041,42 @@ void PrestoServer::setNodeState(NodeState nodeState) {
   updateAnnouncerDetails();
 }
 
+void PrestoServer::pauseTaskAdmission(bool pause) {
+  auto readLockedShuttingDown = shuttingDown_.rlock();
+  if (*readLockedShuttingDown) {
+    return;
+  }
+  if (pause && nodeState() == NodeState::kActive) {
+    LOG(WARNING) << "Changing node status to INACTIVE for memory pushback.";
+    setNodeState(NodeState::kInActive);
+  } else if (!pause && nodeState() == NodeState::kInActive) {
+    LOG(WARNING) << "Changing node status to ACTIVE after memory pushback.";
+    setNodeState(NodeState::kActive);
+  }
+}
+
+// static
+PeriodicMemoryChecker::Config PrestoServer::memoryCheckerConfig() {
+  auto* systemConfig = SystemConfig::instance();
+  PeriodicMemoryChecker::Config config;
+  config.systemMemPushbackEnabled = systemConfig->systemMemPushbackEnabled();
+  config.systemMemLimitBytes =
+      static_cast<uint64_t>(systemConfig->systemMemLimitGb()) << 30;
+  config.systemMemShrinkBytes =
+      static_cast<uint64_t>(systemConfig->systemMemShrinkGb()) << 30;
+  config.predictivePushbackEnabled =
+      systemConfig->systemMemPredictivePushbackEnabled();
+  config.pushbackPredictionWindowMs =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          systemConfig->systemMemPushbackPredictionWindow())
+          .count();
+  config.memPressureStallPctThreshold =
+      systemConfig->systemMemPressureStallPctThreshold();
+  config.pushbackMinConsecutivePredictions =
+      systemConfig->systemMemPushbackMinConsecutivePredictions();
+  return config;
+}
+
 void PrestoServer::enableAnnouncer(bool enable) {
   if (announcer_ != nullptr) {
     announcer_->enableRequest(enable);
@@ -1012,8 +1187,33 @@ PrestoServer::getHttpServerFilters() {
   std::vector<std::unique_ptr<proxygen::RequestHandlerFactory>> filters;
   const auto* systemConfig = SystemConfig::instance();
   if (systemConfig->enableHttpAccessLog()) {
+    http::filters::AccessLogWriter::Options options;
+    options.filePath = systemConfig->httpAccessLogFile();
+    options.maxFileSize = systemConfig->httpAccessLogMaxFileSize();
+    options.maxFiles = systemConfig->httpAccessLogMaxFiles();
+    options.queueSize = systemConfig->httpAccessLogQueueSize();
+    filters.push_back(std::make_unique<http::filters::AccessLogFilterFactory>(
+        std::make_shared<http::filters::AccessLogWriter>(std::move(options))));
+  }
+
+  // Added after the access log filter so that the access log records the
+  // compressed response sizes.
+  if (systemConfig->enableHttpResponseCompression()) {
+    http::filters::ResponseCompressionFilter::Options options;
+    options.minSize = systemConfig->httpResponseCompressionMinSize();
+    options.contentTypes = systemConfig->httpResponseCompressionContentTypes();
+    for (const auto& contentType : options.contentTypes) {
+      VELOX_USER_CHECK(
+          !folly::caseInsensitiveEqual(
+              contentType, protocol::PRESTO_PAGES_MIME_TYPE),
+          "{} responses can not be compressed by the http server",
+          contentType);
+    }
+    options.codecs = http::filters::ResponseCompressionFilter::parseCodecs(
+        systemConfig->httpResponseCompressionCodecs());
     filters.push_back(
-        std::make_unique<http::filters::AccessLogFilterFactory>());
+        std::make_unique<http::filters::ResponseCompressionFilterFactory>(
+            std::move(options)));
   }
 
   if (systemConfig->enableHttpStatsFilter()) {
@@ -1040,7 +1240,8 @@ PrestoServer::getHttpServerFilters() {
 std::vector<std::unique_ptr<proxygen::RequestHandlerFactory>>
 PrestoServer::getAdditionalHttpServerFilters() {
   std::vector<std::unique_ptr<proxygen::RequestHandlerFactory>> filters;
-  filters.emplace_back(std::make_unique<http::filters::StatsFilterFactory>());
+  filters.emplace_back(
+      std::make_unique<http::filters::StatsFilterFactory>(httpServer_.get()));
   return filters;
 }
 
@@ -1053,9 +1254,10 @@ std::vector<std::string> PrestoServer::registerConnectors(
           std::thread::hardware_concurrency(),
       0);
   if (numConnectorIoThreads > 0) {
-    connectorIoExecutor_ = std::make_unique<folly::IOThreadPoolExecutor>(
-        numConnectorIoThreads,
-        std::make_shared<folly::NamedThreadFactory>("Connector"));
+    connectorIoExecutor_ =
+        std::make_unique<InstrumentedExecutor<folly::IOThreadPoolExecutor>>(
+            std::make_shared<InstrumentedThreadFactory>("Connector"),
+            numConnectorIoThreads);
 
     PRESTO_STARTUP_LOG(INFO)
         << "Connector IO executor has " << connectorIoExecutor_->numThreads()
@@ -1316,7 +1518,10 @@ protocol::NodeStatus PrestoServer::fetchNodeStatus() {
   auto systemConfig = SystemConfig::instance();
   const int64_t nodeMemoryGb = systemConfig->systemMemoryGb();
 
-  const double cpuLoadPct{cpuMon_.getCPULoadPct()};
+  // The process load is the load of the cgroup of the process if it runs in
+  // one, which is what limits the worker in a container.
+  const double processCpuLoadPct{cpuMon_.getProcessCPULoadPct()};
+  const double systemCpuLoadPct{cpuMon_.getCPULoadPct()};
 
   // TODO(spershin): As 'nonHeapUsed' we could export the cache memory.
   const int64_t nonHeapUsed{0};
@@ -1331,8 +1536,8 @@ protocol::NodeStatus PrestoServer::fetchNodeStatus() {
       address_,
       **memoryInfo_.rlock(),
       (int)std::thread::hardware_concurrency(),
-      cpuLoadPct,
-      cpuLoadPct,
+      processCpuLoadPct,
+      systemCpuLoadPct,
       pool_ ? pool_->usedBytes() : 0,
       nodeMemoryGb * 1024 * 1024 * 1024,
       nonHeapUsed};
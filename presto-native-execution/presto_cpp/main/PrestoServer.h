@@ -23,6 +23,7 @@
 #include "presto_cpp/main/CPUMon.h"
 #include "presto_cpp/main/CoordinatorDiscoverer.h"
 #include "presto_cpp/main/PeriodicHeartbeatManager.h"
+#include "presto_cpp/main/PeriodicMemoryChecker.h"
 #include "presto_cpp/main/PrestoExchangeSource.h"
 #include "presto_cpp/main/PrestoServerOperations.h"
 #include "velox/common/caching/AsyncDataCache.h"
@@ -92,6 +93,12 @@ class PrestoServer {
   /// Returns the number of threads in the Driver executor.
   size_t numDriverThreads() const;
 
+  /// Returns the connection pool of the exchange http clients or nullptr if
+  /// the connection pool is disabled.
+  http::HttpClientConnectionPool* exchangeSourceConnectionPool() const {
+    return exchangeSourceConnectionPool_.get();
+  }
+
   /// Returns true if the server got terminate signal and in the 'shutting down'
   /// mode. False otherwise.
   bool isShuttingDown() const {
@@ -113,7 +120,23 @@ class PrestoServer {
   /// worker).
   void enableAnnouncer(bool enable);
 
+  /// Stops, resp. resumes, the scheduling of new tasks on this worker for the
+  /// memory pushback by making the node inactive, resp. active again. Has no
+  /// effect while the node is shutting down.
+  void pauseTaskAdmission(bool pause);
+
+  /// Returns the memory checker of the worker if any. Implementations which
+  /// run a PeriodicMemoryChecker return it to expose the state of the memory
+  /// pushback through the server operations.
+  virtual const PeriodicMemoryChecker* memoryChecker() const {
+    return nullptr;
+  }
+
  protected:
+  /// Returns the config of the memory pushback of a PeriodicMemoryChecker from
+  /// the system config. The heap dump settings are left to the caller.
+  static PeriodicMemoryChecker::Config memoryCheckerConfig();
+
   /// Hook for derived PrestoServer implementations to add/stop additional
   /// periodic tasks.
   virtual void addAdditionalPeriodicTasks(){};
@@ -12,13 +12,20 @@
  * limitations under the License.
  */
 #include "presto_cpp/main/PrestoServerOperations.h"
+#include <folly/String.h>
+#include <folly/futures/Future.h>
+#include <folly/io/async/EventBaseManager.h>
 #include <velox/common/base/Exceptions.h>
 #include <velox/common/base/VeloxException.h>
 #include <velox/common/caching/AsyncDataCache.h>
 #include <velox/common/caching/SsdCache.h>
 #include <velox/common/process/TraceContext.h>
+#include "presto_cpp/main/CpuProfiler.h"
+#include "presto_cpp/main/PeriodicMemoryChecker.h"
 #include "presto_cpp/main/PrestoServer.h"
+#include "presto_cpp/main/QueryTraceRecorder.h"
 #include "presto_cpp/main/ServerOperation.h"
+#include "presto_cpp/main/http/HttpServer.h"
 #include "velox/connectors/hive/HiveConnector.h"
 
 namespace facebook::presto {
@@ -72,9 +79,16 @@ std::string getConnectorCacheStats(proxygen::HTTPMessage* message) {
 
 void PrestoServerOperations::runOperation(
     proxygen::HTTPMessage* message,
-    proxygen::ResponseHandler* downstream) {
+    proxygen::ResponseHandler* downstream,
+    std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
   try {
     const ServerOperation op = buildServerOpFromHttpMsgPath(message->getPath());
+    if (op.target == ServerOperation::Target::kServer &&
+        op.action == ServerOperation::Action::kProfile &&
+        message->getQueryParam("type").empty()) {
+      runProfile(message, downstream, std::move(handlerState));
+      return;
+    }
     switch (op.target) {
       case ServerOperation::Target::kConnector:
         http::sendOkResponse(downstream, connectorOperation(op, message));
@@ -256,6 +270,12 @@ std::string PrestoServerOperations::serverOperation(
       return serverOperationClearCache(message);
     case ServerOperation::Action::kWriteSSD:
       return serverOperationWriteSsd(message);
+    case ServerOperation::Action::kMemoryPushback:
+      return serverOperationMemoryPushback();
+    case ServerOperation::Action::kProfile:
+      return serverOperationProfile(message);
+    case ServerOperation::Action::kQueryTrace:
+      return serverOperationQueryTrace(message);
     default:
       break;
   }
@@ -372,4 +392,100 @@ std::string PrestoServerOperations::serverOperationWriteSsd(
   ssdCache->waitForWriteToFinish();
   return "Succeeded write ssd cache";
 }
+
+std::string PrestoServerOperations::serverOperationMemoryPushback() {
+  const auto* memoryChecker = server_->memoryChecker();
+  if (memoryChecker == nullptr) {
+    return "No memory checker running on server";
+  }
+  return folly::toPrettyJson(memoryChecker->pushbackState());
+}
+
+std::string PrestoServerOperations::serverOperationProfile(
+    proxygen::HTTPMessage* message) {
+  const auto& type = message->getQueryParam("type");
+  VELOX_USER_CHECK(
+      type == "background",
+      "Invalid profile type '{}'. Supported type is: 'background'. "
+      "Example: server/profile?seconds=10&frequency=99",
+      type);
+  if (!CpuProfiler::backgroundEnabled()) {
+    return "Background CPU profiler is not enabled";
+  }
+  return CpuProfiler::backgroundProfile();
+}
+
+void PrestoServerOperations::runProfile(
+    proxygen::HTTPMessage* message,
+    proxygen::ResponseHandler* downstream,
+    std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+  static constexpr int32_t kDefaultSeconds{10};
+  static constexpr int32_t kMaxSeconds{60};
+  static constexpr int32_t kDefaultFrequencyHz{99};
+
+  VELOX_USER_CHECK(
+      SystemConfig::instance()->cpuProfilerOnDemandEnabled(),
+      "On-demand CPU profiling is disabled. Set '{}' to enable it.",
+      SystemConfig::kCpuProfilerOnDemandEnabled);
+  const auto& secondsStr = message->getQueryParam("seconds");
+  const auto& frequencyStr = message->getQueryParam("frequency");
+  int32_t seconds;
+  int32_t frequencyHz;
+  try {
+    seconds = secondsStr.empty() ? kDefaultSeconds : stoi(secondsStr);
+    frequencyHz =
+        frequencyStr.empty() ? kDefaultFrequencyHz : stoi(frequencyStr);
+  } catch (std::exception& ex) {
+    VELOX_USER_FAIL(
+        "Invalid seconds '{}' or frequency '{}'.", secondsStr, frequencyStr);
+  }
+  VELOX_USER_CHECK(
+      seconds > 0 && seconds <= kMaxSeconds,
+      "Profile seconds must be in (0, {}]",
+      kMaxSeconds);
+  // Fails the request right away if another profile is in progress.
+  CpuProfiler::startProfile(frequencyHz);
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+  folly::via(
+      profileExecutor_.get(),
+      [deadline]() { return CpuProfiler::finishProfile(deadline); })
+      .via(folly::EventBaseManager::get()->getEventBase())
+      .thenValue([downstream, handlerState](std::string folded) {
+        if (!handlerState->requestExpired()) {
+          http::sendOkResponse(downstream, folded);
+        }
+      })
+      .thenError(
+          folly::tag_t<std::exception>{},
+          [downstream, handlerState](auto&& e) {
+            if (!handlerState->requestExpired()) {
+              http::sendErrorResponse(downstream, e.what());
+            }
+          });
+}
+
+std::string PrestoServerOperations::serverOperationQueryTrace(
+    proxygen::HTTPMessage* message) {
+  const auto& actionStr = message->getQueryParam("action");
+  if (actionStr == "list") {
+    return folly::join('\n', QueryTraceRecorder::tracedQueries());
+  }
+  const auto& queryId = message->getQueryParam("queryId");
+  if (actionStr == "start" || actionStr == "stop") {
+    VELOX_USER_CHECK(
+        !queryId.empty(),
+        "Missing 'queryId' parameter. "
+        "Example: server/queryTrace?action=start&queryId=<query id>");
+    if (actionStr == "start") {
+      QueryTraceRecorder::start(queryId);
+      return fmt::format("Started tracing query {}", queryId);
+    }
+    return QueryTraceRecorder::stop(queryId);
+  }
+  VELOX_USER_FAIL(
+      "Invalid action '{}'. Supported actions are: 'start', 'stop', 'list'. "
+      "Example: server/queryTrace?action=start&queryId=<query id>",
+      actionStr);
+}
 } // namespace facebook::presto
@@ -13,6 +13,9 @@
  */
 #pragma once
 
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <memory>
 #include <string>
 #include "presto_cpp/main/TaskManager.h"
 
@@ -21,6 +24,10 @@ class HTTPMessage;
 class ResponseHandler;
 } // namespace proxygen
 
+namespace facebook::presto::http {
+class CallbackRequestHandlerState;
+} // namespace facebook::presto::http
+
 namespace facebook::presto {
 
 class PrestoServer;
@@ -30,11 +37,16 @@ struct ServerOperation;
 class PrestoServerOperations {
  public:
   PrestoServerOperations(TaskManager* taskManager, PrestoServer* server)
-      : taskManager_(taskManager), server_(server) {}
+      : taskManager_(taskManager),
+        server_(server),
+        profileExecutor_(std::make_unique<folly::CPUThreadPoolExecutor>(
+            1,
+            std::make_shared<folly::NamedThreadFactory>("CpuProfiler"))) {}
 
   void runOperation(
       proxygen::HTTPMessage* message,
-      proxygen::ResponseHandler* downstream);
+      proxygen::ResponseHandler* downstream,
+      std::shared_ptr<http::CallbackRequestHandlerState> handlerState);
 
   std::string connectorOperation(
       const ServerOperation& op,
@@ -69,8 +81,28 @@ class PrestoServerOperations {
   // Writes the in-memory cache into SSD and makes checkpoints.
   std::string serverOperationWriteSsd(proxygen::HTTPMessage* message);
 
+  // Returns the state and the recent actions of the memory pushback.
+  std::string serverOperationMemoryPushback();
+
+  // Returns the background CPU profile as folded stacks.
+  std::string serverOperationProfile(proxygen::HTTPMessage* message);
+
+  // Samples the CPU for a number of seconds on 'profileExecutor_' and responds
+  // with the folded stacks on the event base of the request. Fails unless
+  // 'cpu-profiler-on-demand-enabled' is set.
+  void runProfile(
+      proxygen::HTTPMessage* message,
+      proxygen::ResponseHandler* downstream,
+      std::shared_ptr<http::CallbackRequestHandlerState> handlerState);
+
+  // Starts, stops or lists the traces of queries.
+  std::string serverOperationQueryTrace(proxygen::HTTPMessage* message);
+
   TaskManager* const taskManager_;
   PrestoServer* const server_;
+  // Runs the on-demand CPU profiles, which block their thread for up to a
+  // minute.
+  const std::unique_ptr<folly::CPUThreadPoolExecutor> profileExecutor_;
 };
 
 } // namespace facebook::presto
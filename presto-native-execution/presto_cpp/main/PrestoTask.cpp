@@ -13,6 +13,7 @@
  */
 
 #include "presto_cpp/main/PrestoTask.h"
+#include <folly/hash/Hash.h>
 #include <sys/resource.h>
 #include "presto_cpp/main/common/Configs.h"
 #include "presto_cpp/main/common/Exception.h"
@@ -172,6 +173,7 @@ std::string generateRuntimeStatName(
 // stats.
 struct OperatorStatsCollector {
   const exec::OperatorStats& veloxOperatorStats;
+  OperatorRuntimeStatNames& statNames;
   protocol::RuntimeStats& prestoOperatorStats;
   protocol::RuntimeStats& prestoTaskStats;
 
@@ -190,8 +192,7 @@ struct OperatorStatsCollector {
       const std::string& name,
       int64_t value,
       protocol::RuntimeUnit unit = protocol::RuntimeUnit::NONE) {
-    const std::string statName =
-        generateRuntimeStatName(veloxOperatorStats, name);
+    const auto& statName = statNames.get(veloxOperatorStats, name);
     auto prestoMetric = createProtocolRuntimeMetric(statName, value, unit);
     prestoOperatorStats.emplace(statName, prestoMetric);
     prestoTaskStats.emplace(statName, prestoMetric);
@@ -211,7 +212,8 @@ void addSpillingOperatorMetrics(OperatorStatsCollector& collector) {
 // Updates the operator runtime stats in 'prestoTaskStats' based on the presto
 // task state and system config. For example, if the task is running, then we
 // might skip reporting operator runtime stats to control the communication data
-// size with the coordinator.
+// size with the coordinator. The operator runtime stats are capped like the
+// task ones.
 void updateOperatorRuntimeStats(
     protocol::TaskState state,
     protocol::TaskStats& prestoTaskStats) {
@@ -238,6 +240,9 @@ void updateOperatorRuntimeStats(
           }
         }
       }
+      capRuntimeStats(
+          opStats.runtimeStats,
+          SystemConfig::instance()->taskInfoMaxRuntimeStats());
     }
   }
 }
@@ -271,8 +276,38 @@ presto::protocol::DynamicFilterStats toPrestoDynamicFilterStats(
   }
   return dynamicFilterStats;
 }
+// Number of live tasks with 'hasStuckOperator' set.
+std::atomic_int64_t numTasksWithStuckOperatorCount{0};
+
+// Moves the still pending long-poll requests out of 'requests' into
+// 'holders'.
+template <typename T>
+void takePendingRequests(
+    std::vector<PromiseHolderWeakPtr<T>>& requests,
+    std::vector<PromiseHolderPtr<T>>& holders) {
+  for (auto& request : requests) {
+    if (auto holder = request.lock()) {
+      holders.push_back(std::move(holder));
+    }
+  }
+  requests.clear();
+}
 } // namespace
 
+const std::string& OperatorRuntimeStatNames::get(
+    const exec::OperatorStats& veloxOperatorStats,
+    const std::string& statName) {
+  auto it = names_.find(statName);
+  if (it == names_.end()) {
+    it = names_
+             .emplace(
+                 statName,
+                 generateRuntimeStatName(veloxOperatorStats, statName))
+             .first;
+  }
+  return it->second;
+}
+
 PrestoTask::PrestoTask(
     const std::string& taskId,
     const std::string& nodeId,
@@ -285,6 +320,51 @@ PrestoTask::PrestoTask(
   info.nodeId = nodeId;
 }
 
+PrestoTask::~PrestoTask() {
+  setHasStuckOperator(false);
+}
+
+void PrestoTask::setHasStuckOperator(bool stuck) {
+  if (hasStuckOperator.exchange(stuck) != stuck) {
+    numTasksWithStuckOperatorCount += stuck ? 1 : -1;
+  }
+}
+
+/*static*/ int64_t PrestoTask::numTasksWithStuckOperator() {
+  return numTasksWithStuckOperatorCount;
+}
+
+void PrestoTask::notifyStateChange() {
+  std::vector<PromiseHolderPtr<std::unique_ptr<protocol::TaskStatus>>>
+      statusWaiters;
+  std::vector<PromiseHolderPtr<std::unique_ptr<protocol::TaskInfo>>>
+      infoWaiters;
+  protocol::TaskInfo taskInfo;
+  {
+    std::lock_guard<std::mutex> l(mutex);
+    ++stateVersion;
+    takePendingRequests(statusRequests, statusWaiters);
+    takePendingRequests(infoRequests, infoWaiters);
+    if (!infoWaiters.empty()) {
+      taskInfo = updateInfoLocked();
+    } else if (!statusWaiters.empty()) {
+      taskInfo.taskStatus = updateStatusLocked();
+    } else {
+      return;
+    }
+  }
+
+  // Fulfill the promises outside of the lock as their continuations may
+  // access this task.
+  for (auto& waiter : statusWaiters) {
+    waiter->promise.setValue(
+        std::make_unique<protocol::TaskStatus>(taskInfo.taskStatus));
+  }
+  for (auto& waiter : infoWaiters) {
+    waiter->promise.setValue(std::make_unique<protocol::TaskInfo>(taskInfo));
+  }
+}
+
 void PrestoTask::updateHeartbeatLocked() {
   lastHeartbeatMs = velox::getCurrentTimeMs();
   info.lastHeartbeat = util::toISOTimestamp(lastHeartbeatMs);
@@ -423,7 +503,7 @@ void PrestoTask::updateOutputBufferInfoLocked(
       outputBufferStats.numTopBuffers);
 }
 
-protocol::TaskInfo PrestoTask::updateInfoLocked() {
+protocol::TaskInfo PrestoTask::updateInfoLocked(bool summarize) {
   const protocol::TaskStatus prestoTaskStatus = updateStatusLocked();
 
   // Return limited info if there is no exec task.
@@ -452,10 +532,11 @@ protocol::TaskInfo PrestoTask::updateInfoLocked() {
   updateMemoryInfoLocked(veloxTaskStats, currentTimeMs, taskRuntimeStats);
 
   // Update execution related info.
-  updateExecutionInfoLocked(veloxTaskStats, prestoTaskStatus, taskRuntimeStats);
+  updateExecutionInfoLocked(
+      veloxTaskStats, prestoTaskStatus, summarize, taskRuntimeStats);
 
   // Task runtime metrics we want while the Task is not finalized.
-  hasStuckOperator = false;
+  bool stuckOperator{false};
   if (!isFinalState(prestoTaskStatus.state)) {
     taskRuntimeStats.clear();
 
@@ -478,7 +559,7 @@ protocol::TaskInfo PrestoTask::updateInfoLocked() {
           it.second);
     }
     if (veloxTaskStats.longestRunningOpCallMs != 0) {
-      hasStuckOperator = true;
+      stuckOperator = true;
       addRuntimeMetricIfNotZero(
           taskRuntimeStats,
           "stuck_op." + veloxTaskStats.longestRunningOpCall,
@@ -491,8 +572,19 @@ protocol::TaskInfo PrestoTask::updateInfoLocked() {
         /*tryToSkipIfRunning=*/false,
         prestoTaskStats);
   }
+  setHasStuckOperator(stuckOperator);
+  capRuntimeStats(
+      prestoTaskStats.runtimeStats,
+      SystemConfig::instance()->taskInfoMaxRuntimeStats());
 
   lastTaskStatsUpdateMs = currentTimeMs;
+  if (summarize) {
+    // Skip copying the pipeline and operator stats.
+    auto pipelines = std::move(prestoTaskStats.pipelines);
+    protocol::TaskInfo summarizedInfo = info;
+    prestoTaskStats.pipelines = std::move(pipelines);
+    return summarizedInfo;
+  }
   return info;
 }
 
@@ -580,6 +672,7 @@ void PrestoTask::updateMemoryInfoLocked(
 void PrestoTask::updateExecutionInfoLocked(
     const velox::exec::TaskStats& veloxTaskStats,
     const protocol::TaskStatus& prestoTaskStatus,
+    bool summarize,
     std::unordered_map<std::string, velox::RuntimeMetric>& taskRuntimeStats) {
   protocol::TaskStats& prestoTaskStats = info.stats;
 
@@ -595,10 +688,20 @@ void PrestoTask::updateExecutionInfoLocked(
   prestoTaskStats.runningDrivers = veloxTaskStats.numRunningDrivers;
   prestoTaskStats.completedDrivers = veloxTaskStats.numCompletedDrivers;
 
+  const bool finalState = isFinalState(prestoTaskStatus.state);
+  if (finalState != operatorSummaryCacheFinal_) {
+    // Operator runtime stats are reported differently once the task is final,
+    // so rebuild all the operator summaries.
+    operatorSummaryCache_.clear();
+    operatorSummaryCacheFinal_ = finalState;
+  }
+
   prestoTaskStats.pipelines.resize(veloxTaskStats.pipelineStats.size());
+  operatorSummaryCache_.resize(veloxTaskStats.pipelineStats.size());
   for (int i = 0; i < veloxTaskStats.pipelineStats.size(); ++i) {
     auto& prestoPipeline = info.stats.pipelines[i];
     auto& veloxPipeline = veloxTaskStats.pipelineStats[i];
+    auto& pipelineCache = operatorSummaryCache_[i];
     prestoPipeline.inputPipeline = veloxPipeline.inputPipeline;
     prestoPipeline.outputPipeline = veloxPipeline.outputPipeline;
     prestoPipeline.firstStartTime = prestoTaskStats.createTime;
@@ -606,6 +709,7 @@ void PrestoTask::updateExecutionInfoLocked(
     prestoPipeline.lastEndTime = prestoTaskStats.endTime;
 
     prestoPipeline.operatorSummaries.resize(veloxPipeline.operatorStats.size());
+    pipelineCache.resize(veloxPipeline.operatorStats.size());
     prestoPipeline.totalScheduledTimeInNanos = {};
     prestoPipeline.totalCpuTimeInNanos = {};
     prestoPipeline.totalBlockedTimeInNanos = {};
@@ -654,104 +758,125 @@ void PrestoTask::updateExecutionInfoLocked(
     for (auto j = 0; j < veloxPipeline.operatorStats.size(); ++j) {
       auto& prestoOp = prestoPipeline.operatorSummaries[j];
       auto& veloxOp = veloxPipeline.operatorStats[j];
+      auto& opCache = pipelineCache[j];
+
+      // Only refresh the operator summary if the Velox operator stats changed
+      // since the last update. Raw input statistics of the Project following
+      // TableScan come from the scan, so the Project is always refreshed.
+      // Summarized info does not include operator summaries, so they are left
+      // to be refreshed by the next full update.
+      bool refreshSummary{false};
+      if (!summarize) {
+        const auto fingerprint = operatorStatsFingerprint(veloxOp);
+        refreshSummary = opCache.fingerprint != fingerprint ||
+            (j == 1 && veloxOp.operatorType == "FilterProject");
+        opCache.fingerprint = fingerprint;
+      }
 
-      prestoOp.stageId = id.stageId();
-      prestoOp.stageExecutionId = id.stageExecutionId();
-      prestoOp.pipelineId = i;
-      prestoOp.planNodeId = veloxOp.planNodeId;
-      prestoOp.planNodeId = toPrestoPlanNodeId(prestoOp.planNodeId);
-      prestoOp.operatorId = veloxOp.operatorId;
-      prestoOp.operatorType = toPrestoOperatorType(veloxOp.operatorType);
-
-      prestoOp.totalDrivers = veloxOp.numDrivers;
-      prestoOp.inputPositions = veloxOp.inputPositions;
-      prestoOp.sumSquaredInputPositions =
-          ((double)veloxOp.inputPositions) * veloxOp.inputPositions;
-      prestoOp.inputDataSize =
-          protocol::DataSize(veloxOp.inputBytes, protocol::DataUnit::BYTE);
-      prestoOp.rawInputPositions = veloxOp.rawInputPositions;
-      prestoOp.rawInputDataSize =
-          protocol::DataSize(veloxOp.rawInputBytes, protocol::DataUnit::BYTE);
-
-      // Report raw input statistics on the Project node following TableScan, if
-      // exists.
-      if (j == 1 && veloxOp.operatorType == "FilterProject" &&
-          veloxPipeline.operatorStats[0].operatorType == "TableScan") {
-        const auto& scanOp = veloxPipeline.operatorStats[0];
-        prestoOp.rawInputPositions = scanOp.rawInputPositions;
+      if (refreshSummary) {
+        prestoOp.stageId = id.stageId();
+        prestoOp.stageExecutionId = id.stageExecutionId();
+        prestoOp.pipelineId = i;
+        prestoOp.planNodeId = veloxOp.planNodeId;
+        prestoOp.planNodeId = toPrestoPlanNodeId(prestoOp.planNodeId);
+        prestoOp.operatorId = veloxOp.operatorId;
+        prestoOp.operatorType = toPrestoOperatorType(veloxOp.operatorType);
+
+        prestoOp.totalDrivers = veloxOp.numDrivers;
+        prestoOp.inputPositions = veloxOp.inputPositions;
+        prestoOp.sumSquaredInputPositions =
+            ((double)veloxOp.inputPositions) * veloxOp.inputPositions;
+        prestoOp.inputDataSize =
+            protocol::DataSize(veloxOp.inputBytes, protocol::DataUnit::BYTE);
+        prestoOp.rawInputPositions = veloxOp.rawInputPositions;
         prestoOp.rawInputDataSize =
-            protocol::DataSize(scanOp.rawInputBytes, protocol::DataUnit::BYTE);
-      }
+            protocol::DataSize(veloxOp.rawInputBytes, protocol::DataUnit::BYTE);
+
+        // Report raw input statistics on the Project node following TableScan,
+        // if exists.
+        if (j == 1 && veloxOp.operatorType == "FilterProject" &&
+            veloxPipeline.operatorStats[0].operatorType == "TableScan") {
+          const auto& scanOp = veloxPipeline.operatorStats[0];
+          prestoOp.rawInputPositions = scanOp.rawInputPositions;
+          prestoOp.rawInputDataSize = protocol::DataSize(
+              scanOp.rawInputBytes, protocol::DataUnit::BYTE);
+        }
 
-      prestoOp.outputPositions = veloxOp.outputPositions;
-      prestoOp.outputDataSize =
-          protocol::DataSize(veloxOp.outputBytes, protocol::DataUnit::BYTE);
-
-      setTiming(
-          veloxOp.addInputTiming,
-          prestoOp.addInputCalls,
-          prestoOp.addInputWall,
-          prestoOp.addInputCpu);
-      setTiming(
-          veloxOp.getOutputTiming,
-          prestoOp.getOutputCalls,
-          prestoOp.getOutputWall,
-          prestoOp.getOutputCpu);
-      CpuWallTiming finishAndBackgroundTiming;
-      finishAndBackgroundTiming.add(veloxOp.finishTiming);
-      finishAndBackgroundTiming.add(veloxOp.backgroundTiming);
-      setTiming(
-          finishAndBackgroundTiming,
-          prestoOp.finishCalls,
-          prestoOp.finishWall,
-          prestoOp.finishCpu);
-
-      prestoOp.blockedWall = protocol::Duration(
-          veloxOp.blockedWallNanos, protocol::TimeUnit::NANOSECONDS);
-
-      prestoOp.userMemoryReservation = protocol::DataSize(
-          veloxOp.memoryStats.userMemoryReservation, protocol::DataUnit::BYTE);
-      prestoOp.revocableMemoryReservation = protocol::DataSize(
-          veloxOp.memoryStats.revocableMemoryReservation,
-          protocol::DataUnit::BYTE);
-      prestoOp.systemMemoryReservation = protocol::DataSize(
-          veloxOp.memoryStats.systemMemoryReservation,
-          protocol::DataUnit::BYTE);
-      prestoOp.peakUserMemoryReservation = protocol::DataSize(
-          veloxOp.memoryStats.peakUserMemoryReservation,
-          protocol::DataUnit::BYTE);
-      prestoOp.peakSystemMemoryReservation = protocol::DataSize(
-          veloxOp.memoryStats.peakSystemMemoryReservation,
-          protocol::DataUnit::BYTE);
-      prestoOp.peakTotalMemoryReservation = protocol::DataSize(
-          veloxOp.memoryStats.peakTotalMemoryReservation,
-          protocol::DataUnit::BYTE);
-
-      prestoOp.spilledDataSize =
-          protocol::DataSize(veloxOp.spilledBytes, protocol::DataUnit::BYTE);
-
-      if (veloxOp.operatorType == "HashBuild") {
-        prestoOp.joinBuildKeyCount = veloxOp.inputPositions;
-        prestoOp.nullJoinBuildKeyCount = veloxOp.numNullKeys;
-      }
-      if (veloxOp.operatorType == "HashProbe") {
-        prestoOp.joinProbeKeyCount = veloxOp.inputPositions;
-        prestoOp.nullJoinProbeKeyCount = veloxOp.numNullKeys;
-      }
+        prestoOp.outputPositions = veloxOp.outputPositions;
+        prestoOp.outputDataSize =
+            protocol::DataSize(veloxOp.outputBytes, protocol::DataUnit::BYTE);
+
+        setTiming(
+            veloxOp.addInputTiming,
+            prestoOp.addInputCalls,
+            prestoOp.addInputWall,
+            prestoOp.addInputCpu);
+        setTiming(
+            veloxOp.getOutputTiming,
+            prestoOp.getOutputCalls,
+            prestoOp.getOutputWall,
+            prestoOp.getOutputCpu);
+        CpuWallTiming finishAndBackgroundTiming;
+        finishAndBackgroundTiming.add(veloxOp.finishTiming);
+        finishAndBackgroundTiming.add(veloxOp.backgroundTiming);
+        setTiming(
+            finishAndBackgroundTiming,
+            prestoOp.finishCalls,
+            prestoOp.finishWall,
+            prestoOp.finishCpu);
+
+        prestoOp.blockedWall = protocol::Duration(
+            veloxOp.blockedWallNanos, protocol::TimeUnit::NANOSECONDS);
+
+        prestoOp.userMemoryReservation = protocol::DataSize(
+            veloxOp.memoryStats.userMemoryReservation,
+            protocol::DataUnit::BYTE);
+        prestoOp.revocableMemoryReservation = protocol::DataSize(
+            veloxOp.memoryStats.revocableMemoryReservation,
+            protocol::DataUnit::BYTE);
+        prestoOp.systemMemoryReservation = protocol::DataSize(
+            veloxOp.memoryStats.systemMemoryReservation,
+            protocol::DataUnit::BYTE);
+        prestoOp.peakUserMemoryReservation = protocol::DataSize(
+            veloxOp.memoryStats.peakUserMemoryReservation,
+            protocol::DataUnit::BYTE);
+        prestoOp.peakSystemMemoryReservation = protocol::DataSize(
+            veloxOp.memoryStats.peakSystemMemoryReservation,
+            protocol::DataUnit::BYTE);
+        prestoOp.peakTotalMemoryReservation = protocol::DataSize(
+            veloxOp.memoryStats.peakTotalMemoryReservation,
+            protocol::DataUnit::BYTE);
+
+        prestoOp.spilledDataSize =
+            protocol::DataSize(veloxOp.spilledBytes, protocol::DataUnit::BYTE);
+
+        if (veloxOp.operatorType == "HashBuild") {
+          prestoOp.joinBuildKeyCount = veloxOp.inputPositions;
+          prestoOp.nullJoinBuildKeyCount = veloxOp.numNullKeys;
+        }
+        if (veloxOp.operatorType == "HashProbe") {
+          prestoOp.joinProbeKeyCount = veloxOp.inputPositions;
+          prestoOp.nullJoinProbeKeyCount = veloxOp.numNullKeys;
+        }
 
-      if (!veloxOp.dynamicFilterStats.empty()) {
-        prestoOp.dynamicFilterStats = toPrestoDynamicFilterStats(veloxOp);
+        if (!veloxOp.dynamicFilterStats.empty()) {
+          prestoOp.dynamicFilterStats = toPrestoDynamicFilterStats(veloxOp);
+        }
       }
 
-      for (const auto& stat : veloxOp.runtimeStats) {
-        auto statName = generateRuntimeStatName(veloxOp, stat.first);
-        prestoOp.runtimeStats[statName] =
-            toRuntimeMetric(statName, stat.second);
-        addRuntimeMetric(taskRuntimeStats, statName, stat.second);
+      for (const auto& [name, metric] : veloxOp.runtimeStats) {
+        const auto& statName = opCache.statNames.get(veloxOp, name);
+        if (refreshSummary) {
+          prestoOp.runtimeStats[statName] = toRuntimeMetric(statName, metric);
+        }
+        addRuntimeMetric(taskRuntimeStats, statName, metric);
       }
 
       OperatorStatsCollector operatorStatsCollector{
-          veloxOp, prestoOp.runtimeStats, prestoTaskStats.runtimeStats};
+          veloxOp,
+          opCache.statNames,
+          prestoOp.runtimeStats,
+          prestoTaskStats.runtimeStats};
 
       operatorStatsCollector.addIfNotZero("numSplits", veloxOp.numSplits);
       operatorStatsCollector.addIfNotZero("inputBatches", veloxOp.inputVectors);
@@ -787,7 +912,9 @@ void PrestoTask::updateExecutionInfoLocked(
     } // velox pipeline's operators loop
   } // velox task's pipelines loop
 
-  updateOperatorRuntimeStats(prestoTaskStatus.state, prestoTaskStats);
+  if (!summarize) {
+    updateOperatorRuntimeStats(prestoTaskStatus.state, prestoTaskStats);
+  }
   updateTaskRuntimeStats(
       prestoTaskStatus.state,
       taskRuntimeStats,
@@ -834,6 +961,81 @@ folly::dynamic PrestoTask::toJson() const {
   return obj;
 }
 
+void capRuntimeStats(
+    protocol::RuntimeStats& runtimeStats,
+    uint32_t maxRuntimeStats) {
+  if (maxRuntimeStats == 0 || runtimeStats.size() <= maxRuntimeStats) {
+    return;
+  }
+  std::map<protocol::RuntimeUnit, std::vector<protocol::RuntimeStats::iterator>>
+      metricsByUnit;
+  for (auto it = runtimeStats.begin(); it != runtimeStats.end(); ++it) {
+    metricsByUnit[it->second.unit].push_back(it);
+  }
+  for (auto& [_, metrics] : metricsByUnit) {
+    std::sort(metrics.begin(), metrics.end(), [](auto lhs, auto rhs) {
+      return lhs->second.sum > rhs->second.sum;
+    });
+  }
+
+  protocol::RuntimeStats kept;
+  for (size_t rank = 0; kept.size() < maxRuntimeStats; ++rank) {
+    for (auto& [_, metrics] : metricsByUnit) {
+      if (rank < metrics.size() && kept.size() < maxRuntimeStats) {
+        kept.insert(std::move(*metrics[rank]));
+      }
+    }
+  }
+  runtimeStats = std::move(kept);
+}
+
+size_t operatorStatsFingerprint(const exec::OperatorStats& op) {
+  size_t runtimeStatsHash{0};
+  for (const auto& [name, metric] : op.runtimeStats) {
+    // Order independent, the runtime stats are in an unordered map.
+    runtimeStatsHash += folly::hash::hash_combine(
+        name, metric.sum, metric.count, metric.min, metric.max);
+  }
+  size_t dynamicFilterHash{0};
+  for (const auto& nodeId : op.dynamicFilterStats.producerNodeIds) {
+    dynamicFilterHash += std::hash<std::string>{}(nodeId);
+  }
+  const auto timingHash = [](const CpuWallTiming& timing) {
+    return folly::hash::hash_combine(
+        timing.count, timing.wallNanos, timing.cpuNanos);
+  };
+  return folly::hash::hash_combine(
+      op.numDrivers,
+      op.numSplits,
+      op.inputVectors,
+      op.inputPositions,
+      op.inputBytes,
+      op.rawInputPositions,
+      op.rawInputBytes,
+      op.outputVectors,
+      op.outputPositions,
+      op.outputBytes,
+      timingHash(op.addInputTiming),
+      timingHash(op.getOutputTiming),
+      timingHash(op.finishTiming),
+      timingHash(op.backgroundTiming),
+      op.blockedWallNanos,
+      op.memoryStats.userMemoryReservation,
+      op.memoryStats.revocableMemoryReservation,
+      op.memoryStats.systemMemoryReservation,
+      op.memoryStats.peakUserMemoryReservation,
+      op.memoryStats.peakSystemMemoryReservation,
+      op.memoryStats.peakTotalMemoryReservation,
+      op.memoryStats.numMemoryAllocations,
+      op.spilledBytes,
+      op.spilledRows,
+      op.spilledPartitions,
+      op.spilledFiles,
+      op.numNullKeys,
+      dynamicFilterHash,
+      runtimeStatsHash);
+}
+
 protocol::RuntimeMetric toRuntimeMetric(
     const std::string& name,
     const RuntimeMetric& metric) {
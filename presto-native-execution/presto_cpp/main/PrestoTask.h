@@ -13,7 +13,10 @@
  */
 #pragma once
 
+#include <folly/container/F14Map.h>
+#include <chrono>
 #include <memory>
+#include <thread>
 #include "presto_cpp/main/http/HttpServer.h"
 #include "presto_cpp/main/types/PrestoTaskId.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
@@ -57,6 +60,11 @@ struct Result {
   std::unique_ptr<folly::IOBuf> data;
   bool complete;
   std::vector<int64_t> remainingBytes;
+  // The time and the thread the result was produced on. Used to measure the
+  // handoff to the thread sending the result.
+  std::chrono::steady_clock::time_point createTime{
+      std::chrono::steady_clock::now()};
+  std::thread::id createThread{std::this_thread::get_id()};
 };
 
 struct ResultRequest {
@@ -82,12 +90,38 @@ struct ResultRequest {
         maxSize(_maxSize) {}
 };
 
+/// Caches the Presto runtime stat names generated for a Velox operator, so the
+/// names are formatted once per operator instead of on every info update.
+class OperatorRuntimeStatNames {
+ public:
+  /// Returns '<operator type>.<plan node id>.<statName>' for the operator.
+  const std::string& get(
+      const velox::exec::OperatorStats& veloxOperatorStats,
+      const std::string& statName);
+
+ private:
+  folly::F14FastMap<std::string, std::string> names_;
+};
+
 struct PrestoTask {
   const PrestoTaskId id;
   const long startProcessCpuTime;
   std::shared_ptr<velox::exec::Task> task;
+
+  /// Set when the last info update observed an operator call running longer
+  /// than the stuck operator threshold. Updated via setHasStuckOperator() to
+  /// keep the process-wide count in numTasksWithStuckOperator() in sync.
   std::atomic_bool hasStuckOperator{false};
 
+  /// Incremented on every observed state change of this task (creation with
+  /// error, start, abort before creation and Velox task termination).
+  std::atomic<uint64_t> stateVersion{0};
+
+  /// The Velox task state this task is accounted under in the task manager's
+  /// per-state task counts. Not set if the task is not accounted (not started
+  /// yet or already removed from the task manager). Guarded by 'mutex'.
+  std::optional<velox::exec::TaskState> countedTaskState;
+
   /// Has the task been normally created and started.
   /// When you create task with error - it has never been started.
   /// When you create task from 'delete task' - it has never been started.
@@ -123,11 +157,15 @@ struct PrestoTask {
   /// shared_ptr to define lifetime.
   std::unordered_map<int64_t, std::shared_ptr<ResultRequest>> resultRequests;
 
-  /// Pending status request. May arrive before there is a Task.
-  PromiseHolderWeakPtr<std::unique_ptr<protocol::TaskStatus>> statusRequest;
+  /// Pending long-poll status requests waiting for the next state change. May
+  /// arrive before there is a Task. Completed by notifyStateChange().
+  std::vector<PromiseHolderWeakPtr<std::unique_ptr<protocol::TaskStatus>>>
+      statusRequests;
 
-  /// Info request. May arrive before there is a Task.
-  PromiseHolderWeakPtr<std::unique_ptr<protocol::TaskInfo>> infoRequest;
+  /// Pending long-poll info requests waiting for the next state change. May
+  /// arrive before there is a Task. Completed by notifyStateChange().
+  std::vector<PromiseHolderWeakPtr<std::unique_ptr<protocol::TaskInfo>>>
+      infoRequests;
 
   /// @param taskId Task ID.
   /// @param nodeId Node ID.
@@ -138,6 +176,8 @@ struct PrestoTask {
       const std::string& nodeId,
       long startProcessCpuTime = 0);
 
+  ~PrestoTask();
+
   /// Updates when this task was touched last time.
   void updateHeartbeatLocked();
 
@@ -161,24 +201,38 @@ struct PrestoTask {
     return updateStatusLocked();
   }
 
-  protocol::TaskInfo updateInfo() {
+  protocol::TaskInfo updateInfo(bool summarize = false) {
     std::lock_guard<std::mutex> l(mutex);
-    return updateInfoLocked();
+    return updateInfoLocked(summarize);
   }
 
+  /// Bumps 'stateVersion' and completes all the pending status and info
+  /// long-poll requests. The status and info are computed once and shared by
+  /// all the waiters. Must be called without holding 'mutex'.
+  void notifyStateChange();
+
+  /// Returns the number of live tasks with 'hasStuckOperator' set.
+  static int64_t numTasksWithStuckOperator();
+
   /// Turns the task numbers (per state) into a string.
   static std::string taskStatesToString(
       const std::array<size_t, 5>& taskStates);
 
   /// Invoked to update presto task status from the updated velox task stats.
   protocol::TaskStatus updateStatusLocked();
-  protocol::TaskInfo updateInfoLocked();
+
+  /// Invoked to update presto task info from the updated velox task stats. If
+  /// 'summarize' is true, the operator summaries are not refreshed and the
+  /// returned info has no pipeline stats.
+  protocol::TaskInfo updateInfoLocked(bool summarize = false);
 
   folly::dynamic toJson() const;
 
  private:
   void recordProcessCpuTime();
 
+  void setHasStuckOperator(bool stuck);
+
   void updateOutputBufferInfoLocked(
       const velox::exec::TaskStats& veloxTaskStats,
       std::unordered_map<std::string, velox::RuntimeMetric>& taskRuntimeStats);
@@ -191,6 +245,7 @@ struct PrestoTask {
   void updateExecutionInfoLocked(
       const velox::exec::TaskStats& veloxTaskStats,
       const protocol::TaskStatus& prestoTaskStatus,
+      bool summarize,
       std::unordered_map<std::string, velox::RuntimeMetric>& taskRuntimeStats);
 
   void updateMemoryInfoLocked(
@@ -199,6 +254,22 @@ struct PrestoTask {
       std::unordered_map<std::string, velox::RuntimeMetric>& taskRuntimeStats);
 
   long processCpuTime_{0};
+
+  // Conversion state kept per Velox operator between info updates.
+  struct OperatorSummaryCache {
+    // Fingerprint of the Velox operator stats the Presto operator summary was
+    // last built from.
+    std::optional<size_t> fingerprint;
+    OperatorRuntimeStatNames statNames;
+  };
+
+  // Operator summary caches indexed by pipeline and operator. Used to refresh
+  // only the operator summaries whose Velox stats changed since the last info
+  // update.
+  std::vector<std::vector<OperatorSummaryCache>> operatorSummaryCache_;
+
+  // True if 'operatorSummaryCache_' was built for a task in final state.
+  bool operatorSummaryCacheFinal_{false};
 };
 
 using TaskMap =
@@ -208,6 +279,19 @@ protocol::RuntimeMetric toRuntimeMetric(
     const std::string& name,
     const facebook::velox::RuntimeMetric& metric);
 
+/// Keeps at most 'maxRuntimeStats' runtime metrics in 'runtimeStats'. Zero
+/// means no limit. The sums of metrics of different units do not compare, so
+/// the metrics are ranked by sum within their unit and the units take turns
+/// keeping their next largest metric.
+void capRuntimeStats(
+    protocol::RuntimeStats& runtimeStats,
+    uint32_t maxRuntimeStats);
+
+/// Returns a fingerprint of all the Velox operator stats the Presto operator
+/// summary is built from. The summary built for a fingerprint is reused until
+/// the fingerprint changes.
+size_t operatorStatsFingerprint(const velox::exec::OperatorStats& op);
+
 bool isFinalState(protocol::TaskState state);
 
 } // namespace facebook::presto
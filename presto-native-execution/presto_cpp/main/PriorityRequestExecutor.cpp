@@ -0,0 +1,114 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/PriorityRequestExecutor.h"
+#include "presto_cpp/main/common/Counters.h"
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/base/StatsReporter.h"
+
+namespace facebook::presto {
+namespace {
+
+struct PriorityCounters {
+  folly::StringPiece numQueued;
+  folly::StringPiece queueWaitMs;
+  folly::StringPiece numRejected;
+};
+
+const PriorityCounters& counters(PriorityRequestExecutor::Priority priority) {
+  static const std::array<
+      PriorityCounters,
+      PriorityRequestExecutor::kNumPriorities>
+      kCounters{{
+          {kCounterHttpServerNumQueuedHighPriorityRequests,
+           kCounterHttpServerHighPriorityQueueWaitMs,
+           kCounterHttpServerNumRejectedHighPriorityRequests},
+          {kCounterHttpServerNumQueuedMediumPriorityRequests,
+           kCounterHttpServerMediumPriorityQueueWaitMs,
+           kCounterHttpServerNumRejectedMediumPriorityRequests},
+          {kCounterHttpServerNumQueuedLowPriorityRequests,
+           kCounterHttpServerLowPriorityQueueWaitMs,
+           kCounterHttpServerNumRejectedLowPriorityRequests},
+      }};
+  return kCounters[static_cast<size_t>(priority)];
+}
+
+int8_t toExecutorPriority(PriorityRequestExecutor::Priority priority) {
+  switch (priority) {
+    case PriorityRequestExecutor::Priority::kHigh:
+      return folly::Executor::HI_PRI;
+    case PriorityRequestExecutor::Priority::kMedium:
+      return folly::Executor::MID_PRI;
+    case PriorityRequestExecutor::Priority::kLow:
+      return folly::Executor::LO_PRI;
+  }
+  VELOX_UNREACHABLE();
+}
+} // namespace
+
+PriorityRequestExecutor::PriorityRequestExecutor(
+    folly::Executor* executor,
+    Options options)
+    : options_(std::move(options)) {
+  VELOX_CHECK_NOT_NULL(executor);
+  for (size_t i = 0; i < kNumPriorities; ++i) {
+    lanes_[i].executor_ = executor;
+    lanes_[i].priority_ = static_cast<Priority>(i);
+  }
+}
+
+bool PriorityRequestExecutor::tryAdmit(Priority priority) {
+  const auto maxQueued =
+      options_.maxQueuedRequests[static_cast<size_t>(priority)];
+  if (maxQueued == 0 || numQueued(priority) < maxQueued) {
+    return true;
+  }
+  RECORD_METRIC_VALUE(counters(priority).numRejected);
+  return false;
+}
+
+// static
+std::string_view PriorityRequestExecutor::toString(Priority priority) {
+  switch (priority) {
+    case Priority::kHigh:
+      return "HIGH";
+    case Priority::kMedium:
+      return "MEDIUM";
+    case Priority::kLow:
+      return "LOW";
+  }
+  VELOX_UNREACHABLE();
+}
+
+void PriorityRequestExecutor::Lane::add(folly::Func func) {
+  // The queue depth is sampled as seen by the arriving requests.
+  RECORD_METRIC_VALUE(counters(priority_).numQueued, numQueued_++);
+  const auto enqueueTime = std::chrono::steady_clock::now();
+  folly::Func task = [this, func = std::move(func), enqueueTime]() mutable {
+    --numQueued_;
+    RECORD_HISTOGRAM_METRIC_VALUE(
+        counters(priority_).queueWaitMs,
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - enqueueTime)
+            .count());
+    func();
+  };
+  // Executors without priorities do not implement addWithPriority().
+  if (executor_->getNumPriorities() > 1) {
+    executor_->addWithPriority(std::move(task), toExecutorPriority(priority_));
+  } else {
+    executor_->add(std::move(task));
+  }
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,98 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Executor.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace facebook::presto {
+
+/// Runs the http requests on a shared executor with a priority per request
+/// class, so that a burst of expensive task updates does not delay the latency
+/// critical result and status requests behind it. Each class tracks its
+/// queued requests and rejects new ones when more than the configured number
+/// are waiting. The priorities take effect if the underlying executor was
+/// created with at least 3 priorities, otherwise the requests run in FIFO
+/// order and only the admission control applies.
+class PriorityRequestExecutor {
+ public:
+  enum class Priority {
+    /// Cheap and latency critical: results, acknowledgements, status polls
+    /// and deletes.
+    kHigh = 0,
+    /// Task info.
+    kMedium = 1,
+    /// Task creations and updates which convert the plan.
+    kLow = 2,
+  };
+
+  static constexpr size_t kNumPriorities = 3;
+
+  struct Options {
+    /// Max number of queued requests per priority. 0 means unlimited.
+    std::array<uint32_t, kNumPriorities> maxQueuedRequests{};
+
+    /// Time after which the clients of the rejected requests should retry.
+    std::chrono::seconds retryAfter{1};
+  };
+
+  explicit PriorityRequestExecutor(
+      folly::Executor* executor,
+      Options options = {});
+
+  /// Returns the executor to run the requests of 'priority' on.
+  folly::Executor* executor(Priority priority) {
+    return &lanes_[static_cast<size_t>(priority)];
+  }
+
+  /// Returns true if a new request of 'priority' may be queued. Otherwise
+  /// counts a rejection and the caller is expected to fail the request with
+  /// 503 and Retry-After set to retryAfter().
+  bool tryAdmit(Priority priority);
+
+  /// Number of requests of 'priority' queued and not yet running.
+  uint64_t numQueued(Priority priority) const {
+    return lanes_[static_cast<size_t>(priority)].numQueued();
+  }
+
+  std::chrono::seconds retryAfter() const {
+    return options_.retryAfter;
+  }
+
+  static std::string_view toString(Priority priority);
+
+ private:
+  class Lane : public folly::Executor {
+   public:
+    void add(folly::Func func) override;
+
+    uint64_t numQueued() const {
+      return numQueued_;
+    }
+
+   private:
+    friend class PriorityRequestExecutor;
+
+    folly::Executor* executor_{nullptr};
+    Priority priority_{Priority::kHigh};
+    std::atomic<uint64_t> numQueued_{0};
+  };
+
+  const Options options_;
+  std::array<Lane, kNumPriorities> lanes_;
+};
+
+} // namespace facebook::presto
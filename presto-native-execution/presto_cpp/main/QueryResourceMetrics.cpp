@@ -0,0 +1,119 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/QueryResourceMetrics.h"
+#include <algorithm>
+#include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/common/LabeledStatsReporter.h"
+#include "velox/common/base/Exceptions.h"
+#include "velox/exec/TaskStats.h"
+
+namespace facebook::presto {
+
+void QueryResourceMetrics::Usage::add(const Usage& other) {
+  cpuTimeNanos += other.cpuTimeNanos;
+  exchangeInputBytes += other.exchangeInputBytes;
+  spilledBytes += other.spilledBytes;
+}
+
+// static
+QueryResourceMetrics::Usage QueryResourceMetrics::Usage::fromTaskStats(
+    const velox::exec::TaskStats& stats) {
+  Usage usage;
+  for (const auto& pipelineStats : stats.pipelineStats) {
+    for (const auto& operatorStats : pipelineStats.operatorStats) {
+      usage.cpuTimeNanos += operatorStats.addInputTiming.cpuNanos +
+          operatorStats.getOutputTiming.cpuNanos +
+          operatorStats.finishTiming.cpuNanos;
+      usage.spilledBytes += operatorStats.spilledBytes;
+      if (operatorStats.operatorType == "Exchange" ||
+          operatorStats.operatorType == "MergeExchange") {
+        usage.exchangeInputBytes += operatorStats.rawInputBytes;
+      }
+    }
+  }
+  return usage;
+}
+
+QueryResourceMetrics::QueryResourceMetrics(size_t maxQueries)
+    : maxQueries_(maxQueries) {
+  VELOX_CHECK_GT(maxQueries_, 0);
+}
+
+void QueryResourceMetrics::addFinishedTask(
+    const std::string& queryId,
+    const Usage& usage) {
+  finished_.withWLock([&](auto& finished) { finished[queryId].add(usage); });
+}
+
+std::vector<std::pair<std::string, QueryResourceMetrics::Usage>>
+QueryResourceMetrics::update(
+    const std::unordered_map<std::string, Usage>& running) {
+  std::unordered_map<std::string, Usage> queries = running;
+  finished_.withWLock([&](auto& finished) {
+    for (auto it = finished.begin(); it != finished.end();) {
+      queries[it->first].add(it->second);
+      if (running.count(it->first) == 0) {
+        it = finished.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  });
+
+  std::vector<std::pair<std::string, Usage>> usages(
+      std::make_move_iterator(queries.begin()),
+      std::make_move_iterator(queries.end()));
+  const auto numTop = std::min(maxQueries_, usages.size());
+  std::partial_sort(
+      usages.begin(),
+      usages.begin() + numTop,
+      usages.end(),
+      [](const auto& left, const auto& right) {
+        return left.second.cpuTimeNanos > right.second.cpuTimeNanos;
+      });
+  if (usages.size() > numTop) {
+    Usage other;
+    for (auto i = numTop; i < usages.size(); ++i) {
+      other.add(usages[i].second);
+    }
+    usages.resize(numTop);
+    usages.emplace_back(std::string(kOtherQueries), other);
+  }
+  return usages;
+}
+
+void QueryResourceMetrics::report(
+    const std::unordered_map<std::string, Usage>& running) {
+  const auto usages = update(running);
+  auto reporter = LabeledStatsReporter::instance();
+  if (reporter == nullptr) {
+    return;
+  }
+  std::vector<std::pair<std::string, int64_t>> cpuTimeMs;
+  std::vector<std::pair<std::string, int64_t>> exchangeInputBytes;
+  std::vector<std::pair<std::string, int64_t>> spilledBytes;
+  for (const auto& [queryId, usage] : usages) {
+    cpuTimeMs.emplace_back(queryId, usage.cpuTimeNanos / 1'000'000);
+    exchangeInputBytes.emplace_back(queryId, usage.exchangeInputBytes);
+    spilledBytes.emplace_back(queryId, usage.spilledBytes);
+  }
+  reporter->setLabeledGaugeValues(
+      kCounterQueryCpuTimeMs, kQueryIdLabel, cpuTimeMs);
+  reporter->setLabeledGaugeValues(
+      kCounterQueryExchangeInputBytes, kQueryIdLabel, exchangeInputBytes);
+  reporter->setLabeledGaugeValues(
+      kCounterQuerySpilledBytes, kQueryIdLabel, spilledBytes);
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,75 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Synchronized.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook::velox::exec {
+struct TaskStats;
+}
+
+namespace facebook::presto {
+
+/// Tracks the resource usage of the queries with tasks on this worker and
+/// exports it as gauges labeled by query id. To bound the number of label
+/// values, only the 'maxQueries' queries using the most CPU get their own
+/// label, the others are summed under kOtherQueries.
+///
+/// The usage of a query is the sum of its running tasks, reported
+/// periodically, and of its finished tasks, added when they stop running.
+/// A query is reported one more time after its last running task is gone.
+class QueryResourceMetrics {
+ public:
+  struct Usage {
+    uint64_t cpuTimeNanos{0};
+    uint64_t exchangeInputBytes{0};
+    uint64_t spilledBytes{0};
+
+    void add(const Usage& other);
+
+    static Usage fromTaskStats(const velox::exec::TaskStats& stats);
+  };
+
+  static constexpr std::string_view kQueryIdLabel{"query_id"};
+
+  /// Label value of the sum of the queries beyond 'maxQueries'.
+  static constexpr std::string_view kOtherQueries{"other"};
+
+  explicit QueryResourceMetrics(size_t maxQueries);
+
+  /// Adds the usage of a task of 'queryId' which stopped running.
+  void addFinishedTask(const std::string& queryId, const Usage& usage);
+
+  /// Returns the usage of the top queries by CPU time in descending order,
+  /// followed by kOtherQueries if there are more. 'running' is the usage of
+  /// the running tasks by query id. Forgets the finished tasks of the queries
+  /// without running tasks.
+  std::vector<std::pair<std::string, Usage>> update(
+      const std::unordered_map<std::string, Usage>& running);
+
+  /// Exports the result of update() if the stats reporter supports labels.
+  void report(const std::unordered_map<std::string, Usage>& running);
+
+ private:
+  const size_t maxQueries_;
+
+  // The usage of the finished tasks by query id.
+  folly::Synchronized<std::unordered_map<std::string, Usage>> finished_;
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,382 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/QueryTraceRecorder.h"
+#include <fmt/format.h>
+#include <folly/Synchronized.h>
+#include <folly/json.h>
+#include <folly/system/ThreadId.h>
+#include <folly/system/ThreadName.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include "velox/common/base/Exceptions.h"
+#include "velox/exec/Task.h"
+
+namespace facebook::presto {
+namespace {
+
+// Process id of the thread tracks in the trace. The tasks are numbered from 1.
+constexpr int64_t kThreadsPid{0};
+
+uint64_t toMicros(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+struct RunEvent {
+  const char* pool;
+  uint64_t beginUs;
+  uint64_t endUs;
+};
+
+// Single-producer, single-consumer ring of the runs of a thread. The thread
+// advances 'writeIndex' and the consumer advances 'readIndex' under the lock
+// of the recorder state. The runs are dropped and counted in 'numDropped' when
+// the ring is full.
+struct ThreadBuffer {
+  static constexpr size_t kCapacity{QueryTraceRecorder::kMaxBufferedRuns};
+
+  ThreadBuffer()
+      : osThreadId(folly::getOSThreadID()),
+        threadName(folly::getCurrentThreadName().value_or("")) {}
+
+  const uint64_t osThreadId;
+  const std::string threadName;
+  std::array<RunEvent, kCapacity> events;
+  std::atomic<uint64_t> writeIndex{0};
+  std::atomic<uint64_t> readIndex{0};
+  std::atomic<uint64_t> numDropped{0};
+  std::atomic<bool> exited{false};
+};
+
+// The buffers of the threads which ran a task while a query was traced.
+folly::Synchronized<std::vector<std::shared_ptr<ThreadBuffer>>>&
+threadBuffers() {
+  static folly::Synchronized<std::vector<std::shared_ptr<ThreadBuffer>>>
+      buffers;
+  return buffers;
+}
+
+// Owns the buffer of the calling thread and marks it exited when the thread
+// exits, so that the consumer frees it once drained.
+struct ThreadBufferHolder {
+  ~ThreadBufferHolder() {
+    if (buffer != nullptr) {
+      buffer->exited = true;
+    }
+  }
+
+  std::shared_ptr<ThreadBuffer> buffer;
+};
+
+ThreadBuffer& threadBuffer() {
+  thread_local ThreadBufferHolder holder;
+  if (holder.buffer == nullptr) {
+    holder.buffer = std::make_shared<ThreadBuffer>();
+    threadBuffers().wlock()->push_back(holder.buffer);
+  }
+  return *holder.buffer;
+}
+
+struct OperatorSample {
+  uint64_t wallNanos{0};
+  uint64_t blockedWallNanos{0};
+  uint64_t inputRows{0};
+  uint64_t outputRows{0};
+
+  bool operator==(const OperatorSample& other) const {
+    return wallNanos == other.wallNanos &&
+        blockedWallNanos == other.blockedWallNanos &&
+        inputRows == other.inputRows && outputRows == other.outputRows;
+  }
+};
+
+struct TaskTrace {
+  int64_t pid{0};
+  uint64_t lastSampleUs{0};
+  // The last sample and whether its interval had activity, by pipeline and
+  // operator id.
+  std::map<std::pair<int32_t, int32_t>, std::pair<OperatorSample, bool>>
+      operators;
+};
+
+struct Trace {
+  uint64_t startUs{0};
+  folly::dynamic events = folly::dynamic::array;
+  uint64_t numDroppedEvents{0};
+  std::unordered_map<std::string, TaskTrace> tasks;
+  // Names of the threads with runs, by OS thread id.
+  std::map<uint64_t, std::string> threadNames;
+};
+
+struct State {
+  std::map<std::string, Trace> traces;
+};
+
+folly::Synchronized<State, std::mutex>& state() {
+  static folly::Synchronized<State, std::mutex> state;
+  return state;
+}
+
+std::atomic<int32_t>& numTraces() {
+  static std::atomic<int32_t> numTraces{0};
+  return numTraces;
+}
+
+void addEvent(Trace& trace, folly::dynamic event) {
+  if (trace.events.size() >= QueryTraceRecorder::kMaxEvents) {
+    ++trace.numDroppedEvents;
+    return;
+  }
+  trace.events.push_back(std::move(event));
+}
+
+folly::dynamic metadataEvent(
+    std::string_view name,
+    int64_t pid,
+    uint64_t tid,
+    const std::string& value) {
+  return folly::dynamic::object("ph", "M")("name", name)("pid", pid)(
+      "tid", tid)("args", folly::dynamic::object("name", value));
+}
+
+folly::dynamic counterEvent(
+    const std::string& name,
+    int64_t pid,
+    uint64_t timestampUs,
+    folly::dynamic args) {
+  return folly::dynamic::object("ph", "C")("name", name)("pid", pid)(
+      "ts", timestampUs)("args", std::move(args));
+}
+
+void drainThreadBuffers(State& state) {
+  threadBuffers().withWLock([&](auto& buffers) {
+    for (auto& buffer : buffers) {
+      const auto writeIndex =
+          buffer->writeIndex.load(std::memory_order_acquire);
+      auto readIndex = buffer->readIndex.load(std::memory_order_relaxed);
+      for (; readIndex < writeIndex; ++readIndex) {
+        const auto& run =
+            buffer->events[readIndex % ThreadBuffer::kCapacity];
+        for (auto& [queryId, trace] : state.traces) {
+          if (run.beginUs < trace.startUs) {
+            continue;
+          }
+          trace.threadNames.emplace(buffer->osThreadId, buffer->threadName);
+          addEvent(
+              trace,
+              folly::dynamic::object("ph", "X")("cat", "executor")(
+                  "name", run.pool)("pid", kThreadsPid)(
+                  "tid", buffer->osThreadId)("ts", run.beginUs)(
+                  "dur", run.endUs - run.beginUs));
+        }
+      }
+      buffer->readIndex.store(readIndex, std::memory_order_release);
+      const auto numDropped =
+          buffer->numDropped.exchange(0, std::memory_order_relaxed);
+      for (auto& [queryId, trace] : state.traces) {
+        trace.numDroppedEvents += numDropped;
+      }
+    }
+    buffers.erase(
+        std::remove_if(
+            buffers.begin(),
+            buffers.end(),
+            [](const auto& buffer) {
+              return buffer->exited &&
+                  buffer->readIndex == buffer->writeIndex;
+            }),
+        buffers.end());
+  });
+}
+
+void sampleTask(Trace& trace, velox::exec::Task& task, uint64_t nowUs) {
+  auto& taskTrace = trace.tasks[task.taskId()];
+  if (taskTrace.pid == 0) {
+    taskTrace.pid = trace.tasks.size();
+    taskTrace.lastSampleUs = trace.startUs;
+    addEvent(
+        trace, metadataEvent("process_name", taskTrace.pid, 0, task.taskId()));
+  }
+
+  const auto stats = task.taskStats();
+  int64_t numBlockedDrivers{0};
+  for (const auto& [reason, count] : stats.numBlockedDrivers) {
+    numBlockedDrivers += count;
+  }
+  addEvent(
+      trace,
+      counterEvent(
+          "drivers",
+          taskTrace.pid,
+          taskTrace.lastSampleUs,
+          folly::dynamic::object("running", stats.numRunningDrivers)(
+              "blocked", numBlockedDrivers)));
+
+  for (const auto& pipeline : stats.pipelineStats) {
+    for (const auto& op : pipeline.operatorStats) {
+      const OperatorSample sample{
+          op.addInputTiming.wallNanos + op.getOutputTiming.wallNanos +
+              op.finishTiming.wallNanos,
+          op.blockedWallNanos,
+          op.inputPositions,
+          op.outputPositions};
+      auto& [prev, prevActive] =
+          taskTrace.operators[{op.pipelineId, op.operatorId}];
+      const bool active = !(sample == prev);
+      // Idle operators are reported once to bring their counters back to 0.
+      if (active || prevActive) {
+        const auto name = fmt::format(
+            "{}.{} {} ({})",
+            op.pipelineId,
+            op.operatorId,
+            op.operatorType,
+            op.planNodeId);
+        addEvent(
+            trace,
+            counterEvent(
+                name + " time",
+                taskTrace.pid,
+                taskTrace.lastSampleUs,
+                folly::dynamic::object(
+                    "running_ms", (sample.wallNanos - prev.wallNanos) / 1e6)(
+                    "blocked_ms",
+                    (sample.blockedWallNanos - prev.blockedWallNanos) /
+                        1e6)));
+        addEvent(
+            trace,
+            counterEvent(
+                name + " rows",
+                taskTrace.pid,
+                taskTrace.lastSampleUs,
+                folly::dynamic::object(
+                    "input", sample.inputRows - prev.inputRows)(
+                    "output", sample.outputRows - prev.outputRows)));
+      }
+      prev = sample;
+      prevActive = active;
+    }
+  }
+  taskTrace.lastSampleUs = nowUs;
+}
+
+std::string toJson(const std::string& queryId, const Trace& trace) {
+  folly::dynamic events = folly::dynamic::array;
+  events.push_back(
+      metadataEvent("process_name", kThreadsPid, 0, "Worker threads"));
+  for (const auto& [tid, name] : trace.threadNames) {
+    events.push_back(metadataEvent("thread_name", kThreadsPid, tid, name));
+  }
+  for (const auto& event : trace.events) {
+    events.push_back(event);
+  }
+  return folly::toJson(
+      folly::dynamic::object("traceEvents", std::move(events))(
+          "displayTimeUnit", "ms")(
+          "otherData",
+          folly::dynamic::object("queryId", queryId)(
+              "droppedEvents", trace.numDroppedEvents)));
+}
+} // namespace
+
+// static
+bool QueryTraceRecorder::enabled() {
+  return numTraces().load(std::memory_order_relaxed) > 0;
+}
+
+// static
+void QueryTraceRecorder::recordRun(
+    const char* pool,
+    std::chrono::steady_clock::time_point begin,
+    std::chrono::steady_clock::time_point end) {
+  if (!enabled()) {
+    return;
+  }
+  auto& buffer = threadBuffer();
+  const auto writeIndex = buffer.writeIndex.load(std::memory_order_relaxed);
+  if (writeIndex - buffer.readIndex.load(std::memory_order_acquire) >=
+      ThreadBuffer::kCapacity) {
+    buffer.numDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer.events[writeIndex % ThreadBuffer::kCapacity] =
+      RunEvent{pool, toMicros(begin), toMicros(end)};
+  buffer.writeIndex.store(writeIndex + 1, std::memory_order_release);
+}
+
+// static
+void QueryTraceRecorder::start(const std::string& queryId) {
+  state().withLock([&](auto& state) {
+    VELOX_USER_CHECK_EQ(
+        state.traces.count(queryId), 0, "Query {} is already traced", queryId);
+    VELOX_USER_CHECK_LT(
+        state.traces.size(),
+        kMaxTracedQueries,
+        "Too many traced queries");
+    // Skip the runs recorded before the trace started.
+    drainThreadBuffers(state);
+    state.traces[queryId].startUs =
+        toMicros(std::chrono::steady_clock::now());
+    ++numTraces();
+  });
+}
+
+// static
+std::string QueryTraceRecorder::stop(const std::string& queryId) {
+  return state().withLock([&](auto& state) {
+    auto it = state.traces.find(queryId);
+    VELOX_USER_CHECK(
+        it != state.traces.end(), "Query {} is not traced", queryId);
+    drainThreadBuffers(state);
+    auto json = toJson(queryId, it->second);
+    state.traces.erase(it);
+    --numTraces();
+    return json;
+  });
+}
+
+// static
+std::vector<std::string> QueryTraceRecorder::tracedQueries() {
+  return state().withLock([](auto& state) {
+    std::vector<std::string> queryIds;
+    for (const auto& [queryId, trace] : state.traces) {
+      queryIds.push_back(queryId);
+    }
+    return queryIds;
+  });
+}
+
+// static
+void QueryTraceRecorder::collect(
+    const std::vector<std::shared_ptr<velox::exec::Task>>& tasks) {
+  const auto nowUs = toMicros(std::chrono::steady_clock::now());
+  state().withLock([&](auto& state) {
+    if (state.traces.empty()) {
+      return;
+    }
+    drainThreadBuffers(state);
+    for (const auto& task : tasks) {
+      auto it = state.traces.find(task->queryCtx()->queryId());
+      if (it != state.traces.end()) {
+        sampleTask(it->second, *task, nowUs);
+      }
+    }
+  });
+}
+
+} // namespace facebook::presto
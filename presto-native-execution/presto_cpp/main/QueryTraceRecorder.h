@@ -0,0 +1,85 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace facebook::velox::exec {
+class Task;
+}
+
+namespace facebook::presto {
+
+/// Opt-in timeline recorder of the queries running on this worker, exported
+/// as Chrome trace event JSON which chrome://tracing and Perfetto load.
+///
+/// While at least one query is traced, the thread pools record every task
+/// they run into a lock-free ring buffer of the running thread. The trace has
+/// a 'Worker threads' process with one track per thread, showing when the
+/// threads of each pool ran and when they were idle, e.g. the scheduling gaps
+/// of the driver threads. The tracks cover all the work of the worker while
+/// the query is traced, the runs are not attributed to queries.
+///
+/// The operator stats of the tasks of the traced query are sampled
+/// periodically. The trace has one process per task with, for each operator,
+/// a 'time' counter of its running and blocked wall time and a 'rows' counter
+/// of its input and output rows in each interval, and a 'drivers' counter of
+/// the running and blocked drivers of the task. These show pipeline stalls
+/// and blocked-on-exchange intervals which the aggregated operator stats
+/// cannot.
+class QueryTraceRecorder {
+ public:
+  /// Max number of queries traced at the same time.
+  static constexpr size_t kMaxTracedQueries{4};
+
+  /// Max number of events of a trace. The events beyond are dropped.
+  static constexpr size_t kMaxEvents{500'000};
+
+  /// Max number of runs a thread buffers between two collect() calls. The
+  /// runs beyond are dropped and counted in the dropped events of the traces.
+  static constexpr size_t kMaxBufferedRuns{1'024};
+
+  /// Returns true if at least one query is traced.
+  static bool enabled();
+
+  /// Records that the calling thread ran a task of the thread pool 'pool'
+  /// from 'begin' to 'end'. No-op if no query is traced. 'pool' must stay
+  /// valid for the lifetime of the process.
+  static void recordRun(
+      const char* pool,
+      std::chrono::steady_clock::time_point begin,
+      std::chrono::steady_clock::time_point end);
+
+  /// Starts tracing 'queryId'. Throws if the query is already traced or if
+  /// kMaxTracedQueries queries are.
+  static void start(const std::string& queryId);
+
+  /// Stops tracing 'queryId' and returns its trace. Throws if the query is
+  /// not traced.
+  static std::string stop(const std::string& queryId);
+
+  /// Returns the ids of the traced queries.
+  static std::vector<std::string> tracedQueries();
+
+  /// Moves the runs recorded by the thread pools to the traces and samples the
+  /// operator stats of the 'tasks' of the traced queries. Invoked
+  /// periodically.
+  static void collect(
+      const std::vector<std::shared_ptr<velox::exec::Task>>& tasks);
+};
+
+} // namespace facebook::presto
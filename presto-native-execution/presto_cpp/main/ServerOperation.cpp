@@ -27,7 +27,10 @@ const folly::F14FastMap<std::string, ServerOperation::Action>
         {"listAll", ServerOperation::Action::kListAll},
         {"trace", ServerOperation::Action::kTrace},
         {"setState", ServerOperation::Action::kSetState},
-        {"announcer", ServerOperation::Action::kAnnouncer}};
+        {"announcer", ServerOperation::Action::kAnnouncer},
+        {"memoryPushback", ServerOperation::Action::kMemoryPushback},
+        {"profile", ServerOperation::Action::kProfile},
+        {"queryTrace", ServerOperation::Action::kQueryTrace}};
 
 const folly::F14FastMap<ServerOperation::Action, std::string>
     ServerOperation::kReverseActionLookup{
@@ -40,7 +43,10 @@ const folly::F14FastMap<ServerOperation::Action, std::string>
         {ServerOperation::Action::kListAll, "listAll"},
         {ServerOperation::Action::kTrace, "trace"},
         {ServerOperation::Action::kSetState, "setState"},
-        {ServerOperation::Action::kAnnouncer, "announcer"}};
+        {ServerOperation::Action::kAnnouncer, "announcer"},
+        {ServerOperation::Action::kMemoryPushback, "memoryPushback"},
+        {ServerOperation::Action::kProfile, "profile"},
+        {ServerOperation::Action::kQueryTrace, "queryTrace"}};
 
 const folly::F14FastMap<std::string, ServerOperation::Target>
     ServerOperation::kTargetLookup{
@@ -56,6 +56,15 @@ struct ServerOperation {
     kAnnouncer,
     /// Applicable to kServer. Write in-memory cache data to SSD.
     kWriteSSD,
+    /// Applicable to kServer. Returns the state and the recent actions of the
+    /// memory pushback.
+    kMemoryPushback,
+    /// Applicable to kServer. Returns the folded stacks of a CPU profile of
+    /// the process.
+    kProfile,
+    /// Applicable to kServer. Starts or stops the trace of a query. Stopping
+    /// returns the trace as Chrome trace event JSON.
+    kQueryTrace,
   };
 
   static const folly::F14FastMap<std::string, Target> kTargetLookup;
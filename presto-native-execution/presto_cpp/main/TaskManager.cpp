@@ -16,6 +16,7 @@
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <folly/container/F14Set.h>
+#include <folly/hash/Hash.h>
 #include <velox/core/PlanNode.h>
 #include "presto_cpp/main/common/Configs.h"
 #include "presto_cpp/main/common/Counters.h"
@@ -95,6 +96,63 @@ void keepPromiseAlive(
       [promiseHolder]() mutable { promiseHolder.reset(); });
 }
 
+// Registers 'promiseHolder' as a pending long-poll request in 'requests'. Drops
+// the requests which have already been completed or timed out, so the list does
+// not grow while the task keeps running.
+template <typename T>
+void addPendingRequest(
+    std::vector<PromiseHolderWeakPtr<T>>& requests,
+    const PromiseHolderPtr<T>& promiseHolder) {
+  requests.erase(
+      std::remove_if(
+          requests.begin(),
+          requests.end(),
+          [](const auto& request) { return request.expired(); }),
+      requests.end());
+  requests.push_back(folly::to_weak_ptr(promiseHolder));
+}
+
+// Returns true if a long-poll request which has observed 'currentState' should
+// wait for the next state change of the task which is now in 'state'.
+bool shouldWaitForStateChange(
+    const PrestoTask& prestoTask,
+    protocol::TaskState currentState,
+    protocol::TaskState state) {
+  if (isFinalState(state)) {
+    return false;
+  }
+  // Requests arriving before the task is created wait for its creation.
+  return prestoTask.task == nullptr || currentState == state;
+}
+
+// Returns the version of a batch of task statuses combined with the task id
+// and the state 'stateVersion' of the next task of the batch. The version of
+// a batch starts at 0 and depends on the order of its tasks, so that the
+// state changes of different tasks do not cancel out. The version is kept
+// non-negative to round trip through thrift i64 and JSON clients.
+uint64_t combineTaskStatusVersion(
+    uint64_t version,
+    const PrestoTask& prestoTask,
+    uint64_t stateVersion) {
+  return folly::hash::hash_combine(
+             version, prestoTask.info.taskId, stateVersion) &
+      std::numeric_limits<int64_t>::max();
+}
+
+// Builds the statuses of 'prestoTasks' along with their combined version.
+std::unique_ptr<TaskStatusBatch> makeTaskStatusBatch(
+    const std::vector<std::shared_ptr<PrestoTask>>& prestoTasks) {
+  auto batch = std::make_unique<TaskStatusBatch>();
+  for (const auto& prestoTask : prestoTasks) {
+    std::lock_guard<std::mutex> l(prestoTask->mutex);
+    batch->version = combineTaskStatusVersion(
+        batch->version, *prestoTask, prestoTask->stateVersion);
+    batch->taskStatuses.emplace(
+        prestoTask->info.taskId, prestoTask->updateStatusLocked());
+  }
+  return batch;
+}
+
 std::unique_ptr<Result> createEmptyResult(long token) {
   auto result = std::make_unique<Result>();
   result->sequence = result->nextSequence = token;
@@ -296,6 +354,22 @@ struct ZombieTaskStatsSet {
     }
   }
 };
+
+// Returns the locations of the remote splits in 'sources'.
+std::vector<std::string> remoteSplitLocations(
+    const std::vector<protocol::TaskSource>& sources) {
+  std::vector<std::string> locations;
+  for (const auto& source : sources) {
+    for (const auto& split : source.splits) {
+      if (auto remoteSplit =
+              std::dynamic_pointer_cast<const protocol::RemoteSplit>(
+                  split.split.connectorSplit)) {
+        locations.push_back(remoteSplit->location.location);
+      }
+    }
+  }
+  return locations;
+}
 } // namespace
 
 TaskManager::TaskManager(
@@ -306,10 +380,16 @@ TaskManager::TaskManager(
       queryContextManager_(std::make_unique<QueryContextManager>(
           driverExecutor,
           spillerExecutor)),
-      httpSrvCpuExecutor_(httpSrvCpuExecutor) {
+      httpSrvCpuExecutor_(httpSrvCpuExecutor),
+      longPollTimer_(std::make_unique<LongPollTimer>(httpSrvCpuExecutor)),
+      self_(std::make_shared<folly::Synchronized<TaskManager*>>(this)) {
   VELOX_CHECK_NOT_NULL(bufferManager_, "invalid OutputBufferManager");
 }
 
+TaskManager::~TaskManager() {
+  *self_->wlock() = nullptr;
+}
+
 void TaskManager::setBaseUri(const std::string& baseUri) {
   baseUri_ = baseUri;
 }
@@ -318,6 +398,15 @@ void TaskManager::setNodeId(const std::string& nodeId) {
   nodeId_ = nodeId;
 }
 
+void TaskManager::setRemoteSplitsListener(RemoteSplitsListener listener) {
+  remoteSplitsListener_ = std::move(listener);
+}
+
+void TaskManager::setQueryResourceMetrics(
+    std::shared_ptr<QueryResourceMetrics> queryResourceMetrics) {
+  queryResourceMetrics_ = std::move(queryResourceMetrics);
+}
+
 void TaskManager::setBaseSpillDirectory(const std::string& baseSpillDirectory) {
   VELOX_CHECK(!baseSpillDirectory.empty());
   baseSpillDir_.withWLock(
@@ -332,6 +421,21 @@ bool TaskManager::emptyBaseSpillDirectory() const {
 void TaskManager::setOldTaskCleanUpMs(int32_t oldTaskCleanUpMs) {
   VELOX_CHECK_GE(oldTaskCleanUpMs, 0);
   oldTaskCleanUpMs_ = oldTaskCleanUpMs;
+
+  // Check the existing tasks against the new threshold on the next cleanup.
+  std::vector<protocol::TaskId> taskIds;
+  taskMap_.withRLock([&](const auto& taskMap) {
+    taskIds.reserve(taskMap.size());
+    for (const auto& [taskId, _] : taskMap) {
+      taskIds.push_back(taskId);
+    }
+  });
+  const auto nowMs = getCurrentTimeMs();
+  cleanupQueue_.withWLock([&](auto& queue) {
+    for (const auto& taskId : taskIds) {
+      queue.emplace(nowMs, taskId);
+    }
+  });
 }
 
 TaskMap TaskManager::tasks() const {
@@ -371,6 +475,7 @@ std::unique_ptr<TaskInfo> TaskManager::createOrUpdateErrorTask(
     }
     prestoTask->info.needsPlan = false;
   }
+  prestoTask->notifyStateChange();
 
   auto info = prestoTask->updateInfo();
   return std::make_unique<TaskInfo>(info);
@@ -507,14 +612,17 @@ std::unique_ptr<TaskInfo> TaskManager::createOrUpdateTaskImpl(
       "Task update received before setting a plan. The splits in "
       "this update could not be delivered for {}",
       taskId);
+  if (remoteSplitsListener_) {
+    if (auto locations = remoteSplitLocations(sources); !locations.empty()) {
+      remoteSplitsListener_(std::move(locations));
+    }
+  }
   std::unordered_map<int64_t, std::shared_ptr<ResultRequest>> resultRequests;
-  PromiseHolderWeakPtr<std::unique_ptr<protocol::TaskStatus>> statusRequest;
-  PromiseHolderWeakPtr<std::unique_ptr<protocol::TaskInfo>> infoRequest;
 
   // Create or update task can be called concurrently for the same task.
   // We need to lock here for allow only one to be executed at a time.
   // This is especially important for adding splits to the task.
-  std::lock_guard<std::mutex> l(prestoTask->mutex);
+  std::unique_lock<std::mutex> l(prestoTask->mutex);
 
   if (startTask) {
     const uint32_t maxDrivers =
@@ -542,9 +650,8 @@ std::unique_ptr<TaskInfo> TaskManager::createOrUpdateTaskImpl(
     execTask->start(maxDrivers, concurrentLifespans);
 
     prestoTask->taskStarted = true;
+    updateTaskStateCountLocked(*prestoTask, exec::TaskState::kRunning);
     resultRequests = std::move(prestoTask->resultRequests);
-    statusRequest = prestoTask->statusRequest;
-    infoRequest = prestoTask->infoRequest;
   }
 
   getDataForResultRequests(resultRequests);
@@ -591,12 +698,11 @@ std::unique_ptr<TaskInfo> TaskManager::createOrUpdateTaskImpl(
   // 'prestoTask' will exist by virtue of shared_ptr but may for example have
   // been aborted.
   auto info = prestoTask->updateInfoLocked(); // Presto task is locked above.
-  if (auto promiseHolder = infoRequest.lock()) {
-    promiseHolder->promise.setValue(std::make_unique<protocol::TaskInfo>(info));
-  }
-  if (auto promiseHolder = statusRequest.lock()) {
-    promiseHolder->promise.setValue(
-        std::make_unique<protocol::TaskStatus>(info.taskStatus));
+  l.unlock();
+
+  if (startTask) {
+    subscribeToTaskStateChange(prestoTask);
+    prestoTask->notifyStateChange();
   }
   return std::make_unique<TaskInfo>(info);
 }
@@ -620,7 +726,7 @@ std::unique_ptr<TaskInfo> TaskManager::deleteTask(
     prestoTask = findOrCreateTask(taskId, 0);
   }
 
-  std::lock_guard<std::mutex> l(prestoTask->mutex);
+  std::unique_lock<std::mutex> l(prestoTask->mutex);
   prestoTask->updateHeartbeatLocked();
   prestoTask->updateCoordinatorHeartbeatLocked();
   auto execTask = prestoTask->task;
@@ -638,7 +744,10 @@ std::unique_ptr<TaskInfo> TaskManager::deleteTask(
     // we don't need to do anything on CREATE message and can clean up the
     // cancelled task later.
     prestoTask->info.taskStatus.state = protocol::TaskState::ABORTED;
-    return std::make_unique<TaskInfo>(prestoTask->info);
+    auto info = std::make_unique<TaskInfo>(prestoTask->info);
+    l.unlock();
+    prestoTask->notifyStateChange();
+    return info;
   }
 
   // Do not erase the finished/aborted tasks, because someone might still want
@@ -653,70 +762,115 @@ std::unique_ptr<TaskInfo> TaskManager::deleteTask(
 
 size_t TaskManager::cleanOldTasks() {
   const auto startTimeMs = getCurrentTimeMs();
+  const uint64_t oldTaskCleanUpMs = oldTaskCleanUpMs_;
+
+  // Only look at the tasks due for a cleanup check instead of scanning the
+  // whole task map. A task may have been scheduled more than once.
+  folly::F14FastSet<protocol::TaskId> dueTaskIds;
+  cleanupQueue_.withWLock([&](auto& queue) {
+    while (!queue.empty() && queue.top().first <= startTimeMs) {
+      dueTaskIds.insert(queue.top().second);
+      queue.pop();
+    }
+  });
+
+  std::vector<std::pair<protocol::TaskId, std::shared_ptr<PrestoTask>>>
+      dueTasks;
+  dueTasks.reserve(dueTaskIds.size());
+  taskMap_.withRLock([&](const auto& taskMap) {
+    for (const auto& taskId : dueTaskIds) {
+      auto it = taskMap.find(taskId);
+      if (it != taskMap.end()) {
+        dueTasks.emplace_back(*it);
+      }
+    }
+  });
 
   folly::F14FastSet<protocol::TaskId> taskIdsToClean;
+  std::vector<CleanupCheck> nextChecks;
 
   ZombieTaskStatsSet zombieVeloxTaskCounts;
   ZombieTaskStatsSet zombiePrestoTaskCounts;
-  uint32_t numTasksWithStuckOperator{0};
-  {
-    // We copy task map locally to avoid locking task map for a potentially long
-    // time. We also lock for 'read'.
-    const TaskMap taskMap = *(taskMap_.rlock());
-
-    for (const auto& [id, prestoTask] : taskMap) {
-      if (prestoTask->hasStuckOperator) {
-        ++numTasksWithStuckOperator;
-      }
-
-      bool eraseTask{false};
-      if (prestoTask->task != nullptr) {
-        if (prestoTask->task->state() != exec::TaskState::kRunning) {
-          // Since the state is not running, we know the task has been
-          // terminated. We use termination time instead of end time as the
-          // former does not include time waiting for results to be consumed.
-          if (prestoTask->task->timeSinceTerminationMs() >= oldTaskCleanUpMs_) {
-            // Not running and old.
-            eraseTask = true;
-          }
+  for (const auto& [id, prestoTask] : dueTasks) {
+    bool eraseTask{false};
+    if (prestoTask->task != nullptr) {
+      if (prestoTask->task->state() != exec::TaskState::kRunning) {
+        // Since the state is not running, we know the task has been
+        // terminated. We use termination time instead of end time as the
+        // former does not include time waiting for results to be consumed.
+        const uint64_t timeSinceTerminationMs =
+            prestoTask->task->timeSinceTerminationMs();
+        if (timeSinceTerminationMs >= oldTaskCleanUpMs) {
+          // Not running and old.
+          eraseTask = true;
+        } else {
+          nextChecks.emplace_back(
+              startTimeMs + oldTaskCleanUpMs - timeSinceTerminationMs, id);
         }
       } else {
-        // Use heartbeat to determine the task's age.
-        if (prestoTask->timeSinceLastHeartbeatMs() >= oldTaskCleanUpMs_) {
-          eraseTask = true;
+        // We request cancellation for tasks which haven't been accessed by
+        // coordinator for a considerable time. Running tasks are checked again
+        // when they would become abandoned. Terminated tasks are also
+        // scheduled from the task state change notification.
+        const auto timeSinceHeartbeatMs =
+            prestoTask->timeSinceLastCoordinatorHeartbeatMs();
+        if (timeSinceHeartbeatMs >= oldTaskCleanUpMs) {
+          LOG(INFO) << "Cancelling abandoned task '" << id << "'.";
+          prestoTask->task->requestCancel();
+          nextChecks.emplace_back(startTimeMs + oldTaskCleanUpMs, id);
+        } else {
+          nextChecks.emplace_back(
+              startTimeMs + oldTaskCleanUpMs - timeSinceHeartbeatMs, id);
         }
       }
-
-      // We assume 'not erase' is the 'most common' case.
-      if (!eraseTask) {
-        continue;
+    } else {
+      // Use heartbeat to determine the task's age.
+      const auto timeSinceHeartbeatMs = prestoTask->timeSinceLastHeartbeatMs();
+      if (timeSinceHeartbeatMs >= oldTaskCleanUpMs) {
+        eraseTask = true;
+      } else {
+        nextChecks.emplace_back(
+            startTimeMs + oldTaskCleanUpMs - timeSinceHeartbeatMs, id);
       }
+    }
 
-      const auto prestoTaskRefCount = prestoTask.use_count();
-      const auto taskRefCount = prestoTask->task.use_count();
-
-      // Do not remove 'zombie' tasks (with outstanding references) from the
-      // map. We use it to track the number of tasks. Note, since we copied the
-      // task map, presto tasks should have an extra reference (2 from two
-      // maps).
-      if (prestoTaskRefCount > 2 || taskRefCount > 1) {
-        auto& task = prestoTask->task;
-        if (prestoTaskRefCount > 2) {
-          ++zombiePrestoTaskCounts.numTotal;
-          if (task != nullptr) {
-            zombiePrestoTaskCounts.updateCounts(task, prestoTaskRefCount - 2);
-          }
-        }
-        if (taskRefCount > 1) {
-          ++zombieVeloxTaskCounts.numTotal;
-          zombieVeloxTaskCounts.updateCounts(task, taskRefCount - 1);
+    // We assume 'not erase' is the 'most common' case.
+    if (!eraseTask) {
+      continue;
+    }
+
+    const auto prestoTaskRefCount = prestoTask.use_count();
+    const auto taskRefCount = prestoTask->task.use_count();
+
+    // Do not remove 'zombie' tasks (with outstanding references) from the
+    // map. We use it to track the number of tasks. Note, since we copied the
+    // due tasks, presto tasks should have an extra reference (2 from the map
+    // and the due tasks). Zombie tasks are checked again on the next run.
+    if (prestoTaskRefCount > 2 || taskRefCount > 1) {
+      auto& task = prestoTask->task;
+      if (prestoTaskRefCount > 2) {
+        ++zombiePrestoTaskCounts.numTotal;
+        if (task != nullptr) {
+          zombiePrestoTaskCounts.updateCounts(task, prestoTaskRefCount - 2);
         }
-      } else {
-        taskIdsToClean.emplace(id);
       }
+      if (taskRefCount > 1) {
+        ++zombieVeloxTaskCounts.numTotal;
+        zombieVeloxTaskCounts.updateCounts(task, taskRefCount - 1);
+      }
+      nextChecks.emplace_back(startTimeMs, id);
+    } else {
+      taskIdsToClean.emplace(id);
     }
+  }
+  dueTasks.clear();
 
-    cancelAbandonedTasksInternal(taskMap, oldTaskCleanUpMs_);
+  if (!nextChecks.empty()) {
+    cleanupQueue_.withWLock([&](auto& queue) {
+      for (auto& check : nextChecks) {
+        queue.push(std::move(check));
+      }
+    });
   }
 
   const auto elapsedMs = (getCurrentTimeMs() - startTimeMs);
@@ -731,6 +885,10 @@ size_t TaskManager::cleanOldTasks() {
         writableTaskMap->erase(taskId);
       }
     }
+    for (const auto& prestoTask : tasksToDelete) {
+      std::lock_guard<std::mutex> l(prestoTask->mutex);
+      updateTaskStateCountLocked(*prestoTask, std::nullopt);
+    }
     LOG(INFO) << "cleanOldTasks: Cleaned " << taskIdsToClean.size()
               << " old task(s) in " << elapsedMs << " ms";
   } else if (elapsedMs > 1000) {
@@ -750,10 +908,73 @@ size_t TaskManager::cleanOldTasks() {
   RECORD_METRIC_VALUE(
       kCounterNumZombiePrestoTasks, zombiePrestoTaskCounts.numTotal);
   RECORD_METRIC_VALUE(
-      kCounterNumTasksWithStuckOperator, numTasksWithStuckOperator);
+      kCounterNumTasksWithStuckOperator,
+      PrestoTask::numTasksWithStuckOperator());
   return taskIdsToClean.size();
 }
 
+void TaskManager::scheduleCleanupCheck(
+    const protocol::TaskId& taskId,
+    uint64_t checkTimeMs) {
+  cleanupQueue_.wlock()->emplace(checkTimeMs, taskId);
+}
+
+void TaskManager::updateTaskStateCountLocked(
+    PrestoTask& prestoTask,
+    std::optional<exec::TaskState> newState) {
+  if (prestoTask.countedTaskState.has_value()) {
+    --taskStateCounts_[prestoTask.countedTaskState.value()];
+  }
+  if (newState.has_value()) {
+    ++taskStateCounts_[newState.value()];
+  }
+  prestoTask.countedTaskState = newState;
+}
+
+void TaskManager::subscribeToTaskStateChange(
+    const std::shared_ptr<PrestoTask>& prestoTask) {
+  // Velox fulfills the future once the task is no longer running, which may
+  // be after this is destroyed. Hold a weak reference not to extend the
+  // lifetime of the task.
+  prestoTask->task->stateChangeFuture(0)
+      .via(httpSrvCpuExecutor_)
+      .thenValue(
+          [self = self_, weakPrestoTask = folly::to_weak_ptr(prestoTask)](
+              auto&& /*done*/) {
+            auto prestoTask = weakPrestoTask.lock();
+            if (prestoTask == nullptr) {
+              return;
+            }
+            auto taskManager = self->rlock();
+            if (*taskManager != nullptr) {
+              (*taskManager)->onTaskStateChange(prestoTask);
+            }
+          })
+      .thenError(folly::tag_t<std::exception>{}, [](const std::exception& e) {
+        LOG(WARNING) << "Failed waiting for task state change: " << e.what();
+      });
+}
+
+void TaskManager::onTaskStateChange(
+    const std::shared_ptr<PrestoTask>& prestoTask) {
+  {
+    std::lock_guard<std::mutex> l(prestoTask->mutex);
+    // The task might have been removed from the task manager already.
+    if (prestoTask->countedTaskState.has_value()) {
+      updateTaskStateCountLocked(*prestoTask, prestoTask->task->state());
+    }
+  }
+  if (queryResourceMetrics_ != nullptr) {
+    queryResourceMetrics_->addFinishedTask(
+        prestoTask->id.queryId(),
+        QueryResourceMetrics::Usage::fromTaskStats(
+            prestoTask->task->taskStats()));
+  }
+  scheduleCleanupCheck(
+      prestoTask->info.taskId, getCurrentTimeMs() + oldTaskCleanUpMs_);
+  prestoTask->notifyStateChange();
+}
+
 void TaskManager::cancelAbandonedTasks() {
   // We copy task map locally to avoid locking task map for a potentially long
   // time. We also lock for 'read'.
@@ -772,8 +993,8 @@ folly::Future<std::unique_ptr<protocol::TaskInfo>> TaskManager::getTaskInfo(
   auto prestoTask = findOrCreateTask(taskId);
   if (!currentState || !maxWait) {
     // Return current TaskInfo without waiting.
-    promise.setValue(
-        std::make_unique<protocol::TaskInfo>(prestoTask->updateInfo()));
+    promise.setValue(std::make_unique<protocol::TaskInfo>(
+        prestoTask->updateInfo(summarize)));
     prestoTask->updateCoordinatorHeartbeat();
     return std::move(future).via(httpSrvCpuExecutor_);
   }
@@ -785,45 +1006,36 @@ folly::Future<std::unique_ptr<protocol::TaskInfo>> TaskManager::getTaskInfo(
     std::lock_guard<std::mutex> l(prestoTask->mutex);
     prestoTask->updateHeartbeatLocked();
     prestoTask->updateCoordinatorHeartbeatLocked();
-    if (!prestoTask->task) {
+    info = prestoTask->updateInfoLocked(summarize);
+    if (shouldWaitForStateChange(
+            *prestoTask, currentState.value(), info.taskStatus.state)) {
+      // Wait for the next state change notification. We register under the
+      // task lock, so a concurrent state change cannot be missed.
       auto promiseHolder =
           std::make_shared<PromiseHolder<std::unique_ptr<protocol::TaskInfo>>>(
               std::move(promise));
       keepPromiseAlive(promiseHolder, state);
-      prestoTask->infoRequest = folly::to_weak_ptr(promiseHolder);
-
-      return std::move(future)
-          .via(httpSrvCpuExecutor_)
-          .onTimeout(std::chrono::microseconds(maxWaitMicros), [prestoTask]() {
+      addPendingRequest(prestoTask->infoRequests, promiseHolder);
+
+      return longPollTimer_->onTimeout(
+          std::move(future)
+              .via(httpSrvCpuExecutor_)
+              .thenValue(
+                  [summarize](std::unique_ptr<protocol::TaskInfo> taskInfo) {
+                    // The state change notification delivers the full info.
+                    if (summarize) {
+                      taskInfo->stats.pipelines.clear();
+                    }
+                    return taskInfo;
+                  }),
+          std::chrono::microseconds(maxWaitMicros),
+          [prestoTask, summarize]() {
             return std::make_unique<protocol::TaskInfo>(
-                prestoTask->updateInfo());
+                prestoTask->updateInfo(summarize));
           });
     }
-    info = prestoTask->updateInfoLocked();
-  }
-  if (currentState.value() != info.taskStatus.state ||
-      isFinalState(info.taskStatus.state)) {
-    promise.setValue(std::make_unique<protocol::TaskInfo>(info));
-    return std::move(future).via(httpSrvCpuExecutor_);
   }
-
-  auto promiseHolder =
-      std::make_shared<PromiseHolder<std::unique_ptr<protocol::TaskInfo>>>(
-          std::move(promise));
-
-  prestoTask->task->stateChangeFuture(maxWaitMicros)
-      .via(httpSrvCpuExecutor_)
-      .thenValue([promiseHolder, prestoTask](auto&& /*done*/) {
-        promiseHolder->promise.setValue(
-            std::make_unique<protocol::TaskInfo>(prestoTask->updateInfo()));
-      })
-      .thenError(
-          folly::tag_t<std::exception>{},
-          [promiseHolder, prestoTask](const std::exception& /*e*/) {
-            // We come here in the case of maxWait elapsed.
-            promiseHolder->promise.setValue(
-                std::make_unique<protocol::TaskInfo>(prestoTask->updateInfo()));
-          });
+  promise.setValue(std::make_unique<protocol::TaskInfo>(info));
   return std::move(future).via(httpSrvCpuExecutor_);
 }
 
@@ -834,26 +1046,86 @@ folly::Future<std::unique_ptr<Result>> TaskManager::getResults(
     protocol::DataSize maxSize,
     protocol::Duration maxWait,
     std::shared_ptr<http::CallbackRequestHandlerState> state) {
+  return getResultsImpl(
+      nullptr,
+      taskId,
+      destination,
+      token,
+      maxSize,
+      maxWait,
+      std::move(state),
+      httpSrvCpuExecutor_);
+}
+
+std::optional<folly::Future<std::unique_ptr<Result>>>
+TaskManager::tryGetResults(
+    const TaskId& taskId,
+    long destination,
+    long token,
+    protocol::DataSize maxSize,
+    protocol::Duration maxWait,
+    std::shared_ptr<http::CallbackRequestHandlerState> state,
+    folly::EventBase* eventBase) {
+  std::shared_ptr<PrestoTask> prestoTask;
+  taskMap_.withRLock([&](const auto& taskMap) {
+    auto it = taskMap.find(taskId);
+    if (it != taskMap.end()) {
+      prestoTask = it->second;
+    }
+  });
+  if (prestoTask == nullptr) {
+    return std::nullopt;
+  }
+  {
+    // The mutex is held across the creation of the task, so do not wait for
+    // it.
+    std::unique_lock<std::mutex> l(prestoTask->mutex, std::try_to_lock);
+    if (!l.owns_lock() || !prestoTask->taskStarted) {
+      return std::nullopt;
+    }
+    prestoTask->updateHeartbeatLocked();
+    ++prestoTask->info.taskStatus.version;
+  }
+  return getResultsImpl(
+      std::move(prestoTask),
+      taskId,
+      destination,
+      token,
+      maxSize,
+      maxWait,
+      std::move(state),
+      eventBase);
+}
+
+folly::Future<std::unique_ptr<Result>> TaskManager::getResultsImpl(
+    std::shared_ptr<PrestoTask> prestoTask,
+    const TaskId& taskId,
+    long destination,
+    long token,
+    protocol::DataSize maxSize,
+    protocol::Duration maxWait,
+    std::shared_ptr<http::CallbackRequestHandlerState> state,
+    folly::Executor* executor) {
   uint64_t maxWaitMicros =
       std::max(1.0, maxWait.getValue(protocol::TimeUnit::MICROSECONDS));
   VLOG(1) << "TaskManager::getResults task:" << taskId
           << ", destination:" << destination << ", token:" << token;
 
   try {
-    auto prestoTask = findOrCreateTask(taskId);
+    if (prestoTask == nullptr) {
+      prestoTask = findOrCreateTask(taskId);
+    }
 
     // If the task is aborted or failed, then return an error.
     if (prestoTask->info.taskStatus.state == protocol::TaskState::ABORTED) {
       // respond with a delay to prevent request "bursts"
-      return folly::futures::sleep(std::chrono::microseconds(maxWaitMicros))
-          .via(httpSrvCpuExecutor_)
+      return longPollTimer_->sleep(std::chrono::microseconds(maxWaitMicros))
           .thenValue([token](auto&&) { return createEmptyResult(token); });
     }
     if (prestoTask->error != nullptr) {
       LOG(WARNING) << "Calling getResult() on a failed PrestoTask: " << taskId;
       // respond with a delay to prevent request "bursts"
-      return folly::futures::sleep(std::chrono::microseconds(maxWaitMicros))
-          .via(httpSrvCpuExecutor_)
+      return longPollTimer_->sleep(std::chrono::microseconds(maxWaitMicros))
           .thenValue([token](auto&&) { return createEmptyResult(token); });
     }
 
@@ -880,7 +1152,7 @@ folly::Future<std::unique_ptr<Result>> TaskManager::getResults(
         // If the task has finished, then send completion result.
         if (prestoTask->task->state() == exec::kFinished) {
           promiseHolder->promise.setValue(createCompleteResult(token));
-          return std::move(future).via(httpSrvCpuExecutor_);
+          return std::move(future).via(executor);
         }
         // If task is not running let the request timeout. The task may have
         // failed at creation time and the coordinator hasn't yet caught up.
@@ -894,9 +1166,10 @@ folly::Future<std::unique_ptr<Result>> TaskManager::getResults(
               maxSize,
               *bufferManager_);
         }
-        return std::move(future)
-            .via(httpSrvCpuExecutor_)
-            .onTimeout(std::chrono::microseconds(maxWaitMicros), timeoutFn);
+        return longPollTimer_->onTimeout(
+            std::move(future).via(executor),
+            std::chrono::microseconds(maxWaitMicros),
+            timeoutFn);
       }
 
       std::lock_guard<std::mutex> l(prestoTask->mutex);
@@ -917,16 +1190,15 @@ folly::Future<std::unique_ptr<Result>> TaskManager::getResults(
           token,
           maxSize);
       prestoTask->resultRequests.insert({destination, std::move(request)});
-      return std::move(future)
-          .via(httpSrvCpuExecutor_)
-          .onTimeout(std::chrono::microseconds(maxWaitMicros), timeoutFn);
+      return longPollTimer_->onTimeout(
+          std::move(future).via(executor),
+          std::chrono::microseconds(maxWaitMicros),
+          timeoutFn);
     }
   } catch (const velox::VeloxException& e) {
-    return folly::makeSemiFuture<std::unique_ptr<Result>>(e).via(
-        httpSrvCpuExecutor_);
+    return folly::makeSemiFuture<std::unique_ptr<Result>>(e).via(executor);
   } catch (const std::exception& e) {
-    return folly::makeSemiFuture<std::unique_ptr<Result>>(e).via(
-        httpSrvCpuExecutor_);
+    return folly::makeSemiFuture<std::unique_ptr<Result>>(e).via(executor);
   }
 }
 
@@ -953,48 +1225,107 @@ folly::Future<std::unique_ptr<protocol::TaskStatus>> TaskManager::getTaskStatus(
   {
     std::lock_guard<std::mutex> l(prestoTask->mutex);
     prestoTask->updateCoordinatorHeartbeatLocked();
-    if (!prestoTask->task) {
+    status = prestoTask->updateStatusLocked();
+    if (shouldWaitForStateChange(
+            *prestoTask, currentState.value(), status.state)) {
+      // Wait for the next state change notification. We register under the
+      // task lock, so a concurrent state change cannot be missed.
       auto promiseHolder = std::make_shared<
           PromiseHolder<std::unique_ptr<protocol::TaskStatus>>>(
           std::move(promise));
 
       keepPromiseAlive(promiseHolder, state);
-      prestoTask->statusRequest = folly::to_weak_ptr(promiseHolder);
-      return std::move(future)
-          .via(httpSrvCpuExecutor_)
-          .onTimeout(std::chrono::microseconds(maxWaitMicros), [prestoTask]() {
+      addPendingRequest(prestoTask->statusRequests, promiseHolder);
+      return longPollTimer_->onTimeout(
+          std::move(future).via(httpSrvCpuExecutor_),
+          std::chrono::microseconds(maxWaitMicros),
+          [prestoTask]() {
             return std::make_unique<protocol::TaskStatus>(
                 prestoTask->updateStatus());
           });
     }
+  }
 
-    status = prestoTask->updateStatusLocked();
+  promise.setValue(std::make_unique<protocol::TaskStatus>(status));
+  return std::move(future).via(httpSrvCpuExecutor_);
+}
+
+folly::Future<std::unique_ptr<TaskStatusBatch>> TaskManager::getTaskStatuses(
+    const std::vector<protocol::TaskId>& taskIds,
+    const std::optional<std::string>& queryId,
+    std::optional<uint64_t> currentVersion,
+    std::optional<protocol::Duration> maxWait,
+    std::shared_ptr<http::CallbackRequestHandlerState> state) {
+  std::vector<std::shared_ptr<PrestoTask>> prestoTasks;
+  if (queryId.has_value()) {
+    taskMap_.withRLock([&](const auto& taskMap) {
+      for (const auto& [_, prestoTask] : taskMap) {
+        if (prestoTask->id.queryId() == queryId.value()) {
+          prestoTasks.push_back(prestoTask);
+        }
+      }
+    });
+    // The version of the batch depends on the order of the tasks.
+    std::sort(
+        prestoTasks.begin(),
+        prestoTasks.end(),
+        [](const auto& lhs, const auto& rhs) {
+          return lhs->info.taskId < rhs->info.taskId;
+        });
+  } else {
+    prestoTasks.reserve(taskIds.size());
+    for (const auto& taskId : taskIds) {
+      prestoTasks.push_back(findOrCreateTask(taskId));
+    }
   }
 
-  if (currentState.value() != status.state || isFinalState(status.state)) {
-    promise.setValue(std::make_unique<protocol::TaskStatus>(status));
-    return std::move(future).via(httpSrvCpuExecutor_);
+  // The bulk request serves as the coordinator heartbeat for all the tasks.
+  std::vector<uint64_t> stateVersions;
+  stateVersions.reserve(prestoTasks.size());
+  uint64_t version{0};
+  for (const auto& prestoTask : prestoTasks) {
+    prestoTask->updateCoordinatorHeartbeat();
+    stateVersions.push_back(prestoTask->stateVersion);
+    version =
+        combineTaskStatusVersion(version, *prestoTask, stateVersions.back());
   }
 
-  auto promiseHolder =
-      std::make_shared<PromiseHolder<std::unique_ptr<protocol::TaskStatus>>>(
-          std::move(promise));
+  if (!currentVersion.has_value() || !maxWait.has_value() ||
+      currentVersion.value() != version || prestoTasks.empty()) {
+    return folly::makeFuture(makeTaskStatusBatch(prestoTasks));
+  }
 
-  prestoTask->task->stateChangeFuture(maxWaitMicros)
-      .via(httpSrvCpuExecutor_)
-      .thenValue([promiseHolder, prestoTask](auto&& /*done*/) {
-        promiseHolder->promise.setValue(
-            std::make_unique<protocol::TaskStatus>(prestoTask->updateStatus()));
-      })
-      .thenError(
-          folly::tag_t<std::exception>{},
-          [promiseHolder, prestoTask](std::exception const& /*e*/) {
-            // We come here in the case of maxWait elapsed.
-            promiseHolder->promise.setValue(
-                std::make_unique<protocol::TaskStatus>(
-                    prestoTask->updateStatus()));
-          });
-  return std::move(future).via(httpSrvCpuExecutor_);
+  // Subscribe to the state changes of every task. A task whose state changed
+  // since we read its version completes the request right away.
+  std::vector<folly::Future<std::unique_ptr<protocol::TaskStatus>>> futures;
+  futures.reserve(prestoTasks.size());
+  for (size_t i = 0; i < prestoTasks.size(); ++i) {
+    auto& prestoTask = prestoTasks[i];
+    auto [promise, future] =
+        folly::makePromiseContract<std::unique_ptr<protocol::TaskStatus>>();
+    std::unique_lock<std::mutex> l(prestoTask->mutex);
+    if (prestoTask->stateVersion != stateVersions[i]) {
+      l.unlock();
+      return folly::makeFuture(makeTaskStatusBatch(prestoTasks));
+    }
+    auto promiseHolder =
+        std::make_shared<PromiseHolder<std::unique_ptr<protocol::TaskStatus>>>(
+            std::move(promise));
+    keepPromiseAlive(promiseHolder, state);
+    addPendingRequest(prestoTask->statusRequests, promiseHolder);
+    futures.push_back(std::move(future).via(httpSrvCpuExecutor_));
+  }
+
+  const uint64_t maxWaitMicros =
+      std::max(1.0, maxWait.value().getValue(protocol::TimeUnit::MICROSECONDS));
+  return longPollTimer_->onTimeout(
+      folly::collectAny(std::move(futures))
+          .via(httpSrvCpuExecutor_)
+          .thenValue([prestoTasks](auto&& /*unused*/) {
+            return makeTaskStatusBatch(prestoTasks);
+          }),
+      std::chrono::microseconds(maxWaitMicros),
+      [prestoTasks]() { return makeTaskStatusBatch(prestoTasks); });
 }
 
 void TaskManager::removeRemoteSource(
@@ -1051,13 +1382,18 @@ std::shared_ptr<PrestoTask> TaskManager::findOrCreateTask(
   prestoTask->updateHeartbeatLocked();
   ++prestoTask->info.taskStatus.version;
 
+  bool inserted{false};
   taskMap_.withWLock([&](auto& taskMap) {
     if (taskMap.count(taskId) == 0) {
       taskMap[taskId] = prestoTask;
+      inserted = true;
     } else {
       prestoTask = taskMap[taskId];
     }
   });
+  if (inserted) {
+    scheduleCleanupCheck(taskId, getCurrentTimeMs() + oldTaskCleanUpMs_);
+  }
   return prestoTask;
 }
 
@@ -1094,6 +1430,23 @@ velox::exec::Task::DriverCounts TaskManager::getDriverCounts() const {
   return ret;
 }
 
+std::unordered_map<std::string, QueryResourceMetrics::Usage>
+TaskManager::getRunningQueryResourceUsage() const {
+  const auto taskMap = *taskMap_.rlock();
+  std::unordered_map<std::string, QueryResourceMetrics::Usage> usages;
+  for (const auto& [taskId, prestoTask] : taskMap) {
+    // The tasks which stopped running were added to queryResourceMetrics_.
+    if (prestoTask->task == nullptr ||
+        prestoTask->task->state() != velox::exec::TaskState::kRunning) {
+      continue;
+    }
+    usages[prestoTask->id.queryId()].add(
+        QueryResourceMetrics::Usage::fromTaskStats(
+            prestoTask->task->taskStats()));
+  }
+  return usages;
+}
+
 bool TaskManager::getStuckOpCalls(
     std::vector<std::string>& deadlockTasks,
     std::vector<velox::exec::Task::OpCallInfo>& stuckOpCalls) const {
@@ -1133,13 +1486,10 @@ int32_t TaskManager::yieldTasks(
 
 std::array<size_t, 5> TaskManager::getTaskNumbers(size_t& numTasks) const {
   std::array<size_t, 5> res{0};
-  auto taskMap = taskMap_.rlock();
   numTasks = 0;
-  for (const auto& pair : *taskMap) {
-    if (pair.second->task != nullptr) {
-      ++res[pair.second->task->state()];
-      ++numTasks;
-    }
+  for (size_t i = 0; i < res.size(); ++i) {
+    res[i] = taskStateCounts_[i];
+    numTasks += res[i];
   }
   return res;
 }
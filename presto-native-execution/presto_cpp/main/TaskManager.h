@@ -15,14 +15,27 @@
 
 #include <folly/Synchronized.h>
 #include <memory>
+#include <queue>
+#include "presto_cpp/main/LongPollTimer.h"
 #include "presto_cpp/main/PrestoTask.h"
 #include "presto_cpp/main/QueryContextManager.h"
+#include "presto_cpp/main/QueryResourceMetrics.h"
 #include "presto_cpp/main/http/HttpServer.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 #include "velox/exec/OutputBufferManager.h"
 
 namespace facebook::presto {
 
+/// Statuses of a set of tasks returned by the bulk task status request.
+struct TaskStatusBatch {
+  /// Combination of the ids and state versions of the tasks. Changes when
+  /// any of the tasks changes its state. Passed back by the client to
+  /// long-poll for changes.
+  uint64_t version{0};
+
+  std::map<protocol::TaskId, protocol::TaskStatus> taskStatuses;
+};
+
 class TaskManager {
  public:
   TaskManager(
@@ -30,6 +43,8 @@ class TaskManager {
       folly::Executor* httpSrvExecutor,
       folly::Executor* spillerExecutor);
 
+  ~TaskManager();
+
   /// Invoked by Presto server shutdown to wait for all the tasks to complete
   /// and cleanup the completed tasks.
   void shutdown();
@@ -40,6 +55,25 @@ class TaskManager {
 
   void setBaseSpillDirectory(const std::string& baseSpillDirectory);
 
+  /// Invoked with the locations of the remote splits of each task update,
+  /// before the splits are added to the task. Must not block.
+  using RemoteSplitsListener =
+      std::function<void(std::vector<std::string> locations)>;
+
+  /// Sets the listener of the remote splits. Must be called before the first
+  /// task update.
+  void setRemoteSplitsListener(RemoteSplitsListener listener);
+
+  /// Sets the tracker of the per-query resource usage, which gets the usage of
+  /// the tasks when they stop running. Must be called before the first task
+  /// update.
+  void setQueryResourceMetrics(
+      std::shared_ptr<QueryResourceMetrics> queryResourceMetrics);
+
+  QueryResourceMetrics* queryResourceMetrics() const {
+    return queryResourceMetrics_.get();
+  }
+
   bool emptyBaseSpillDirectory() const;
 
   /// Sets the time (ms) that a task is considered to be old for cleanup since
@@ -107,12 +141,37 @@ class TaskManager {
       protocol::Duration maxWait,
       std::shared_ptr<http::CallbackRequestHandlerState> state);
 
+  /// Like getResults() but never waits for the mutex of the task, so that it
+  /// can run on the http IO thread 'eventBase'. The returned future completes
+  /// on 'eventBase'. Returns std::nullopt if the task does not exist, has not
+  /// started or its mutex is held, e.g. while the task is being created or
+  /// updated. The caller then calls getResults() on a CPU thread.
+  std::optional<folly::Future<std::unique_ptr<Result>>> tryGetResults(
+      const protocol::TaskId& taskId,
+      long destination,
+      long token,
+      protocol::DataSize maxSize,
+      protocol::Duration maxWait,
+      std::shared_ptr<http::CallbackRequestHandlerState> state,
+      folly::EventBase* eventBase);
+
   folly::Future<std::unique_ptr<protocol::TaskStatus>> getTaskStatus(
       const protocol::TaskId& taskId,
       std::optional<protocol::TaskState> currentState,
       std::optional<protocol::Duration> maxWait,
       std::shared_ptr<http::CallbackRequestHandlerState> state);
 
+  /// Returns the statuses of 'taskIds' or, if 'queryId' is set, of all the
+  /// tasks of the query on this worker. If 'currentVersion' and 'maxWait' are
+  /// set and 'currentVersion' matches the version of the tasks, waits up to
+  /// 'maxWait' for any of the tasks to change its state.
+  folly::Future<std::unique_ptr<TaskStatusBatch>> getTaskStatuses(
+      const std::vector<protocol::TaskId>& taskIds,
+      const std::optional<std::string>& queryId,
+      std::optional<uint64_t> currentVersion,
+      std::optional<protocol::Duration> maxWait,
+      std::shared_ptr<http::CallbackRequestHandlerState> state);
+
   void removeRemoteSource(
       const protocol::TaskId& taskId,
       const protocol::TaskId& remoteSourceTaskId);
@@ -137,8 +196,13 @@ class TaskManager {
   /// Stores the number of drivers in various states of execution.
   velox::exec::Task::DriverCounts getDriverCounts() const;
 
+  /// Returns the resource usage of the running tasks by query id.
+  std::unordered_map<std::string, QueryResourceMetrics::Usage>
+  getRunningQueryResourceUsage() const;
+
   // Returns array with number of tasks for each of five TaskState (enum defined
-  // in exec/Task.h).
+  // in exec/Task.h). The numbers are maintained incrementally from the task
+  // state change notifications and do not require scanning the task map.
   std::array<size_t, 5> getTaskNumbers(size_t& numTasks) const;
 
   /// Invoked to check the stuck operation calls in the system.  If the function
@@ -183,14 +247,70 @@ class TaskManager {
       const protocol::TaskId& taskId,
       long startProcessCpuTime = 0);
 
+  // Implements getResults() and tryGetResults(). Looks up the task if
+  // 'prestoTask' is null. The returned future completes on 'executor'.
+  folly::Future<std::unique_ptr<Result>> getResultsImpl(
+      std::shared_ptr<PrestoTask> prestoTask,
+      const protocol::TaskId& taskId,
+      long destination,
+      long token,
+      protocol::DataSize maxSize,
+      protocol::Duration maxWait,
+      std::shared_ptr<http::CallbackRequestHandlerState> state,
+      folly::Executor* executor);
+
+  // Subscribes to the state changes of the Velox task of 'prestoTask' which
+  // has just been started.
+  void subscribeToTaskStateChange(
+      const std::shared_ptr<PrestoTask>& prestoTask);
+
+  // Invoked on 'httpSrvCpuExecutor_' when the Velox task of 'prestoTask' is no
+  // longer running. Updates the per-state task counts, schedules the task for
+  // cleanup and completes the pending status and info requests.
+  void onTaskStateChange(const std::shared_ptr<PrestoTask>& prestoTask);
+
+  // Moves the accounting of 'prestoTask' in 'taskStateCounts_' to 'newState'.
+  // If 'newState' is not set, removes the task from the counts. Presto task
+  // must be locked by the caller.
+  void updateTaskStateCountLocked(
+      PrestoTask& prestoTask,
+      std::optional<velox::exec::TaskState> newState);
+
+  // Schedules 'taskId' to be checked by cleanOldTasks() not earlier than at
+  // 'checkTimeMs'.
+  void scheduleCleanupCheck(
+      const protocol::TaskId& taskId,
+      uint64_t checkTimeMs);
+
   std::string baseUri_;
   std::string nodeId_;
   folly::Synchronized<std::string> baseSpillDir_;
-  int32_t oldTaskCleanUpMs_;
+  RemoteSplitsListener remoteSplitsListener_;
+  std::shared_ptr<QueryResourceMetrics> queryResourceMetrics_;
+  int32_t oldTaskCleanUpMs_{60'000};
   std::shared_ptr<velox::exec::OutputBufferManager> bufferManager_;
   folly::Synchronized<TaskMap> taskMap_;
+
+  // Pairs of (check time in ms, task id) ordered by the earliest check time.
+  // cleanOldTasks() only looks at the tasks which are due instead of scanning
+  // the whole task map. A task may have more than one entry.
+  using CleanupCheck = std::pair<uint64_t, protocol::TaskId>;
+  folly::Synchronized<std::priority_queue<
+      CleanupCheck,
+      std::vector<CleanupCheck>,
+      std::greater<CleanupCheck>>>
+      cleanupQueue_;
+
+  // Number of started tasks per Velox task state.
+  std::array<std::atomic<size_t>, 5> taskStateCounts_{};
   std::unique_ptr<QueryContextManager> queryContextManager_;
   folly::Executor* httpSrvCpuExecutor_;
+  // Expires the long-poll requests in batches instead of a timer per request.
+  std::unique_ptr<LongPollTimer> longPollTimer_;
+  // Shared with the task state change continuations, which may run after
+  // this is destroyed. Reset to nullptr by the destructor, which waits for
+  // the running continuations.
+  const std::shared_ptr<folly::Synchronized<TaskManager*>> self_;
 };
 
 } // namespace facebook::presto
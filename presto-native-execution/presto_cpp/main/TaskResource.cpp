@@ -14,17 +14,21 @@
 #include "presto_cpp/main/TaskResource.h"
 #include <presto_cpp/main/common/Exception.h>
 #include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/common/Counters.h"
 #include "presto_cpp/main/common/Utils.h"
 #include "presto_cpp/main/thrift/ProtocolToThrift.h"
 #include "presto_cpp/main/thrift/ThriftIO.h"
 #include "presto_cpp/main/thrift/gen-cpp2/PrestoThrift.h"
 #include "presto_cpp/main/types/PrestoToVeloxQueryPlan.h"
+#include "velox/common/base/StatsReporter.h"
 #include "velox/common/time/Timer.h"
 
 namespace facebook::presto {
 
 namespace {
 
+using Priority = PriorityRequestExecutor::Priority;
+
 void sendTaskNotFound(
     proxygen::ResponseHandler* downstream,
     const protocol::TaskId& taskId) {
@@ -47,6 +51,32 @@ std::optional<protocol::TaskState> getCurrentState(
   return currentState;
 }
 
+// Records the thread switches of a results request which arrived on
+// 'arrivalThread' and looked up the results on 'callThread', and the time from
+// producing 'result' to sending it. Called on the thread sending 'result'.
+void recordResultsHandoff(
+    std::thread::id arrivalThread,
+    std::thread::id callThread,
+    const Result& result) {
+  const std::array<std::thread::id, 4> threads{
+      arrivalThread,
+      callThread,
+      result.createThread,
+      std::this_thread::get_id()};
+  int64_t numHops{0};
+  for (size_t i = 1; i < threads.size(); ++i) {
+    if (threads[i] != threads[i - 1]) {
+      ++numHops;
+    }
+  }
+  RECORD_METRIC_VALUE(kCounterHttpServerResultsNumHops, numHops);
+  RECORD_HISTOGRAM_METRIC_VALUE(
+      kCounterHttpServerResultsHandoffUs,
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - result.createTime)
+          .count());
+}
+
 std::optional<protocol::Duration> getMaxWait(proxygen::HTTPMessage* message) {
   auto& headers = message->getHeaders();
   if (!headers.exists(protocol::PRESTO_MAX_WAIT_HTTP_HEADER)) {
@@ -102,6 +132,15 @@ void TaskResource::registerUris(http::HttpServer& server) {
         return deleteTask(message, pathMatch);
       });
 
+  // task/status must come before the /v1/task/(.+)/status and /v1/task/(.+)
+  // as it's more specific.
+  server.registerGet(
+      R"(/v1/task/status)",
+      [&](proxygen::HTTPMessage* message,
+          const std::vector<std::string>& /*pathMatch*/) {
+        return getTaskStatuses(message);
+      });
+
   server.registerGet(
       R"(/v1/task/(.+)/status)",
       [&](proxygen::HTTPMessage* message,
@@ -131,6 +170,21 @@ void TaskResource::registerUris(http::HttpServer& server) {
       });
 }
 
+bool TaskResource::admit(
+    Priority priority,
+    proxygen::ResponseHandler* downstream) {
+  if (requestExecutor_.tryAdmit(priority)) {
+    return true;
+  }
+  http::sendRetryLaterResponse(
+      downstream,
+      fmt::format(
+          "Too many queued {} priority requests",
+          PriorityRequestExecutor::toString(priority)),
+      requestExecutor_.retryAfter());
+  return false;
+}
+
 proxygen::RequestHandler* TaskResource::abortResults(
     proxygen::HTTPMessage* /*message*/,
     const std::vector<std::string>& pathMatch) {
@@ -142,8 +196,11 @@ proxygen::RequestHandler* TaskResource::abortResults(
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream,
           std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        if (!admit(Priority::kHigh, downstream)) {
+          return;
+        }
         folly::via(
-            httpSrvCpuExecutor_,
+            requestExecutor_.executor(Priority::kHigh),
             [this, taskId, destination, handlerState]() {
               taskManager_.abortResults(taskId, destination);
               return true;
@@ -177,8 +234,11 @@ proxygen::RequestHandler* TaskResource::acknowledgeResults(
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream,
           std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        if (!admit(Priority::kHigh, downstream)) {
+          return;
+        }
         folly::via(
-            httpSrvCpuExecutor_,
+            requestExecutor_.executor(Priority::kHigh),
             [this, taskId, bufferId, token]() {
               taskManager_.acknowledgeResults(taskId, bufferId, token);
               return true;
@@ -218,8 +278,11 @@ proxygen::RequestHandler* TaskResource::createOrUpdateTaskImpl(
           const std::vector<std::unique_ptr<folly::IOBuf>>& body,
           proxygen::ResponseHandler* downstream,
           std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        if (!admit(Priority::kLow, downstream)) {
+          return;
+        }
         folly::via(
-            httpSrvCpuExecutor_,
+            requestExecutor_.executor(Priority::kLow),
             [this, &body, taskId, createOrUpdateFunc]() {
               const auto startProcessCpuTimeNs = util::getProcessCpuTimeNs();
 
@@ -371,8 +434,11 @@ proxygen::RequestHandler* TaskResource::deleteTask(
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream,
           std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        if (!admit(Priority::kHigh, downstream)) {
+          return;
+        }
         folly::via(
-            httpSrvCpuExecutor_,
+            requestExecutor_.executor(Priority::kHigh),
             [this, taskId, abort, downstream]() {
               std::unique_ptr<protocol::TaskInfo> taskInfo;
               taskInfo = taskManager_.deleteTask(taskId, abort);
@@ -432,68 +498,95 @@ proxygen::RequestHandler* TaskResource::getResults(
           proxygen::ResponseHandler* downstream,
           std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
         auto evb = folly::EventBaseManager::get()->getEventBase();
+        const auto arrivalThread = std::this_thread::get_id();
+        // Sends the results once 'results' completes. Called on the thread
+        // which looked up the results.
+        auto sendResults = [evb,
+                            arrivalThread,
+                            taskId,
+                            downstream,
+                            handlerState](
+                               folly::Future<std::unique_ptr<Result>> results) {
+          const auto callThread = std::this_thread::get_id();
+          std::move(results)
+              .via(evb)
+              .thenValue([downstream,
+                          taskId,
+                          handlerState,
+                          arrivalThread,
+                          callThread](std::unique_ptr<Result> result) {
+                if (handlerState->requestExpired()) {
+                  return;
+                }
+                recordResultsHandoff(arrivalThread, callThread, *result);
+                auto status = result->data && result->data->length() == 0
+                    ? http::kHttpNoContent
+                    : http::kHttpOk;
+
+                proxygen::ResponseBuilder builder(downstream);
+                builder.status(status, "")
+                    .header(
+                        proxygen::HTTP_HEADER_CONTENT_TYPE,
+                        protocol::PRESTO_PAGES_MIME_TYPE)
+                    .header(protocol::PRESTO_TASK_INSTANCE_ID_HEADER, taskId)
+                    .header(
+                        protocol::PRESTO_PAGE_TOKEN_HEADER,
+                        std::to_string(result->sequence))
+                    .header(
+                        protocol::PRESTO_PAGE_NEXT_TOKEN_HEADER,
+                        std::to_string(result->nextSequence))
+                    .header(
+                        protocol::PRESTO_BUFFER_COMPLETE_HEADER,
+                        result->complete ? "true" : "false");
+                if (!result->remainingBytes.empty()) {
+                  builder.header(
+                      protocol::PRESTO_BUFFER_REMAINING_BYTES_HEADER,
+                      folly::join(',', result->remainingBytes));
+                }
+                builder.body(std::move(result->data)).sendWithEOM();
+              })
+              .thenError(
+                  folly::tag_t<velox::VeloxException>{},
+                  [downstream, handlerState](const velox::VeloxException& e) {
+                    if (!handlerState->requestExpired()) {
+                      http::sendErrorResponse(downstream, e.what());
+                    }
+                  })
+              .thenError(
+                  folly::tag_t<std::exception>{},
+                  [downstream, handlerState](const std::exception& e) {
+                    if (!handlerState->requestExpired()) {
+                      http::sendErrorResponse(downstream, e.what());
+                    }
+                  });
+        };
+        // Looking up the results of a started task only takes short locks, so
+        // it can run on the IO thread without blocking the other requests of
+        // the event base. Otherwise, e.g. while the task is being created, the
+        // lookup runs on the CPU executor.
+        if (resultsOnIoThread_) {
+          auto results = taskManager_.tryGetResults(
+              taskId, bufferId, token, maxSize, maxWait, handlerState, evb);
+          if (results.has_value()) {
+            sendResults(std::move(results.value()));
+            return;
+          }
+        }
+        if (!admit(Priority::kHigh, downstream)) {
+          return;
+        }
         folly::via(
-            httpSrvCpuExecutor_,
+            requestExecutor_.executor(Priority::kHigh),
             [this,
-             evb,
+             sendResults = std::move(sendResults),
              taskId,
              bufferId,
              token,
              maxSize,
              maxWait,
-             downstream,
              handlerState]() {
-              taskManager_
-                  .getResults(
-                      taskId, bufferId, token, maxSize, maxWait, handlerState)
-                  .via(evb)
-                  .thenValue([downstream, taskId, handlerState](
-                                 std::unique_ptr<Result> result) {
-                    if (handlerState->requestExpired()) {
-                      return;
-                    }
-                    auto status = result->data && result->data->length() == 0
-                        ? http::kHttpNoContent
-                        : http::kHttpOk;
-
-                    proxygen::ResponseBuilder builder(downstream);
-                    builder.status(status, "")
-                        .header(
-                            proxygen::HTTP_HEADER_CONTENT_TYPE,
-                            protocol::PRESTO_PAGES_MIME_TYPE)
-                        .header(
-                            protocol::PRESTO_TASK_INSTANCE_ID_HEADER, taskId)
-                        .header(
-                            protocol::PRESTO_PAGE_TOKEN_HEADER,
-                            std::to_string(result->sequence))
-                        .header(
-                            protocol::PRESTO_PAGE_NEXT_TOKEN_HEADER,
-                            std::to_string(result->nextSequence))
-                        .header(
-                            protocol::PRESTO_BUFFER_COMPLETE_HEADER,
-                            result->complete ? "true" : "false");
-                    if (!result->remainingBytes.empty()) {
-                      builder.header(
-                          protocol::PRESTO_BUFFER_REMAINING_BYTES_HEADER,
-                          folly::join(',', result->remainingBytes));
-                    }
-                    builder.body(std::move(result->data)).sendWithEOM();
-                  })
-                  .thenError(
-                      folly::tag_t<velox::VeloxException>{},
-                      [downstream,
-                       handlerState](const velox::VeloxException& e) {
-                        if (!handlerState->requestExpired()) {
-                          http::sendErrorResponse(downstream, e.what());
-                        }
-                      })
-                  .thenError(
-                      folly::tag_t<std::exception>{},
-                      [downstream, handlerState](const std::exception& e) {
-                        if (!handlerState->requestExpired()) {
-                          http::sendErrorResponse(downstream, e.what());
-                        }
-                      });
+              sendResults(taskManager_.getResults(
+                  taskId, bufferId, token, maxSize, maxWait, handlerState));
             });
       });
 }
@@ -516,9 +609,12 @@ proxygen::RequestHandler* TaskResource::getTaskStatus(
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream,
           std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        if (!admit(Priority::kHigh, downstream)) {
+          return;
+        }
         auto evb = folly::EventBaseManager::get()->getEventBase();
         folly::via(
-            httpSrvCpuExecutor_,
+            requestExecutor_.executor(Priority::kHigh),
             [this,
              evb,
              useThrift,
@@ -568,6 +664,115 @@ proxygen::RequestHandler* TaskResource::getTaskStatus(
       });
 }
 
+proxygen::RequestHandler* TaskResource::getTaskStatuses(
+    proxygen::HTTPMessage* message) {
+  std::vector<protocol::TaskId> taskIds;
+  if (message->hasQueryParam("taskIds")) {
+    folly::split(',', message->getQueryParam("taskIds"), taskIds, true);
+  }
+  std::optional<std::string> queryId;
+  if (message->hasQueryParam("queryId")) {
+    queryId = message->getQueryParam("queryId");
+  }
+  std::optional<uint64_t> currentVersion;
+  if (message->hasQueryParam("version")) {
+    const auto& version = message->getQueryParam("version");
+    const auto parsed = folly::tryTo<uint64_t>(version);
+    if (!parsed.hasValue()) {
+      return new http::ErrorRequestHandler(
+          http::kHttpBadRequest,
+          fmt::format("Invalid task status version '{}'", version));
+    }
+    currentVersion = parsed.value();
+  }
+  auto maxWait = getMaxWait(message);
+
+  auto& headers = message->getHeaders();
+  auto acceptHeader = headers.getSingleOrEmpty(proxygen::HTTP_HEADER_ACCEPT);
+  auto useThrift =
+      acceptHeader.find(http::kMimeTypeApplicationThrift) != std::string::npos;
+
+  return new http::CallbackRequestHandler(
+      [this, useThrift, taskIds, queryId, currentVersion, maxWait](
+          proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+          proxygen::ResponseHandler* downstream,
+          std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        if (!admit(Priority::kHigh, downstream)) {
+          return;
+        }
+        if (taskIds.empty() == !queryId.has_value()) {
+          http::sendErrorResponse(
+              downstream,
+              "Exactly one of 'taskIds' and 'queryId' must be specified",
+              http::kHttpBadRequest);
+          return;
+        }
+        folly::via(
+            requestExecutor_.executor(Priority::kHigh),
+            [this,
+             evb = folly::EventBaseManager::get()->getEventBase(),
+             useThrift,
+             taskIds,
+             queryId,
+             currentVersion,
+             maxWait,
+             handlerState,
+             downstream]() {
+              taskManager_
+                  .getTaskStatuses(
+                      taskIds, queryId, currentVersion, maxWait, handlerState)
+                  .via(evb)
+                  .thenValue([useThrift, downstream, handlerState](
+                                 std::unique_ptr<TaskStatusBatch> batch) {
+                    if (handlerState->requestExpired()) {
+                      return;
+                    }
+                    if (useThrift) {
+                      thrift::TaskStatusBatch thriftBatch;
+                      *thriftBatch.version_ref() = batch->version;
+                      for (const auto& [taskId, taskStatus] :
+                           batch->taskStatuses) {
+                        toThrift(
+                            taskStatus,
+                            (*thriftBatch.taskStatuses_ref())[taskId]);
+                      }
+                      http::sendOkThriftResponse(
+                          downstream, thriftWrite(thriftBatch));
+                    } else {
+                      json batchJson = json::object();
+                      batchJson["version"] = batch->version;
+                      json taskStatusesJson = json::object();
+                      for (const auto& [taskId, taskStatus] :
+                           batch->taskStatuses) {
+                        taskStatusesJson[taskId] = taskStatus;
+                      }
+                      batchJson["taskStatuses"] = std::move(taskStatusesJson);
+                      http::sendOkResponse(downstream, batchJson);
+                    }
+                  })
+                  .thenError(
+                      folly::tag_t<velox::VeloxException>{},
+                      [downstream,
+                       handlerState](const velox::VeloxException& e) {
+                        if (!handlerState->requestExpired()) {
+                          http::sendErrorResponse(downstream, e.what());
+                        }
+                      })
+                  .thenError(
+                      folly::tag_t<std::exception>{},
+                      [downstream, handlerState](const std::exception& e) {
+                        if (!handlerState->requestExpired()) {
+                          http::sendErrorResponse(downstream, e.what());
+                        }
+                      });
+            })
+            .thenError(folly::tag_t<std::exception>{}, [downstream](auto&& e) {
+              http::sendErrorResponse(downstream, e.what());
+            });
+      });
+}
+
 proxygen::RequestHandler* TaskResource::getTaskInfo(
     proxygen::HTTPMessage* message,
     const std::vector<std::string>& pathMatch) {
@@ -582,8 +787,11 @@ proxygen::RequestHandler* TaskResource::getTaskInfo(
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream,
           std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        if (!admit(Priority::kMedium, downstream)) {
+          return;
+        }
         folly::via(
-            httpSrvCpuExecutor_,
+            requestExecutor_.executor(Priority::kMedium),
             [this,
              evb = folly::EventBaseManager::get()->getEventBase(),
              taskId,
@@ -596,11 +804,20 @@ proxygen::RequestHandler* TaskResource::getTaskInfo(
                   .getTaskInfo(
                       taskId, summarize, currentState, maxWait, handlerState)
                   .via(evb)
-                  .thenValue([downstream, taskId, handlerState](
+                  .thenValue([downstream, taskId, summarize, handlerState](
                                  std::unique_ptr<protocol::TaskInfo> taskInfo) {
                     if (!handlerState->requestExpired()) {
                       json taskInfoJson = *taskInfo;
-                      http::sendOkResponse(downstream, taskInfoJson);
+                      const auto body = http::toJsonString(taskInfoJson);
+                      if (summarize) {
+                        RECORD_HISTOGRAM_METRIC_VALUE(
+                            kCounterSummarizedTaskInfoResponseBytes,
+                            body.size());
+                      } else {
+                        RECORD_HISTOGRAM_METRIC_VALUE(
+                            kCounterTaskInfoResponseBytes, body.size());
+                      }
+                      http::sendOkResponse(downstream, body);
                     }
                   })
                   .thenError(
@@ -637,8 +854,11 @@ proxygen::RequestHandler* TaskResource::removeRemoteSource(
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream,
           std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        if (!admit(Priority::kHigh, downstream)) {
+          return;
+        }
         folly::via(
-            httpSrvCpuExecutor_,
+            requestExecutor_.executor(Priority::kHigh),
             [this, taskId, remoteId, downstream]() {
               taskManager_.removeRemoteSource(taskId, remoteId);
             })
@@ -13,6 +13,7 @@
  */
 #pragma once
 
+#include "presto_cpp/main/PriorityRequestExecutor.h"
 #include "presto_cpp/main/TaskManager.h"
 #include "presto_cpp/main/http/HttpServer.h"
 #include "velox/common/memory/Memory.h"
@@ -24,14 +25,23 @@ class TaskResource {
   explicit TaskResource(
       TaskManager& taskManager,
       velox::memory::MemoryPool* pool,
-      folly::Executor* httpSrvCpuExecutor)
-      : httpSrvCpuExecutor_(httpSrvCpuExecutor),
+      folly::Executor* httpSrvCpuExecutor,
+      PriorityRequestExecutor::Options executorOptions = {},
+      bool resultsOnIoThread = false)
+      : requestExecutor_(httpSrvCpuExecutor, std::move(executorOptions)),
+        resultsOnIoThread_(resultsOnIoThread),
         pool_{pool},
         taskManager_(taskManager) {}
 
   void registerUris(http::HttpServer& server);
 
  private:
+  // Returns false and fails the request with 503 if too many requests of
+  // 'priority' are queued.
+  bool admit(
+      PriorityRequestExecutor::Priority priority,
+      proxygen::ResponseHandler* downstream);
+
   proxygen::RequestHandler* abortResults(
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch);
@@ -87,6 +97,12 @@ class TaskResource {
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch);
 
+  /// Returns the statuses of the tasks listed in the comma-separated 'taskIds'
+  /// query parameter or of all the tasks of the 'queryId' query parameter.
+  /// Long-polls for a state change when the 'version' query parameter and the
+  /// max wait header are set.
+  proxygen::RequestHandler* getTaskStatuses(proxygen::HTTPMessage* message);
+
   proxygen::RequestHandler* getTaskInfo(
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch);
@@ -95,7 +111,13 @@ class TaskResource {
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch);
 
-  folly::Executor* const httpSrvCpuExecutor_;
+  // Runs the requests on the http server CPU executor with a priority per
+  // endpoint.
+  PriorityRequestExecutor requestExecutor_;
+  // If true, the result requests of started tasks are served on the http IO
+  // thread they arrive on instead of on 'requestExecutor_'. See
+  // 'exchange.io-thread-data-path'.
+  const bool resultsOnIoThread_;
   velox::memory::MemoryPool* const pool_;
 
   TaskManager& taskManager_;
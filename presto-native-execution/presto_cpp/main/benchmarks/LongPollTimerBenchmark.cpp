@@ -0,0 +1,102 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <folly/Benchmark.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+#include "presto_cpp/main/LongPollTimer.h"
+
+DEFINE_int32(num_long_polls, 10'000, "Number of concurrent long-polls");
+
+using namespace facebook::presto;
+
+namespace {
+
+folly::CPUThreadPoolExecutor* executor() {
+  static auto executor = std::make_unique<folly::CPUThreadPoolExecutor>(8);
+  return executor.get();
+}
+
+LongPollTimer* longPollTimer() {
+  static auto timer = std::make_unique<LongPollTimer>(executor());
+  return timer.get();
+}
+
+// Starts 'num_long_polls' concurrent long-polls with 'timeout' using
+// 'withTimeout' to install the timeout. If 'respond' is true, completes them
+// before the timeout, otherwise lets them expire.
+template <typename F>
+void runLongPolls(
+    uint32_t iterations,
+    std::chrono::microseconds timeout,
+    bool respond,
+    F withTimeout) {
+  for (uint32_t i = 0; i < iterations; ++i) {
+    std::vector<folly::Promise<int>> promises;
+    std::vector<folly::Future<int>> futures;
+    promises.reserve(FLAGS_num_long_polls);
+    futures.reserve(FLAGS_num_long_polls);
+    for (auto j = 0; j < FLAGS_num_long_polls; ++j) {
+      auto [promise, future] = folly::makePromiseContract<int>();
+      futures.push_back(
+          withTimeout(std::move(future).via(executor()), timeout));
+      promises.push_back(std::move(promise));
+    }
+    if (respond) {
+      for (auto& promise : promises) {
+        promise.setValue(1);
+      }
+    }
+    folly::collectAll(std::move(futures)).get();
+  }
+}
+
+auto follyOnTimeout() {
+  return [](folly::Future<int> future, std::chrono::microseconds timeout) {
+    return std::move(future).onTimeout(timeout, []() { return -1; });
+  };
+}
+
+auto sharedOnTimeout() {
+  return [](folly::Future<int> future, std::chrono::microseconds timeout) {
+    return longPollTimer()->onTimeout(
+        std::move(future), timeout, []() { return -1; });
+  };
+}
+
+} // namespace
+
+BENCHMARK(respondedFollyOnTimeout, n) {
+  runLongPolls(n, std::chrono::seconds(1), true, follyOnTimeout());
+}
+
+BENCHMARK_RELATIVE(respondedLongPollTimer, n) {
+  runLongPolls(n, std::chrono::seconds(1), true, sharedOnTimeout());
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(expiredFollyOnTimeout, n) {
+  runLongPolls(n, std::chrono::milliseconds(20), false, follyOnTimeout());
+}
+
+BENCHMARK_RELATIVE(expiredLongPollTimer, n) {
+  runLongPolls(n, std::chrono::milliseconds(20), false, sharedOnTimeout());
+}
+
+int main(int argc, char** argv) {
+  folly::Init init{&argc, &argv};
+  folly::runBenchmarks();
+  return 0;
+}
@@ -20,6 +20,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <folly/String.h>
 #if __has_include("filesystem")
 #include <filesystem>
 namespace fs = std::filesystem;
@@ -178,9 +179,16 @@ SystemConfig::SystemConfig() {
           NUM_PROP(kSystemMemShrinkGb, 8),
           BOOL_PROP(kMallocMemHeapDumpEnabled, false),
           BOOL_PROP(kSystemMemPushbackAbortEnabled, false),
+          BOOL_PROP(kSystemMemPredictivePushbackEnabled, false),
+          STR_PROP(kSystemMemPushbackPredictionWindow, "10s"),
+          NUM_PROP(kSystemMemPressureStallPctThreshold, 10),
+          NUM_PROP(kSystemMemPushbackMinConsecutivePredictions, 3),
           NUM_PROP(kMallocHeapDumpThresholdGb, 20),
           NUM_PROP(kMallocMemMinHeapDumpInterval, 10),
           NUM_PROP(kMallocMemMaxHeapDumpFiles, 5),
+          NUM_PROP(kCpuProfilerBackgroundFrequencyHz, 0),
+          BOOL_PROP(kCpuProfilerOnDemandEnabled, false),
+          NUM_PROP(kExecutorTaskStatsSampleRate, 0),
           BOOL_PROP(kNativeSidecar, false),
           BOOL_PROP(kAsyncDataCacheEnabled, true),
           NUM_PROP(kAsyncCacheSsdGb, 0),
@@ -204,9 +212,25 @@ SystemConfig::SystemConfig() {
           BOOL_PROP(kEnableVeloxExprSetLogging, false),
           NUM_PROP(kLocalShuffleMaxPartitionBytes, 268435456),
           STR_PROP(kShuffleName, ""),
+          STR_PROP(kBroadcastServeDirectory, ""),
           STR_PROP(kRemoteFunctionServerCatalogName, ""),
           STR_PROP(kRemoteFunctionServerSerde, "presto_page"),
           BOOL_PROP(kHttpEnableAccessLog, false),
+          STR_PROP(kHttpAccessLogFile, ""),
+          STR_PROP(kHttpAccessLogMaxFileSize, "100MB"),
+          NUM_PROP(kHttpAccessLogMaxFiles, 5),
+          NUM_PROP(kHttpAccessLogQueueSize, 4096),
+          BOOL_PROP(kHttpEnableResponseCompression, false),
+          STR_PROP(kHttpResponseCompressionMinSize, "16kB"),
+          STR_PROP(kHttpResponseCompressionContentTypes, "application/json"),
+          STR_PROP(kHttpResponseCompressionCodecs, "zstd,gzip"),
+          STR_PROP(kHttpServerIdleTimeout, "60s"),
+          STR_PROP(kHttpServerHttp2InitialReceiveWindow, "1MB"),
+          STR_PROP(kHttpServerHttp2ReceiveStreamWindowSize, "1MB"),
+          STR_PROP(kHttpServerHttp2ReceiveSessionWindowSize, "10MB"),
+          NUM_PROP(kHttpServerMaxQueuedHighPriorityRequests, 0),
+          NUM_PROP(kHttpServerMaxQueuedMediumPriorityRequests, 0),
+          NUM_PROP(kHttpServerMaxQueuedLowPriorityRequests, 0),
           BOOL_PROP(kHttpEnableStatsFilter, false),
           BOOL_PROP(kHttpEnableEndpointLatencyFilter, false),
           BOOL_PROP(kRegisterTestFunctions, false),
@@ -215,6 +239,7 @@ SystemConfig::SystemConfig() {
           BOOL_PROP(kEnableMemoryLeakCheck, true),
           NONE_PROP(kRemoteFunctionServerThriftPort),
           BOOL_PROP(kSkipRuntimeStatsInRunningTaskInfo, true),
+          NUM_PROP(kTaskInfoMaxRuntimeStats, 0),
           BOOL_PROP(kLogZombieTaskInfo, false),
           NUM_PROP(kLogNumZombieTasks, 20),
           NUM_PROP(kAnnouncementMaxFrequencyMs, 30'000), // 30s
@@ -223,8 +248,16 @@ SystemConfig::SystemConfig() {
           STR_PROP(kExchangeRequestTimeout, "20s"),
           STR_PROP(kExchangeConnectTimeout, "20s"),
           BOOL_PROP(kExchangeEnableConnectionPool, true),
+          NUM_PROP(kExchangeHttpClientMaxConnectionsPerServer, 250),
+          STR_PROP(kExchangeHttpClientIdleSessionTimeout, "30s"),
+          STR_PROP(kExchangeHttpClientHttp2StreamWindowSize, "1MB"),
+          STR_PROP(kExchangeHttpClientHttp2SessionWindowSize, "10MB"),
+          BOOL_PROP(kExchangeHttpClientHttp2AdaptiveStreamWindow, false),
+          STR_PROP(kExchangeHttpClientHttp2MaxStreamWindowSize, "64MB"),
+          NUM_PROP(kExchangeHttpClientWarmUpConnectionsPerServer, 0),
           BOOL_PROP(kExchangeEnableBufferCopy, true),
           BOOL_PROP(kExchangeImmediateBufferTransfer, true),
+          BOOL_PROP(kExchangeIoThreadDataPath, false),
           NUM_PROP(kTaskRunTimeSliceMicros, 50'000),
           BOOL_PROP(kIncludeNodeInSpillPath, false),
           NUM_PROP(kOldTaskCleanUpMs, 60'000),
@@ -239,6 +272,9 @@ SystemConfig::SystemConfig() {
           STR_PROP(kCacheVeloxTtlThreshold, "2d"),
           STR_PROP(kCacheVeloxTtlCheckInterval, "1h"),
           BOOL_PROP(kEnableRuntimeMetricsCollection, false),
+          BOOL_PROP(kRuntimeMetricsShardedCollection, false),
+          STR_PROP(kRuntimeMetricsScrapeCacheTtl, "0s"),
+          NUM_PROP(kRuntimeMetricsMaxLabeledQueries, 0),
       };
 }
 
@@ -423,6 +459,25 @@ bool SystemConfig::systemMemPushBackAbortEnabled() const {
   return optionalProperty<bool>(kSystemMemPushbackAbortEnabled).value();
 }
 
+bool SystemConfig::systemMemPredictivePushbackEnabled() const {
+  return optionalProperty<bool>(kSystemMemPredictivePushbackEnabled).value();
+}
+
+std::chrono::duration<double> SystemConfig::systemMemPushbackPredictionWindow()
+    const {
+  return velox::core::toDuration(
+      optionalProperty(kSystemMemPushbackPredictionWindow).value());
+}
+
+double SystemConfig::systemMemPressureStallPctThreshold() const {
+  return optionalProperty<double>(kSystemMemPressureStallPctThreshold).value();
+}
+
+uint32_t SystemConfig::systemMemPushbackMinConsecutivePredictions() const {
+  return optionalProperty<uint32_t>(kSystemMemPushbackMinConsecutivePredictions)
+      .value();
+}
+
 bool SystemConfig::mallocMemHeapDumpEnabled() const {
   return optionalProperty<bool>(kMallocMemHeapDumpEnabled).value();
 }
@@ -439,6 +494,18 @@ uint32_t SystemConfig::mallocMemMaxHeapDumpFiles() const {
   return optionalProperty<uint32_t>(kMallocMemMaxHeapDumpFiles).value();
 }
 
+int32_t SystemConfig::cpuProfilerBackgroundFrequencyHz() const {
+  return optionalProperty<int32_t>(kCpuProfilerBackgroundFrequencyHz).value();
+}
+
+bool SystemConfig::cpuProfilerOnDemandEnabled() const {
+  return optionalProperty<bool>(kCpuProfilerOnDemandEnabled).value();
+}
+
+uint32_t SystemConfig::executorTaskStatsSampleRate() const {
+  return optionalProperty<uint32_t>(kExecutorTaskStatsSampleRate).value();
+}
+
 uint64_t SystemConfig::asyncCacheSsdGb() const {
   return optionalProperty<uint64_t>(kAsyncCacheSsdGb).value();
 }
@@ -493,6 +560,10 @@ std::string SystemConfig::shuffleName() const {
   return optionalProperty(kShuffleName).value();
 }
 
+std::string SystemConfig::broadcastServeDirectory() const {
+  return optionalProperty(kBroadcastServeDirectory).value();
+}
+
 bool SystemConfig::enableSerializedPageChecksum() const {
   return optionalProperty<bool>(kEnableSerializedPageChecksum).value();
 }
@@ -559,6 +630,90 @@ bool SystemConfig::enableHttpAccessLog() const {
   return optionalProperty<bool>(kHttpEnableAccessLog).value();
 }
 
+std::string SystemConfig::httpAccessLogFile() const {
+  return optionalProperty(kHttpAccessLogFile).value();
+}
+
+uint64_t SystemConfig::httpAccessLogMaxFileSize() const {
+  return toCapacity(
+      optionalProperty(kHttpAccessLogMaxFileSize).value(),
+      velox::core::CapacityUnit::BYTE);
+}
+
+uint32_t SystemConfig::httpAccessLogMaxFiles() const {
+  return optionalProperty<uint32_t>(kHttpAccessLogMaxFiles).value();
+}
+
+uint32_t SystemConfig::httpAccessLogQueueSize() const {
+  return optionalProperty<uint32_t>(kHttpAccessLogQueueSize).value();
+}
+
+std::chrono::duration<double> SystemConfig::httpServerIdleTimeout() const {
+  return velox::core::toDuration(
+      optionalProperty(kHttpServerIdleTimeout).value());
+}
+
+uint64_t SystemConfig::httpServerHttp2InitialReceiveWindow() const {
+  return toCapacity(
+      optionalProperty(kHttpServerHttp2InitialReceiveWindow).value(),
+      velox::core::CapacityUnit::BYTE);
+}
+
+uint64_t SystemConfig::httpServerHttp2ReceiveStreamWindowSize() const {
+  return toCapacity(
+      optionalProperty(kHttpServerHttp2ReceiveStreamWindowSize).value(),
+      velox::core::CapacityUnit::BYTE);
+}
+
+uint64_t SystemConfig::httpServerHttp2ReceiveSessionWindowSize() const {
+  return toCapacity(
+      optionalProperty(kHttpServerHttp2ReceiveSessionWindowSize).value(),
+      velox::core::CapacityUnit::BYTE);
+}
+
+uint32_t SystemConfig::httpServerMaxQueuedHighPriorityRequests() const {
+  return optionalProperty<uint32_t>(kHttpServerMaxQueuedHighPriorityRequests)
+      .value();
+}
+
+uint32_t SystemConfig::httpServerMaxQueuedMediumPriorityRequests() const {
+  return optionalProperty<uint32_t>(kHttpServerMaxQueuedMediumPriorityRequests)
+      .value();
+}
+
+uint32_t SystemConfig::httpServerMaxQueuedLowPriorityRequests() const {
+  return optionalProperty<uint32_t>(kHttpServerMaxQueuedLowPriorityRequests)
+      .value();
+}
+
+bool SystemConfig::enableHttpResponseCompression() const {
+  return optionalProperty<bool>(kHttpEnableResponseCompression).value();
+}
+
+uint64_t SystemConfig::httpResponseCompressionMinSize() const {
+  return toCapacity(
+      optionalProperty(kHttpResponseCompressionMinSize).value(),
+      velox::core::CapacityUnit::BYTE);
+}
+
+std::vector<std::string> SystemConfig::httpResponseCompressionContentTypes()
+    const {
+  std::vector<std::string> contentTypes;
+  folly::split(
+      ',',
+      optionalProperty(kHttpResponseCompressionContentTypes).value(),
+      contentTypes,
+      true);
+  for (auto& contentType : contentTypes) {
+    contentType = folly::trimWhitespace(contentType).str();
+  }
+  return contentTypes;
+}
+
+std::string SystemConfig::httpResponseCompressionCodecs() const {
+  return optionalProperty(kHttpResponseCompressionCodecs).value();
+}
+
 bool SystemConfig::enableHttpStatsFilter() const {
   return optionalProperty<bool>(kHttpEnableStatsFilter).value();
 }
@@ -594,6 +749,10 @@ bool SystemConfig::skipRuntimeStatsInRunningTaskInfo() const {
   return optionalProperty<bool>(kSkipRuntimeStatsInRunningTaskInfo).value();
 }
 
+uint32_t SystemConfig::taskInfoMaxRuntimeStats() const {
+  return optionalProperty<uint32_t>(kTaskInfoMaxRuntimeStats).value();
+}
+
 bool SystemConfig::logZombieTaskInfo() const {
   return optionalProperty<bool>(kLogZombieTaskInfo).value();
 }
@@ -629,6 +788,46 @@ bool SystemConfig::exchangeEnableConnectionPool() const {
   return optionalProperty<bool>(kExchangeEnableConnectionPool).value();
 }
 
+uint32_t SystemConfig::exchangeHttpClientMaxConnectionsPerServer() const {
+  return optionalProperty<uint32_t>(kExchangeHttpClientMaxConnectionsPerServer)
+      .value();
+}
+
+std::chrono::duration<double>
+SystemConfig::exchangeHttpClientIdleSessionTimeout() const {
+  return velox::core::toDuration(
+      optionalProperty(kExchangeHttpClientIdleSessionTimeout).value());
+}
+
+uint64_t SystemConfig::exchangeHttpClientHttp2StreamWindowSize() const {
+  return toCapacity(
+      optionalProperty(kExchangeHttpClientHttp2StreamWindowSize).value(),
+      velox::core::CapacityUnit::BYTE);
+}
+
+uint64_t SystemConfig::exchangeHttpClientHttp2SessionWindowSize() const {
+  return toCapacity(
+      optionalProperty(kExchangeHttpClientHttp2SessionWindowSize).value(),
+      velox::core::CapacityUnit::BYTE);
+}
+
+bool SystemConfig::exchangeHttpClientHttp2AdaptiveStreamWindow() const {
+  return optionalProperty<bool>(kExchangeHttpClientHttp2AdaptiveStreamWindow)
+      .value();
+}
+
+uint64_t SystemConfig::exchangeHttpClientHttp2MaxStreamWindowSize() const {
+  return toCapacity(
+      optionalProperty(kExchangeHttpClientHttp2MaxStreamWindowSize).value(),
+      velox::core::CapacityUnit::BYTE);
+}
+
+uint32_t SystemConfig::exchangeHttpClientWarmUpConnectionsPerServer() const {
+  return optionalProperty<uint32_t>(
+             kExchangeHttpClientWarmUpConnectionsPerServer)
+      .value();
+}
+
 bool SystemConfig::exchangeEnableBufferCopy() const {
   return optionalProperty<bool>(kExchangeEnableBufferCopy).value();
 }
@@ -637,6 +836,10 @@ bool SystemConfig::exchangeImmediateBufferTransfer() const {
   return optionalProperty<bool>(kExchangeImmediateBufferTransfer).value();
 }
 
+bool SystemConfig::exchangeIoThreadDataPath() const {
+  return optionalProperty<bool>(kExchangeIoThreadDataPath).value();
+}
+
 int32_t SystemConfig::taskRunTimeSliceMicros() const {
   return optionalProperty<int32_t>(kTaskRunTimeSliceMicros).value();
 }
@@ -694,6 +897,20 @@ bool SystemConfig::enableRuntimeMetricsCollection() const {
   return optionalProperty<bool>(kEnableRuntimeMetricsCollection).value();
 }
 
+bool SystemConfig::runtimeMetricsShardedCollection() const {
+  return optionalProperty<bool>(kRuntimeMetricsShardedCollection).value();
+}
+
+std::chrono::duration<double> SystemConfig::runtimeMetricsScrapeCacheTtl()
+    const {
+  return velox::core::toDuration(
+      optionalProperty(kRuntimeMetricsScrapeCacheTtl).value());
+}
+
+uint32_t SystemConfig::runtimeMetricsMaxLabeledQueries() const {
+  return optionalProperty<uint32_t>(kRuntimeMetricsMaxLabeledQueries).value();
+}
+
 NodeConfig::NodeConfig() {
   registeredProps_ =
       std::unordered_map<std::string, folly::Optional<std::string>>{
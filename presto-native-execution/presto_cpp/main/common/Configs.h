@@ -293,6 +293,29 @@ class SystemConfig : public ConfigBase {
   /// 'system-mem-pushback-enabled' is set.
   static constexpr std::string_view kSystemMemPushbackAbortEnabled{
       "system-mem-pushback-abort-enabled"};
+  /// If true, the memory pushback shrinks the cache, requests spilling and
+  /// pauses the task admission before the memory usage reaches
+  /// 'system-mem-limit-gb' if the usage is predicted to reach the limit
+  /// within 'system-mem-pushback-prediction-window' or the memory pressure
+  /// stall exceeds 'system-mem-pressure-stall-pct-threshold'. This only
+  /// applies if 'system-mem-pushback-enabled' is set.
+  static constexpr std::string_view kSystemMemPredictivePushbackEnabled{
+      "system-mem-predictive-pushback-enabled"};
+  /// The time ahead for which the predictive memory pushback extrapolates the
+  /// memory usage with its current growth rate.
+  static constexpr std::string_view kSystemMemPushbackPredictionWindow{
+      "system-mem-pushback-prediction-window"};
+  /// Percentage of the time some tasks of the cgroup of the worker were
+  /// stalled on memory, from the memory.pressure PSI file, which triggers the
+  /// predictive memory pushback.
+  static constexpr std::string_view kSystemMemPressureStallPctThreshold{
+      "system-mem-pressure-stall-pct-threshold"};
+  /// Number of consecutive checks for which the memory usage must be
+  /// predicted to exceed 'system-mem-limit-gb' before the predictive memory
+  /// pushback requests spilling and pauses the task admission. The cache is
+  /// shrunk on the first such check.
+  static constexpr std::string_view kSystemMemPushbackMinConsecutivePredictions{
+      "system-mem-pushback-min-consecutive-predictions"};
 
   /// If true, memory allocated via malloc is periodically checked and a heap
   /// profile is dumped if usage exceeds 'malloc-heap-dump-gb-threshold'.
@@ -315,6 +338,29 @@ class SystemConfig : public ConfigBase {
   static constexpr std::string_view kMallocMemMaxHeapDumpFiles{
       "malloc-mem-max-heap-dump-files"};
 
+  /// Frequency in Hz of the always-on background CPU profiler, which samples
+  /// the stacks of the threads using CPU and tags them with the id of the task
+  /// they run. 0 disables it. The profile is fetched with the server operation
+  /// /v1/operation/server/profile?type=background. Off by default, the
+  /// unwinding of the stacks may deadlock a thread with an older glibc, see
+  /// CpuProfiler.
+  static constexpr std::string_view kCpuProfilerBackgroundFrequencyHz{
+      "cpu-profiler-background-frequency-hz"};
+
+  /// If true, the server operation /v1/operation/server/profile runs an
+  /// on-demand CPU profile. Off by default for the same reason as the
+  /// background profiler: the unwinding of the stacks may deadlock a thread
+  /// with an older glibc, see CpuProfiler.
+  static constexpr std::string_view kCpuProfilerOnDemandEnabled{
+      "cpu-profiler-on-demand-enabled"};
+
+  /// If N > 0, the thread pools count their busy threads and record the queue
+  /// wait and run time of 1 in every N tasks. 0 disables the per-task stats,
+  /// which then cost nothing on the task path. The CPU utilization and
+  /// scheduler stats of the pools are sampled regardless.
+  static constexpr std::string_view kExecutorTaskStatsSampleRate{
+      "executor-task-stats-sample-rate"};
+
   static constexpr std::string_view kAsyncDataCacheEnabled{
       "async-data-cache-enabled"};
   static constexpr std::string_view kAsyncCacheSsdGb{"async-cache-ssd-gb"};
@@ -383,6 +429,27 @@ class SystemConfig : public ConfigBase {
   static constexpr std::string_view kEnableRuntimeMetricsCollection{
       "runtime-metrics-collection-enabled"};
 
+  /// If true, the runtime metrics reporter accumulates the counters and
+  /// histograms in per-thread shards which are merged when the metrics are
+  /// fetched. The histogram percentiles are then computed from the buckets
+  /// instead of being tracked per value. Applies if
+  /// runtime-metrics-collection-enabled is true.
+  static constexpr std::string_view kRuntimeMetricsShardedCollection{
+      "runtime-metrics-sharded-collection"};
+
+  /// The time for which the runtime metrics serialized for a scrape are
+  /// served to the following scrapes. Concurrent scrapes share one
+  /// serialization. 0 serializes the metrics for every scrape.
+  static constexpr std::string_view kRuntimeMetricsScrapeCacheTtl{
+      "runtime-metrics-scrape-cache-ttl"};
+
+  /// Max number of queries whose resource usage is exported as metrics
+  /// labeled by query id. The queries using the most CPU are exported, the
+  /// others are summed under one label. 0 disables the per-query metrics.
+  /// Requires a stats reporter which supports labels.
+  static constexpr std::string_view kRuntimeMetricsMaxLabeledQueries{
+      "runtime-metrics-max-labeled-queries"};
+
   /// Specifies the memory arbitrator kind. If it is empty, then there is no
   /// memory arbitration.
   static constexpr std::string_view kMemoryArbitratorKind{
@@ -432,8 +499,71 @@ class SystemConfig : public ConfigBase {
   static constexpr std::string_view kLocalShuffleMaxPartitionBytes{
       "shuffle.local.max-partition-bytes"};
   static constexpr std::string_view kShuffleName{"shuffle.name"};
+  /// Local directory with the broadcast files written by this worker. If set,
+  /// the files are served to remote readers at /v1/broadcast/<file name>. The
+  /// directory must be the base path of the BroadcastWrite plan nodes.
+  static constexpr std::string_view kBroadcastServeDirectory{
+      "broadcast.serve-directory"};
+  /// Writes an access log line per http request. The logged url, including its
+  /// query string, is truncated to 255 bytes, the referer and the user agent
+  /// to 127 bytes.
   static constexpr std::string_view kHttpEnableAccessLog{
       "http-server.enable-access-log"};
+  /// The file the access log is written to. If empty, the access log goes to
+  /// the INFO log.
+  static constexpr std::string_view kHttpAccessLogFile{
+      "http-server.access-log-file"};
+  /// The access log file is rotated when it grows above this size.
+  static constexpr std::string_view kHttpAccessLogMaxFileSize{
+      "http-server.access-log-max-file-size"};
+  /// Number of rotated access log files to keep.
+  static constexpr std::string_view kHttpAccessLogMaxFiles{
+      "http-server.access-log-max-files"};
+  /// Max number of access log records waiting to be written. Records are
+  /// dropped when the queue is full. The queue is preallocated when the access
+  /// log is enabled, at about 640 bytes per record.
+  static constexpr std::string_view kHttpAccessLogQueueSize{
+      "http-server.access-log-queue-size"};
+  /// Compresses the http responses of the content types in
+  /// http-server.response-compression-content-types which are larger than
+  /// http-server.response-compression-min-size, with the first codec in
+  /// http-server.response-compression-codecs the client accepts.
+  static constexpr std::string_view kHttpEnableResponseCompression{
+      "http-server.enable-response-compression"};
+  static constexpr std::string_view kHttpResponseCompressionMinSize{
+      "http-server.response-compression-min-size"};
+  /// Comma separated list of content types. The data plane
+  /// application/x-presto-pages responses are already compressed and can not
+  /// be listed.
+  static constexpr std::string_view kHttpResponseCompressionContentTypes{
+      "http-server.response-compression-content-types"};
+  /// Comma separated list of codecs in order of preference. Supported codecs
+  /// are zstd and gzip.
+  static constexpr std::string_view kHttpResponseCompressionCodecs{
+      "http-server.response-compression-codecs"};
+  /// Time after which the idle connections to the http server are closed.
+  static constexpr std::string_view kHttpServerIdleTimeout{
+      "http-server.idle-timeout"};
+  /// HTTP/2 flow control windows of the http server. They limit how much data
+  /// a client can send before the server reads it.
+  static constexpr std::string_view kHttpServerHttp2InitialReceiveWindow{
+      "http-server.http2.initial-receive-window"};
+  static constexpr std::string_view kHttpServerHttp2ReceiveStreamWindowSize{
+      "http-server.http2.receive-stream-window-size"};
+  static constexpr std::string_view kHttpServerHttp2ReceiveSessionWindowSize{
+      "http-server.http2.receive-session-window-size"};
+  /// Max number of task requests of each priority class waiting for a thread
+  /// of the http server CPU executor. The requests above the limit are
+  /// rejected with 503 and Retry-After. 0 means unlimited. High priority are
+  /// the result, acknowledge, status and delete requests, medium the task info
+  /// requests and low the task creations and updates.
+  static constexpr std::string_view kHttpServerMaxQueuedHighPriorityRequests{
+      "http-server.max-queued-high-priority-requests"};
+  static constexpr std::string_view
+      kHttpServerMaxQueuedMediumPriorityRequests{
+          "http-server.max-queued-medium-priority-requests"};
+  static constexpr std::string_view kHttpServerMaxQueuedLowPriorityRequests{
+      "http-server.max-queued-low-priority-requests"};
   static constexpr std::string_view kHttpEnableStatsFilter{
       "http-server.enable-stats-filter"};
   static constexpr std::string_view kHttpEnableEndpointLatencyFilter{
@@ -462,6 +592,12 @@ class SystemConfig : public ConfigBase {
   static constexpr std::string_view kSkipRuntimeStatsInRunningTaskInfo{
       "skip-runtime-stats-in-running-task-info"};
 
+  /// Maximum number of runtime metrics reported in the task info per task
+  /// and per operator. When exceeded, the metrics with the largest sums of
+  /// each unit are kept. Zero means no limit.
+  static constexpr std::string_view kTaskInfoMaxRuntimeStats{
+      "task-info-max-runtime-stats"};
+
   static constexpr std::string_view kLogZombieTaskInfo{"log-zombie-task-info"};
   static constexpr std::string_view kLogNumZombieTasks{"log-num-zombie-tasks"};
 
@@ -499,6 +635,17 @@ class SystemConfig : public ConfigBase {
   static constexpr std::string_view kExchangeImmediateBufferTransfer{
       "exchange.immediate-buffer-transfer"};
 
+  /// If true, the exchange data path runs on the http IO threads: the exchange
+  /// processes a data response on the IO thread which received it instead of
+  /// on a driver thread, and the http server serves the result requests on
+  /// its IO thread instead of on the http server CPU executor. The responses
+  /// which need a buffer copy, i.e. if 'exchange.enable-buffer-copy' is true
+  /// and 'exchange.immediate-buffer-transfer' is false, are still processed
+  /// on the driver threads. The result requests of a task which has not
+  /// started, or is being updated, are still served on the CPU executor.
+  static constexpr std::string_view kExchangeIoThreadDataPath{
+      "exchange.io-thread-data-path"};
+
   /// Specifies the timeout duration from exchange client's http connect
   /// success to response reception.
   static constexpr std::string_view kExchangeRequestTimeout{
@@ -513,6 +660,40 @@ class SystemConfig : public ConfigBase {
   static constexpr std::string_view kExchangeEnableConnectionPool{
       "exchange.http-client.enable-connection-pool"};
 
+  /// Max number of idle connections the exchange HTTP client connection pool
+  /// keeps per server.
+  static constexpr std::string_view kExchangeHttpClientMaxConnectionsPerServer{
+      "exchange.http-client.max-connections-per-server"};
+
+  /// Time after which the idle connections of the exchange HTTP client
+  /// connection pool are closed.
+  static constexpr std::string_view kExchangeHttpClientIdleSessionTimeout{
+      "exchange.http-client.idle-session-timeout"};
+
+  /// HTTP/2 receive windows of the exchange HTTP client connections. A
+  /// single exchange stream can not go faster than window / round trip time.
+  static constexpr std::string_view kExchangeHttpClientHttp2StreamWindowSize{
+      "exchange.http-client.http2.stream-window-size"};
+  static constexpr std::string_view kExchangeHttpClientHttp2SessionWindowSize{
+      "exchange.http-client.http2.session-window-size"};
+
+  /// If true, the HTTP/2 stream window of each server grows up to
+  /// 'exchange.http-client.http2.max-stream-window-size' to twice the
+  /// bandwidth-delay product observed on the exchange responses from it.
+  static constexpr std::string_view
+      kExchangeHttpClientHttp2AdaptiveStreamWindow{
+          "exchange.http-client.http2.adaptive-stream-window"};
+  static constexpr std::string_view
+      kExchangeHttpClientHttp2MaxStreamWindowSize{
+          "exchange.http-client.http2.max-stream-window-size"};
+
+  /// Number of connections to open to a worker in parallel as soon as a task
+  /// update names it as a remote split location, before the exchange sends
+  /// the first request. 0 disables the warm-up.
+  static constexpr std::string_view
+      kExchangeHttpClientWarmUpConnectionsPerServer{
+          "exchange.http-client.warm-up-connections-per-server"};
+
   /// Floating point number used in calculating how many threads we would use
   /// for Exchange HTTP client IO executor: hw_concurrency x multiplier.
   /// 1.0 is default.
@@ -676,6 +857,14 @@ class SystemConfig : public ConfigBase {
 
   bool systemMemPushBackAbortEnabled() const;
 
+  bool systemMemPredictivePushbackEnabled() const;
+
+  std::chrono::duration<double> systemMemPushbackPredictionWindow() const;
+
+  double systemMemPressureStallPctThreshold() const;
+
+  uint32_t systemMemPushbackMinConsecutivePredictions() const;
+
   bool mallocMemHeapDumpEnabled() const;
 
   uint32_t mallocHeapDumpThresholdGb() const;
@@ -684,6 +873,12 @@ class SystemConfig : public ConfigBase {
 
   uint32_t mallocMemMaxHeapDumpFiles() const;
 
+  int32_t cpuProfilerBackgroundFrequencyHz() const;
+
+  bool cpuProfilerOnDemandEnabled() const;
+
+  uint32_t executorTaskStatsSampleRate() const;
+
   bool asyncDataCacheEnabled() const;
 
   uint64_t asyncCacheSsdGb() const;
@@ -710,6 +905,8 @@ class SystemConfig : public ConfigBase {
 
   std::string shuffleName() const;
 
+  std::string broadcastServeDirectory() const;
+
   bool enableSerializedPageChecksum() const;
 
   bool enableVeloxTaskLogging() const;
@@ -738,6 +935,36 @@ class SystemConfig : public ConfigBase {
 
   bool enableHttpAccessLog() const;
 
+  std::string httpAccessLogFile() const;
+
+  uint64_t httpAccessLogMaxFileSize() const;
+
+  uint32_t httpAccessLogMaxFiles() const;
+
+  uint32_t httpAccessLogQueueSize() const;
+
+  std::chrono::duration<double> httpServerIdleTimeout() const;
+
+  uint64_t httpServerHttp2InitialReceiveWindow() const;
+
+  uint64_t httpServerHttp2ReceiveStreamWindowSize() const;
+
+  uint64_t httpServerHttp2ReceiveSessionWindowSize() const;
+
+  uint32_t httpServerMaxQueuedHighPriorityRequests() const;
+
+  uint32_t httpServerMaxQueuedMediumPriorityRequests() const;
+
+  uint32_t httpServerMaxQueuedLowPriorityRequests() const;
+
+  bool enableHttpResponseCompression() const;
+
+  uint64_t httpResponseCompressionMinSize() const;
+
+  std::vector<std::string> httpResponseCompressionContentTypes() const;
+
+  std::string httpResponseCompressionCodecs() const;
+
   bool enableHttpStatsFilter() const;
 
   bool enableHttpEndpointLatencyFilter() const;
@@ -754,6 +981,8 @@ class SystemConfig : public ConfigBase {
 
   bool skipRuntimeStatsInRunningTaskInfo() const;
 
+  uint32_t taskInfoMaxRuntimeStats() const;
+
   bool logZombieTaskInfo() const;
 
   uint32_t logNumZombieTasks() const;
@@ -770,10 +999,26 @@ class SystemConfig : public ConfigBase {
 
   bool exchangeEnableConnectionPool() const;
 
+  uint32_t exchangeHttpClientMaxConnectionsPerServer() const;
+
+  std::chrono::duration<double> exchangeHttpClientIdleSessionTimeout() const;
+
+  uint64_t exchangeHttpClientHttp2StreamWindowSize() const;
+
+  uint64_t exchangeHttpClientHttp2SessionWindowSize() const;
+
+  bool exchangeHttpClientHttp2AdaptiveStreamWindow() const;
+
+  uint64_t exchangeHttpClientHttp2MaxStreamWindowSize() const;
+
+  uint32_t exchangeHttpClientWarmUpConnectionsPerServer() const;
+
   bool exchangeEnableBufferCopy() const;
 
   bool exchangeImmediateBufferTransfer() const;
 
+  bool exchangeIoThreadDataPath() const;
+
   int32_t taskRunTimeSliceMicros() const;
 
   bool includeNodeInSpillPath() const;
@@ -800,6 +1045,12 @@ class SystemConfig : public ConfigBase {
 
   bool enableRuntimeMetricsCollection() const;
 
+  bool runtimeMetricsShardedCollection() const;
+
+  std::chrono::duration<double> runtimeMetricsScrapeCacheTtl() const;
+
+  uint32_t runtimeMetricsMaxLabeledQueries() const;
+
   bool prestoNativeSidecar() const;
 };
 
@@ -45,6 +45,106 @@ void registerPrestoMetrics() {
       100);
   DEFINE_METRIC(
       kCounterHttpClientNumConnectionsCreated, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpClientNumActiveSessions, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterHttpClientNumIdleSessions, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterHttpClientNumSessionsReused, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpClientNumSessionsWarmedUp, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpClientSessionPoolHitPct, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterHttpClientAvgSessionsPerEventBase,
+      facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterHttpClientMaxSessionsPerEventBase,
+      facebook::velox::StatType::AVG);
+  DEFINE_HISTOGRAM_METRIC(
+      kCounterHttpClientConnectLatencyMs,
+      10,
+      0,
+      10'000, // max bucket value: 10s
+      50,
+      90,
+      99,
+      100);
+  DEFINE_HISTOGRAM_METRIC(
+      kCounterHttpClientTlsHandshakeLatencyMs,
+      10,
+      0,
+      10'000, // max bucket value: 10s
+      50,
+      90,
+      99,
+      100);
+  DEFINE_METRIC(
+      kCounterHttpAccessLogNumDroppedRecords, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpResponseNumCompressed, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpResponseCompressionInputBytes,
+      facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpResponseCompressionOutputBytes,
+      facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpResponseCompressionCpuTimeUs,
+      facebook::velox::StatType::SUM);
+  DEFINE_METRIC(kCounterHttpFileResponseBytes, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpServerNumQueuedHighPriorityRequests,
+      facebook::velox::StatType::AVG);
+  DEFINE_HISTOGRAM_METRIC(
+      kCounterHttpServerHighPriorityQueueWaitMs,
+      10,
+      0,
+      10'000, // max bucket value: 10s
+      50,
+      90,
+      99,
+      100);
+  DEFINE_METRIC(
+      kCounterHttpServerNumRejectedHighPriorityRequests,
+      facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpServerNumQueuedMediumPriorityRequests,
+      facebook::velox::StatType::AVG);
+  DEFINE_HISTOGRAM_METRIC(
+      kCounterHttpServerMediumPriorityQueueWaitMs,
+      10,
+      0,
+      10'000, // max bucket value: 10s
+      50,
+      90,
+      99,
+      100);
+  DEFINE_METRIC(
+      kCounterHttpServerNumRejectedMediumPriorityRequests,
+      facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpServerNumQueuedLowPriorityRequests,
+      facebook::velox::StatType::AVG);
+  DEFINE_HISTOGRAM_METRIC(
+      kCounterHttpServerLowPriorityQueueWaitMs,
+      10,
+      0,
+      10'000, // max bucket value: 10s
+      50,
+      90,
+      99,
+      100);
+  DEFINE_METRIC(
+      kCounterHttpServerNumRejectedLowPriorityRequests,
+      facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterHttpServerNumInFlightRequests, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterHttpServerInFlightResponseBytes, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterHttpServerMaxThreadInFlightResponseBytes,
+      facebook::velox::StatType::AVG);
   DEFINE_METRIC(kCounterNumQueryContexts, facebook::velox::StatType::AVG);
   DEFINE_METRIC(kCounterNumTasks, facebook::velox::StatType::AVG);
   DEFINE_METRIC(kCounterNumTasksRunning, facebook::velox::StatType::AVG);
@@ -54,6 +154,24 @@ void registerPrestoMetrics() {
   DEFINE_METRIC(kCounterNumTasksFailed, facebook::velox::StatType::AVG);
   DEFINE_METRIC(kCounterNumZombieVeloxTasks, facebook::velox::StatType::AVG);
   DEFINE_METRIC(kCounterNumZombiePrestoTasks, facebook::velox::StatType::AVG);
+  DEFINE_HISTOGRAM_METRIC(
+      kCounterTaskInfoResponseBytes,
+      16l * 1024,
+      0,
+      1l * 1024 * 1024, // max bucket value: 1MB
+      50,
+      90,
+      99,
+      100);
+  DEFINE_HISTOGRAM_METRIC(
+      kCounterSummarizedTaskInfoResponseBytes,
+      16l * 1024,
+      0,
+      1l * 1024 * 1024, // max bucket value: 1MB
+      50,
+      90,
+      99,
+      100);
   DEFINE_METRIC(
       kCounterNumTasksWithStuckOperator, facebook::velox::StatType::AVG);
   DEFINE_METRIC(kCounterNumTasksDeadlock, facebook::velox::StatType::AVG);
@@ -91,6 +209,38 @@ void registerPrestoMetrics() {
   DEFINE_METRIC(
       kCounterPartitionedOutputBufferGetDataLatencyMs,
       facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterMemoryPushbackNumCacheShrinks, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterMemoryPushbackCacheShrinkBytes, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterMemoryPushbackNumSpills, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterMemoryPushbackSpillBytes, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterMemoryPushbackNumTaskAdmissionPauses,
+      facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterMemoryPushbackNumHardLimits, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterMemoryPushbackHardLimitBytes, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(
+      kCounterMemoryPushbackPredictedBytes, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterMemoryPushbackGrowthBytesPerSec, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterMemoryPushbackStallPct, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterMemoryPushbackTaskAdmissionPaused,
+      facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterCpuLoadPct, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterCpuMinCoreLoadPct, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterCpuMaxCoreLoadPct, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterCgroupCpuLoadPct, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterCgroupCpuNumThrottledPeriods, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(kCounterCgroupCpuThrottledUs, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(kCounterCgroupCpuSomeStalledUs, facebook::velox::StatType::SUM);
+  DEFINE_METRIC(kCounterCgroupCpuFullStalledUs, facebook::velox::StatType::SUM);
   DEFINE_METRIC(kCounterOsUserCpuTimeMicros, facebook::velox::StatType::AVG);
   DEFINE_METRIC(kCounterOsSystemCpuTimeMicros, facebook::velox::StatType::AVG);
   DEFINE_METRIC(kCounterOsNumSoftPageFaults, facebook::velox::StatType::AVG);
@@ -99,6 +249,35 @@ void registerPrestoMetrics() {
       kCounterOsNumVoluntaryContextSwitches, facebook::velox::StatType::AVG);
   DEFINE_METRIC(
       kCounterOsNumForcedContextSwitches, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterOsNumNumaPagesMigrated, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterOsNumNumaHintFaults, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterOsNumThpFaultAllocs, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterOsNumThpFaultFallbacks, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterOsNumThpCollapseAllocs, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterOsNumThpSplitPages, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(kCounterOsAnonHugePagesBytes, facebook::velox::StatType::AVG);
+  DEFINE_METRIC(
+      kCounterExchangeDataResponseNumHops, facebook::velox::StatType::AVG);
+  DEFINE_HISTOGRAM_METRIC(
+      kCounterExchangeDataResponseHandoffUs,
+      100,
+      0,
+      100'000, // max bucket value: 100ms
+      50,
+      90,
+      99,
+      100);
+  DEFINE_METRIC(
+      kCounterHttpServerResultsNumHops, facebook::velox::StatType::AVG);
+  DEFINE_HISTOGRAM_METRIC(
+      kCounterHttpServerResultsHandoffUs,
+      100,
+      0,
+      100'000, // max bucket value: 100ms
+      50,
+      90,
+      99,
+      100);
   DEFINE_HISTOGRAM_METRIC(
       kCounterExchangeSourcePeakQueuedBytes,
       1l * 1024 * 1024 * 1024,
@@ -48,6 +48,100 @@ constexpr folly::StringPiece kCounterHttpClientPrestoExchangeOnBodyBytes{
     "presto_cpp.http.client.presto_exchange_source.on_body_bytes"};
 constexpr folly::StringPiece kCounterHttpClientNumConnectionsCreated{
     "presto_cpp.http.client.num_connections_created"};
+/// Number of active and idle sessions in the exchange http client connection
+/// pool.
+constexpr folly::StringPiece kCounterHttpClientNumActiveSessions{
+    "presto_cpp.http.client.num_active_sessions"};
+constexpr folly::StringPiece kCounterHttpClientNumIdleSessions{
+    "presto_cpp.http.client.num_idle_sessions"};
+/// Number of exchange http requests sent on an already established session.
+constexpr folly::StringPiece kCounterHttpClientNumSessionsReused{
+    "presto_cpp.http.client.num_sessions_reused"};
+/// Number of exchange http client sessions connected ahead of the first
+/// request to a worker.
+constexpr folly::StringPiece kCounterHttpClientNumSessionsWarmedUp{
+    "presto_cpp.http.client.num_sessions_warmed_up"};
+/// Percentage of the exchange http requests sent on an already established
+/// session, including the warmed up ones, since the last update.
+constexpr folly::StringPiece kCounterHttpClientSessionPoolHitPct{
+    "presto_cpp.http.client.session_pool_hit_pct"};
+/// Average and max number of sessions per event base across the endpoints of
+/// the exchange http client connection pool.
+constexpr folly::StringPiece kCounterHttpClientAvgSessionsPerEventBase{
+    "presto_cpp.http.client.avg_sessions_per_event_base"};
+constexpr folly::StringPiece kCounterHttpClientMaxSessionsPerEventBase{
+    "presto_cpp.http.client.max_sessions_per_event_base"};
+/// Time to establish an http client connection, including the TLS handshake.
+constexpr folly::StringPiece kCounterHttpClientConnectLatencyMs{
+    "presto_cpp.http.client.connect_latency_ms"};
+/// Time of the TLS handshake of an https client connection.
+constexpr folly::StringPiece kCounterHttpClientTlsHandshakeLatencyMs{
+    "presto_cpp.http.client.tls_handshake_latency_ms"};
+/// Number of http access log records dropped because the writer queue was
+/// full.
+constexpr folly::StringPiece kCounterHttpAccessLogNumDroppedRecords{
+    "presto_cpp.http.access_log_num_dropped_records"};
+/// Number of http responses compressed by the server.
+constexpr folly::StringPiece kCounterHttpResponseNumCompressed{
+    "presto_cpp.http.response_compression.num_compressed"};
+/// Uncompressed and compressed bytes of the compressed http responses. Their
+/// ratio is the compression ratio.
+constexpr folly::StringPiece kCounterHttpResponseCompressionInputBytes{
+    "presto_cpp.http.response_compression.input_bytes"};
+constexpr folly::StringPiece kCounterHttpResponseCompressionOutputBytes{
+    "presto_cpp.http.response_compression.output_bytes"};
+/// CPU time spent compressing http responses in microseconds.
+constexpr folly::StringPiece kCounterHttpResponseCompressionCpuTimeUs{
+    "presto_cpp.http.response_compression.cpu_time_us"};
+/// Number of bytes of the local files sent by http::FileRequestHandler.
+constexpr folly::StringPiece kCounterHttpFileResponseBytes{
+    "presto_cpp.http.file_response_bytes"};
+/// Number of queued http server requests of each priority class as seen by the
+/// arriving requests, the time the requests wait for a thread and the number
+/// of requests rejected because too many were queued. See
+/// PriorityRequestExecutor.
+constexpr folly::StringPiece kCounterHttpServerNumQueuedHighPriorityRequests{
+    "presto_cpp.http.server.num_queued_high_priority_requests"};
+constexpr folly::StringPiece kCounterHttpServerHighPriorityQueueWaitMs{
+    "presto_cpp.http.server.high_priority_queue_wait_ms"};
+constexpr folly::StringPiece kCounterHttpServerNumRejectedHighPriorityRequests{
+    "presto_cpp.http.server.num_rejected_high_priority_requests"};
+constexpr folly::StringPiece kCounterHttpServerNumQueuedMediumPriorityRequests{
+    "presto_cpp.http.server.num_queued_medium_priority_requests"};
+constexpr folly::StringPiece kCounterHttpServerMediumPriorityQueueWaitMs{
+    "presto_cpp.http.server.medium_priority_queue_wait_ms"};
+constexpr folly::StringPiece
+    kCounterHttpServerNumRejectedMediumPriorityRequests{
+        "presto_cpp.http.server.num_rejected_medium_priority_requests"};
+constexpr folly::StringPiece kCounterHttpServerNumQueuedLowPriorityRequests{
+    "presto_cpp.http.server.num_queued_low_priority_requests"};
+constexpr folly::StringPiece kCounterHttpServerLowPriorityQueueWaitMs{
+    "presto_cpp.http.server.low_priority_queue_wait_ms"};
+constexpr folly::StringPiece kCounterHttpServerNumRejectedLowPriorityRequests{
+    "presto_cpp.http.server.num_rejected_low_priority_requests"};
+/// Number of http server requests in flight, the response bytes sent by them
+/// and the max of the in-flight response bytes of a thread. The per-endpoint
+/// values are exported by http::filters::StatsFilter::reportMetrics().
+constexpr folly::StringPiece kCounterHttpServerNumInFlightRequests{
+    "presto_cpp.http.server.num_in_flight_requests"};
+constexpr folly::StringPiece kCounterHttpServerInFlightResponseBytes{
+    "presto_cpp.http.server.in_flight_response_bytes"};
+constexpr folly::StringPiece kCounterHttpServerMaxThreadInFlightResponseBytes{
+    "presto_cpp.http.server.max_thread_in_flight_response_bytes"};
+/// Number of thread switches between receiving an exchange data response on
+/// the http IO thread and processing it, and the time in microseconds the
+/// response waits for processing. See 'exchange.io-thread-data-path'.
+constexpr folly::StringPiece kCounterExchangeDataResponseNumHops{
+    "presto_cpp.exchange.data_response_num_hops"};
+constexpr folly::StringPiece kCounterExchangeDataResponseHandoffUs{
+    "presto_cpp.exchange.data_response_handoff_us"};
+/// Number of thread switches of the http server threads serving a results
+/// request, and the time in microseconds from the results being ready to the
+/// start of sending them. See 'exchange.io-thread-data-path'.
+constexpr folly::StringPiece kCounterHttpServerResultsNumHops{
+    "presto_cpp.http.server.results_num_hops"};
+constexpr folly::StringPiece kCounterHttpServerResultsHandoffUs{
+    "presto_cpp.http.server.results_handoff_us"};
 /// Peak number of bytes queued in PrestoExchangeSource waiting for consume.
 constexpr folly::StringPiece kCounterExchangeSourcePeakQueuedBytes{
     "presto_cpp.exchange_source_peak_queued_bytes"};
@@ -70,6 +164,12 @@ constexpr folly::StringPiece kCounterNumZombieVeloxTasks{
     "presto_cpp.num_zombie_velox_tasks"};
 constexpr folly::StringPiece kCounterNumZombiePrestoTasks{
     "presto_cpp.num_zombie_presto_tasks"};
+/// Size in bytes of the full (non-summarized) TaskInfo responses.
+constexpr folly::StringPiece kCounterTaskInfoResponseBytes{
+    "presto_cpp.task_info_response_bytes"};
+/// Size in bytes of the summarized TaskInfo responses.
+constexpr folly::StringPiece kCounterSummarizedTaskInfoResponseBytes{
+    "presto_cpp.summarized_task_info_response_bytes"};
 constexpr folly::StringPiece kCounterNumTasksWithStuckOperator{
     "presto_cpp.num_tasks_with_stuck_operator"};
 constexpr folly::StringPiece kCounterNumTasksDeadlock{
@@ -115,8 +215,62 @@ constexpr folly::StringPiece kCounterTotalPartitionedOutputBuffer{
 constexpr folly::StringPiece kCounterPartitionedOutputBufferGetDataLatencyMs{
     "presto_cpp.partitioned_output_buffer_get_data_latency_ms"};
 
+/// ================== Memory Pushback Counters ==================
+
+/// Number of times each action of the memory pushback was taken and the bytes
+/// it freed. See PeriodicMemoryChecker.
+constexpr folly::StringPiece kCounterMemoryPushbackNumCacheShrinks{
+    "presto_cpp.memory_pushback_num_cache_shrinks"};
+constexpr folly::StringPiece kCounterMemoryPushbackCacheShrinkBytes{
+    "presto_cpp.memory_pushback_cache_shrink_bytes"};
+constexpr folly::StringPiece kCounterMemoryPushbackNumSpills{
+    "presto_cpp.memory_pushback_num_spills"};
+constexpr folly::StringPiece kCounterMemoryPushbackSpillBytes{
+    "presto_cpp.memory_pushback_spill_bytes"};
+constexpr folly::StringPiece kCounterMemoryPushbackNumTaskAdmissionPauses{
+    "presto_cpp.memory_pushback_num_task_admission_pauses"};
+constexpr folly::StringPiece kCounterMemoryPushbackNumHardLimits{
+    "presto_cpp.memory_pushback_num_hard_limits"};
+constexpr folly::StringPiece kCounterMemoryPushbackHardLimitBytes{
+    "presto_cpp.memory_pushback_hard_limit_bytes"};
+/// System memory usage predicted by the predictive memory pushback, the growth
+/// rate of the memory usage it is extrapolated with, the percentage of the
+/// time some tasks of the cgroup were stalled on memory and 1 if the task
+/// admission is paused, 0 otherwise.
+constexpr folly::StringPiece kCounterMemoryPushbackPredictedBytes{
+    "presto_cpp.memory_pushback_predicted_bytes"};
+constexpr folly::StringPiece kCounterMemoryPushbackGrowthBytesPerSec{
+    "presto_cpp.memory_pushback_growth_bytes_per_sec"};
+constexpr folly::StringPiece kCounterMemoryPushbackStallPct{
+    "presto_cpp.memory_pushback_stall_pct"};
+constexpr folly::StringPiece kCounterMemoryPushbackTaskAdmissionPaused{
+    "presto_cpp.memory_pushback_task_admission_paused"};
+
 /// ================== OS Counters =================
 
+/// CPU load of the host in percent and the min and max of the loads of its
+/// cores. See CPUMon.
+constexpr folly::StringPiece kCounterCpuLoadPct{"presto_cpp.cpu_load_pct"};
+constexpr folly::StringPiece kCounterCpuMinCoreLoadPct{
+    "presto_cpp.cpu_min_core_load_pct"};
+constexpr folly::StringPiece kCounterCpuMaxCoreLoadPct{
+    "presto_cpp.cpu_max_core_load_pct"};
+/// CPU load of the cgroup v2 of the process in percent of its CPU limit.
+constexpr folly::StringPiece kCounterCgroupCpuLoadPct{
+    "presto_cpp.cgroup_cpu_load_pct"};
+/// Number of CFS periods in which the cgroup was throttled and the throttled
+/// time in microseconds since the previous update.
+constexpr folly::StringPiece kCounterCgroupCpuNumThrottledPeriods{
+    "presto_cpp.cgroup_cpu_num_throttled_periods"};
+constexpr folly::StringPiece kCounterCgroupCpuThrottledUs{
+    "presto_cpp.cgroup_cpu_throttled_us"};
+/// Time in microseconds some, resp. all, of the runnable tasks of the cgroup
+/// were stalled waiting for a CPU since the previous update, from PSI.
+constexpr folly::StringPiece kCounterCgroupCpuSomeStalledUs{
+    "presto_cpp.cgroup_cpu_some_stalled_us"};
+constexpr folly::StringPiece kCounterCgroupCpuFullStalledUs{
+    "presto_cpp.cgroup_cpu_full_stalled_us"};
+
 /// User CPU time of the presto_server process in microsecond since the process
 /// start.
 constexpr folly::StringPiece kCounterOsUserCpuTimeMicros{
@@ -139,6 +293,44 @@ constexpr folly::StringPiece kCounterOsNumVoluntaryContextSwitches{
 /// Total number of involuntary context switches in the presto_server process.
 constexpr folly::StringPiece kCounterOsNumForcedContextSwitches{
     "presto_cpp.os_num_forced_context_switches"};
+/// Number of pages of the host migrated by the NUMA balancing and number of
+/// NUMA hinting faults since the previous update, from /proc/vmstat.
+constexpr folly::StringPiece kCounterOsNumNumaPagesMigrated{
+    "presto_cpp.os_num_numa_pages_migrated"};
+constexpr folly::StringPiece kCounterOsNumNumaHintFaults{
+    "presto_cpp.os_num_numa_hint_faults"};
+/// Number of transparent huge pages of the host allocated on page fault,
+/// which failed to be allocated on page fault, collapsed by khugepaged and
+/// split since the previous update, from /proc/vmstat.
+constexpr folly::StringPiece kCounterOsNumThpFaultAllocs{
+    "presto_cpp.os_num_thp_fault_allocs"};
+constexpr folly::StringPiece kCounterOsNumThpFaultFallbacks{
+    "presto_cpp.os_num_thp_fault_fallbacks"};
+constexpr folly::StringPiece kCounterOsNumThpCollapseAllocs{
+    "presto_cpp.os_num_thp_collapse_allocs"};
+constexpr folly::StringPiece kCounterOsNumThpSplitPages{
+    "presto_cpp.os_num_thp_split_pages"};
+/// Bytes of anonymous memory backed by transparent huge pages. From the
+/// memory.stat of the cgroup of the presto_server process, else from
+/// /proc/meminfo of the host.
+constexpr folly::StringPiece kCounterOsAnonHugePagesBytes{
+    "presto_cpp.os_anon_huge_pages_bytes"};
+
+/// ================== Query Resource Counters ==================
+/// The resource usage of the queries with tasks on this worker, labeled by
+/// query id. Only the queries using the most CPU get their own label, see
+/// QueryResourceMetrics. Exported by the stats reporters which implement
+/// LabeledStatsReporter.
+
+/// CPU time of the operators of the query in milliseconds.
+constexpr folly::StringPiece kCounterQueryCpuTimeMs{
+    "presto_cpp.query_cpu_time_ms"};
+/// Raw bytes received by the exchanges of the query.
+constexpr folly::StringPiece kCounterQueryExchangeInputBytes{
+    "presto_cpp.query_exchange_input_bytes"};
+/// Bytes spilled by the operators of the query.
+constexpr folly::StringPiece kCounterQuerySpilledBytes{
+    "presto_cpp.query_spilled_bytes"};
 
 /// ================== HiveConnector Counters ==================
 /// Format template strings use 'constexpr std::string_view' to be 'fmt::format'
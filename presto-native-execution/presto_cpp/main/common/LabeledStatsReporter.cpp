@@ -0,0 +1,26 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/common/LabeledStatsReporter.h"
+#include <folly/Singleton.h>
+#include "velox/common/base/StatsReporter.h"
+
+namespace facebook::presto {
+
+// static
+std::shared_ptr<LabeledStatsReporter> LabeledStatsReporter::instance() {
+  return std::dynamic_pointer_cast<LabeledStatsReporter>(
+      folly::Singleton<velox::BaseStatsReporter>::try_get());
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,51 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Range.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Exports gauges broken down by the values of a label, e.g. the resource
+/// usage per query. velox::BaseStatsReporter applies one fixed set of labels
+/// to all metrics, the stats reporters which support more implement this
+/// interface too.
+class LabeledStatsReporter {
+ public:
+  /// Max number of label values of a labeled gauge. The values beyond are
+  /// dropped, the callers are expected to bound the label values themselves,
+  /// e.g. by summing the smallest ones under one label value.
+  static constexpr size_t kMaxLabelValues = 1'000;
+
+  virtual ~LabeledStatsReporter() = default;
+
+  /// Replaces the values of the labeled gauge 'key' with 'values', which are
+  /// pairs of a value of the label 'labelName' and the gauge value. The label
+  /// values which are not in 'values' are no longer exported.
+  virtual void setLabeledGaugeValues(
+      folly::StringPiece key,
+      std::string_view labelName,
+      const std::vector<std::pair<std::string, int64_t>>& values) const = 0;
+
+  /// Returns the registered velox::BaseStatsReporter if it supports labels,
+  /// nullptr otherwise.
+  static std::shared_ptr<LabeledStatsReporter> instance();
+};
+
+} // namespace facebook::presto
@@ -14,7 +14,10 @@
 
 #include "presto_cpp/main/common/Utils.h"
 #include <fmt/format.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
 #include <sys/resource.h>
+#include <unistd.h>
 
 namespace facebook::presto::util {
 
@@ -55,4 +58,66 @@ long getProcessCpuTimeNs() {
   return tvNanos(rusageEnd.ru_utime) + tvNanos(rusageEnd.ru_stime);
 }
 
+std::optional<std::string> findProcessCgroupPath(
+    std::string_view file,
+    const std::string& procPath,
+    const std::string& cgroupPath) {
+  // The cgroup v2 entry of the process is '0::<path>'.
+  std::string contents;
+  if (!folly::readFile((procPath + "/self/cgroup").c_str(), contents)) {
+    return std::nullopt;
+  }
+  std::vector<folly::StringPiece> lines;
+  folly::split('\n', contents, lines, true);
+  for (auto line : lines) {
+    if (!line.removePrefix("0::")) {
+      continue;
+    }
+    // Inside a container with its own cgroup namespace the path is '/'.
+    for (const auto& path : {cgroupPath + line.str(), cgroupPath}) {
+      if (access(fmt::format("{}/{}", path, file).c_str(), R_OK) == 0) {
+        return path;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<uint64_t> keyValueStat(
+    std::string_view contents,
+    std::string_view name) {
+  std::vector<folly::StringPiece> lines;
+  folly::split('\n', contents, lines, true);
+  for (auto line : lines) {
+    if (line.removePrefix(name) && line.startsWith(' ')) {
+      line = folly::ltrimWhitespace(line);
+      return folly::tryTo<uint64_t>(line.subpiece(0, line.find(' ')))
+          .value_or(0);
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<uint64_t> pressureStallTotalUs(
+    std::string_view contents,
+    std::string_view kind) {
+  std::vector<folly::StringPiece> lines;
+  folly::split('\n', contents, lines, true);
+  for (auto line : lines) {
+    if (!line.removePrefix(kind) || !line.startsWith(' ')) {
+      continue;
+    }
+    const auto pos = line.find("total=");
+    if (pos == folly::StringPiece::npos) {
+      return std::nullopt;
+    }
+    const auto total = folly::tryTo<uint64_t>(line.subpiece(pos + 6));
+    if (total.hasError()) {
+      return std::nullopt;
+    }
+    return total.value();
+  }
+  return std::nullopt;
+}
+
 } // namespace facebook::presto::util
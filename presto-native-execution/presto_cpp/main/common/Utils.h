@@ -14,6 +14,9 @@
 #pragma once
 #include <folly/io/async/SSLContext.h>
 #include <glog/logging.h>
+#include <optional>
+#include <string>
+#include <string_view>
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 
 namespace facebook::presto::util {
@@ -34,4 +37,27 @@ std::shared_ptr<folly::SSLContext> createSSLContext(
 /// Returns current process-wide CPU time in nanoseconds.
 long getProcessCpuTimeNs();
 
+/// Returns the cgroup v2 directory of the process if it contains 'file', e.g.
+/// cpu.stat if the cpu controller is enabled. 'procPath' and 'cgroupPath' are
+/// the mount points of procfs and of the cgroup v2 hierarchy.
+std::optional<std::string> findProcessCgroupPath(
+    std::string_view file,
+    const std::string& procPath = "/proc",
+    const std::string& cgroupPath = "/sys/fs/cgroup");
+
+/// Returns the value of 'name' in 'contents' of a file of "<name> <value>"
+/// lines like the cgroup v2 cpu.stat and memory.stat or /proc/vmstat. The
+/// value may be padded and followed by a unit, e.g. 'name' "MemFree:" in
+/// "MemFree:   1024 kB" of /proc/meminfo is 1024.
+std::optional<uint64_t> keyValueStat(
+    std::string_view contents,
+    std::string_view name);
+
+/// Returns the total stall time in microseconds of the 'some' or 'full' line
+/// of 'contents' of a pressure stall information (PSI) file like
+/// "some avg10=0.00 avg60=0.00 avg300=0.00 total=1234".
+std::optional<uint64_t> pressureStallTotalUs(
+    std::string_view contents,
+    std::string_view kind);
+
 } // namespace facebook::presto::util
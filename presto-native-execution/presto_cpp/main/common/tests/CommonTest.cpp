@@ -133,3 +133,16 @@ TEST(UtilsTest, general) {
   EXPECT_EQ("2021-05-20T19:18:27.001Z", util::toISOTimestamp(1621538307001l));
   EXPECT_EQ("2021-05-20T19:18:27.000Z", util::toISOTimestamp(1621538307000l));
 }
+
+TEST(UtilsTest, keyValueStat) {
+  const std::string memoryStat = "anon 4096\nanon_thp 2097152\nfile 10\n";
+  EXPECT_EQ(util::keyValueStat(memoryStat, "anon").value(), 4096);
+  EXPECT_EQ(util::keyValueStat(memoryStat, "anon_thp").value(), 2097152);
+  EXPECT_EQ(util::keyValueStat(memoryStat, "file").value(), 10);
+  EXPECT_FALSE(util::keyValueStat(memoryStat, "shmem").has_value());
+
+  const std::string meminfo =
+      "MemTotal:       65536 kB\nAnonHugePages:    2048 kB\n";
+  EXPECT_EQ(util::keyValueStat(meminfo, "AnonHugePages:").value(), 2048);
+  EXPECT_FALSE(util::keyValueStat(meminfo, "AnonHugePages").has_value());
+}
@@ -19,7 +19,9 @@
 #include <folly/io/async/EventBaseManager.h>
 #include <folly/synchronization/Latch.h>
 #include <velox/common/base/Exceptions.h>
+#include <velox/common/base/StatsReporter.h>
 #include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/common/Counters.h"
 #include "presto_cpp/main/http/HttpClient.h"
 
 namespace facebook::presto::http {
@@ -214,6 +216,7 @@ class ResponseHandler : public proxygen::HTTPTransactionHandler {
 
   void onHeadersComplete(
       std::unique_ptr<proxygen::HTTPMessage> msg) noexcept override {
+    headersTime_ = std::chrono::steady_clock::now();
     response_ = std::make_unique<HttpResponse>(
         std::move(msg),
         client_->memoryPool(),
@@ -226,6 +229,7 @@ class ResponseHandler : public proxygen::HTTPTransactionHandler {
       if (reportOnBodyStatsFunc_ != nullptr) {
         reportOnBodyStatsFunc_(chain->length());
       }
+      bodyBytes_ += chain->computeChainDataLength();
       response_->append(std::move(chain));
     }
   }
@@ -235,6 +239,14 @@ class ResponseHandler : public proxygen::HTTPTransactionHandler {
   }
 
   void onEOM() noexcept override {
+    const auto now = std::chrono::steady_clock::now();
+    if (auto* stats = client_->endpointStats()) {
+      stats->recordTransfer(
+          bodyBytes_,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              now - headersTime_));
+    }
+    response_->setCompletionTime(now);
     promise_.setValue(std::move(response_));
   }
 
@@ -258,6 +270,13 @@ class ResponseHandler : public proxygen::HTTPTransactionHandler {
 
   void sendRequest(proxygen::HTTPTransaction* txn) {
     txn->sendHeaders(request_);
+    // The window can only be updated once the stream is open. This grows the
+    // window of the streams on the sessions created before the last increase.
+    if (auto* stats = client_->endpointStats()) {
+      if (const auto windowSize = stats->streamWindowSize(); windowSize > 0) {
+        txn->setReceiveWindow(windowSize);
+      }
+    }
     if (!body_.empty()) {
       txn->sendBody(folly::IOBuf::wrapBuffer(body_.c_str(), body_.size()));
     }
@@ -271,11 +290,53 @@ class ResponseHandler : public proxygen::HTTPTransactionHandler {
   const uint64_t minResponseAllocBytes_;
   const uint64_t maxResponseAllocBytes_;
   std::unique_ptr<HttpResponse> response_;
+  std::chrono::steady_clock::time_point headersTime_;
+  uint64_t bodyBytes_{0};
   folly::Promise<std::unique_ptr<HttpResponse>> promise_;
   std::shared_ptr<ResponseHandler> self_;
   std::shared_ptr<HttpClient> client_;
 };
 
+namespace {
+// Returns the receive session window of the new sessions of a pool with
+// 'options'.
+uint32_t sessionWindowSize(const HttpClientConnectionPool::Options& options) {
+  return options.adaptiveStreamWindow
+      ? std::max(options.sessionWindowSize, options.maxStreamWindowSize)
+      : options.sessionWindowSize;
+}
+
+// Records the connect metrics of the new 'session' and applies the flow control
+// settings of its endpoint. 'endpointStats' is null if the session is not
+// pooled.
+void initSession(
+    proxygen::HTTPUpstreamSession* session,
+    std::chrono::steady_clock::time_point connectStartTime,
+    bool useHttps,
+    HttpClientConnectionPool::EndpointStats* endpointStats,
+    uint32_t sessionWindowSize) {
+  const auto connectTime =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - connectStartTime);
+  RECORD_HISTOGRAM_METRIC_VALUE(
+      kCounterHttpClientConnectLatencyMs, connectTime.count() / 1'000);
+  if (useHttps) {
+    RECORD_HISTOGRAM_METRIC_VALUE(
+        kCounterHttpClientTlsHandshakeLatencyMs,
+        session->getSetupTransportInfo().sslSetupTime.count());
+  }
+  if (endpointStats == nullptr) {
+    return;
+  }
+  endpointStats->recordSessionCreated(connectTime);
+  if (const auto windowSize = endpointStats->streamWindowSize();
+      windowSize > 0) {
+    session->setFlowControl(
+        windowSize, windowSize, std::max(windowSize, sessionWindowSize));
+  }
+}
+} // namespace
+
 // Responsible for making an HTTP request. The request will be made in 2
 // phases:
 // 1. Connection establishment: An RTT(HTTP) or a series of RTTs(HTTPS) that
@@ -300,20 +361,25 @@ class ConnectionHandler : public proxygen::HTTPConnector::Callback {
       std::chrono::milliseconds connectTimeout,
       folly::EventBase* eventBase,
       const folly::SocketAddress& address,
-      folly::SSLContextPtr sslContext)
+      folly::SSLContextPtr sslContext,
+      HttpClientConnectionPool::EndpointStats* endpointStats,
+      uint32_t sessionWindowSize)
       : responseHandler_(responseHandler),
         sessionPool_(sessionPool),
         transactionTimer_(transactionTimeout),
         connectTimeout_(connectTimeout),
         eventBase_(eventBase),
         address_(address),
-        sslContext_(std::move(sslContext)) {}
+        sslContext_(std::move(sslContext)),
+        endpointStats_(endpointStats),
+        sessionWindowSize_(sessionWindowSize) {}
 
   bool useHttps() const {
     return sslContext_ != nullptr;
   }
 
   void connect() {
+    connectStartTime_ = std::chrono::steady_clock::now();
     connector_ =
         std::make_unique<proxygen::HTTPConnector>(this, transactionTimer_);
     if (useHttps()) {
@@ -325,6 +391,12 @@ class ConnectionHandler : public proxygen::HTTPConnector::Callback {
   }
 
   void connectSuccess(proxygen::HTTPUpstreamSession* session) override {
+    initSession(
+        session,
+        connectStartTime_,
+        useHttps(),
+        endpointStats_,
+        sessionWindowSize_);
     auto txn = session->newTransaction(responseHandler_.get());
     if (txn) {
       responseHandler_->sendRequest(txn);
@@ -350,15 +422,152 @@ class ConnectionHandler : public proxygen::HTTPConnector::Callback {
   folly::EventBase* const eventBase_;
   const folly::SocketAddress address_;
   const folly::SSLContextPtr sslContext_;
+  HttpClientConnectionPool::EndpointStats* const endpointStats_;
+  const uint32_t sessionWindowSize_;
+  std::chrono::steady_clock::time_point connectStartTime_;
+  std::unique_ptr<proxygen::HTTPConnector> connector_;
+};
+
+// Connects a session ahead of the first request and leaves it idle in the
+// session pool of its event base. Registered in 'connectors' until done, when
+// it removes and deletes itself. Runs on its event base thread, where
+// HttpClientConnectionPool::destroy() also deletes the connectors left.
+class WarmUpConnector : public proxygen::HTTPConnector::Callback {
+ public:
+  WarmUpConnector(
+      folly::Synchronized<folly::F14FastSet<WarmUpConnector*>>* connectors,
+      proxygen::WheelTimerInstance transactionTimeout,
+      std::chrono::milliseconds connectTimeout,
+      folly::EventBase* eventBase,
+      const folly::SocketAddress& address,
+      folly::SSLContextPtr sslContext,
+      HttpClientConnectionPool::EndpointStats* endpointStats,
+      uint32_t sessionWindowSize)
+      : connectors_(connectors),
+        transactionTimer_(transactionTimeout),
+        connectTimeout_(connectTimeout),
+        eventBase_(eventBase),
+        address_(address),
+        sslContext_(std::move(sslContext)),
+        endpointStats_(endpointStats),
+        sessionWindowSize_(sessionWindowSize) {}
+
+  folly::EventBase* eventBase() const {
+    return eventBase_;
+  }
+
+  // Connects a session to put into 'sessionPool'.
+  void connect(proxygen::SessionPool* sessionPool) {
+    sessionPool_ = sessionPool;
+    connectStartTime_ = std::chrono::steady_clock::now();
+    connector_ =
+        std::make_unique<proxygen::HTTPConnector>(this, transactionTimer_);
+    if (sslContext_ != nullptr) {
+      connector_->connectSSL(
+          eventBase_, address_, sslContext_, nullptr, connectTimeout_);
+    } else {
+      connector_->connect(eventBase_, address_, connectTimeout_);
+    }
+  }
+
+  void connectSuccess(proxygen::HTTPUpstreamSession* session) override {
+    initSession(
+        session,
+        connectStartTime_,
+        sslContext_ != nullptr,
+        endpointStats_,
+        sessionWindowSize_);
+    endpointStats_->recordSessionWarmedUp();
+    sessionPool_->putSession(session);
+    finish();
+  }
+
+  void connectError(const folly::AsyncSocketException& ex) override {
+    VLOG(1) << "Failed to warm up connection to " << address_.describe()
+            << ": " << ex.what();
+    finish();
+  }
+
+  // Unregisters and deletes the connector.
+  void finish() {
+    connectors_->wlock()->erase(this);
+    delete this;
+  }
+
+ private:
+  folly::Synchronized<folly::F14FastSet<WarmUpConnector*>>* const connectors_;
+  const proxygen::WheelTimerInstance transactionTimer_;
+  const std::chrono::milliseconds connectTimeout_;
+  folly::EventBase* const eventBase_;
+  const folly::SocketAddress address_;
+  const folly::SSLContextPtr sslContext_;
+  HttpClientConnectionPool::EndpointStats* const endpointStats_;
+  const uint32_t sessionWindowSize_;
+  proxygen::SessionPool* sessionPool_{nullptr};
+  std::chrono::steady_clock::time_point connectStartTime_;
   std::unique_ptr<proxygen::HTTPConnector> connector_;
 };
 
 namespace {
-// Same value as
-// https://github.com/prestodb/presto/blob/831d5947b909fee0d5c0091a3246ddc5b31b2731/presto-main/src/main/java/com/facebook/presto/server/ServerMainModule.java#L547
-constexpr int kMaxConnectionsPerServer = 250;
+// Responses smaller than this are dominated by latency rather than bandwidth
+// and are not used to estimate the bandwidth of an endpoint.
+constexpr uint64_t kMinBandwidthSampleBytes = 64 << 10;
 } // namespace
 
+void HttpClientConnectionPool::EndpointStats::recordSessionCreated(
+    std::chrono::microseconds connectTime) {
+  ++numSessionsCreated_;
+  const uint64_t connectTimeUs = std::max<int64_t>(connectTime.count(), 1);
+  auto rttUs = rttUs_.load();
+  while ((rttUs == 0 || connectTimeUs < rttUs) &&
+         !rttUs_.compare_exchange_weak(rttUs, connectTimeUs)) {
+  }
+}
+
+void HttpClientConnectionPool::EndpointStats::recordTransfer(
+    uint64_t bytes,
+    std::chrono::microseconds duration) {
+  if (bytes < kMinBandwidthSampleBytes || duration.count() <= 0) {
+    return;
+  }
+  const uint64_t sample = bytes * 1'000'000 / duration.count();
+  // Exponentially weighted moving average with a weight of 1/8 for the new
+  // sample. Concurrent updates may lose a sample, which is fine for an
+  // estimate.
+  const auto bandwidth = bandwidthBytesPerSec_.load();
+  const uint64_t newBandwidth =
+      bandwidth == 0 ? sample : bandwidth - bandwidth / 8 + sample / 8;
+  bandwidthBytesPerSec_ = newBandwidth;
+
+  const auto rttUs = rttUs_.load();
+  if (rttUs == 0 || maxStreamWindowSize_ <= streamWindowSize_) {
+    return;
+  }
+  // The bandwidth is capped by window / rtt while the stream is window
+  // limited, so this doubles the window until the bandwidth stops growing.
+  const uint32_t target = std::min<uint64_t>(
+      maxStreamWindowSize_, 2 * newBandwidth * rttUs / 1'000'000);
+  auto windowSize = streamWindowSize_.load();
+  while (windowSize < target &&
+         !streamWindowSize_.compare_exchange_weak(windowSize, target)) {
+  }
+}
+
+HttpClientConnectionPool::HttpClientConnectionPool(Options options)
+    : options_(std::move(options)) {
+  VELOX_CHECK_EQ(
+      options_.streamWindowSize == 0,
+      options_.sessionWindowSize == 0,
+      "The stream and session windows must be both set or both unset");
+  if (options_.adaptiveStreamWindow) {
+    VELOX_CHECK_GT(
+        options_.streamWindowSize,
+        0,
+        "Adaptive stream window requires an initial stream window");
+    VELOX_CHECK_GE(options_.maxStreamWindowSize, options_.streamWindowSize);
+  }
+}
+
 std::pair<proxygen::SessionPool*, proxygen::ServerIdleSessionController*>
 HttpClientConnectionPool::getSessionPoolImpl(SessionPools& endpointPools) {
   auto* evb = folly::EventBaseManager::get()->getExistingEventBase();
@@ -377,40 +586,192 @@ HttpClientConnectionPool::getSessionPoolImpl(SessionPools& endpointPools) {
   VELOX_CHECK_NULL(pool);
   pool = std::make_unique<proxygen::SessionPool>(
       nullptr,
-      kMaxConnectionsPerServer,
-      std::chrono::seconds(30),
+      options_.maxConnectionsPerServer,
+      options_.idleSessionTimeout,
       std::chrono::milliseconds(0),
       nullptr,
       &endpointPools.idleSessions);
   return {pool.get(), &endpointPools.idleSessions};
 }
 
-std::pair<proxygen::SessionPool*, proxygen::ServerIdleSessionController*>
-HttpClientConnectionPool::getSessionPool(const proxygen::Endpoint& endpoint) {
+HttpClientConnectionPool::SessionPools&
+HttpClientConnectionPool::getSessionPools(const proxygen::Endpoint& endpoint) {
+  // NOTE: the session pools of an endpoint are never removed before destroy(),
+  // so the reference stays valid after the lock is released.
   {
     auto rlock = pools_.rlock();
     auto it = rlock->find(endpoint);
     if (it != rlock->end()) {
-      return getSessionPoolImpl(*it->second);
+      return *it->second;
     }
   }
   auto wlock = pools_.wlock();
-  auto it = wlock->find(endpoint);
-  if (it != wlock->end()) {
-    auto rlock = wlock.moveFromWriteToRead();
-    return getSessionPoolImpl(*it->second);
-  }
   auto& endpointPools = (*wlock)[endpoint];
-  VELOX_CHECK_NULL(endpointPools);
-  endpointPools = std::make_unique<SessionPools>();
-  endpointPools->idleSessions.setMaxIdleCount(kMaxConnectionsPerServer);
-  auto rlock = wlock.moveFromWriteToRead();
-  return getSessionPoolImpl(*endpointPools);
+  if (endpointPools == nullptr) {
+    endpointPools = std::make_unique<SessionPools>(options_);
+    endpointPools->idleSessions.setMaxIdleCount(
+        options_.maxConnectionsPerServer);
+  }
+  return *endpointPools;
+}
+
+std::pair<proxygen::SessionPool*, proxygen::ServerIdleSessionController*>
+HttpClientConnectionPool::getSessionPool(const proxygen::Endpoint& endpoint) {
+  return getSessionPoolImpl(getSessionPools(endpoint));
+}
+
+HttpClientConnectionPool::EndpointStats*
+HttpClientConnectionPool::endpointStats(const proxygen::Endpoint& endpoint) {
+  return &getSessionPools(endpoint).stats;
+}
+
+void HttpClientConnectionPool::warmUp(
+    const proxygen::Endpoint& endpoint,
+    const std::function<folly::SocketAddress()>& resolveAddress,
+    folly::SSLContextPtr sslContext,
+    std::chrono::milliseconds connectTimeout,
+    std::chrono::milliseconds transactionTimeout,
+    folly::IOThreadPoolExecutor* ioExecutor) {
+  if (options_.warmUpConnectionsPerServer == 0) {
+    return;
+  }
+  auto& endpointPools = getSessionPools(endpoint);
+  const int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+  auto lastWarmUpMs = endpointPools.lastWarmUpMs.load();
+  if ((lastWarmUpMs != 0 &&
+       nowMs - lastWarmUpMs <
+           std::chrono::duration_cast<std::chrono::milliseconds>(
+               options_.idleSessionTimeout)
+               .count()) ||
+      !endpointPools.lastWarmUpMs.compare_exchange_strong(
+          lastWarmUpMs, nowMs)) {
+    return;
+  }
+  const auto address = resolveAddress();
+  const auto numConnects = std::min<size_t>(
+      options_.warmUpConnectionsPerServer, ioExecutor->numThreads());
+  const auto windowSize = sessionWindowSize(options_);
+  for (size_t i = 0; i < numConnects; ++i) {
+    auto* evb = ioExecutor->getEventBase();
+    // Registered before the event base runs it, so that destroy() finds it.
+    auto* connector = new WarmUpConnector(
+        &endpointPools.warmUpConnectors,
+        proxygen::WheelTimerInstance(transactionTimeout, evb),
+        connectTimeout,
+        evb,
+        address,
+        sslContext,
+        &endpointPools.stats,
+        windowSize);
+    endpointPools.warmUpConnectors.wlock()->insert(connector);
+    evb->runInEventBaseThread([this, &endpointPools, connector]() {
+      auto* sessionPool = getSessionPoolImpl(endpointPools).first;
+      if (sessionPool->getNumActiveSessions() +
+              sessionPool->getNumIdleSessions() >
+          0) {
+        connector->finish();
+        return;
+      }
+      connector->connect(sessionPool);
+    });
+  }
+}
+
+folly::SemiFuture<std::vector<HttpClientConnectionPool::PoolStats>>
+HttpClientConnectionPool::stats() {
+  // Collect the pools first and count the sessions without holding the locks,
+  // as the event base threads take the same locks to create new pools.
+  std::vector<std::pair<std::string, SessionPools*>> endpoints;
+  pools_.withRLock([&](const auto& pools) {
+    for (const auto& [endpoint, endpointPools] : pools) {
+      endpoints.emplace_back(
+          fmt::format("{}:{}", endpoint.getHostname(), endpoint.getPort()),
+          endpointPools.get());
+    }
+  });
+
+  struct SessionCount {
+    size_t endpointIndex;
+    uint32_t numActiveSessions;
+    uint32_t numIdleSessions;
+  };
+  std::vector<PoolStats> result;
+  result.reserve(endpoints.size());
+  std::vector<folly::Future<SessionCount>> sessionCounts;
+  for (auto& [endpoint, endpointPools] : endpoints) {
+    const auto endpointIndex = result.size();
+    auto& stats = result.emplace_back();
+    stats.endpoint = std::move(endpoint);
+    stats.numSessionsCreated = endpointPools->stats.numSessionsCreated();
+    stats.numSessionsReused = endpointPools->stats.numSessionsReused();
+    stats.numSessionsWarmedUp = endpointPools->stats.numSessionsWarmedUp();
+    stats.streamWindowSize = endpointPools->stats.streamWindowSize();
+    endpointPools->byEventBase.withRLock([&](const auto& byEventBase) {
+      stats.numEventBases = byEventBase.size();
+      for (const auto& [evb, sessionPool] : byEventBase) {
+        sessionCounts.push_back(folly::via(
+            evb, [endpointIndex, sessionPool = sessionPool.get()]() {
+              return SessionCount{
+                  endpointIndex,
+                  sessionPool->getNumActiveSessions(),
+                  sessionPool->getNumIdleSessions()};
+            }));
+      }
+    });
+  }
+  return folly::collectAll(std::move(sessionCounts))
+      .deferValue([result = std::move(result)](
+                      std::vector<folly::Try<SessionCount>> counts) mutable {
+        for (const auto& count : counts) {
+          // The event base stopped before counting.
+          if (!count.hasValue()) {
+            continue;
+          }
+          auto& stats = result[count->endpointIndex];
+          stats.numActiveSessions += count->numActiveSessions;
+          stats.numIdleSessions += count->numIdleSessions;
+          stats.maxSessionsPerEventBase = std::max<uint64_t>(
+              stats.maxSessionsPerEventBase,
+              count->numActiveSessions + count->numIdleSessions);
+        }
+        return std::move(result);
+      });
 }
 
 void HttpClientConnectionPool::destroy() {
   pools_.withWLock([](auto& pools) {
     for (auto& [_, endpointPools] : pools) {
+      // Cancel the warm up connects in progress on their event bases, before
+      // the session pools they connect for go away.
+      std::vector<folly::EventBase*> eventBases;
+      endpointPools->warmUpConnectors.withRLock([&](const auto& connectors) {
+        for (const auto* connector : connectors) {
+          eventBases.push_back(connector->eventBase());
+        }
+      });
+      std::sort(eventBases.begin(), eventBases.end());
+      eventBases.erase(
+          std::unique(eventBases.begin(), eventBases.end()), eventBases.end());
+      folly::Latch connectorsLatch(eventBases.size());
+      for (auto* evb : eventBases) {
+        evb->runInEventBaseThread([&, evb]() {
+          endpointPools->warmUpConnectors.withWLock([&](auto& connectors) {
+            for (auto it = connectors.begin(); it != connectors.end();) {
+              if ((*it)->eventBase() == evb) {
+                delete *it;
+                it = connectors.erase(it);
+              } else {
+                ++it;
+              }
+            }
+          });
+          connectorsLatch.count_down();
+        });
+      }
+      connectorsLatch.wait();
+
       endpointPools->idleSessions.markForDeath();
       endpointPools->byEventBase.withWLock([](auto& byEventBase) {
         folly::Latch latch(byEventBase.size());
@@ -436,6 +797,7 @@ void HttpClient::initSessionPool() {
   if (connPool_) {
     std::tie(sessionPool_, idleSessions_) =
         connPool_->getSessionPool(endpoint_);
+    endpointStats_ = connPool_->endpointStats(endpoint_);
     return;
   }
   sessionPoolHolder_ = std::make_unique<proxygen::SessionPool>();
@@ -448,6 +810,9 @@ folly::SemiFuture<proxygen::HTTPTransaction*> HttpClient::createTransaction(
   eventBase_->dcheckIsInEventBaseThread();
   if (auto* txn = sessionPool_->getTransaction(handler)) {
     VLOG(3) << "Reuse same thread connection to " << address_.describe();
+    if (endpointStats_ != nullptr) {
+      endpointStats_->recordSessionReused();
+    }
     return folly::makeSemiFuture(txn);
   }
   if (!idleSessions_) {
@@ -475,7 +840,11 @@ folly::SemiFuture<proxygen::HTTPTransaction*> HttpClient::createTransaction(
         nullptr,
         nullptr);
     sessionPool_->putSession(session);
-    return sessionPool_->getTransaction(handler);
+    auto* txn = sessionPool_->getTransaction(handler);
+    if (txn != nullptr && endpointStats_ != nullptr) {
+      endpointStats_->recordSessionReused();
+    }
+    return txn;
   };
   if (idleSessionFuture.isReady()) {
     return getFromIdleSession(idleSessionFuture.value());
@@ -505,7 +874,9 @@ void HttpClient::sendRequest(std::shared_ptr<ResponseHandler> responseHandler) {
         connectTimeout_,
         eventBase_,
         address_,
-        sslContext_);
+        sslContext_,
+        endpointStats_,
+        connPool_ == nullptr ? 0 : sessionWindowSize(connPool_->options()));
     connectionHandler->connect();
   };
   if (txnFuture.isReady()) {
@@ -12,6 +12,8 @@
  * limitations under the License.
  */
 #pragma once
+#include <folly/container/F14Set.h>
+#include <folly/executors/IOThreadPoolExecutor.h>
 #include <folly/futures/Future.h>
 #include <proxygen/lib/http/HTTPConnector.h>
 #include <proxygen/lib/http/connpool/ServerIdleSessionController.h>
@@ -79,6 +81,15 @@ class HttpResponse {
 
   std::string dumpBodyChain() const;
 
+  /// Time at which the IO thread received the end of this response.
+  std::chrono::steady_clock::time_point completionTime() const {
+    return completionTime_;
+  }
+
+  void setCompletionTime(std::chrono::steady_clock::time_point time) {
+    completionTime_ = time;
+  }
+
  private:
   // The append operation that copies the 'iobuf' to velox memory 'pool_' and
   // free 'iobuf' immediately.
@@ -106,23 +117,159 @@ class HttpResponse {
   std::string error_{};
   std::vector<std::unique_ptr<folly::IOBuf>> bodyChain_;
   size_t bodyChainBytes_{0};
+  std::chrono::steady_clock::time_point completionTime_;
 };
 
 /// Connection pool shared by all the http clients.  It is held by presto server
 /// and should outlive all the http clients, and destroyed before we join the
 /// threads backing the event bases.
+class WarmUpConnector;
+
 class HttpClientConnectionPool {
  public:
+  struct Options {
+    /// Max number of idle sessions kept per endpoint.
+    uint32_t maxConnectionsPerServer{250};
+
+    /// Idle sessions are closed after this time.
+    std::chrono::seconds idleSessionTimeout{30};
+
+    /// HTTP/2 receive stream and session windows of the new sessions. 0 keeps
+    /// the proxygen defaults. Has no effect on HTTP/1.1 sessions.
+    uint32_t streamWindowSize{0};
+    uint32_t sessionWindowSize{0};
+
+    /// If true, the receive stream window of an endpoint grows from
+    /// 'streamWindowSize' up to 'maxStreamWindowSize' to twice the observed
+    /// bandwidth-delay product of the endpoint. The session windows of the new
+    /// sessions are then at least 'maxStreamWindowSize'.
+    bool adaptiveStreamWindow{false};
+    uint32_t maxStreamWindowSize{64 << 20};
+
+    /// Max number of sessions warmUp() connects in parallel to one endpoint.
+    /// 0 disables the warm up.
+    uint32_t warmUpConnectionsPerServer{0};
+  };
+
+  /// Session counters and flow control state of one endpoint. Thread safe.
+  class EndpointStats {
+   public:
+    EndpointStats(uint32_t streamWindowSize, uint32_t maxStreamWindowSize)
+        : streamWindowSize_(streamWindowSize),
+          maxStreamWindowSize_(maxStreamWindowSize) {}
+
+    /// Records a new session which took 'connectTime' to establish. The
+    /// shortest connect time is used as the round trip time of the endpoint.
+    void recordSessionCreated(std::chrono::microseconds connectTime);
+
+    /// Records a request sent on an already established session.
+    void recordSessionReused() {
+      ++numSessionsReused_;
+    }
+
+    /// Records a session connected by warmUp().
+    void recordSessionWarmedUp() {
+      ++numSessionsWarmedUp_;
+    }
+
+    /// Records a response body of 'bytes' received in 'duration'. Grows the
+    /// stream window to twice the bandwidth-delay product.
+    void recordTransfer(uint64_t bytes, std::chrono::microseconds duration);
+
+    /// The receive window to use for the streams to this endpoint. 0 if the
+    /// proxygen default is used.
+    uint32_t streamWindowSize() const {
+      return streamWindowSize_;
+    }
+
+    uint64_t numSessionsCreated() const {
+      return numSessionsCreated_;
+    }
+
+    uint64_t numSessionsReused() const {
+      return numSessionsReused_;
+    }
+
+    uint64_t numSessionsWarmedUp() const {
+      return numSessionsWarmedUp_;
+    }
+
+    uint64_t bandwidthBytesPerSec() const {
+      return bandwidthBytesPerSec_;
+    }
+
+    std::chrono::microseconds rtt() const {
+      return std::chrono::microseconds(rttUs_);
+    }
+
+   private:
+    std::atomic<uint32_t> streamWindowSize_;
+    const uint32_t maxStreamWindowSize_;
+    std::atomic<uint64_t> numSessionsCreated_{0};
+    std::atomic<uint64_t> numSessionsReused_{0};
+    std::atomic<uint64_t> numSessionsWarmedUp_{0};
+    std::atomic<uint64_t> rttUs_{0};
+    std::atomic<uint64_t> bandwidthBytesPerSec_{0};
+  };
+
+  /// Point in time stats of the sessions to one endpoint.
+  struct PoolStats {
+    std::string endpoint;
+    uint32_t numActiveSessions{0};
+    uint32_t numIdleSessions{0};
+    uint64_t numSessionsCreated{0};
+    uint64_t numSessionsReused{0};
+    uint64_t numSessionsWarmedUp{0};
+    uint32_t streamWindowSize{0};
+    /// Number of event bases with a session pool for the endpoint and the max
+    /// number of sessions on one of them.
+    uint64_t numEventBases{0};
+    uint64_t maxSessionsPerEventBase{0};
+  };
+
+  HttpClientConnectionPool() : HttpClientConnectionPool(Options{}) {}
+
+  explicit HttpClientConnectionPool(Options options);
+
   ~HttpClientConnectionPool() {
     destroy();
   }
 
+  const Options& options() const {
+    return options_;
+  }
+
   /// Returns the session pool for a given endpoint and local event base.
   ///
   /// NOTE: this must be called from a thread context with local event base set.
   std::pair<proxygen::SessionPool*, proxygen::ServerIdleSessionController*>
   getSessionPool(const proxygen::Endpoint& endpoint);
 
+  /// Returns the stats of 'endpoint'. The stats live as long as the pool.
+  EndpointStats* endpointStats(const proxygen::Endpoint& endpoint);
+
+  /// Connects sessions to 'endpoint' ahead of the first request, so that the
+  /// requests do not all pay the TCP and TLS setup at once. Connects at most
+  /// Options::warmUpConnectionsPerServer sessions in parallel, one on each of
+  /// the next event bases of 'ioExecutor', skipping the event bases which
+  /// already have a session to the endpoint. Does nothing if the endpoint was
+  /// warmed up within the idle session timeout. 'resolveAddress' returns the
+  /// address to connect to. It is invoked on the calling thread only if the
+  /// warm up goes ahead, so that throttled warm ups do not resolve DNS. Does
+  /// not block otherwise. The connects in progress are cancelled by destroy().
+  void warmUp(
+      const proxygen::Endpoint& endpoint,
+      const std::function<folly::SocketAddress()>& resolveAddress,
+      folly::SSLContextPtr sslContext,
+      std::chrono::milliseconds connectTimeout,
+      std::chrono::milliseconds transactionTimeout,
+      folly::IOThreadPoolExecutor* ioExecutor);
+
+  /// Returns the stats of all the endpoints. The sessions are counted on their
+  /// event bases, the future completes once all of them have. Must not be
+  /// called concurrently with destroy().
+  folly::SemiFuture<std::vector<PoolStats>> stats();
+
   void destroy();
 
  private:
@@ -130,16 +277,31 @@ class HttpClientConnectionPool {
   // bases.  All the operations on the SessionPool must be performed on the
   // corresponding EventBase.
   struct SessionPools {
+    explicit SessionPools(const Options& options)
+        : stats(options.streamWindowSize,
+                options.adaptiveStreamWindow ? options.maxStreamWindowSize
+                                             : options.streamWindowSize) {}
+
     proxygen::ServerIdleSessionController idleSessions;
     folly::Synchronized<folly::F14FastMap<
         folly::EventBase*,
         std::unique_ptr<proxygen::SessionPool>>>
         byEventBase;
+    EndpointStats stats;
+    // Time in ms since epoch of the last warm up.
+    std::atomic<int64_t> lastWarmUpMs{0};
+    // The warm up connects in progress. A connector is removed and deleted on
+    // its event base thread.
+    folly::Synchronized<folly::F14FastSet<WarmUpConnector*>> warmUpConnectors;
   };
 
+  SessionPools& getSessionPools(const proxygen::Endpoint& endpoint);
+
   std::pair<proxygen::SessionPool*, proxygen::ServerIdleSessionController*>
   getSessionPoolImpl(SessionPools& endpointPools);
 
+  const Options options_;
+
   // The map from http end point to the corresponding session pools.
   folly::Synchronized<folly::F14FastMap<
       proxygen::Endpoint,
@@ -184,6 +346,13 @@ class HttpClient : public std::enable_shared_from_this<HttpClient> {
     return numConnectionsCreated_;
   }
 
+  /// Returns the stats of the endpoint in the connection pool or nullptr if
+  /// the connection pool is not used. Must be called on the event base after
+  /// the first request is sent.
+  HttpClientConnectionPool::EndpointStats* endpointStats() const {
+    return endpointStats_;
+  }
+
  private:
   void initSessionPool();
 
@@ -207,6 +376,7 @@ class HttpClient : public std::enable_shared_from_this<HttpClient> {
 
   proxygen::SessionPool* sessionPool_ = nullptr;
   proxygen::ServerIdleSessionController* idleSessions_ = nullptr;
+  HttpClientConnectionPool::EndpointStats* endpointStats_ = nullptr;
 
   // Create only if connPool_ is null (disabled).
   std::unique_ptr<proxygen::SessionPool> sessionPoolHolder_;
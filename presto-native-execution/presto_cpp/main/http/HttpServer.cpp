@@ -12,11 +12,19 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <sys/stat.h>
 #include <algorithm>
+#include <cctype>
 
 #include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/common/Counters.h"
 #include "presto_cpp/main/common/Utils.h"
 #include "presto_cpp/main/http/HttpServer.h"
+#include "velox/common/base/StatsReporter.h"
 
 namespace facebook::presto::http {
 
@@ -27,6 +35,10 @@ void sendOkResponse(proxygen::ResponseHandler* downstream) {
 }
 
 void sendOkResponse(proxygen::ResponseHandler* downstream, const json& body) {
+  sendOkResponse(downstream, toJsonString(body));
+}
+
+std::string toJsonString(const json& body) {
   // nlohmann::json throws when it finds invalid UTF-8 characters. In that case
   // the server will crash. We handle such situation here and generate body
   // replacing the faulty UTF-8 sequences.
@@ -41,8 +53,7 @@ void sendOkResponse(proxygen::ResponseHandler* downstream, const json& body) {
                     "Json Dump:\n"
                  << messageBody;
   }
-
-  sendOkResponse(downstream, messageBody);
+  return messageBody;
 }
 
 void sendOkResponse(
@@ -56,6 +67,17 @@ void sendOkResponse(
       .sendWithEOM();
 }
 
+void sendOkResponse(
+    proxygen::ResponseHandler* downstream,
+    std::unique_ptr<folly::IOBuf> body) {
+  proxygen::ResponseBuilder(downstream)
+      .status(http::kHttpOk, "OK")
+      .header(
+          proxygen::HTTP_HEADER_CONTENT_TYPE, http::kMimeTypeApplicationJson)
+      .body(std::move(body))
+      .sendWithEOM();
+}
+
 void sendOkThriftResponse(
     proxygen::ResponseHandler* downstream,
     const std::string& body) {
@@ -88,6 +110,159 @@ void sendErrorResponse(
       .sendWithEOM();
 }
 
+void sendRetryLaterResponse(
+    proxygen::ResponseHandler* downstream,
+    const std::string& error,
+    std::chrono::seconds retryAfter) {
+  proxygen::ResponseBuilder(downstream)
+      .status(kHttpServiceUnavailable, "Service Unavailable")
+      .header(
+          proxygen::HTTP_HEADER_RETRY_AFTER, std::to_string(retryAfter.count()))
+      .body(error)
+      .sendWithEOM();
+}
+
+FileRequestHandler::File::~File() {
+  if (fd >= 0) {
+    folly::closeNoInt(fd);
+  }
+}
+
+FileRequestHandler::FileRequestHandler(
+    std::string path,
+    std::string contentType,
+    folly::Executor* executor,
+    size_t chunkSize)
+    : path_(std::move(path)),
+      contentType_(std::move(contentType)),
+      executor_(executor),
+      chunkSize_(chunkSize) {
+  VELOX_CHECK_NOT_NULL(executor_);
+}
+
+void FileRequestHandler::onEOM() noexcept {
+  eventBase_ = folly::EventBaseManager::get()->getEventBase();
+  file_ = std::make_shared<File>();
+  executor_->add([this, evb = eventBase_, file = file_, path = path_]() {
+    uint16_t errorCode{kHttpOk};
+    std::string error;
+    const int fd = folly::openNoInt(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      if (errno == ENOENT) {
+        errorCode = kHttpNotFound;
+        error = fmt::format("File not found: {}", path);
+      } else {
+        errorCode = kHttpInternalServerError;
+        error =
+            fmt::format("Failed to open {}: {}", path, folly::errnoStr(errno));
+      }
+    } else {
+      file->fd = fd;
+      struct stat fileStat;
+      if (fstat(fd, &fileStat) != 0) {
+        errorCode = kHttpInternalServerError;
+        error =
+            fmt::format("Failed to stat {}: {}", path, folly::errnoStr(errno));
+      } else {
+        file->size = fileStat.st_size;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      }
+    }
+    evb->runInEventBaseThread(
+        [this, file, errorCode, error = std::move(error)]() {
+          if (file->expired) {
+            return;
+          }
+          if (!error.empty()) {
+            sendErrorResponse(downstream_, error, errorCode);
+            return;
+          }
+          proxygen::ResponseBuilder(downstream_)
+              .status(kHttpOk, "OK")
+              .header(proxygen::HTTP_HEADER_CONTENT_TYPE, contentType_)
+              .header(
+                  proxygen::HTTP_HEADER_CONTENT_LENGTH,
+                  std::to_string(file->size))
+              .send();
+          started_ = true;
+          readNextChunk();
+        });
+  });
+}
+
+void FileRequestHandler::onEgressResumed() noexcept {
+  paused_ = false;
+  if (started_) {
+    readNextChunk();
+  }
+}
+
+void FileRequestHandler::requestComplete() noexcept {
+  if (file_ != nullptr) {
+    file_->expired = true;
+  }
+  AbstractRequestHandler::requestComplete();
+}
+
+void FileRequestHandler::onError(proxygen::ProxygenError err) noexcept {
+  if (file_ != nullptr) {
+    file_->expired = true;
+  }
+  AbstractRequestHandler::onError(err);
+}
+
+void FileRequestHandler::readNextChunk() {
+  if (paused_ || reading_ || done_) {
+    return;
+  }
+  if (offset_ == file_->size) {
+    done_ = true;
+    proxygen::ResponseBuilder(downstream_).sendWithEOM();
+    return;
+  }
+  reading_ = true;
+  const auto size = std::min(chunkSize_, file_->size - offset_);
+  executor_->add([this,
+                  evb = eventBase_,
+                  file = file_,
+                  offset = offset_,
+                  size]() {
+    auto chunk = folly::IOBuf::create(size);
+    const auto numRead =
+        folly::preadFull(file->fd, chunk->writableData(), size, offset);
+    const int readErrno = errno;
+    if (numRead > 0) {
+      chunk->append(numRead);
+    }
+    evb->runInEventBaseThread([this,
+                               file,
+                               chunk = std::move(chunk),
+                               numRead,
+                               size,
+                               readErrno]() mutable {
+      if (file->expired) {
+        return;
+      }
+      reading_ = false;
+      if (numRead != static_cast<ssize_t>(size)) {
+        // The content length is already sent, so the response can only be
+        // aborted.
+        LOG(WARNING) << "Failed to read " << path_ << " at offset "
+                     << offset_ << ": "
+                     << (numRead < 0 ? folly::errnoStr(readErrno)
+                                     : "file truncated");
+        done_ = true;
+        downstream_->sendAbort();
+        return;
+      }
+      offset_ += size;
+      RECORD_METRIC_VALUE(kCounterHttpFileResponseBytes, size);
+      proxygen::ResponseBuilder(downstream_).body(std::move(chunk)).send();
+      readNextChunk();
+    });
+  });
+}
+
 HttpConfig::HttpConfig(const folly::SocketAddress& address, bool reusePort)
     : address_(address), reusePort_(reusePort) {}
 
@@ -183,11 +358,119 @@ proxygen::RequestHandler* EndPoint::checkAndApply(
   return nullptr;
 }
 
+namespace {
+// The endpoint of the last request routed by the dispatcher on this thread.
+// proxygen builds the handler chain of a request and hands it the request on
+// the IO thread right after the dispatcher routed it, so the filters of the
+// request find its endpoint here.
+struct RoutedRequest {
+  const proxygen::HTTPMessage* message{nullptr};
+  std::optional<size_t> endpointId;
+};
+
+thread_local RoutedRequest routedRequest;
+} // namespace
+
+void setEndpointId(
+    const proxygen::HTTPMessage& message,
+    std::optional<size_t> endpointId) {
+  routedRequest.message = &message;
+  routedRequest.endpointId = endpointId;
+}
+
+std::optional<size_t> getEndpointId(const proxygen::HTTPMessage& message) {
+  if (routedRequest.message != &message) {
+    return std::nullopt;
+  }
+  return routedRequest.endpointId;
+}
+
+std::string endpointName(
+    proxygen::HTTPMethod method,
+    const std::string& pattern) {
+  return proxygen::methodToString(method) + " " + pattern;
+}
+
+std::string endpointMetricKey(const std::string& endpoint) {
+  // Capture groups become 'x' to keep the keys of e.g. /v1/task/status and
+  // /v1/task/(.+)/status apart.
+  std::string name;
+  int depth{0};
+  for (const char c : endpoint) {
+    if (c == '(') {
+      if (depth++ == 0) {
+        name += "_x_";
+      }
+    } else if (c == ')') {
+      --depth;
+    } else if (depth == 0) {
+      if (std::isalnum(static_cast<unsigned char>(c))) {
+        name += std::tolower(static_cast<unsigned char>(c));
+      } else if (!name.empty() && name.back() != '_') {
+        name += '_';
+      }
+    }
+  }
+  // Collapse the separators around the capture groups.
+  std::string key;
+  for (const char c : name) {
+    if (c != '_' || (!key.empty() && key.back() != '_')) {
+      key += c;
+    }
+  }
+  while (!key.empty() && key.back() == '_') {
+    key.pop_back();
+  }
+  return key;
+}
+
+std::optional<size_t> DispatchingRequestHandlerFactory::route(
+    proxygen::HTTPMethod method,
+    const std::string& path,
+    std::vector<std::string>& matches) const {
+  auto it = methodPatterns_.find(method);
+  if (it == methodPatterns_.end()) {
+    return std::nullopt;
+  }
+  const auto& methodPattern = it->second;
+
+  // Reuse the buffer across the requests served by the thread.
+  thread_local std::vector<re2::StringPiece> groups;
+  groups.resize(methodPattern.pattern->NumberOfCapturingGroups() + 1);
+  if (!methodPattern.pattern->Match(
+          path,
+          0,
+          path.size(),
+          RE2::ANCHOR_BOTH,
+          groups.data(),
+          groups.size())) {
+    return std::nullopt;
+  }
+  // Only the group of the matched alternative is set.
+  const auto& groupOffsets = methodPattern.groupOffsets;
+  for (size_t id = 0; id < groupOffsets.size(); ++id) {
+    const auto offset = groupOffsets[id];
+    if (groups[offset].data() == nullptr) {
+      continue;
+    }
+    const auto numCaptures = endpoints_.at(method)[id]->numCaptures();
+    matches.resize(numCaptures + 1);
+    matches[0] = path;
+    for (int i = 1; i <= numCaptures; ++i) {
+      const auto& group = groups[offset + i];
+      matches[i].assign(group.data(), group.size());
+    }
+    return id;
+  }
+  return std::nullopt;
+}
+
 proxygen::RequestHandler* DispatchingRequestHandlerFactory::onRequest(
     proxygen::RequestHandler*,
     proxygen::HTTPMessage* message) noexcept {
-  auto it = endpoints_.find(message->getMethod().value());
-  if (it == endpoints_.end()) {
+  setEndpointId(*message, std::nullopt);
+  const auto method = message->getMethod().value();
+  if (endpoints_.count(method) == 0) {
     return new ErrorRequestHandler(
         http::kHttpInternalServerError,
         fmt::format(
@@ -196,18 +479,22 @@ proxygen::RequestHandler* DispatchingRequestHandlerFactory::onRequest(
             message->getURL()));
   }
 
-  auto path = message->getPath();
-
-  // Allocate vector outside of loop to avoid repeated alloc/free.
-  std::vector<std::string> matches(4);
-  std::vector<RE2::Arg> args(4);
-  std::vector<RE2::Arg*> argPtrs(4);
-
-  for (const auto& endpoint : it->second) {
-    if (auto handler =
-            endpoint->checkAndApply(path, message, matches, args, argPtrs)) {
-      return handler;
+  try {
+    thread_local std::vector<std::string> matches;
+    auto id = route(method, message->getPath(), matches);
+    if (id.has_value()) {
+      setEndpointId(*message, id);
+      return endpoints_.at(method)[id.value()]->apply(message, matches);
     }
+  } catch (const std::exception& e) {
+    setEndpointId(*message, std::nullopt);
+    return new ErrorRequestHandler(
+        http::kHttpInternalServerError,
+        fmt::format(
+            "Failed to dispatch HTTP request: {} {}: {}",
+            message->getMethodString(),
+            message->getURL(),
+            e.what()));
   }
 
   return new ErrorRequestHandler(
@@ -222,13 +509,36 @@ void DispatchingRequestHandlerFactory::registerEndPoint(
     proxygen::HTTPMethod method,
     const std::string& pattern,
     const EndpointRequestHandlerFactory& endpoint) {
-  auto it = endpoints_.find(method);
-  if (it == endpoints_.end()) {
-    endpoints_[method].emplace_back(
-        std::make_unique<EndPoint>(pattern, endpoint));
-  } else {
-    it->second.emplace_back(std::make_unique<EndPoint>(pattern, endpoint));
+  auto& endpoints = endpoints_[method];
+  endpoints.emplace_back(std::make_unique<EndPoint>(pattern, endpoint));
+  VELOX_CHECK(
+      endpoints.back()->ok(),
+      "Invalid endpoint pattern {}: {}",
+      pattern,
+      endpoints.back()->error());
+
+  // The endpoints are registered at startup, so rebuild the pattern of the
+  // method from scratch. Alternative i is the pattern of endpoint i in a
+  // capture group, followed by the capture groups of the pattern.
+  MethodPattern methodPattern;
+  std::string combined;
+  int offset{1};
+  for (const auto& registered : endpoints) {
+    if (!combined.empty()) {
+      combined += '|';
+    }
+    combined += '(';
+    combined += registered->pattern();
+    combined += ')';
+    methodPattern.groupOffsets.push_back(offset);
+    offset += 1 + registered->numCaptures();
   }
+  methodPattern.pattern = std::make_unique<RE2>(combined);
+  VELOX_CHECK(
+      methodPattern.pattern->ok(),
+      "Failed to compile endpoint patterns: {}",
+      methodPattern.pattern->error());
+  methodPatterns_[method] = std::move(methodPattern);
 }
 
 const std::
@@ -260,8 +570,10 @@ void HttpServer::start(
     std::vector<std::unique_ptr<proxygen::RequestHandlerFactory>> filters,
     std::function<void(proxygen::HTTPServer* /*server*/)> onSuccess,
     std::function<void(std::exception_ptr)> onError) {
+  const auto* systemConfig = SystemConfig::instance();
   proxygen::HTTPServerOptions options;
-  options.idleTimeout = std::chrono::milliseconds(60'000);
+  options.idleTimeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+      systemConfig->httpServerIdleTimeout());
   options.enableContentCompression = false;
 
   proxygen::RequestHandlerChain handlerFactories;
@@ -276,10 +588,13 @@ void HttpServer::start(
   handlerFactories.addThen(std::move(handlerFactory_));
   options.handlerFactories = handlerFactories.build();
 
-  // Increase the default flow control to 1MB/10MB
-  options.initialReceiveWindow = uint32_t(1 << 20);
-  options.receiveStreamWindowSize = uint32_t(1 << 20);
-  options.receiveSessionWindowSize = 10 * (1 << 20);
+  // Increase the default flow control, 1MB/10MB by default.
+  options.initialReceiveWindow =
+      systemConfig->httpServerHttp2InitialReceiveWindow();
+  options.receiveStreamWindowSize =
+      systemConfig->httpServerHttp2ReceiveStreamWindowSize();
+  options.receiveSessionWindowSize =
+      systemConfig->httpServerHttp2ReceiveSessionWindowSize();
   options.h2cEnabled = true;
 
   server_ = std::make_unique<proxygen::HTTPServer>(std::move(options));
@@ -13,6 +13,7 @@
  */
 #pragma once
 #include <fmt/core.h>
+#include <folly/Executor.h>
 #include <proxygen/httpserver/HTTPServer.h>
 #include <proxygen/httpserver/RequestHandlerFactory.h>
 #include <proxygen/httpserver/ResponseBuilder.h>
@@ -29,10 +30,19 @@ void sendOkResponse(proxygen::ResponseHandler* downstream);
 
 void sendOkResponse(proxygen::ResponseHandler* downstream, const json& body);
 
+/// Serializes 'body' to a string. Invalid UTF-8 sequences are replaced instead
+/// of failing the serialization.
+std::string toJsonString(const json& body);
+
 void sendOkResponse(
     proxygen::ResponseHandler* downstream,
     const std::string& body);
 
+/// Sends 'body' without copying it.
+void sendOkResponse(
+    proxygen::ResponseHandler* downstream,
+    std::unique_ptr<folly::IOBuf> body);
+
 void sendOkThriftResponse(
     proxygen::ResponseHandler* downstream,
     const std::string& body);
@@ -42,6 +52,13 @@ void sendErrorResponse(
     const std::string& error = "",
     uint16_t status = http::kHttpInternalServerError);
 
+/// Sends 503 with a Retry-After header telling the client to retry the request
+/// after 'retryAfter'.
+void sendRetryLaterResponse(
+    proxygen::ResponseHandler* downstream,
+    const std::string& error,
+    std::chrono::seconds retryAfter);
+
 class AbstractRequestHandler : public proxygen::RequestHandler {
  public:
   void onRequest(
@@ -173,6 +190,64 @@ class ErrorRequestHandler : public AbstractRequestHandler {
   const std::string errorMessage_;
 };
 
+/// Responds with the content of a local file. The file is read in chunks of
+/// 'chunkSize' on 'executor', so that the disk reads do not block the event
+/// base of the request. The next chunk is read only after the previous one is
+/// sent and while the egress is not paused by flow control, so at most one
+/// chunk per request is in memory. Responds with 404 if the file does not
+/// exist. If the file is truncated while being served, the response is
+/// aborted.
+class FileRequestHandler : public AbstractRequestHandler {
+ public:
+  FileRequestHandler(
+      std::string path,
+      std::string contentType,
+      folly::Executor* executor,
+      size_t chunkSize = 1 << 20);
+
+  void onEOM() noexcept override;
+
+  void onEgressPaused() noexcept override {
+    paused_ = true;
+  }
+
+  void onEgressResumed() noexcept override;
+
+  void requestComplete() noexcept override;
+
+  void onError(proxygen::ProxygenError err) noexcept override;
+
+ private:
+  // The open file. Shared with the reads on 'executor_', which may complete
+  // after the handler is deleted.
+  struct File {
+    ~File();
+
+    int fd{-1};
+    size_t size{0};
+    // Set on the event base when the handler is deleted. The completions of
+    // the reads check it before touching the handler.
+    bool expired{false};
+  };
+
+  // Reads the next chunk on 'executor_' and sends it on the event base, unless
+  // a read is in progress, the egress is paused or the whole file is sent.
+  void readNextChunk();
+
+  const std::string path_;
+  const std::string contentType_;
+  folly::Executor* const executor_;
+  const size_t chunkSize_;
+
+  folly::EventBase* eventBase_{nullptr};
+  std::shared_ptr<File> file_;
+  size_t offset_{0};
+  bool paused_{false};
+  bool started_{false};
+  bool reading_{false};
+  bool done_{false};
+};
+
 using EndpointRequestHandlerFactory = std::function<proxygen::RequestHandler*(
     proxygen::HTTPMessage* message,
     const std::vector<std::string>& args)>;
@@ -197,15 +272,66 @@ class EndPoint {
       std::vector<RE2::Arg>& args,
       std::vector<RE2::Arg*>& argPtrs) const;
 
+  /// Creates the request handler for 'matches' obtained from check().
+  proxygen::RequestHandler* apply(
+      proxygen::HTTPMessage* message,
+      const std::vector<std::string>& matches) const {
+    return factory_(message, matches);
+  }
+
   const std::string& pattern() const {
     return re_.pattern();
   }
 
+  /// Returns true if the pattern compiled. error() tells why otherwise.
+  bool ok() const {
+    return re_.ok();
+  }
+
+  const std::string& error() const {
+    return re_.error();
+  }
+
+  /// Number of capture groups of the pattern.
+  int numCaptures() const {
+    return re_.NumberOfCapturingGroups();
+  }
+
  private:
   const RE2 re_;
   EndpointRequestHandlerFactory factory_;
 };
 
+/// Records the id of the endpoint the dispatcher routed 'message' to, or
+/// std::nullopt if none. The id is the index of the endpoint among the
+/// endpoints registered for the request method. Must be invoked on the thread
+/// building the handler chain of the request.
+void setEndpointId(
+    const proxygen::HTTPMessage& message,
+    std::optional<size_t> endpointId);
+
+/// Returns the id of the endpoint set by setEndpointId() for 'message', or
+/// std::nullopt if 'message' was not routed. Valid while the handler chain of
+/// the request is built and receives the request, e.g. in the onRequest() of
+/// the filters.
+std::optional<size_t> getEndpointId(const proxygen::HTTPMessage& message);
+
+/// Returns the name of the endpoint of 'method' and 'pattern' as shown in the
+/// stats, e.g. "GET /v1/task/(.+)/status".
+std::string endpointName(
+    proxygen::HTTPMethod method,
+    const std::string& pattern);
+
+/// Returns 'endpoint' as returned by endpointName() in the form used in the
+/// names of the exported metrics, e.g. "get_v1_task_x_status" for
+/// "GET /v1/task/(.+)/status".
+std::string endpointMetricKey(const std::string& endpoint);
+
+/// Routes the requests to the endpoints registered for the request method. The
+/// first registered endpoint whose pattern matches the path serves the request.
+/// The patterns of a method are combined into a single regular expression with
+/// one alternative per endpoint, so a request is matched against all of them
+/// and its captures are extracted in one pass.
 class DispatchingRequestHandlerFactory
     : public proxygen::RequestHandlerFactory {
  public:
@@ -222,6 +348,13 @@ class DispatchingRequestHandlerFactory
       const std::string& pattern,
       const EndpointRequestHandlerFactory& endpoint);
 
+  /// Returns the id of the endpoint serving 'method' and 'path' or std::nullopt
+  /// if there is none. Sets 'matches' to the path followed by the captures.
+  std::optional<size_t> route(
+      proxygen::HTTPMethod method,
+      const std::string& path,
+      std::vector<std::string>& matches) const;
+
   const std::unordered_map<
       proxygen::HTTPMethod,
       std::vector<std::unique_ptr<EndPoint>>>&
@@ -232,6 +365,18 @@ class DispatchingRequestHandlerFactory
       proxygen::HTTPMethod,
       std::vector<std::unique_ptr<EndPoint>>>
       endpoints_;
+
+  // The patterns of the endpoints of a method as alternatives of a single
+  // regular expression. The first alternative which matches wins, as RE2
+  // prefers the leftmost alternative.
+  struct MethodPattern {
+    std::unique_ptr<RE2> pattern;
+    // Index of the capture group of the alternative of each endpoint. The
+    // captures of the endpoint pattern follow.
+    std::vector<int> groupOffsets;
+  };
+
+  std::unordered_map<proxygen::HTTPMethod, MethodPattern> methodPatterns_;
 };
 
 class HttpConfig {
@@ -0,0 +1,99 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include "presto_cpp/main/http/HttpServer.h"
+
+using namespace facebook::presto;
+
+namespace {
+
+// The GET endpoints in the order registered by TaskResource::registerUris()
+// and PrestoServer.
+const std::vector<std::string> kGetPatterns{
+    R"(/v1/task/(.+)/results/([0-9]+)/([0-9]+)/acknowledge)",
+    R"(/v1/task/status)",
+    R"(/v1/task/(.+)/status)",
+    R"(/v1/task/(.+)/results/([0-9]+)/([0-9]+))",
+    R"(/v1/task/(.+))",
+    "/v1/info",
+    "/v1/info/state",
+    "/v1/status",
+    "/v1/info/metrics",
+    "/v1/operation/.*",
+};
+
+// A request mix dominated by the exchange and task status long-polls.
+const std::vector<std::string> kPaths{
+    "/v1/task/20240101_000000_00001_abcde.1.0.12.0/results/3/1024",
+    "/v1/task/20240101_000000_00001_abcde.1.0.12.0/results/3/1024/acknowledge",
+    "/v1/task/20240101_000000_00001_abcde.1.0.12.0/results/7/88",
+    "/v1/task/20240101_000000_00001_abcde.1.0.12.0/results/7/88/acknowledge",
+    "/v1/task/20240101_000000_00001_abcde.2.0.3.0/status",
+    "/v1/task/20240101_000000_00001_abcde.2.0.3.0",
+    "/v1/task/status",
+    "/v1/info/state",
+};
+
+http::DispatchingRequestHandlerFactory& factory() {
+  static auto factory = []() {
+    auto factory = std::make_unique<http::DispatchingRequestHandlerFactory>();
+    for (const auto& pattern : kGetPatterns) {
+      factory->registerEndPoint(proxygen::HTTPMethod::GET, pattern, nullptr);
+    }
+    return factory;
+  }();
+  return *factory;
+}
+
+} // namespace
+
+// Matches the endpoints one by one in registration order.
+BENCHMARK(linearScan, n) {
+  const auto& endpoints = factory().endpoints().at(proxygen::HTTPMethod::GET);
+  std::vector<std::string> matches(4);
+  std::vector<RE2::Arg> args(4);
+  std::vector<RE2::Arg*> argPtrs(4);
+  size_t sum{0};
+  for (uint32_t i = 0; i < n; ++i) {
+    const auto& path = kPaths[i % kPaths.size()];
+    for (size_t id = 0; id < endpoints.size(); ++id) {
+      if (endpoints[id]->check(path, matches, args, argPtrs)) {
+        sum += id;
+        break;
+      }
+    }
+  }
+  folly::doNotOptimizeAway(sum);
+}
+
+BENCHMARK_RELATIVE(combinedPattern, n) {
+  std::vector<std::string> matches;
+  size_t sum{0};
+  for (uint32_t i = 0; i < n; ++i) {
+    sum += factory()
+               .route(
+                   proxygen::HTTPMethod::GET,
+                   kPaths[i % kPaths.size()],
+                   matches)
+               .value();
+  }
+  folly::doNotOptimizeAway(sum);
+}
+
+int main(int argc, char** argv) {
+  folly::Init init{&argc, &argv};
+  folly::runBenchmarks();
+  return 0;
+}
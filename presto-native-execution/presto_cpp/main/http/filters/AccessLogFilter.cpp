@@ -12,47 +12,51 @@
  * limitations under the License.
  */
 
-#include <fmt/format.h>
 #include "presto_cpp/main/http/filters/AccessLogFilter.h"
 
 namespace facebook::presto::http::filters {
 
-AccessLogFilter::AccessLogFilter(proxygen::RequestHandler* upstream)
-    : Filter(upstream) {}
+AccessLogFilter::AccessLogFilter(
+    proxygen::RequestHandler* upstream,
+    std::shared_ptr<AccessLogWriter> writer)
+    : Filter(upstream), writer_(std::move(writer)) {}
 
 void AccessLogFilter::onRequest(
     std::unique_ptr<proxygen::HTTPMessage> msg) noexcept {
   startTime_ = msg->getStartTime();
-  method_ = msg->getMethodString();
-  url_ = msg->getURL();
-  version_ = getVersion(*msg);
-  remoteAddr_ = msg->getClientIP();
+  AccessLogRecord::set(record_.method, msg->getMethodString());
+  AccessLogRecord::set(record_.url, msg->getURL());
+  AccessLogRecord::set(record_.version, getVersion(*msg));
+  AccessLogRecord::set(record_.remoteAddr, msg->getClientIP());
 
   const auto& headers = msg->getHeaders();
-  httpReferer_ = headers.getSingleOrEmpty(proxygen::HTTP_HEADER_REFERER);
-  httpUserAgent_ = headers.getSingleOrEmpty(proxygen::HTTP_HEADER_USER_AGENT);
+  AccessLogRecord::set(
+      record_.referer, headers.getSingleOrEmpty(proxygen::HTTP_HEADER_REFERER));
+  AccessLogRecord::set(
+      record_.userAgent,
+      headers.getSingleOrEmpty(proxygen::HTTP_HEADER_USER_AGENT));
 
   Filter::onRequest(std::move(msg));
 }
 
 void AccessLogFilter::requestComplete() noexcept {
-  writeLog(generateLog());
+  writeLog();
   Filter::requestComplete();
 }
 
 void AccessLogFilter::onError(proxygen::ProxygenError err) noexcept {
-  writeLog(generateLog());
+  writeLog();
   Filter::onError(err);
 }
 
 // Response handler
 void AccessLogFilter::sendHeaders(proxygen::HTTPMessage& msg) noexcept {
-  statusCode_ = msg.getStatusCode();
+  record_.statusCode = msg.getStatusCode();
   Filter::sendHeaders(msg);
 }
 
 void AccessLogFilter::sendBody(std::unique_ptr<folly::IOBuf> body) noexcept {
-  bytesSent_ += body->computeChainDataLength();
+  record_.bytesSent += body->computeChainDataLength();
   Filter::sendBody(std::move(body));
 }
 
@@ -65,32 +69,12 @@ std::string AccessLogFilter::getVersion(
   }
 }
 
-void AccessLogFilter::writeLog(std::string logLine) const noexcept {
-  LOG(INFO) << logLine;
-}
-
-std::string AccessLogFilter::generateLog() const noexcept {
-  std::time_t requestStartTime = proxygen::toTimeT(proxygen::getCurrentTime());
-  static struct tm formattedStartTime;
-  localtime_r(&requestStartTime, &formattedStartTime);
-  char timeBuf[64];
-  std::strftime(timeBuf, 64, "%F %T", &formattedStartTime);
-  const auto latency = proxygen::millisecondsSince(startTime_);
-
-  std::string logLine = fmt::format(
-      "{} - - [{}] \"{} {} {}\" {:d} {:d} {} {} {:d}",
-      remoteAddr_.c_str(),
-      timeBuf,
-      method_.c_str(),
-      url_.c_str(),
-      version_.c_str(),
-      statusCode_,
-      bytesSent_,
-      httpReferer_.c_str(),
-      httpUserAgent_.c_str(),
-      latency.count());
-
-  return logLine;
+void AccessLogFilter::writeLog() noexcept {
+  record_.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+  record_.latencyMs = proxygen::millisecondsSince(startTime_).count();
+  writer_->write(record_);
 }
 
 } // namespace facebook::presto::http::filters
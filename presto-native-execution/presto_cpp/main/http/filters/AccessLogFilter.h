@@ -16,13 +16,18 @@
 
 #include <proxygen/httpserver/Filters.h>
 #include <proxygen/httpserver/RequestHandlerFactory.h>
+#include "presto_cpp/main/http/filters/AccessLogWriter.h"
 
 namespace facebook::presto::http::filters {
 
-/// A filter that does access logging in nginx `combined` format
+/// A filter that does access logging in nginx `combined` format. The filter
+/// only fills a fixed-size record, the formatting and the IO happen on the
+/// background thread of the AccessLogWriter.
 class AccessLogFilter : public proxygen::Filter {
  public:
-  explicit AccessLogFilter(proxygen::RequestHandler* upstream);
+  AccessLogFilter(
+      proxygen::RequestHandler* upstream,
+      std::shared_ptr<AccessLogWriter> writer);
 
   void onRequest(std::unique_ptr<proxygen::HTTPMessage> msg) noexcept override;
 
@@ -37,26 +42,17 @@ class AccessLogFilter : public proxygen::Filter {
  private:
   std::string getVersion(const proxygen::HTTPMessage& msg) const noexcept;
 
-  virtual void writeLog(std::string logLine) const noexcept;
-
-  std::string generateLog() const noexcept;
+  void writeLog() noexcept;
 
+  const std::shared_ptr<AccessLogWriter> writer_;
   proxygen::TimePoint startTime_;
-  std::string method_;
-  std::string url_;
-  std::string version_;
-  std::string remoteAddr_;
-
-  uint16_t statusCode_{0};
-  size_t bytesSent_{0};
-
-  std::string httpReferer_;
-  std::string httpUserAgent_;
+  AccessLogRecord record_;
 };
 
 class AccessLogFilterFactory : public proxygen::RequestHandlerFactory {
  public:
-  explicit AccessLogFilterFactory() {}
+  explicit AccessLogFilterFactory(std::shared_ptr<AccessLogWriter> writer)
+      : writer_(std::move(writer)) {}
 
   void onServerStart(folly::EventBase* /*evb*/) noexcept override {}
 
@@ -65,8 +61,11 @@ class AccessLogFilterFactory : public proxygen::RequestHandlerFactory {
   proxygen::RequestHandler* onRequest(
       proxygen::RequestHandler* handler,
       proxygen::HTTPMessage*) noexcept override {
-    return new AccessLogFilter(handler);
+    return new AccessLogFilter(handler, writer_);
   }
+
+ private:
+  const std::shared_ptr<AccessLogWriter> writer_;
 };
 
 } // namespace facebook::presto::http::filters
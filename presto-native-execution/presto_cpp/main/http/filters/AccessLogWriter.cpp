@@ -0,0 +1,159 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/http/filters/AccessLogWriter.h"
+#include <fmt/format.h>
+#include <folly/String.h>
+#include <folly/system/ThreadName.h>
+#include <glog/logging.h>
+#include <ctime>
+#include "velox/common/base/Exceptions.h"
+
+namespace facebook::presto::http::filters {
+namespace {
+// How often the background thread checks for the stop request when idle.
+constexpr auto kPollInterval = std::chrono::milliseconds(100);
+} // namespace
+
+AccessLogWriter::AccessLogWriter(Options options)
+    : options_(std::move(options)), queue_(options_.queueSize) {
+  VELOX_CHECK_GT(options_.maxBatchSize, 0);
+  if (!options_.filePath.empty()) {
+    openFile();
+  }
+  thread_ = std::thread([this]() { run(); });
+}
+
+AccessLogWriter::~AccessLogWriter() {
+  stop_ = true;
+  thread_.join();
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+}
+
+void AccessLogWriter::write(const AccessLogRecord& record) {
+  if (queue_.write(record)) {
+    ++numQueued_;
+  } else {
+    ++numDroppedRecords_;
+  }
+}
+
+void AccessLogWriter::flush() {
+  const auto numQueued = numQueued_.load();
+  while (numProcessed_ < numQueued) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// static
+void AccessLogWriter::format(const AccessLogRecord& record, std::string& out) {
+  const std::time_t time = record.timeMs / 1'000;
+  struct tm localTime;
+  localtime_r(&time, &localTime);
+  char timeBuf[64];
+  std::strftime(timeBuf, sizeof(timeBuf), "%F %T", &localTime);
+
+  fmt::format_to(
+      std::back_inserter(out),
+      "{} - - [{}] \"{} {} {}\" {:d} {:d} {} {} {:d}",
+      record.remoteAddr,
+      timeBuf,
+      record.method,
+      record.url,
+      record.version,
+      record.statusCode,
+      record.bytesSent,
+      record.referer,
+      record.userAgent,
+      record.latencyMs);
+}
+
+void AccessLogWriter::run() {
+  folly::setThreadName("AccessLog");
+  std::string lines;
+  AccessLogRecord record;
+  for (;;) {
+    if (!queue_.tryReadUntil(
+            std::chrono::steady_clock::now() + kPollInterval, record)) {
+      if (stop_) {
+        break;
+      }
+      continue;
+    }
+    size_t numLines{0};
+    do {
+      format(record, lines);
+      lines += '\n';
+      ++numLines;
+    } while (numLines < options_.maxBatchSize && queue_.read(record));
+    writeBatch(lines, numLines);
+    lines.clear();
+  }
+}
+
+void AccessLogWriter::writeBatch(const std::string& lines, size_t numLines) {
+  if (file_ == nullptr) {
+    if (options_.filePath.empty()) {
+      size_t start{0};
+      while (start < lines.size()) {
+        const auto end = lines.find('\n', start);
+        LOG(INFO) << std::string_view(lines).substr(start, end - start);
+        start = end + 1;
+      }
+    }
+  } else {
+    if (fwrite(lines.data(), 1, lines.size(), file_) != lines.size()) {
+      LOG(ERROR) << "Failed to write access log " << options_.filePath << ": "
+                 << folly::errnoStr(errno);
+    }
+    fflush(file_);
+    fileSize_ += lines.size();
+    if (fileSize_ >= options_.maxFileSize) {
+      rotate();
+    }
+  }
+  numProcessed_ += numLines;
+}
+
+void AccessLogWriter::openFile() {
+  file_ = fopen(options_.filePath.c_str(), "a");
+  if (file_ == nullptr) {
+    LOG(ERROR) << "Failed to open access log " << options_.filePath << ": "
+               << folly::errnoStr(errno);
+    fileSize_ = 0;
+    return;
+  }
+  fseek(file_, 0, SEEK_END);
+  fileSize_ = ftell(file_);
+}
+
+void AccessLogWriter::rotate() {
+  fclose(file_);
+  file_ = nullptr;
+  const auto& path = options_.filePath;
+  if (options_.maxFiles == 0) {
+    std::remove(path.c_str());
+  } else {
+    for (auto i = options_.maxFiles - 1; i > 0; --i) {
+      std::rename(
+          fmt::format("{}.{}", path, i).c_str(),
+          fmt::format("{}.{}", path, i + 1).c_str());
+    }
+    std::rename(path.c_str(), fmt::format("{}.1", path).c_str());
+  }
+  openFile();
+}
+
+} // namespace facebook::presto::http::filters
@@ -0,0 +1,114 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/MPMCQueue.h>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace facebook::presto::http::filters {
+
+/// Fixed-size binary access log record, so that queuing a record does not
+/// allocate. Strings longer than their field are truncated, e.g. the url with
+/// its query string to 255 bytes.
+struct AccessLogRecord {
+  /// Wall time of the request completion in ms since epoch.
+  int64_t timeMs{0};
+  int64_t latencyMs{0};
+  uint64_t bytesSent{0};
+  uint16_t statusCode{0};
+  char remoteAddr[48]{};
+  char method[16]{};
+  char version[16]{};
+  char url[256]{};
+  char referer[128]{};
+  char userAgent[128]{};
+
+  /// Copies 'value' into 'field' truncating it if needed.
+  template <size_t N>
+  static void set(char (&field)[N], const std::string& value) {
+    const auto size = std::min(value.size(), N - 1);
+    std::memcpy(field, value.data(), size);
+    field[size] = '\0';
+  }
+};
+
+/// Writes access log records in nginx `combined` format from a background
+/// thread. The request threads only copy the record into a bounded lock-free
+/// queue. If the queue is full, the record is dropped and counted in
+/// numDroppedRecords(). The background thread formats the records and writes
+/// them in batches to a file which is rotated by size.
+class AccessLogWriter {
+ public:
+  struct Options {
+    /// The file to write to. If empty, the records go to the INFO log.
+    std::string filePath;
+
+    /// The file is rotated when it grows above this size.
+    uint64_t maxFileSize{100 << 20};
+
+    /// Number of rotated files <filePath>.1 ... <filePath>.<maxFiles> to keep.
+    uint32_t maxFiles{5};
+
+    /// Max number of records waiting to be written. The queue is preallocated,
+    /// the records are about 640 bytes each.
+    uint32_t queueSize{4'096};
+
+    /// Max number of records written at once.
+    uint32_t maxBatchSize{1'024};
+  };
+
+  explicit AccessLogWriter(Options options);
+
+  /// Writes the queued records and stops the background thread.
+  ~AccessLogWriter();
+
+  /// Queues 'record' for writing. Never blocks.
+  void write(const AccessLogRecord& record);
+
+  /// Waits until the records queued before the call are written. Used in tests.
+  void flush();
+
+  /// Appends 'record' as a log line without a trailing newline to 'out'.
+  static void format(const AccessLogRecord& record, std::string& out);
+
+  /// Number of records dropped because the queue was full.
+  static int64_t numDroppedRecords() {
+    return numDroppedRecords_;
+  }
+
+ private:
+  void run();
+
+  void writeBatch(const std::string& lines, size_t numLines);
+
+  void openFile();
+
+  void rotate();
+
+  const Options options_;
+  folly::MPMCQueue<AccessLogRecord> queue_;
+  std::atomic_bool stop_{false};
+  std::atomic<uint64_t> numQueued_{0};
+  std::atomic<uint64_t> numProcessed_{0};
+  FILE* file_{nullptr};
+  uint64_t fileSize_{0};
+  std::thread thread_;
+
+  static inline std::atomic_int64_t numDroppedRecords_{0};
+};
+
+} // namespace facebook::presto::http::filters
@@ -13,74 +13,349 @@
  */
 
 #include "presto_cpp/main/http/filters/HttpEndpointLatencyFilter.h"
+#include <folly/ThreadLocal.h>
+#include <folly/container/F14Map.h>
+#include <folly/lang/Bits.h>
 #include "velox/common/base/Exceptions.h"
+#include "velox/common/base/StatsReporter.h"
 
 namespace facebook::presto::http::filters {
+namespace {
+
+// Max number of distinct endpoints with latency slots.
+constexpr size_t kMaxSlots = 256;
+
+// Log-linear buckets: values below 8 have a bucket each, every power of two
+// above is split into 8 buckets. Latencies are capped at 2^40us (~12 days).
+constexpr int kSubBucketBits = 3;
+constexpr int kNumSubBuckets = 1 << kSubBucketBits;
+constexpr int kMaxValueBits = 40;
+constexpr size_t kNumBuckets =
+    kNumSubBuckets * (kMaxValueBits - kSubBucketBits + 1);
+
+size_t bucketIndex(uint64_t value) {
+  value = std::min<uint64_t>(value, (1ULL << kMaxValueBits) - 1);
+  if (value < kNumSubBuckets) {
+    return value;
+  }
+  const int exponent = folly::findLastSet(value) - 1;
+  const int shift = exponent - kSubBucketBits;
+  return kNumSubBuckets * (shift + 1) +
+      ((value >> shift) & (kNumSubBuckets - 1));
+}
+
+// Returns the largest value which falls into bucket 'index'.
+uint64_t bucketMaxValue(size_t index) {
+  if (index < kNumSubBuckets) {
+    return index;
+  }
+  const int shift = index / kNumSubBuckets - 1;
+  const uint64_t subBucket = kNumSubBuckets + index % kNumSubBuckets;
+  return ((subBucket + 1) << shift) - 1;
+}
+
+// Latency histogram of one endpoint. Written by the owning thread only and
+// read and reset concurrently by retrieveLatencies(), hence the atomics.
+struct alignas(folly::hardware_destructive_interference_size)
+    LatencyHistogram {
+  std::array<std::atomic<uint32_t>, kNumBuckets> buckets{};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sumUs{0};
+  std::atomic<uint64_t> maxUs{0};
+
+  void add(uint64_t latencyUs) {
+    buckets[bucketIndex(latencyUs)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(latencyUs, std::memory_order_relaxed);
+    auto max = maxUs.load(std::memory_order_relaxed);
+    while (latencyUs > max &&
+           !maxUs.compare_exchange_weak(
+               max, latencyUs, std::memory_order_relaxed)) {
+    }
+  }
+};
+
+// Non-atomic histogram the per-thread histograms are merged into.
+struct MergedHistogram {
+  std::array<uint64_t, kNumBuckets> buckets{};
+  uint64_t count{0};
+  uint64_t sumUs{0};
+  uint64_t maxUs{0};
+
+  // Moves the values of 'histogram' into this and resets 'histogram'.
+  void takeFrom(LatencyHistogram& histogram) {
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      buckets[i] += histogram.buckets[i].exchange(0, std::memory_order_relaxed);
+    }
+    count += histogram.count.exchange(0, std::memory_order_relaxed);
+    sumUs += histogram.sumUs.exchange(0, std::memory_order_relaxed);
+    maxUs = std::max(
+        maxUs, histogram.maxUs.exchange(0, std::memory_order_relaxed));
+  }
+
+  void add(const MergedHistogram& other) {
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sumUs += other.sumUs;
+    maxUs = std::max(maxUs, other.maxUs);
+  }
+
+  uint64_t percentile(double fraction) const {
+    const auto rank = std::max<uint64_t>(1, std::ceil(fraction * count));
+    uint64_t cumulative{0};
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      cumulative += buckets[i];
+      if (cumulative >= rank) {
+        return std::min(bucketMaxValue(i), maxUs);
+      }
+    }
+    return maxUs;
+  }
+};
+
+using MergedHistograms =
+    std::array<std::unique_ptr<MergedHistogram>, kMaxSlots>;
+
+void merge(MergedHistograms& to, MergedHistograms& from) {
+  for (size_t slot = 0; slot < kMaxSlots; ++slot) {
+    if (from[slot] == nullptr) {
+      continue;
+    }
+    if (to[slot] == nullptr) {
+      to[slot] = std::move(from[slot]);
+    } else {
+      to[slot]->add(*from[slot]);
+      from[slot].reset();
+    }
+  }
+}
+
+// Histograms of the threads which exited since the last retrieval.
+folly::Synchronized<MergedHistograms>& exitedThreadHistograms() {
+  static folly::Synchronized<MergedHistograms> histograms;
+  return histograms;
+}
+
+// The histograms of one thread. A histogram is allocated on the first request
+// to its endpoint and published to the readers with release semantics.
+struct ThreadHistograms {
+  std::array<std::atomic<LatencyHistogram*>, kMaxSlots> histograms{};
+
+  ~ThreadHistograms() {
+    MergedHistograms merged;
+    for (size_t slot = 0; slot < kMaxSlots; ++slot) {
+      if (auto* histogram = histograms[slot].load(std::memory_order_acquire)) {
+        merged[slot] = std::make_unique<MergedHistogram>();
+        merged[slot]->takeFrom(*histogram);
+        delete histogram;
+      }
+    }
+    exitedThreadHistograms().withWLock(
+        [&](auto& histograms) { merge(histograms, merged); });
+  }
+
+  LatencyHistogram& get(size_t slot) {
+    auto* histogram = histograms[slot].load(std::memory_order_relaxed);
+    if (histogram == nullptr) {
+      histogram = new LatencyHistogram();
+      histograms[slot].store(histogram, std::memory_order_release);
+    }
+    return *histogram;
+  }
+};
+
+struct LatencyTag {};
+
+folly::ThreadLocal<ThreadHistograms, LatencyTag>& threadHistograms() {
+  static folly::ThreadLocal<ThreadHistograms, LatencyTag> histograms;
+  return histograms;
+}
+
+// Assigns the latency slots to the endpoint names.
+struct SlotRegistry {
+  folly::F14FastMap<std::string, size_t> slots;
+  std::vector<std::string> names;
+};
+
+folly::Synchronized<SlotRegistry>& slotRegistry() {
+  static folly::Synchronized<SlotRegistry> registry;
+  return registry;
+}
+
+std::optional<size_t> slotOf(const std::string& endpoint) {
+  return slotRegistry().withWLock(
+      [&](auto& registry) -> std::optional<size_t> {
+        auto it = registry.slots.find(endpoint);
+        if (it != registry.slots.end()) {
+          return it->second;
+        }
+        if (registry.names.size() >= kMaxSlots) {
+          LOG(WARNING) << "Too many endpoints to track latency of: "
+                       << endpoint;
+          return std::nullopt;
+        }
+        registry.slots.emplace(endpoint, registry.names.size());
+        registry.names.push_back(endpoint);
+        return registry.names.size() - 1;
+      });
+}
+
+// The exported quantiles in the order of the fields in EndPointMetrics.
+constexpr std::array<std::string_view, 4> kQuantiles{
+    "p50",
+    "p90",
+    "p99",
+    "p999"};
+} // namespace
+
+HttpEndpointLatencyFilter::Endpoints::Endpoints(EndpointMap endpoints)
+    : endpoints_(std::move(endpoints)) {
+  for (const auto& [method, methodEndpoints] : endpoints_) {
+    auto& slots = slots_[method];
+    slots.reserve(methodEndpoints.size());
+    for (const auto& endpoint : methodEndpoints) {
+      slots.push_back(slotOf(endpointName(method, endpoint->pattern())));
+    }
+  }
+}
+
+std::optional<size_t> HttpEndpointLatencyFilter::Endpoints::slot(
+    const proxygen::HTTPMessage& message) const {
+  const auto method = message.getMethod().value();
+  auto it = endpoints_.find(method);
+  if (it == endpoints_.end()) {
+    return std::nullopt;
+  }
+  const auto& slots = slots_.at(method);
+
+  // Reuse the endpoint matched by the dispatcher if available.
+  const auto endpointId = getEndpointId(message);
+  if (endpointId.has_value() && endpointId.value() < slots.size()) {
+    return slots[endpointId.value()];
+  }
+
+  auto path = message.getPath();
+
+  // Allocate vector outside of loop to avoid repeated alloc/free.
+  std::vector<std::string> matches(4);
+  std::vector<RE2::Arg> args(4);
+  std::vector<RE2::Arg*> argPtrs(4);
+
+  for (size_t i = 0; i < it->second.size(); ++i) {
+    if (it->second[i]->check(path, matches, args, argPtrs)) {
+      return slots[i];
+    }
+  }
+  return std::nullopt;
+}
 
 HttpEndpointLatencyFilter::HttpEndpointLatencyFilter(
     proxygen::RequestHandler* upstream,
-    const std::shared_ptr<std::unordered_map<
-        proxygen::HTTPMethod,
-        std::vector<std::unique_ptr<EndPoint>>>>& endpoints)
+    const std::shared_ptr<const Endpoints>& endpoints)
     : Filter(upstream), endpoints_(endpoints) {}
 
 // static
 void HttpEndpointLatencyFilter::updateLatency(
-    const std::string& endpoint,
+    std::optional<size_t> slot,
     uint64_t latencyUs) {
-  metricMap().withWLock([&](std::unordered_map<std::string, EndPointMetrics>&
-                                map) {
-    auto itr = map.find(endpoint);
-    if (itr != map.end()) {
-      auto& metrics = itr->second;
-      metrics.maxLatencyUs = std::max(metrics.maxLatencyUs, latencyUs);
-      metrics.avgLatencyUs =
-          (metrics.avgLatencyUs * metrics.count + latencyUs) /
-          (metrics.count + 1);
-      ++metrics.count;
-    } else {
-      map.emplace(endpoint, EndPointMetrics{endpoint, latencyUs, latencyUs, 1});
-    }
-  });
+  if (!slot.has_value()) {
+    return;
+  }
+  threadHistograms()->get(slot.value()).add(latencyUs);
 }
 
 // static
 std::vector<HttpEndpointLatencyFilter::EndPointMetrics>
 HttpEndpointLatencyFilter::retrieveLatencies() {
+  MergedHistograms merged;
+  exitedThreadHistograms().withWLock(
+      [&](auto& histograms) { merge(merged, histograms); });
+  {
+    auto accessor = threadHistograms().accessAllThreads();
+    for (auto& thread : accessor) {
+      for (size_t slot = 0; slot < kMaxSlots; ++slot) {
+        auto* histogram =
+            thread.histograms[slot].load(std::memory_order_acquire);
+        if (histogram == nullptr) {
+          continue;
+        }
+        if (merged[slot] == nullptr) {
+          merged[slot] = std::make_unique<MergedHistogram>();
+        }
+        merged[slot]->takeFrom(*histogram);
+      }
+    }
+  }
+
+  const auto names = slotRegistry().rlock()->names;
   std::vector<HttpEndpointLatencyFilter::EndPointMetrics> result;
-  metricMap().withWLock([&](std::unordered_map<
-                            std::string,
-                            HttpEndpointLatencyFilter::EndPointMetrics>& map) {
-    result.reserve(map.size());
-    for (const auto& pair : map) {
-      result.push_back(pair.second);
+  for (size_t slot = 0; slot < kMaxSlots; ++slot) {
+    const auto& histogram = merged[slot];
+    if (histogram == nullptr || histogram->count == 0) {
+      continue;
     }
-    map.clear();
-  });
+    EndPointMetrics metrics{
+        names[slot],
+        histogram->maxUs,
+        histogram->sumUs / histogram->count,
+        histogram->count};
+    metrics.p50LatencyUs = histogram->percentile(0.5);
+    metrics.p90LatencyUs = histogram->percentile(0.9);
+    metrics.p99LatencyUs = histogram->percentile(0.99);
+    metrics.p999LatencyUs = histogram->percentile(0.999);
+    result.push_back(std::move(metrics));
+  }
   std::sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
     return lhs.maxLatencyUs > rhs.maxLatencyUs;
   });
   return result;
 }
 
-void HttpEndpointLatencyFilter::onRequest(
-    std::unique_ptr<proxygen::HTTPMessage> msg) noexcept {
-  auto path = msg->getPath();
-  const auto method = msg->getMethod().value();
-  const auto& endpoints = endpoints_->at(method);
+// static
+std::string HttpEndpointLatencyFilter::metricName(
+    const std::string& endpoint,
+    std::string_view quantile) {
+  return fmt::format(
+      "presto_cpp.http_endpoint_latency_us.{}.{}",
+      endpointMetricKey(endpoint),
+      quantile);
+}
 
-  // Allocate vector outside of loop to avoid repeated alloc/free.
-  std::vector<std::string> matches(4);
-  std::vector<RE2::Arg> args(4);
-  std::vector<RE2::Arg*> argPtrs(4);
+// static
+void HttpEndpointLatencyFilter::registerMetrics(const EndpointMap& endpoints) {
+  for (const auto& [method, methodEndpoints] : endpoints) {
+    for (const auto& endpoint : methodEndpoints) {
+      const auto name = endpointName(method, endpoint->pattern());
+      for (const auto& quantile : kQuantiles) {
+        DEFINE_METRIC(
+            metricName(name, quantile), facebook::velox::StatType::AVG);
+      }
+    }
+  }
+}
 
-  for (const auto& endpoint : endpoints) {
-    if (endpoint->check(path, matches, args, argPtrs)) {
-      requestEndpoint_ = methodToString(method) + " " + endpoint->pattern();
-      break;
+// static
+void HttpEndpointLatencyFilter::reportMetrics(
+    const std::vector<EndPointMetrics>& metrics) {
+  for (const auto& endpointMetrics : metrics) {
+    const std::array<uint64_t, 4> values{
+        endpointMetrics.p50LatencyUs,
+        endpointMetrics.p90LatencyUs,
+        endpointMetrics.p99LatencyUs,
+        endpointMetrics.p999LatencyUs};
+    for (size_t i = 0; i < kQuantiles.size(); ++i) {
+      RECORD_METRIC_VALUE(
+          metricName(endpointMetrics.endpoint, kQuantiles[i]),
+          values[i]);
     }
   }
-  VELOX_CHECK(!requestEndpoint_.empty());
+}
+
+void HttpEndpointLatencyFilter::onRequest(
+    std::unique_ptr<proxygen::HTTPMessage> msg) noexcept {
+  slot_ = endpoints_->slot(*msg);
 
   // Starts the timer.
   timer_ = std::make_unique<velox::MicrosecondTimer>(&timeUs_);
@@ -89,13 +364,13 @@ void HttpEndpointLatencyFilter::onRequest(
 
 void HttpEndpointLatencyFilter::requestComplete() noexcept {
   timer_.reset();
-  updateLatency(requestEndpoint_, timeUs_);
+  updateLatency(slot_, timeUs_);
   proxygen::Filter::requestComplete();
 }
 
 void HttpEndpointLatencyFilter::onError(proxygen::ProxygenError err) noexcept {
   timer_.reset();
-  updateLatency(requestEndpoint_, timeUs_);
+  updateLatency(slot_, timeUs_);
   proxygen::Filter::onError(err);
 }
 
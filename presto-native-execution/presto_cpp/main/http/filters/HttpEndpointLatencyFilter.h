@@ -22,6 +22,10 @@
 
 namespace facebook::presto::http::filters {
 
+/// Records the latency of the requests per endpoint. The latencies go to
+/// per-thread histograms indexed by a dense endpoint slot, so recording does
+/// not take locks or contend with other threads. The histograms of all threads
+/// are merged on retrieveLatencies().
 class HttpEndpointLatencyFilter : public proxygen::Filter {
  public:
   struct EndPointMetrics {
@@ -38,23 +42,66 @@ class HttpEndpointLatencyFilter : public proxygen::Filter {
     /// Number of requests on this endpoint
     uint64_t count;
 
+    /// Latency percentiles of the requests on this endpoint. Accurate to
+    /// within 1/8 of the value.
+    uint64_t p50LatencyUs{0};
+    uint64_t p90LatencyUs{0};
+    uint64_t p99LatencyUs{0};
+    uint64_t p999LatencyUs{0};
+
     std::string toString() const {
       std::stringstream oss;
       oss << "{'" << endpoint << "' : " << velox::succinctMicros(maxLatencyUs)
           << "(max) " << velox::succinctMicros(avgLatencyUs) << "(avg) "
-          << count << "(count)}";
+          << velox::succinctMicros(p50LatencyUs) << "(p50) "
+          << velox::succinctMicros(p90LatencyUs) << "(p90) "
+          << velox::succinctMicros(p99LatencyUs) << "(p99) "
+          << velox::succinctMicros(p999LatencyUs) << "(p999) " << count
+          << "(count)}";
       return oss.str();
     }
   };
 
+  using EndpointMap = std::unordered_map<
+      proxygen::HTTPMethod,
+      std::vector<std::unique_ptr<EndPoint>>>;
+
+  /// The endpoints the server is listening on along with their latency slots.
+  class Endpoints {
+   public:
+    explicit Endpoints(EndpointMap endpoints);
+
+    /// Returns the latency slot of the endpoint serving 'message' or
+    /// std::nullopt if no endpoint serves it or there are too many endpoints.
+    std::optional<size_t> slot(const proxygen::HTTPMessage& message) const;
+
+   private:
+    const EndpointMap endpoints_;
+    // The slots of 'endpoints_' per method, in the same order.
+    std::unordered_map<proxygen::HTTPMethod, std::vector<std::optional<size_t>>>
+        slots_;
+  };
+
   HttpEndpointLatencyFilter(
       proxygen::RequestHandler* upstream,
-      const std::shared_ptr<std::unordered_map<
-          proxygen::HTTPMethod,
-          std::vector<std::unique_ptr<EndPoint>>>>& endpoints);
+      const std::shared_ptr<const Endpoints>& endpoints);
 
+  /// Returns the metrics of the endpoints which served requests since the last
+  /// call, sorted by the max latency.
   static std::vector<EndPointMetrics> retrieveLatencies();
 
+  /// Returns the name of the exported metric for 'quantile' (e.g. "p99") of
+  /// 'endpoint' (e.g. "GET /v1/task/(.+)/status").
+  static std::string metricName(
+      const std::string& endpoint,
+      std::string_view quantile);
+
+  /// Registers the exported latency percentile metrics of 'endpoints'.
+  static void registerMetrics(const EndpointMap& endpoints);
+
+  /// Exports the percentiles of 'metrics' through the stats reporter.
+  static void reportMetrics(const std::vector<EndPointMetrics>& metrics);
+
   void onRequest(std::unique_ptr<proxygen::HTTPMessage> msg) noexcept override;
 
   void requestComplete() noexcept override;
@@ -62,24 +109,14 @@ class HttpEndpointLatencyFilter : public proxygen::Filter {
   void onError(proxygen::ProxygenError err) noexcept override;
 
  private:
-  static void updateLatency(const std::string& endpoint, uint64_t latencyMs);
+  static void updateLatency(std::optional<size_t> slot, uint64_t latencyUs);
 
-  static folly::Synchronized<std::unordered_map<std::string, EndPointMetrics>>&
-  metricMap() {
-    static folly::Synchronized<std::unordered_map<std::string, EndPointMetrics>>
-        metricMap_;
-    return metricMap_;
-  }
+  // The endpoints the server is listening on. This is used to find the slot of
+  // the current request's endpoint.
+  const std::shared_ptr<const Endpoints> endpoints_;
 
-  // The endpoints the server is listening on. This is used to match the current
-  // request's endpoint.
-  const std::shared_ptr<std::unordered_map<
-      proxygen::HTTPMethod,
-      std::vector<std::unique_ptr<EndPoint>>>>
-      endpoints_;
-
-  // The http endpoint of this request
-  std::string requestEndpoint_;
+  // The latency slot of the endpoint of this request.
+  std::optional<size_t> slot_;
 
   // The timer used for keeping track of the duration of the request.
   std::unique_ptr<velox::MicrosecondTimer> timer_;
@@ -92,9 +129,7 @@ class HttpEndpointLatencyFilterFactory
     : public proxygen::RequestHandlerFactory {
  public:
   explicit HttpEndpointLatencyFilterFactory(http::HttpServer* httpServer)
-      : endpoints_(std::make_shared<std::unordered_map<
-                       proxygen::HTTPMethod,
-                       std::vector<std::unique_ptr<EndPoint>>>>(
+      : endpoints_(std::make_shared<HttpEndpointLatencyFilter::Endpoints>(
             httpServer->endpoints())) {}
 
   void onServerStart(folly::EventBase* /*evb*/) noexcept override {}
@@ -108,10 +143,7 @@ class HttpEndpointLatencyFilterFactory
   }
 
  private:
-  const std::shared_ptr<std::unordered_map<
-      proxygen::HTTPMethod,
-      std::vector<std::unique_ptr<EndPoint>>>>
-      endpoints_;
+  const std::shared_ptr<const HttpEndpointLatencyFilter::Endpoints> endpoints_;
 };
 
 } // namespace facebook::presto::http::filters
@@ -0,0 +1,209 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/http/filters/ResponseCompressionFilter.h"
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/http/HttpConstants.h"
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/base/StatsReporter.h"
+#include "velox/common/time/CpuWallTimer.h"
+
+namespace facebook::presto::http::filters {
+namespace {
+
+std::string_view codecName(folly::io::CodecType codec) {
+  switch (codec) {
+    case folly::io::CodecType::ZSTD:
+      return "zstd";
+    case folly::io::CodecType::GZIP:
+      return "gzip";
+    default:
+      VELOX_UNREACHABLE();
+  }
+}
+
+// Returns a codec of 'type' owned by the calling thread. Creating a codec
+// allocates its compression context, so reuse it across responses.
+folly::io::Codec* threadCodec(folly::io::CodecType type) {
+  thread_local std::array<
+      std::unique_ptr<folly::io::Codec>,
+      static_cast<size_t>(folly::io::CodecType::NUM_CODEC_TYPES)>
+      codecs;
+  auto& codec = codecs[static_cast<size_t>(type)];
+  if (codec == nullptr) {
+    codec = folly::io::getCodec(type, folly::io::COMPRESSION_LEVEL_FASTEST);
+  }
+  return codec.get();
+}
+
+// Returns the media type of a Content-Type header value without parameters,
+// e.g. "application/json" for "application/json; charset=utf-8".
+std::string_view mediaType(std::string_view contentType) {
+  return folly::trimWhitespace(contentType.substr(0, contentType.find(';')));
+}
+} // namespace
+
+ResponseCompressionFilter::ResponseCompressionFilter(
+    proxygen::RequestHandler* upstream,
+    std::shared_ptr<const Options> options)
+    : Filter(upstream), options_(std::move(options)) {}
+
+// static
+std::vector<folly::io::CodecType> ResponseCompressionFilter::parseCodecs(
+    const std::string& names) {
+  std::vector<std::string_view> parts;
+  folly::split(',', names, parts, true);
+  std::vector<folly::io::CodecType> codecs;
+  for (const auto& part : parts) {
+    const auto name = folly::trimWhitespace(part);
+    folly::io::CodecType codec;
+    if (name == "zstd") {
+      codec = folly::io::CodecType::ZSTD;
+    } else if (name == "gzip") {
+      codec = folly::io::CodecType::GZIP;
+    } else {
+      VELOX_USER_FAIL("Unsupported response compression codec: {}", name);
+    }
+    VELOX_USER_CHECK(
+        folly::io::hasCodec(codec),
+        "Response compression codec {} is not available",
+        name);
+    codecs.push_back(codec);
+  }
+  return codecs;
+}
+
+// static
+std::optional<folly::io::CodecType> ResponseCompressionFilter::selectCodec(
+    std::string_view acceptEncoding,
+    const std::vector<folly::io::CodecType>& codecs) {
+  std::vector<std::string_view> encodings;
+  folly::split(',', acceptEncoding, encodings, true);
+  for (const auto codec : codecs) {
+    for (const auto& encoding : encodings) {
+      std::vector<std::string_view> params;
+      folly::split(';', encoding, params);
+      const auto name = folly::trimWhitespace(params[0]);
+      if (name != "*" &&
+          !folly::caseInsensitiveEqual(name, codecName(codec))) {
+        continue;
+      }
+      // A zero quality value means "not acceptable".
+      bool rejected{false};
+      for (size_t i = 1; i < params.size(); ++i) {
+        const auto param = folly::trimWhitespace(params[i]);
+        if (param.size() > 2 && param.substr(0, 2) == "q=") {
+          rejected = folly::tryTo<double>(param.substr(2)).value_or(0) == 0;
+        }
+      }
+      if (!rejected) {
+        return codec;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+void ResponseCompressionFilter::onRequest(
+    std::unique_ptr<proxygen::HTTPMessage> msg) noexcept {
+  const auto& acceptEncoding = msg->getHeaders().getSingleOrEmpty(
+      proxygen::HTTP_HEADER_ACCEPT_ENCODING);
+  if (!acceptEncoding.empty()) {
+    codec_ = selectCodec(acceptEncoding, options_->codecs);
+  }
+  Filter::onRequest(std::move(msg));
+}
+
+bool ResponseCompressionFilter::shouldCompress(
+    const proxygen::HTTPMessage& msg) const {
+  if (!codec_.has_value() || msg.getStatusCode() != http::kHttpOk ||
+      msg.getIsChunked()) {
+    return false;
+  }
+  const auto& headers = msg.getHeaders();
+  if (headers.exists(proxygen::HTTP_HEADER_CONTENT_ENCODING)) {
+    return false;
+  }
+  const auto type =
+      mediaType(headers.getSingleOrEmpty(proxygen::HTTP_HEADER_CONTENT_TYPE));
+  return std::any_of(
+      options_->contentTypes.begin(),
+      options_->contentTypes.end(),
+      [&](const auto& contentType) {
+        return folly::caseInsensitiveEqual(type, contentType);
+      });
+}
+
+void ResponseCompressionFilter::sendHeaders(
+    proxygen::HTTPMessage& msg) noexcept {
+  if (!shouldCompress(msg)) {
+    Filter::sendHeaders(msg);
+    return;
+  }
+  headers_ = msg;
+}
+
+void ResponseCompressionFilter::sendBody(
+    std::unique_ptr<folly::IOBuf> body) noexcept {
+  if (!headers_.has_value()) {
+    Filter::sendBody(std::move(body));
+    return;
+  }
+  body_.append(std::move(body));
+}
+
+void ResponseCompressionFilter::sendEOM() noexcept {
+  if (!headers_.has_value()) {
+    Filter::sendEOM();
+    return;
+  }
+  auto body = body_.move();
+  const auto inputBytes = body == nullptr ? 0 : body->computeChainDataLength();
+  if (inputBytes >= options_->minSize) {
+    std::unique_ptr<folly::IOBuf> compressed;
+    velox::CpuWallTiming timing;
+    try {
+      velox::CpuWallTimer timer(timing);
+      compressed = threadCodec(*codec_)->compress(body.get());
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "Failed to compress response: " << e.what();
+    }
+    if (compressed != nullptr) {
+      const auto outputBytes = compressed->computeChainDataLength();
+      auto& headers = headers_->getHeaders();
+      headers.set(
+          proxygen::HTTP_HEADER_CONTENT_ENCODING,
+          std::string(codecName(*codec_)));
+      headers.set(
+          proxygen::HTTP_HEADER_CONTENT_LENGTH, std::to_string(outputBytes));
+      headers.add(proxygen::HTTP_HEADER_VARY, "Accept-Encoding");
+      body = std::move(compressed);
+      RECORD_METRIC_VALUE(kCounterHttpResponseNumCompressed, 1);
+      RECORD_METRIC_VALUE(
+          kCounterHttpResponseCompressionInputBytes, inputBytes);
+      RECORD_METRIC_VALUE(
+          kCounterHttpResponseCompressionOutputBytes, outputBytes);
+      RECORD_METRIC_VALUE(
+          kCounterHttpResponseCompressionCpuTimeUs, timing.cpuNanos / 1'000);
+    }
+  }
+  Filter::sendHeaders(*headers_);
+  if (body != nullptr) {
+    Filter::sendBody(std::move(body));
+  }
+  Filter::sendEOM();
+}
+
+} // namespace facebook::presto::http::filters
@@ -0,0 +1,102 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/compression/Compression.h>
+#include <folly/io/IOBufQueue.h>
+#include <proxygen/httpserver/Filters.h>
+#include <proxygen/httpserver/RequestHandlerFactory.h>
+
+namespace facebook::presto::http::filters {
+
+/// Compresses the responses of the content types in Options::contentTypes
+/// with the first codec in Options::codecs that the client accepts. Only
+/// complete, non-chunked 200 responses are compressed. Their body is buffered
+/// until EOM and sent uncompressed if smaller than Options::minSize. This is
+/// meant for the large JSON control-plane responses like TaskInfo, the data
+/// plane pages are already compressed by the serde and must not be listed.
+class ResponseCompressionFilter : public proxygen::Filter {
+ public:
+  struct Options {
+    /// Responses smaller than this are sent uncompressed.
+    uint64_t minSize{16 << 10};
+
+    /// Content types of the responses to compress, e.g. "application/json".
+    std::vector<std::string> contentTypes;
+
+    /// Codecs to use, in order of preference.
+    std::vector<folly::io::CodecType> codecs;
+  };
+
+  ResponseCompressionFilter(
+      proxygen::RequestHandler* upstream,
+      std::shared_ptr<const Options> options);
+
+  /// Parses a comma separated list of codec names ("zstd", "gzip"). Throws if
+  /// a codec is unknown or not available in this build.
+  static std::vector<folly::io::CodecType> parseCodecs(
+      const std::string& names);
+
+  /// Returns the first of 'codecs' accepted by the 'acceptEncoding' request
+  /// header value or std::nullopt if none is accepted.
+  static std::optional<folly::io::CodecType> selectCodec(
+      std::string_view acceptEncoding,
+      const std::vector<folly::io::CodecType>& codecs);
+
+  void onRequest(std::unique_ptr<proxygen::HTTPMessage> msg) noexcept override;
+
+  void sendHeaders(proxygen::HTTPMessage& msg) noexcept override;
+
+  void sendBody(std::unique_ptr<folly::IOBuf> body) noexcept override;
+
+  void sendEOM() noexcept override;
+
+ private:
+  bool shouldCompress(const proxygen::HTTPMessage& msg) const;
+
+  const std::shared_ptr<const Options> options_;
+
+  // The codec accepted by the client, if any.
+  std::optional<folly::io::CodecType> codec_;
+
+  // The response headers held back while the body of a response to compress
+  // is buffered.
+  std::optional<proxygen::HTTPMessage> headers_;
+  folly::IOBufQueue body_{folly::IOBufQueue::cacheChainLength()};
+};
+
+class ResponseCompressionFilterFactory
+    : public proxygen::RequestHandlerFactory {
+ public:
+  explicit ResponseCompressionFilterFactory(
+      ResponseCompressionFilter::Options options)
+      : options_(std::make_shared<const ResponseCompressionFilter::Options>(
+            std::move(options))) {}
+
+  void onServerStart(folly::EventBase* /*evb*/) noexcept override {}
+
+  void onServerStop() noexcept override {}
+
+  proxygen::RequestHandler* onRequest(
+      proxygen::RequestHandler* handler,
+      proxygen::HTTPMessage*) noexcept override {
+    return new ResponseCompressionFilter(handler, options_);
+  }
+
+ private:
+  const std::shared_ptr<const ResponseCompressionFilter::Options> options_;
+};
+
+} // namespace facebook::presto::http::filters
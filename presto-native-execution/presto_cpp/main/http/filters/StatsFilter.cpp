@@ -13,33 +13,220 @@
  */
 
 #include "presto_cpp/main/http/filters/StatsFilter.h"
+#include <folly/Synchronized.h>
+#include <algorithm>
+#include <map>
 #include "presto_cpp/main/common/Counters.h"
 #include "velox/common/base/StatsReporter.h"
+#include "velox/common/base/SuccinctPrinter.h"
 
 namespace facebook::presto::http::filters {
+namespace {
 
-StatsFilter::StatsFilter(proxygen::RequestHandler* upstream)
-    : Filter(upstream) {}
+// The gauges of all endpoints by name. The gauges are never freed, so the
+// filters and the endpoints can refer to them without synchronization.
+folly::Synchronized<
+    std::map<std::string, std::unique_ptr<StatsFilter::InFlightGauges>>>&
+gaugesRegistry() {
+  static folly::Synchronized<
+      std::map<std::string, std::unique_ptr<StatsFilter::InFlightGauges>>>
+      registry;
+  return registry;
+}
+
+StatsFilter::InFlightGauges* gaugesOf(const std::string& endpoint) {
+  return gaugesRegistry().withWLock([&](auto& registry) {
+    auto& gauges = registry[endpoint];
+    if (gauges == nullptr) {
+      gauges = std::make_unique<StatsFilter::InFlightGauges>();
+    }
+    return gauges.get();
+  });
+}
+
+// The in-flight response bytes of each thread which sent responses. Like the
+// gauges they outlive their threads, so a request can subtract its bytes
+// after the thread which sent them exited.
+folly::Synchronized<std::vector<std::unique_ptr<std::atomic<int64_t>>>>&
+threadResponseBytesRegistry() {
+  static folly::Synchronized<
+      std::vector<std::unique_ptr<std::atomic<int64_t>>>>
+      registry;
+  return registry;
+}
+
+std::atomic<int64_t>* threadResponseBytes() {
+  thread_local std::atomic<int64_t>* bytes{nullptr};
+  if (bytes == nullptr) {
+    bytes = threadResponseBytesRegistry().withWLock([](auto& registry) {
+      registry.push_back(std::make_unique<std::atomic<int64_t>>(0));
+      return registry.back().get();
+    });
+  }
+  return bytes;
+}
+} // namespace
+
+std::string StatsFilter::EndpointInFlightStats::toString() const {
+  return fmt::format(
+      "{{'{}' : {}(requests) {}(response bytes)}}",
+      endpoint,
+      numRequests,
+      velox::succinctBytes(responseBytes));
+}
+
+StatsFilter::Endpoints::Endpoints(const EndpointMap& endpoints)
+    : unrouted_(gaugesOf(std::string(kUnroutedEndpoint))) {
+  for (const auto& [method, methodEndpoints] : endpoints) {
+    auto& gauges = gauges_[method];
+    gauges.reserve(methodEndpoints.size());
+    for (const auto& endpoint : methodEndpoints) {
+      gauges.push_back(gaugesOf(endpointName(method, endpoint->pattern())));
+    }
+  }
+}
+
+StatsFilter::InFlightGauges* StatsFilter::Endpoints::gauges(
+    const proxygen::HTTPMessage& message) const {
+  const auto endpointId = getEndpointId(message);
+  if (!endpointId.has_value()) {
+    return unrouted_;
+  }
+  auto it = gauges_.find(message.getMethod().value());
+  if (it == gauges_.end() || endpointId.value() >= it->second.size()) {
+    return unrouted_;
+  }
+  return it->second[endpointId.value()];
+}
+
+StatsFilter::StatsFilter(
+    proxygen::RequestHandler* upstream,
+    std::shared_ptr<const Endpoints> endpoints)
+    : Filter(upstream), endpoints_(std::move(endpoints)) {}
+
+// static
+std::vector<StatsFilter::EndpointInFlightStats> StatsFilter::inFlightStats() {
+  std::vector<EndpointInFlightStats> stats;
+  gaugesRegistry().withRLock([&](const auto& registry) {
+    stats.reserve(registry.size());
+    for (const auto& [endpoint, gauges] : registry) {
+      stats.push_back(
+          {endpoint, gauges->numRequests.load(), gauges->responseBytes.load()});
+    }
+  });
+  return stats;
+}
+
+// static
+std::vector<int64_t> StatsFilter::threadInFlightResponseBytes() {
+  std::vector<int64_t> bytes;
+  threadResponseBytesRegistry().withRLock([&](const auto& registry) {
+    bytes.reserve(registry.size());
+    for (const auto& threadBytes : registry) {
+      bytes.push_back(threadBytes->load());
+    }
+  });
+  return bytes;
+}
+
+// static
+std::string StatsFilter::metricName(
+    const std::string& endpoint,
+    std::string_view stat) {
+  return fmt::format(
+      "presto_cpp.http.server.in_flight_{}.{}",
+      stat,
+      endpointMetricKey(endpoint));
+}
+
+// static
+void StatsFilter::registerMetrics(const EndpointMap& endpoints) {
+  std::vector<std::string> names{std::string(kUnroutedEndpoint)};
+  for (const auto& [method, methodEndpoints] : endpoints) {
+    for (const auto& endpoint : methodEndpoints) {
+      names.push_back(endpointName(method, endpoint->pattern()));
+    }
+  }
+  for (const auto& name : names) {
+    DEFINE_METRIC(metricName(name, "requests"), velox::StatType::AVG);
+    DEFINE_METRIC(metricName(name, "response_bytes"), velox::StatType::AVG);
+  }
+}
+
+// static
+void StatsFilter::reportMetrics(
+    const std::vector<EndpointInFlightStats>& stats) {
+  int64_t numRequests{0};
+  int64_t responseBytes{0};
+  for (const auto& endpointStats : stats) {
+    RECORD_METRIC_VALUE(
+        metricName(endpointStats.endpoint, "requests"),
+        endpointStats.numRequests);
+    RECORD_METRIC_VALUE(
+        metricName(endpointStats.endpoint, "response_bytes"),
+        endpointStats.responseBytes);
+    numRequests += endpointStats.numRequests;
+    responseBytes += endpointStats.responseBytes;
+  }
+  RECORD_METRIC_VALUE(kCounterHttpServerNumInFlightRequests, numRequests);
+  RECORD_METRIC_VALUE(kCounterHttpServerInFlightResponseBytes, responseBytes);
+
+  const auto threadBytes = threadInFlightResponseBytes();
+  RECORD_METRIC_VALUE(
+      kCounterHttpServerMaxThreadInFlightResponseBytes,
+      threadBytes.empty()
+          ? 0
+          : *std::max_element(threadBytes.begin(), threadBytes.end()));
+}
 
 void StatsFilter::onRequest(
     std::unique_ptr<proxygen::HTTPMessage> msg) noexcept {
   startTime_ = std::chrono::steady_clock::now();
   RECORD_METRIC_VALUE(kCounterNumHTTPRequest, 1);
+  gauges_ = endpoints_->gauges(*msg);
+  ++gauges_->numRequests;
   Filter::onRequest(std::move(msg));
 }
 
+void StatsFilter::sendBody(std::unique_ptr<folly::IOBuf> body) noexcept {
+  if (gauges_ != nullptr && body != nullptr) {
+    const int64_t bytes = body->computeChainDataLength();
+    if (threadResponseBytes_ == nullptr) {
+      threadResponseBytes_ = threadResponseBytes();
+    }
+    *threadResponseBytes_ += bytes;
+    gauges_->responseBytes += bytes;
+    responseBytes_ += bytes;
+  }
+  Filter::sendBody(std::move(body));
+}
+
 void StatsFilter::requestComplete() noexcept {
   RECORD_METRIC_VALUE(
       kCounterHTTPRequestLatencyMs,
       std::chrono::duration_cast<std::chrono::milliseconds>(
           std::chrono::steady_clock::now() - startTime_)
           .count());
-  delete this;
+  finish();
+  Filter::requestComplete();
 }
 
 void StatsFilter::onError(proxygen::ProxygenError err) noexcept {
   RECORD_METRIC_VALUE(kCounterNumHTTPRequestError, 1);
-  delete this;
+  finish();
+  Filter::onError(err);
+}
+
+void StatsFilter::finish() {
+  if (gauges_ == nullptr) {
+    return;
+  }
+  --gauges_->numRequests;
+  gauges_->responseBytes -= responseBytes_;
+  if (threadResponseBytes_ != nullptr) {
+    *threadResponseBytes_ -= responseBytes_;
+  }
+  gauges_ = nullptr;
 }
 
 } // namespace facebook::presto::http::filters
@@ -16,26 +16,113 @@
 
 #include <proxygen/httpserver/Filters.h>
 #include <proxygen/httpserver/RequestHandlerFactory.h>
+#include "presto_cpp/main/http/HttpServer.h"
 
 namespace facebook::presto::http::filters {
 
+/// Records the number of requests and their latency. Also tracks the requests
+/// in flight and the response bytes sent by them per endpoint and per thread,
+/// e.g. the number of outstanding results and status long-polls. The response
+/// bytes of a request count as in flight from sendBody() until the request
+/// completes.
 class StatsFilter : public proxygen::Filter {
  public:
-  explicit StatsFilter(proxygen::RequestHandler* upstream);
+  /// The requests in flight and their response bytes of an endpoint.
+  struct InFlightGauges {
+    std::atomic<int64_t> numRequests{0};
+    std::atomic<int64_t> responseBytes{0};
+  };
+
+  struct EndpointInFlightStats {
+    /// The endpoint with method and pattern, e.g. "GET /v1/task/(.+)/status".
+    std::string endpoint;
+    int64_t numRequests;
+    int64_t responseBytes;
+
+    std::string toString() const;
+  };
+
+  /// Name of the gauges of the requests not served by any endpoint.
+  static constexpr std::string_view kUnroutedEndpoint{"UNROUTED"};
+
+  using EndpointMap = std::unordered_map<
+      proxygen::HTTPMethod,
+      std::vector<std::unique_ptr<EndPoint>>>;
+
+  /// The gauges of the endpoints the server is listening on, in the order of
+  /// the endpoint ids set by the dispatcher.
+  class Endpoints {
+   public:
+    explicit Endpoints(const EndpointMap& endpoints);
+
+    /// Returns the gauges of the endpoint serving 'message'. The requests
+    /// without an endpoint id share the kUnroutedEndpoint gauges.
+    InFlightGauges* gauges(const proxygen::HTTPMessage& message) const;
+
+   private:
+    std::unordered_map<proxygen::HTTPMethod, std::vector<InFlightGauges*>>
+        gauges_;
+    InFlightGauges* const unrouted_;
+  };
+
+  StatsFilter(
+      proxygen::RequestHandler* upstream,
+      std::shared_ptr<const Endpoints> endpoints);
+
+  /// Returns the in-flight stats of all endpoints which served requests since
+  /// the server started, sorted by endpoint.
+  static std::vector<EndpointInFlightStats> inFlightStats();
+
+  /// Returns the response bytes in flight per thread which sent responses.
+  static std::vector<int64_t> threadInFlightResponseBytes();
+
+  /// Returns the name of the exported metric of 'endpoint', e.g.
+  /// "GET /v1/task/(.+)/status", for 'stat' which is "requests" or
+  /// "response_bytes".
+  static std::string metricName(
+      const std::string& endpoint,
+      std::string_view stat);
+
+  /// Registers the exported in-flight metrics of 'endpoints'.
+  static void registerMetrics(const EndpointMap& endpoints);
+
+  /// Exports 'stats' and their totals through the stats reporter.
+  static void reportMetrics(const std::vector<EndpointInFlightStats>& stats);
 
   void onRequest(std::unique_ptr<proxygen::HTTPMessage> msg) noexcept override;
 
+  void sendBody(std::unique_ptr<folly::IOBuf> body) noexcept override;
+
   void requestComplete() noexcept override;
 
   void onError(proxygen::ProxygenError err) noexcept override;
 
  private:
+  // Removes this request from the in-flight gauges.
+  void finish();
+
+  const std::shared_ptr<const Endpoints> endpoints_;
+
   std::chrono::steady_clock::time_point startTime_;
+
+  // The gauges of the endpoint of this request. Set on onRequest().
+  InFlightGauges* gauges_{nullptr};
+
+  // The in-flight response bytes of the thread which sent the first body of
+  // this request.
+  std::atomic<int64_t>* threadResponseBytes_{nullptr};
+
+  // The response bytes of this request counted in the gauges.
+  int64_t responseBytes_{0};
 };
 
 class StatsFilterFactory : public proxygen::RequestHandlerFactory {
  public:
-  explicit StatsFilterFactory() {}
+  /// If 'httpServer' is null, all requests are counted as unrouted.
+  explicit StatsFilterFactory(http::HttpServer* httpServer = nullptr)
+      : endpoints_(std::make_shared<const StatsFilter::Endpoints>(
+            httpServer == nullptr ? StatsFilter::EndpointMap{}
+                                  : httpServer->endpoints())) {}
 
   void onServerStart(folly::EventBase* /*evb*/) noexcept override {}
 
@@ -44,8 +131,11 @@ class StatsFilterFactory : public proxygen::RequestHandlerFactory {
   proxygen::RequestHandler* onRequest(
       proxygen::RequestHandler* handler,
       proxygen::HTTPMessage*) noexcept override {
-    return new StatsFilter(handler);
+    return new StatsFilter(handler, endpoints_);
   }
+
+ private:
+  const std::shared_ptr<const StatsFilter::Endpoints> endpoints_;
 };
 
 } // namespace facebook::presto::http::filters
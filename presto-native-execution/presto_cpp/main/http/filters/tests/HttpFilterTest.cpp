@@ -14,8 +14,14 @@
 
 #include <folly/init/Init.h>
 #include <gtest/gtest.h>
+#include <proxygen/httpserver/Mocks.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
 #include "presto_cpp/main/http/HttpServer.h"
+#include "presto_cpp/main/http/filters/AccessLogWriter.h"
 #include "presto_cpp/main/http/filters/HttpEndpointLatencyFilter.h"
+#include "presto_cpp/main/http/filters/StatsFilter.h"
 
 using namespace facebook::presto::http::filters;
 using namespace facebook::presto::http;
@@ -41,27 +47,52 @@ class DummyRequestHandler : public proxygen::RequestHandler {
 namespace {
 // Builds endpoint map for all methods specified by 'methods'. 'size' specifies
 // the number of endpoints for each method.
-std::shared_ptr<std::unordered_map<
-    proxygen::HTTPMethod,
-    std::vector<std::unique_ptr<EndPoint>>>>
-buildEndpoints(
+std::shared_ptr<const HttpEndpointLatencyFilter::Endpoints> buildEndpoints(
     const std::vector<proxygen::HTTPMethod>& methods,
     uint64_t size) {
-  std::shared_ptr<std::unordered_map<
-      proxygen::HTTPMethod,
-      std::vector<std::unique_ptr<EndPoint>>>>
-      result = std::make_shared<std::unordered_map<
-          proxygen::HTTPMethod,
-          std::vector<std::unique_ptr<EndPoint>>>>(methods.size());
+  HttpEndpointLatencyFilter::EndpointMap result(methods.size());
   for (const auto& method : methods) {
-    (*result)[method] = std::vector<std::unique_ptr<EndPoint>>();
-    auto& endpoints = result->at(method);
+    auto& endpoints = result[method];
     for (uint32_t i = 0; i < size; ++i) {
       endpoints.emplace_back(
           std::make_unique<EndPoint>(fmt::format("/v1/ep{}", i), nullptr));
     }
   }
-  return result;
+  return std::make_shared<HttpEndpointLatencyFilter::Endpoints>(
+      std::move(result));
+}
+
+// Returns an empty directory under the system temp directory.
+std::filesystem::path makeTempDirectory(const std::string& name) {
+  auto path = std::filesystem::temp_directory_path() /
+      fmt::format("{}_{}", name, getpid());
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+  return path;
+}
+
+std::vector<std::string> readLines(const std::filesystem::path& path) {
+  std::vector<std::string> lines;
+  std::ifstream in(path);
+  for (std::string line; std::getline(in, line);) {
+    lines.push_back(std::move(line));
+  }
+  return lines;
+}
+
+AccessLogRecord makeAccessLogRecord(const std::string& url) {
+  AccessLogRecord record;
+  record.timeMs = 1'700'000'000'000;
+  record.latencyMs = 12;
+  record.bytesSent = 345;
+  record.statusCode = 200;
+  AccessLogRecord::set(record.remoteAddr, "10.0.0.1");
+  AccessLogRecord::set(record.method, "GET");
+  AccessLogRecord::set(record.version, "HTTP/1.1");
+  AccessLogRecord::set(record.url, url);
+  AccessLogRecord::set(record.referer, "-");
+  AccessLogRecord::set(record.userAgent, "test");
+  return record;
 }
 
 std::unique_ptr<proxygen::HTTPMessage> buildRequestMsg(
@@ -116,6 +147,12 @@ TEST_F(HttpFilterTest, testEndpointLatencyFilter) {
     ASSERT_GT(metrics.avgLatencyUs, 0);
     ASSERT_LE(metrics.avgLatencyUs, metrics.maxLatencyUs);
     ASSERT_GT(metrics.count, 0);
+    // The requests took at least 500ms. The percentiles are accurate to 1/8.
+    ASSERT_GE(metrics.p50LatencyUs, 500'000 * 7 / 8);
+    ASSERT_LE(metrics.p50LatencyUs, metrics.p90LatencyUs);
+    ASSERT_LE(metrics.p90LatencyUs, metrics.p99LatencyUs);
+    ASSERT_LE(metrics.p99LatencyUs, metrics.p999LatencyUs);
+    ASSERT_LE(metrics.p999LatencyUs, metrics.maxLatencyUs);
   }
 }
 
@@ -161,3 +198,161 @@ TEST_F(HttpFilterTest, testConcurrentEndpointLatencyFilter) {
     ASSERT_EQ(metrics.count, numRequests / 2);
   }
 }
+
+TEST_F(HttpFilterTest, endpointLatencyMetricName) {
+  ASSERT_EQ(
+      HttpEndpointLatencyFilter::metricName("GET /v1/task/status", "p99"),
+      "presto_cpp.http_endpoint_latency_us.get_v1_task_status.p99");
+  ASSERT_EQ(
+      HttpEndpointLatencyFilter::metricName("GET /v1/task/(.+)/status", "p50"),
+      "presto_cpp.http_endpoint_latency_us.get_v1_task_x_status.p50");
+  ASSERT_EQ(
+      HttpEndpointLatencyFilter::metricName(
+          "GET /v1/task/(.+)/results/([0-9]+)/([0-9]+)", "p999"),
+      "presto_cpp.http_endpoint_latency_us.get_v1_task_x_results_x_x.p999");
+  ASSERT_EQ(
+      HttpEndpointLatencyFilter::metricName("GET /v1/operation/.*", "p90"),
+      "presto_cpp.http_endpoint_latency_us.get_v1_operation.p90");
+}
+
+TEST_F(HttpFilterTest, statsFilterInFlight) {
+  StatsFilter::EndpointMap endpointMap;
+  auto& getEndpoints = endpointMap[proxygen::HTTPMethod::GET];
+  getEndpoints.emplace_back(
+      std::make_unique<EndPoint>("/v1/task/(.+)/status", nullptr));
+  getEndpoints.emplace_back(
+      std::make_unique<EndPoint>("/v1/task/(.+)/results", nullptr));
+  const auto endpoints =
+      std::make_shared<const StatsFilter::Endpoints>(endpointMap);
+
+  const auto inFlight = [](const std::string& endpoint) {
+    for (const auto& stats : StatsFilter::inFlightStats()) {
+      if (stats.endpoint == endpoint) {
+        return std::make_pair(stats.numRequests, stats.responseBytes);
+      }
+    }
+    return std::make_pair<int64_t, int64_t>(0, 0);
+  };
+  const std::string status = "GET /v1/task/(.+)/status";
+  const std::string results = "GET /v1/task/(.+)/results";
+  const std::string unrouted(StatsFilter::kUnroutedEndpoint);
+  const auto baseUnrouted = inFlight(unrouted);
+
+  DummyRequestHandler handler;
+  testing::NiceMock<proxygen::MockResponseHandler> downstream(&handler);
+  std::vector<StatsFilter*> filters;
+  for (size_t i = 0; i < 5; ++i) {
+    auto msg = buildRequestMsg(proxygen::HTTPMethod::GET, "/v1/task/t/x");
+    // The first 2 requests go to the status endpoint, the next 2 to the
+    // results endpoint and the last one is not routed.
+    setEndpointId(
+        *msg, i < 4 ? std::make_optional<size_t>(i / 2) : std::nullopt);
+    filters.push_back(new StatsFilter(&handler, endpoints));
+    filters.back()->setResponseHandler(&downstream);
+    filters.back()->onRequest(std::move(msg));
+  }
+  ASSERT_EQ(inFlight(status), std::make_pair<int64_t, int64_t>(2, 0));
+  ASSERT_EQ(inFlight(results), std::make_pair<int64_t, int64_t>(2, 0));
+  ASSERT_EQ(inFlight(unrouted).first, baseUnrouted.first + 1);
+
+  filters[2]->sendBody(folly::IOBuf::copyBuffer(std::string(100, 'x')));
+  filters[3]->sendBody(folly::IOBuf::copyBuffer(std::string(20, 'x')));
+  filters[3]->sendBody(folly::IOBuf::copyBuffer(std::string(30, 'x')));
+  ASSERT_EQ(inFlight(results), std::make_pair<int64_t, int64_t>(2, 150));
+  const auto threadBytes = StatsFilter::threadInFlightResponseBytes();
+  ASSERT_EQ(*std::max_element(threadBytes.begin(), threadBytes.end()), 150);
+
+  filters[0]->requestComplete();
+  filters[2]->requestComplete();
+  ASSERT_EQ(inFlight(status), std::make_pair<int64_t, int64_t>(1, 0));
+  ASSERT_EQ(inFlight(results), std::make_pair<int64_t, int64_t>(1, 50));
+
+  filters[1]->onError(proxygen::ProxygenError());
+  filters[3]->onError(proxygen::ProxygenError());
+  filters[4]->requestComplete();
+  ASSERT_EQ(inFlight(status), std::make_pair<int64_t, int64_t>(0, 0));
+  ASSERT_EQ(inFlight(results), std::make_pair<int64_t, int64_t>(0, 0));
+  ASSERT_EQ(inFlight(unrouted), baseUnrouted);
+  for (const auto bytes : StatsFilter::threadInFlightResponseBytes()) {
+    ASSERT_EQ(bytes, 0);
+  }
+
+  ASSERT_EQ(
+      StatsFilter::metricName(status, "requests"),
+      "presto_cpp.http.server.in_flight_requests.get_v1_task_x_status");
+  ASSERT_EQ(
+      StatsFilter::metricName(unrouted, "response_bytes"),
+      "presto_cpp.http.server.in_flight_response_bytes.unrouted");
+}
+
+TEST_F(HttpFilterTest, accessLogWriter) {
+  const auto dir = makeTempDirectory("accessLogWriter");
+  AccessLogWriter::Options options;
+  options.filePath = (dir / "access.log").string();
+  AccessLogWriter writer(options);
+  constexpr int kNumRecords = 100;
+  for (int i = 0; i < kNumRecords; ++i) {
+    writer.write(makeAccessLogRecord(fmt::format("/v1/task/{}", i)));
+  }
+  writer.flush();
+
+  const auto lines = readLines(options.filePath);
+  ASSERT_EQ(lines.size(), kNumRecords);
+  for (int i = 0; i < kNumRecords; ++i) {
+    ASSERT_EQ(lines[i].find("10.0.0.1 - - ["), 0) << lines[i];
+    const auto request =
+        fmt::format("] \"GET /v1/task/{} HTTP/1.1\" 200 345 - test 12", i);
+    ASSERT_EQ(lines[i].substr(lines[i].size() - request.size()), request);
+  }
+
+  // Long values are truncated.
+  std::string line;
+  AccessLogWriter::format(makeAccessLogRecord(std::string(1'000, 'x')), line);
+  ASSERT_NE(line.find(std::string(255, 'x')), std::string::npos);
+  ASSERT_EQ(line.find(std::string(256, 'x')), std::string::npos);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_F(HttpFilterTest, accessLogWriterRotation) {
+  const auto dir = makeTempDirectory("accessLogWriterRotation");
+  AccessLogWriter::Options options;
+  options.filePath = (dir / "access.log").string();
+  options.maxFileSize = 1'000;
+  options.maxFiles = 2;
+  options.maxBatchSize = 1;
+  {
+    AccessLogWriter writer(options);
+    for (int i = 0; i < 100; ++i) {
+      writer.write(makeAccessLogRecord("/v1/info"));
+    }
+    writer.flush();
+  }
+  ASSERT_TRUE(std::filesystem::exists(dir / "access.log"));
+  ASSERT_TRUE(std::filesystem::exists(dir / "access.log.1"));
+  ASSERT_TRUE(std::filesystem::exists(dir / "access.log.2"));
+  ASSERT_FALSE(std::filesystem::exists(dir / "access.log.3"));
+  ASSERT_LT(std::filesystem::file_size(dir / "access.log"), 1'000);
+  ASSERT_GE(std::filesystem::file_size(dir / "access.log.1"), 1'000);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_F(HttpFilterTest, accessLogWriterDrops) {
+  const auto dir = makeTempDirectory("accessLogWriterDrops");
+  AccessLogWriter::Options options;
+  options.filePath = (dir / "access.log").string();
+  options.queueSize = 1;
+  const auto numDroppedBefore = AccessLogWriter::numDroppedRecords();
+  constexpr int kNumRecords = 10'000;
+  {
+    AccessLogWriter writer(options);
+    for (int i = 0; i < kNumRecords; ++i) {
+      writer.write(makeAccessLogRecord("/v1/info"));
+    }
+    writer.flush();
+  }
+  // Every record is either written or counted as dropped.
+  const auto numDropped =
+      AccessLogWriter::numDroppedRecords() - numDroppedBefore;
+  ASSERT_EQ(readLines(options.filePath).size() + numDropped, kNumRecords);
+  std::filesystem::remove_all(dir);
+}
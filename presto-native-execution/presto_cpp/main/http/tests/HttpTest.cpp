@@ -11,6 +11,9 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <fstream>
+#include "presto_cpp/main/http/filters/ResponseCompressionFilter.h"
 #include "presto_cpp/main/http/tests/HttpTestBase.h"
 
 int main(int argc, char** argv) {
@@ -168,6 +171,194 @@ TEST_P(HttpTestSuite, clientIdleSessions) {
   wrapper.stop();
 }
 
+TEST_P(HttpTestSuite, connectionPoolStats) {
+  auto memoryPool =
+      memory::MemoryManager::getInstance()->addLeafPool("connectionPoolStats");
+  const bool useHttps = GetParam();
+  auto server = getServer(useHttps);
+  server->registerGet("/ping", ping);
+  HttpServerWrapper wrapper(std::move(server));
+  auto address = wrapper.start().get();
+  folly::IOThreadPoolExecutor threadPool(1);
+  http::HttpClientConnectionPool::Options options;
+  options.streamWindowSize = 1 << 20;
+  options.sessionWindowSize = 10 << 20;
+  http::HttpClientConnectionPool connPool(options);
+  const proxygen::Endpoint endpoint(
+      address.getAddressStr(), address.getPort(), useHttps);
+  auto client = std::make_shared<http::HttpClient>(
+      threadPool.getEventBase(),
+      &connPool,
+      endpoint,
+      address,
+      std::chrono::seconds(1),
+      std::chrono::milliseconds(0),
+      memoryPool,
+      useHttps ? makeSslContext() : nullptr);
+  constexpr int kNumRequests = 3;
+  for (int i = 0; i < kNumRequests; ++i) {
+    auto response = sendGet(client.get(), "/ping").get(std::chrono::seconds(3));
+    ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+  }
+
+  const auto stats = connPool.stats().get();
+  ASSERT_EQ(stats.size(), 1);
+  ASSERT_EQ(
+      stats[0].endpoint,
+      fmt::format("{}:{}", address.getAddressStr(), address.getPort()));
+  ASSERT_EQ(stats[0].numSessionsCreated, 1);
+  ASSERT_EQ(stats[0].numSessionsReused, kNumRequests - 1);
+  ASSERT_EQ(stats[0].numActiveSessions + stats[0].numIdleSessions, 1);
+  ASSERT_EQ(stats[0].streamWindowSize, 1 << 20);
+  ASSERT_GT(connPool.endpointStats(endpoint)->rtt().count(), 0);
+
+  client.reset();
+  connPool.destroy();
+  threadPool.join();
+  wrapper.stop();
+}
+
+TEST_P(HttpTestSuite, connectionPoolWarmUp) {
+  auto memoryPool =
+      memory::MemoryManager::getInstance()->addLeafPool("connectionPoolWarmUp");
+  const bool useHttps = GetParam();
+  auto server = getServer(useHttps);
+  server->registerGet("/ping", ping);
+  HttpServerWrapper wrapper(std::move(server));
+  auto address = wrapper.start().get();
+  constexpr int kNumThreads = 2;
+  folly::IOThreadPoolExecutor threadPool(kNumThreads);
+  http::HttpClientConnectionPool::Options options;
+  options.warmUpConnectionsPerServer = 4;
+  http::HttpClientConnectionPool connPool(options);
+  const proxygen::Endpoint endpoint(
+      address.getAddressStr(), address.getPort(), useHttps);
+  auto sslContext = useHttps ? makeSslContext() : nullptr;
+  int numResolves{0};
+  const auto resolveAddress = [&]() {
+    ++numResolves;
+    return address;
+  };
+  connPool.warmUp(
+      endpoint,
+      resolveAddress,
+      sslContext,
+      std::chrono::seconds(1),
+      std::chrono::seconds(1),
+      &threadPool);
+  // One session per event base.
+  auto* endpointStats = connPool.endpointStats(endpoint);
+  while (endpointStats->numSessionsWarmedUp() < kNumThreads) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  // A repeated warm-up within the idle session timeout does nothing, not even
+  // resolve the address.
+  connPool.warmUp(
+      endpoint,
+      resolveAddress,
+      sslContext,
+      std::chrono::seconds(1),
+      std::chrono::seconds(1),
+      &threadPool);
+  ASSERT_EQ(numResolves, 1);
+
+  auto client = std::make_shared<http::HttpClient>(
+      threadPool.getEventBase(),
+      &connPool,
+      endpoint,
+      address,
+      std::chrono::seconds(1),
+      std::chrono::milliseconds(0),
+      memoryPool,
+      sslContext);
+  auto response = sendGet(client.get(), "/ping").get(std::chrono::seconds(3));
+  ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+
+  const auto stats = connPool.stats().get();
+  ASSERT_EQ(stats.size(), 1);
+  ASSERT_EQ(stats[0].numSessionsWarmedUp, kNumThreads);
+  ASSERT_EQ(stats[0].numSessionsCreated, kNumThreads);
+  ASSERT_EQ(stats[0].numSessionsReused, 1);
+  ASSERT_EQ(stats[0].numEventBases, kNumThreads);
+  ASSERT_EQ(stats[0].maxSessionsPerEventBase, 1);
+
+  client.reset();
+  connPool.destroy();
+  threadPool.join();
+  wrapper.stop();
+}
+
+TEST_P(HttpTestSuite, connectionPoolDestroyDuringWarmUp) {
+  const bool useHttps = GetParam();
+  folly::IOThreadPoolExecutor threadPool(2);
+  http::HttpClientConnectionPool::Options options;
+  options.warmUpConnectionsPerServer = 2;
+  // A non-routable address, the connects stay in progress until cancelled.
+  const folly::SocketAddress address("10.255.255.1", 8080);
+  for (int i = 0; i < 10; ++i) {
+    http::HttpClientConnectionPool connPool(options);
+    connPool.warmUp(
+        proxygen::Endpoint(
+            address.getAddressStr(), address.getPort(), useHttps),
+        [&]() { return address; },
+        useHttps ? makeSslContext() : nullptr,
+        std::chrono::seconds(60),
+        std::chrono::seconds(60),
+        &threadPool);
+    // The connects in progress are cancelled rather than completing into the
+    // destroyed pool.
+    connPool.destroy();
+  }
+  threadPool.join();
+}
+
+TEST(HttpClientConnectionPoolTest, adaptiveStreamWindow) {
+  using EndpointStats = http::HttpClientConnectionPool::EndpointStats;
+  using namespace std::chrono_literals;
+  constexpr uint32_t kInitialWindow = 1 << 20;
+  constexpr uint32_t kMaxWindow = 16 << 20;
+
+  EndpointStats fixedWindow(kInitialWindow, kInitialWindow);
+  fixedWindow.recordSessionCreated(10ms);
+  fixedWindow.recordTransfer(1'000'000'000, 1s);
+  ASSERT_EQ(fixedWindow.streamWindowSize(), kInitialWindow);
+
+  EndpointStats stats(kInitialWindow, kMaxWindow);
+  // No window change before the round trip time is known.
+  stats.recordTransfer(100'000'000, 1s);
+  ASSERT_EQ(stats.bandwidthBytesPerSec(), 100'000'000);
+  ASSERT_EQ(stats.streamWindowSize(), kInitialWindow);
+
+  // The shortest connect time is the round trip time.
+  stats.recordSessionCreated(2ms);
+  stats.recordSessionCreated(3ms);
+  ASSERT_EQ(stats.rtt(), 2ms);
+  ASSERT_EQ(stats.numSessionsCreated(), 2);
+
+  // 100MB/s x 2ms = 200KB, the window does not shrink.
+  stats.recordTransfer(100'000'000, 1s);
+  ASSERT_EQ(stats.streamWindowSize(), kInitialWindow);
+
+  // Small responses do not count.
+  stats.recordTransfer(1'000, 1us);
+  ASSERT_EQ(stats.bandwidthBytesPerSec(), 100'000'000);
+
+  // The average bandwidth goes to 1.2GB/s. 2 x 1.2GB/s x 2ms = 4.8MB.
+  stats.recordTransfer(1'700'000'000, 1s);
+  ASSERT_EQ(stats.bandwidthBytesPerSec(), 300'000'000);
+  for (int i = 0; i < 20; ++i) {
+    stats.recordTransfer(1'300'000'000, 1s);
+  }
+  ASSERT_GT(stats.streamWindowSize(), 4 << 20);
+  ASSERT_LT(stats.streamWindowSize(), 6 << 20);
+
+  // Capped by the max window.
+  EndpointStats farStats(kInitialWindow, kMaxWindow);
+  farStats.recordSessionCreated(100ms);
+  farStats.recordTransfer(1'000'000'000, 1s);
+  ASSERT_EQ(farStats.streamWindowSize(), kMaxWindow);
+}
+
 TEST_P(HttpTestSuite, httpResponseAllocationFailure) {
   const int64_t memoryCapBytes = 1 << 10;
   auto rootPool =
@@ -535,6 +726,238 @@ TEST_P(HttpTestSuite, testReportOnBodyStatsFunc) {
   wrapper.stop();
 }
 
+TEST_P(HttpTestSuite, responseCompression) {
+  auto memoryPool =
+      memory::MemoryManager::getInstance()->addLeafPool("responseCompression");
+  const bool useHttps = GetParam();
+  auto server = getServer(useHttps);
+
+  std::string largeBody;
+  for (int i = 0; i < 1'000; ++i) {
+    largeBody += fmt::format("{{\"taskId\": \"{}\"}}", i);
+  }
+  server->registerGet(
+      "/large",
+      [&](proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+          proxygen::ResponseHandler* downstream) {
+        http::sendOkResponse(downstream, largeBody);
+      });
+  server->registerGet(
+      "/small",
+      [](proxygen::HTTPMessage* /*message*/,
+         const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+         proxygen::ResponseHandler* downstream) {
+        http::sendOkResponse(downstream, std::string("{}"));
+      });
+  server->registerGet(R"(/echo.*)", echo);
+
+  http::filters::ResponseCompressionFilter::Options options;
+  options.minSize = 1'024;
+  options.contentTypes = {http::kMimeTypeApplicationJson};
+  options.codecs = {folly::io::CodecType::GZIP};
+  std::vector<std::unique_ptr<proxygen::RequestHandlerFactory>> filters;
+  filters.push_back(
+      std::make_unique<http::filters::ResponseCompressionFilterFactory>(
+          std::move(options)));
+  HttpServerWrapper wrapper(std::move(server));
+  wrapper.setFilters(filters);
+  auto serverAddress = wrapper.start().get();
+
+  HttpClientFactory clientFactory;
+  auto client = clientFactory.newClient(
+      serverAddress,
+      std::chrono::milliseconds(1'000),
+      std::chrono::milliseconds(0),
+      useHttps,
+      memoryPool);
+
+  const auto sendGetWithEncoding = [&](const std::string& url,
+                                       const std::string& acceptEncoding) {
+    return http::RequestBuilder()
+        .method(proxygen::HTTPMethod::GET)
+        .url(url)
+        .header(proxygen::HTTP_HEADER_ACCEPT_ENCODING, acceptEncoding)
+        .send(client.get())
+        .get();
+  };
+  const auto contentEncoding = [](http::HttpResponse& response) {
+    return response.headers()->getHeaders().getSingleOrEmpty(
+        proxygen::HTTP_HEADER_CONTENT_ENCODING);
+  };
+
+  {
+    auto response = sendGetWithEncoding("/large", "zstd, gzip;q=0.5");
+    ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+    ASSERT_EQ(contentEncoding(*response), "gzip");
+    const auto compressed = bodyAsString(*response, memoryPool.get());
+    ASSERT_LT(compressed.size(), largeBody.size() / 4);
+    ASSERT_EQ(
+        folly::io::getCodec(folly::io::CodecType::GZIP)
+            ->uncompress(compressed),
+        largeBody);
+
+    // The client does not accept gzip.
+    response = sendGetWithEncoding("/large", "zstd, gzip;q=0");
+    ASSERT_EQ(contentEncoding(*response), "");
+    ASSERT_EQ(bodyAsString(*response, memoryPool.get()), largeBody);
+
+    response = sendGet(client.get(), "/large").get();
+    ASSERT_EQ(contentEncoding(*response), "");
+    ASSERT_EQ(bodyAsString(*response, memoryPool.get()), largeBody);
+
+    // Below the size threshold.
+    response = sendGetWithEncoding("/small", "gzip");
+    ASSERT_EQ(contentEncoding(*response), "");
+    ASSERT_EQ(bodyAsString(*response, memoryPool.get()), "{}");
+
+    // Not a compressed content type.
+    const std::string url = "/echo/" + std::string(2'000, 'x');
+    response = sendGetWithEncoding(url, "gzip");
+    ASSERT_EQ(contentEncoding(*response), "");
+    ASSERT_EQ(bodyAsString(*response, memoryPool.get()), url);
+  }
+  wrapper.stop();
+}
+
+TEST_P(HttpTestSuite, fileResponse) {
+  auto memoryPool =
+      memory::MemoryManager::getInstance()->addLeafPool("fileResponse");
+  const bool useHttps = GetParam();
+  auto server = getServer(useHttps);
+
+  const auto directory = boost::filesystem::temp_directory_path() /
+      boost::filesystem::unique_path();
+  boost::filesystem::create_directories(directory);
+  std::string content;
+  for (int i = 0; content.size() < (3 << 20) + 100; ++i) {
+    content += fmt::format("{},", i);
+  }
+  std::ofstream((directory / "large").string(), std::ios::binary) << content;
+  std::ofstream((directory / "empty").string(), std::ios::binary);
+  folly::CPUThreadPoolExecutor executor(2);
+  server->registerGet(
+      R"(/files/(.+))",
+      [&](proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::string>& pathMatch) {
+        return new http::FileRequestHandler(
+            (directory / pathMatch[1]).string(),
+            http::kMimeTypeApplicationJson,
+            &executor,
+            64 << 10);
+      });
+  HttpServerWrapper wrapper(std::move(server));
+  auto serverAddress = wrapper.start().get();
+
+  HttpClientFactory clientFactory;
+  auto client = clientFactory.newClient(
+      serverAddress,
+      std::chrono::milliseconds(1'000),
+      std::chrono::milliseconds(0),
+      useHttps,
+      memoryPool);
+  {
+    auto response = sendGet(client.get(), "/files/large").get();
+    ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+    ASSERT_EQ(
+        response->headers()->getHeaders().getSingleOrEmpty(
+            proxygen::HTTP_HEADER_CONTENT_LENGTH),
+        std::to_string(content.size()));
+    ASSERT_EQ(bodyAsString(*response, memoryPool.get()), content);
+
+    response = sendGet(client.get(), "/files/empty").get();
+    ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+    ASSERT_EQ(bodyAsString(*response, memoryPool.get()), "");
+
+    response = sendGet(client.get(), "/files/missing").get();
+    ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpNotFound);
+  }
+  wrapper.stop();
+  boost::filesystem::remove_all(directory);
+}
+
+TEST(ResponseCompressionFilterTest, selectCodec) {
+  using http::filters::ResponseCompressionFilter;
+  const auto kZstd = folly::io::CodecType::ZSTD;
+  const auto kGzip = folly::io::CodecType::GZIP;
+  const std::vector<folly::io::CodecType> codecs{kZstd, kGzip};
+
+  EXPECT_EQ(ResponseCompressionFilter::selectCodec("gzip", codecs), kGzip);
+  EXPECT_EQ(
+      ResponseCompressionFilter::selectCodec("gzip, deflate, zstd", codecs),
+      kZstd);
+  EXPECT_EQ(
+      ResponseCompressionFilter::selectCodec("GZIP;q=0.8, zstd;q=0", codecs),
+      kGzip);
+  EXPECT_EQ(ResponseCompressionFilter::selectCodec("*", codecs), kZstd);
+  EXPECT_FALSE(
+      ResponseCompressionFilter::selectCodec("deflate, br", codecs)
+          .has_value());
+  EXPECT_FALSE(ResponseCompressionFilter::selectCodec("gzip", {kZstd})
+                   .has_value());
+  EXPECT_FALSE(ResponseCompressionFilter::selectCodec("", codecs).has_value());
+
+  EXPECT_EQ(
+      ResponseCompressionFilter::parseCodecs("gzip"),
+      std::vector<folly::io::CodecType>{kGzip});
+  EXPECT_TRUE(ResponseCompressionFilter::parseCodecs("").empty());
+  VELOX_ASSERT_THROW(
+      ResponseCompressionFilter::parseCodecs("gzip,lz77"),
+      "Unsupported response compression codec: lz77");
+}
+
+TEST(DispatchingRequestHandlerFactoryTest, route) {
+  http::DispatchingRequestHandlerFactory factory;
+  const auto get = proxygen::HTTPMethod::GET;
+  for (const auto* pattern :
+       {R"(/v1/task/(.+)/results/([0-9]+)/([0-9]+)/acknowledge)",
+        R"(/v1/task/status)",
+        R"(/v1/task/(.+)/status)",
+        R"(/v1/task/(.+)/results/([0-9]+)/([0-9]+))",
+        R"(/v1/task/(.+))"}) {
+    factory.registerEndPoint(get, pattern, nullptr);
+  }
+  factory.registerEndPoint(
+      proxygen::HTTPMethod::POST, R"(/v1/task/(.+))", nullptr);
+
+  std::vector<std::string> matches;
+  EXPECT_EQ(factory.route(get, "/v1/task/status", matches), 1);
+  EXPECT_EQ(matches, std::vector<std::string>{"/v1/task/status"});
+
+  // The first registered endpoint wins over the later ones that also match.
+  EXPECT_EQ(factory.route(get, "/v1/task/q.1.0.2.0/status", matches), 2);
+  EXPECT_EQ(
+      matches,
+      (std::vector<std::string>{"/v1/task/q.1.0.2.0/status", "q.1.0.2.0"}));
+
+  EXPECT_EQ(factory.route(get, "/v1/task/q.1.0.2.0/results/3/17", matches), 3);
+  EXPECT_EQ(
+      matches,
+      (std::vector<std::string>{
+          "/v1/task/q.1.0.2.0/results/3/17", "q.1.0.2.0", "3", "17"}));
+
+  EXPECT_EQ(factory.route(get, "/v1/task/q.1.0.2.0", matches), 4);
+  EXPECT_EQ(
+      factory.route(proxygen::HTTPMethod::POST, "/v1/task/q.1.0.2.0", matches),
+      0);
+
+  EXPECT_FALSE(factory.route(get, "/v1/info", matches).has_value());
+  EXPECT_FALSE(
+      factory.route(proxygen::HTTPMethod::PUT, "/v1/task/x", matches)
+          .has_value());
+
+  // The matched endpoint is passed to the filters of the request only.
+  proxygen::HTTPMessage message;
+  proxygen::HTTPMessage otherMessage;
+  EXPECT_FALSE(http::getEndpointId(message).has_value());
+  http::setEndpointId(message, 3);
+  EXPECT_EQ(http::getEndpointId(message), 3);
+  EXPECT_FALSE(http::getEndpointId(otherMessage).has_value());
+  http::setEndpointId(otherMessage, std::nullopt);
+  EXPECT_FALSE(http::getEndpointId(message).has_value());
+  EXPECT_FALSE(http::getEndpointId(otherMessage).has_value());
+}
+
 INSTANTIATE_TEST_CASE_P(
     HTTPTest,
     HttpTestSuite,
@@ -117,6 +117,11 @@ class BroadcastFactory {
       const std::unique_ptr<BroadcastFileInfo> fileInfo,
       velox::memory::MemoryPool* pool);
 
+  /// Regular expression matching the names of the files created by
+  /// createWriter().
+  static constexpr std::string_view kFileNamePattern{
+      R"(file_broadcast_[0-9a-f\-]+\.bin)"};
+
  private:
   const std::string basePath_;
   std::shared_ptr<velox::filesystems::FileSystem> fileSystem_;
@@ -14,13 +14,25 @@
 
 #include "presto_cpp/main/runtime-metrics/PrometheusStatsReporter.h"
 
+#include <folly/Synchronized.h>
+#include <folly/ThreadLocal.h>
+#include <folly/hash/Hash.h>
+#include <prometheus/client_metric.h>
 #include <prometheus/collectable.h>
 #include <prometheus/counter.h>
 #include <prometheus/gauge.h>
 #include <prometheus/histogram.h>
+#include <prometheus/metric_family.h>
 #include <prometheus/registry.h>
 #include <prometheus/summary.h>
 #include <prometheus/text_serializer.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <ostream>
+#include <streambuf>
 
 namespace facebook::presto::prometheus {
 
@@ -34,27 +46,391 @@ folly::Singleton<facebook::velox::BaseStatsReporter> reporter(
 
 static constexpr std::string_view kSummarySuffix("_summary");
 
+namespace {
+
+// Max number of metrics accumulated in per-thread shards. The metrics
+// registered beyond it are recorded in the Prometheus metrics.
+constexpr size_t kMaxShardedMetrics = 1024;
+
+// The summary quantiles of the sharded histograms are computed over the values
+// of about the last 'kSummaryWindow', like the max age and the age buckets of
+// the Prometheus summaries.
+constexpr std::chrono::seconds kSummaryWindow{60};
+constexpr int kSummaryAgeBuckets = 5;
+
+// A counter or histogram accumulated in per-thread shards.
+struct ShardedMetric {
+  // The sanitized metric name.
+  std::string name;
+  velox::StatType statType;
+  // The histogram buckets. A value falls into the first bucket whose upper
+  // bound is not less than the value or into an extra overflow bucket.
+  int64_t min{0};
+  int64_t bucketWidth{1};
+  std::vector<double> upperBounds;
+  std::vector<int32_t> pcts;
+
+  size_t numBuckets() const {
+    return statType == velox::StatType::HISTOGRAM ? upperBounds.size() + 1 : 0;
+  }
+
+  size_t bucketIndex(uint64_t value) const {
+    const auto signedValue = static_cast<int64_t>(
+        std::min<uint64_t>(value, std::numeric_limits<int64_t>::max()));
+    if (signedValue <= min) {
+      return 0;
+    }
+    return std::min<uint64_t>(
+        (signedValue - min - 1) / bucketWidth, upperBounds.size());
+  }
+};
+
+// Adds 'value' to 'cell'. Only the owning thread writes the cells of a shard,
+// so this needs no atomic read-modify-write.
+void add(std::atomic<uint64_t>& cell, uint64_t value) {
+  cell.store(
+      cell.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// The values of a metric recorded by one thread. Written by the owning thread
+// only and read concurrently by fetchMetrics(), hence the atomics.
+struct alignas(folly::hardware_destructive_interference_size) ShardValues {
+  explicit ShardValues(size_t numBuckets)
+      : buckets(std::make_unique<std::atomic<uint64_t>[]>(numBuckets)) {}
+
+  void increment(uint64_t value) {
+    add(sum, value);
+  }
+
+  void observe(size_t bucket, uint64_t value) {
+    add(buckets[bucket], 1);
+    add(count, 1);
+    add(sum, value);
+    if (value > max.load(std::memory_order_relaxed)) {
+      max.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  // The counter value or the sum of the histogram values.
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> max{0};
+  std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+};
+
+// Non-atomic values the per-thread values are merged into.
+struct MergedValues {
+  uint64_t sum{0};
+  uint64_t count{0};
+  uint64_t max{0};
+  std::vector<uint64_t> buckets;
+
+  void add(const ShardValues& values, size_t numBuckets) {
+    buckets.resize(numBuckets);
+    for (size_t i = 0; i < numBuckets; ++i) {
+      buckets[i] += values.buckets[i].load(std::memory_order_relaxed);
+    }
+    sum += values.sum.load(std::memory_order_relaxed);
+    count += values.count.load(std::memory_order_relaxed);
+    max = std::max(max, values.max.load(std::memory_order_relaxed));
+  }
+
+  void add(const MergedValues& other) {
+    buckets.resize(std::max(buckets.size(), other.buckets.size()));
+    for (size_t i = 0; i < other.buckets.size(); ++i) {
+      buckets[i] += other.buckets[i];
+    }
+    sum += other.sum;
+    count += other.count;
+    max = std::max(max, other.max);
+  }
+
+  // Returns the values recorded since 'earlier', a snapshot of the same
+  // metric. The max is not windowed.
+  MergedValues since(const MergedValues& earlier) const {
+    MergedValues window{sum - earlier.sum, count - earlier.count, max, buckets};
+    for (size_t i = 0; i < earlier.buckets.size(); ++i) {
+      window.buckets[i] -= earlier.buckets[i];
+    }
+    return window;
+  }
+
+  double percentile(const ShardedMetric& metric, double fraction) const {
+    if (count == 0) {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+    const auto rank = std::max<uint64_t>(1, std::ceil(fraction * count));
+    uint64_t cumulative{0};
+    for (size_t i = 0; i < metric.upperBounds.size(); ++i) {
+      cumulative += buckets[i];
+      if (cumulative >= rank) {
+        return std::min<double>(metric.upperBounds[i], max);
+      }
+    }
+    return max;
+  }
+};
+
+// The sharded metrics of a reporter by slot and the values of the threads
+// which exited.
+struct ShardedMetrics {
+  ShardedMetrics() {
+    // The shards read the metrics while more may be registered.
+    metrics.reserve(kMaxShardedMetrics);
+  }
+
+  std::vector<std::unique_ptr<ShardedMetric>> metrics;
+  folly::Synchronized<std::vector<MergedValues>> exited;
+};
+
+// The values of one thread. The values of a metric are allocated on its first
+// update and published to the readers with release semantics.
+struct Shard {
+  explicit Shard(ShardedMetrics* sharded) : sharded(sharded) {}
+
+  ~Shard() {
+    sharded->exited.withWLock([&](auto& exited) {
+      for (size_t slot = 0; slot < kMaxShardedMetrics; ++slot) {
+        auto* slotValues = values[slot].load(std::memory_order_acquire);
+        if (slotValues == nullptr) {
+          continue;
+        }
+        if (exited.size() <= slot) {
+          exited.resize(slot + 1);
+        }
+        exited[slot].add(*slotValues, sharded->metrics[slot]->numBuckets());
+        delete slotValues;
+      }
+    });
+  }
+
+  ShardValues& get(size_t slot) {
+    auto* slotValues = values[slot].load(std::memory_order_relaxed);
+    if (slotValues == nullptr) {
+      slotValues = new ShardValues(sharded->metrics[slot]->numBuckets());
+      values[slot].store(slotValues, std::memory_order_release);
+    }
+    return *slotValues;
+  }
+
+  void mergeInto(std::vector<MergedValues>& merged) const {
+    for (size_t slot = 0; slot < merged.size(); ++slot) {
+      if (auto* slotValues = values[slot].load(std::memory_order_acquire)) {
+        merged[slot].add(*slotValues, sharded->metrics[slot]->numBuckets());
+      }
+    }
+  }
+
+  ShardedMetrics* const sharded;
+  std::array<std::atomic<ShardValues*>, kMaxShardedMetrics> values{};
+};
+
+struct ShardTag {};
+
+// Strict so that a thread does not exit while fetchMetrics() merges the
+// shards, which would count its values twice or not at all.
+using Shards = folly::ThreadLocal<Shard, ShardTag, folly::AccessModeStrict>;
+
+// Appends the serialized metrics to a string. Saves the copy of the result of
+// an std::ostringstream. The put area is the unused tail of the string, so
+// that the stream writes into it directly. The string is trimmed to the
+// written size on destruction.
+class StringAppendBuffer : public std::streambuf {
+ public:
+  explicit StringAppendBuffer(std::string& out) : out_(out) {
+    grow(out_.size(), 0);
+  }
+
+  ~StringAppendBuffer() override {
+    out_.resize(written());
+  }
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    grow(written(), 1);
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+  }
+
+  std::streamsize xsputn(const char* data, std::streamsize size) override {
+    if (epptr() - pptr() < size) {
+      grow(written(), size);
+    }
+    std::memcpy(pptr(), data, size);
+    setp(pptr() + size, epptr());
+    return size;
+  }
+
+ private:
+  size_t written() const {
+    return pptr() - out_.data();
+  }
+
+  // Makes room for at least 'size' more chars after the 'used' ones.
+  void grow(size_t used, size_t size) {
+    out_.resize(std::max<size_t>(
+        {used + size, out_.capacity(), 2 * out_.size(), kMinSize}));
+    setp(out_.data() + used, out_.data() + out_.size());
+  }
+
+  static constexpr size_t kMinSize = 4096;
+
+  std::string& out_;
+};
+
+::prometheus::ClientMetric newClientMetric(
+    const ::prometheus::Labels& labels) {
+  ::prometheus::ClientMetric metric;
+  for (const auto& [name, value] : labels) {
+    metric.label.push_back({name, value});
+  }
+  return metric;
+}
+} // namespace
+
 struct PrometheusStatsReporter::PrometheusImpl {
-  explicit PrometheusImpl(const ::prometheus::Labels& labels) {
+  PrometheusImpl(const ::prometheus::Labels& labels, bool sharded)
+      : sharded(sharded) {
     registry = std::make_shared<::prometheus::Registry>();
     for (const auto& itr : labels) {
       this->labels[itr.first] = itr.second;
     }
   }
 
+  // Returns the slot of a new sharded metric or std::nullopt if the metrics
+  // are not sharded.
+  std::optional<size_t> addShardedMetric(ShardedMetric metric) {
+    if (!sharded) {
+      return std::nullopt;
+    }
+    auto& metrics = shardedMetrics.metrics;
+    if (metrics.size() >= kMaxShardedMetrics) {
+      LOG(WARNING) << "Too many sharded metrics, not sharding " << metric.name;
+      return std::nullopt;
+    }
+    metrics.push_back(std::make_unique<ShardedMetric>(std::move(metric)));
+    return metrics.size() - 1;
+  }
+
+  // Merges the shards of all threads into metric families. The summary
+  // quantiles cover the values recorded since the newest snapshot which is at
+  // least 'kSummaryWindow' old at 'now', or all values if there is none. Not
+  // thread safe, called under the scrape cache lock.
+  std::vector<::prometheus::MetricFamily> collectShardedMetrics(
+      std::chrono::steady_clock::time_point now) {
+    const auto& metrics = shardedMetrics.metrics;
+    std::vector<MergedValues> merged(metrics.size());
+    {
+      auto accessor = shards.accessAllThreads();
+      for (const auto& shard : accessor) {
+        shard.mergeInto(merged);
+      }
+      shardedMetrics.exited.withRLock([&](const auto& exited) {
+        for (size_t slot = 0; slot < exited.size(); ++slot) {
+          merged[slot].add(exited[slot]);
+        }
+      });
+    }
+
+    while (snapshots.size() > 1 &&
+           now - snapshots[1].time >= kSummaryWindow) {
+      snapshots.pop_front();
+    }
+    const std::vector<MergedValues>* windowStart =
+        !snapshots.empty() && now - snapshots.front().time >= kSummaryWindow
+        ? &snapshots.front().values
+        : nullptr;
+
+    std::vector<::prometheus::MetricFamily> families;
+    for (size_t slot = 0; slot < metrics.size(); ++slot) {
+      const auto& metric = *metrics[slot];
+      auto& values = merged[slot];
+      if (metric.statType == velox::StatType::COUNT) {
+        auto counter = newClientMetric(labels);
+        counter.counter.value = values.sum;
+        families.push_back(
+            {metric.name, "", ::prometheus::MetricType::Counter, {counter}});
+        continue;
+      }
+      values.buckets.resize(metric.numBuckets());
+      auto histogram = newClientMetric(labels);
+      histogram.histogram.sample_count = values.count;
+      histogram.histogram.sample_sum = values.sum;
+      uint64_t cumulative{0};
+      for (size_t i = 0; i < metric.upperBounds.size(); ++i) {
+        cumulative += values.buckets[i];
+        histogram.histogram.bucket.push_back(
+            {cumulative, metric.upperBounds[i]});
+      }
+      histogram.histogram.bucket.push_back(
+          {values.count, std::numeric_limits<double>::infinity()});
+      families.push_back(
+          {metric.name,
+           "",
+           ::prometheus::MetricType::Histogram,
+           {std::move(histogram)}});
+
+      if (metric.pcts.empty()) {
+        continue;
+      }
+      const auto window = windowStart != nullptr && slot < windowStart->size()
+          ? values.since((*windowStart)[slot])
+          : values;
+      auto summary = newClientMetric(labels);
+      summary.summary.sample_count = values.count;
+      summary.summary.sample_sum = values.sum;
+      for (auto pct : metric.pcts) {
+        summary.summary.quantile.push_back(
+            {pct / 100.0, window.percentile(metric, pct / 100.0)});
+      }
+      families.push_back(
+          {metric.name + std::string(kSummarySuffix),
+           "",
+           ::prometheus::MetricType::Summary,
+           {std::move(summary)}});
+    }
+
+    if (snapshots.empty() ||
+        now - snapshots.back().time >= kSummaryWindow / kSummaryAgeBuckets) {
+      snapshots.push_back({now, std::move(merged)});
+    }
+    return families;
+  }
+
+  // The merged values of the sharded metrics at a collection.
+  struct Snapshot {
+    std::chrono::steady_clock::time_point time;
+    std::vector<MergedValues> values;
+  };
+
   ::prometheus::Labels labels;
   std::shared_ptr<::prometheus::Registry> registry;
+  const bool sharded;
+  ShardedMetrics shardedMetrics;
+  // Oldest first, at least 'kSummaryWindow' / 'kSummaryAgeBuckets' apart. Only
+  // the newest snapshot older than 'kSummaryWindow' is kept of the old ones.
+  std::deque<Snapshot> snapshots;
+  // Declared last so that the shards are merged into 'shardedMetrics' when
+  // destroyed.
+  Shards shards{[this]() { return new Shard(&shardedMetrics); }};
 };
 
 PrometheusStatsReporter::PrometheusStatsReporter(
-    const std::map<std::string, std::string>& labels) {
-  impl_ = std::make_shared<PrometheusImpl>(labels);
+    const std::map<std::string, std::string>& labels,
+    bool sharded,
+    std::chrono::milliseconds scrapeCacheTtl)
+    : scrapeCacheTtl_(scrapeCacheTtl) {
+  impl_ = std::make_shared<PrometheusImpl>(labels, sharded);
 }
 
 void PrometheusStatsReporter::registerMetricExportType(
     const char* key,
     facebook::velox::StatType statType) const {
-  if (registeredMetricsMap_.count(key)) {
+  if (findMetric(key) != nullptr) {
     VLOG(1) << "Trying to register already registered metric " << key;
     return;
   }
@@ -63,6 +439,11 @@ void PrometheusStatsReporter::registerMetricExportType(
   std::replace(sanitizedMetricKey.begin(), sanitizedMetricKey.end(), '.', '_');
   switch (statType) {
     case facebook::velox::StatType::COUNT: {
+      if (auto slot = impl_->addShardedMetric({sanitizedMetricKey, statType})) {
+        registeredMetricsMap_.emplace(
+            std::string(key), StatsInfo{statType, nullptr, nullptr, slot});
+        break;
+      }
       // A new MetricFamily object is built for every new metric key.
       auto& counterFamily = ::prometheus::BuildCounter()
                                 .Name(sanitizedMetricKey)
@@ -99,7 +480,7 @@ void PrometheusStatsReporter::registerHistogramMetricExportType(
     int64_t min,
     int64_t max,
     const std::vector<int32_t>& pcts) const {
-  if (registeredMetricsMap_.count(key)) {
+  if (findMetric(key) != nullptr) {
     // Already registered;
     VLOG(1) << "Trying to register already registered metric " << key;
     return;
@@ -110,10 +491,6 @@ void PrometheusStatsReporter::registerHistogramMetricExportType(
   // '.' is replaced with '_'.
   std::replace(sanitizedMetricKey.begin(), sanitizedMetricKey.end(), '.', '_');
 
-  auto& histogramFamily = ::prometheus::BuildHistogram()
-                              .Name(sanitizedMetricKey)
-                              .Register(*impl_->registry);
-
   ::prometheus::Histogram::BucketBoundaries bucketBoundaries;
   while (numBuckets > 0) {
     bucketBoundaries.push_back(bound);
@@ -121,10 +498,25 @@ void PrometheusStatsReporter::registerHistogramMetricExportType(
     numBuckets--;
   }
   VELOX_CHECK_GE(bucketBoundaries.size(), 1);
+
+  if (auto slot = impl_->addShardedMetric(
+          {sanitizedMetricKey,
+           velox::StatType::HISTOGRAM,
+           min,
+           bucketWidth,
+           bucketBoundaries,
+           pcts})) {
+    registeredMetricsMap_.emplace(
+        key, StatsInfo{velox::StatType::HISTOGRAM, nullptr, nullptr, slot});
+    return;
+  }
+
+  auto& histogramFamily = ::prometheus::BuildHistogram()
+                              .Name(sanitizedMetricKey)
+                              .Register(*impl_->registry);
   auto& histogramMetric = histogramFamily.Add(impl_->labels, bucketBoundaries);
 
-  registeredMetricsMap_.emplace(
-      key, StatsInfo{velox::StatType::HISTOGRAM, &histogramMetric});
+  StatsInfo statsInfo{velox::StatType::HISTOGRAM, &histogramMetric};
   // If percentiles are provided, create a Summary type metric and register.
   if (pcts.size() > 0) {
     auto summaryMetricKey = sanitizedMetricKey + std::string(kSummarySuffix);
@@ -137,10 +529,9 @@ void PrometheusStatsReporter::registerHistogramMetricExportType(
           ::prometheus::detail::CKMSQuantiles::Quantile(pct / (double)100, 0));
     }
     auto& summaryMetric = summaryFamily.Add({impl_->labels}, quantiles);
-    registeredMetricsMap_.emplace(
-        std::string(key).append(kSummarySuffix),
-        StatsInfo{velox::StatType::HISTOGRAM, &summaryMetric});
+    statsInfo.summaryPtr = &summaryMetric;
   }
+  registeredMetricsMap_.emplace(key, statsInfo);
 }
 
 void PrometheusStatsReporter::registerHistogramMetricExportType(
@@ -153,44 +544,114 @@ void PrometheusStatsReporter::registerHistogramMetricExportType(
       key.toString().c_str(), bucketWidth, min, max, pcts);
 }
 
-void PrometheusStatsReporter::addMetricValue(
-    const std::string& key,
-    size_t value) const {
-  addMetricValue(key.c_str(), value);
+const StatsInfo* PrometheusStatsReporter::findMetric(
+    folly::StringPiece key) const {
+  auto it = registeredMetricsMap_.find(key);
+  return it == registeredMetricsMap_.end() ? nullptr : &it->second;
 }
 
-void PrometheusStatsReporter::addMetricValue(const char* key, size_t value)
-    const {
-  auto metricIterator = registeredMetricsMap_.find(key);
-  if (metricIterator == registeredMetricsMap_.end()) {
-    VLOG(1) << "addMetricValue called for unregistered metric " << key;
-    return;
+const StatsInfo* PrometheusStatsReporter::findInternedMetric(
+    folly::StringPiece key) const {
+  const auto hash =
+      folly::hash::twang_mix64(reinterpret_cast<uintptr_t>(key.data()));
+  for (size_t i = 0; i < kMaxInternedKeyProbes; ++i) {
+    auto& entry = internedKeys_[(hash + i) % kMaxInternedKeys];
+    const auto state = entry.state.load(std::memory_order_acquire);
+    if (state == InternedKey::kReady) {
+      // Compare the contents too in case 'key' is not a constant and another
+      // key lived at its address before.
+      if (entry.data == key.data() && key == folly::StringPiece(*entry.key)) {
+        return entry.info;
+      }
+      continue;
+    }
+    if (state == InternedKey::kWriting) {
+      continue;
+    }
+    auto it = registeredMetricsMap_.find(key);
+    if (it == registeredMetricsMap_.end()) {
+      return nullptr;
+    }
+    auto expected = InternedKey::kEmpty;
+    if (entry.state.compare_exchange_strong(
+            expected, InternedKey::kWriting, std::memory_order_acquire)) {
+      entry.data = key.data();
+      entry.key = &it->first;
+      entry.info = &it->second;
+      entry.state.store(InternedKey::kReady, std::memory_order_release);
+    }
+    return &it->second;
   }
-  auto statsInfo = metricIterator->second;
-  switch (statsInfo.statType) {
+  // The probed slots are taken.
+  return findMetric(key);
+}
+
+void PrometheusStatsReporter::recordValue(const StatsInfo& info, size_t value)
+    const {
+  switch (info.statType) {
     case velox::StatType::COUNT: {
-      auto counter =
-          reinterpret_cast<::prometheus::Counter*>(statsInfo.metricPtr);
+      if (info.slot.has_value()) {
+        impl_->shards->get(info.slot.value()).increment(value);
+        break;
+      }
+      auto counter = reinterpret_cast<::prometheus::Counter*>(info.metricPtr);
       counter->Increment(value);
     } break;
     case velox::StatType::SUM:
     case velox::StatType::AVG:
     case velox::StatType::RATE: {
       // Overrides the existing state.
-      auto gauge = reinterpret_cast<::prometheus::Gauge*>(statsInfo.metricPtr);
+      auto gauge = reinterpret_cast<::prometheus::Gauge*>(info.metricPtr);
       gauge->Set(value);
     } break;
     default:
       VELOX_UNSUPPORTED(
-          "Unsupported metric type {}",
-          velox::statTypeString(statsInfo.statType));
+          "Unsupported metric type {}", velox::statTypeString(info.statType));
   };
 }
 
+void PrometheusStatsReporter::recordHistogramValue(
+    const StatsInfo& info,
+    size_t value) const {
+  if (info.slot.has_value()) {
+    const auto& metric = *impl_->shardedMetrics.metrics[info.slot.value()];
+    impl_->shards->get(info.slot.value())
+        .observe(metric.bucketIndex(value), value);
+    return;
+  }
+  auto histogram = reinterpret_cast<::prometheus::Histogram*>(info.metricPtr);
+  histogram->Observe(value);
+  if (info.summaryPtr != nullptr) {
+    auto summary = reinterpret_cast<::prometheus::Summary*>(info.summaryPtr);
+    summary->Observe(value);
+  }
+}
+
+void PrometheusStatsReporter::addMetricValue(
+    const std::string& key,
+    size_t value) const {
+  addMetricValue(key.c_str(), value);
+}
+
+void PrometheusStatsReporter::addMetricValue(const char* key, size_t value)
+    const {
+  const auto* info = findMetric(key);
+  if (info == nullptr) {
+    VLOG(1) << "addMetricValue called for unregistered metric " << key;
+    return;
+  }
+  recordValue(*info, value);
+}
+
 void PrometheusStatsReporter::addMetricValue(
     folly::StringPiece key,
     size_t value) const {
-  addMetricValue(key.toString().c_str(), value);
+  const auto* info = findInternedMetric(key);
+  if (info == nullptr) {
+    VLOG(1) << "addMetricValue called for unregistered metric " << key;
+    return;
+  }
+  recordValue(*info, value);
 }
 
 void PrometheusStatsReporter::addHistogramMetricValue(
@@ -202,37 +663,95 @@ void PrometheusStatsReporter::addHistogramMetricValue(
 void PrometheusStatsReporter::addHistogramMetricValue(
     const char* key,
     size_t value) const {
-  auto metricIterator = registeredMetricsMap_.find(key);
-  if (metricIterator == registeredMetricsMap_.end()) {
+  const auto* info = findMetric(key);
+  if (info == nullptr) {
     VLOG(1) << "addMetricValue for unregistered metric " << key;
     return;
   }
-  auto histogram = reinterpret_cast<::prometheus::Histogram*>(
-      metricIterator->second.metricPtr);
-  histogram->Observe(value);
-
-  std::string summaryKey = std::string(key).append(kSummarySuffix);
-  metricIterator = registeredMetricsMap_.find(summaryKey);
-  if (metricIterator != registeredMetricsMap_.end()) {
-    auto summary = reinterpret_cast<::prometheus::Summary*>(
-        metricIterator->second.metricPtr);
-    summary->Observe(value);
-  }
+  recordHistogramValue(*info, value);
 }
 
 void PrometheusStatsReporter::addHistogramMetricValue(
     folly::StringPiece key,
     size_t value) const {
-  addHistogramMetricValue(key.toString().c_str(), value);
+  const auto* info = findInternedMetric(key);
+  if (info == nullptr) {
+    VLOG(1) << "addMetricValue for unregistered metric " << key;
+    return;
+  }
+  recordHistogramValue(*info, value);
+}
+
+void PrometheusStatsReporter::setLabeledGaugeValues(
+    folly::StringPiece key,
+    std::string_view labelName,
+    const std::vector<std::pair<std::string, int64_t>>& values) const {
+  std::string sanitizedMetricKey = key.str();
+  // '.' is replaced with '_'.
+  std::replace(sanitizedMetricKey.begin(), sanitizedMetricKey.end(), '.', '_');
+  LabeledGauge gauge{std::string(labelName), values};
+  if (gauge.values.size() > kMaxLabelValues) {
+    LOG_EVERY_N(WARNING, 100) << "Dropping " << values.size() - kMaxLabelValues
+                              << " label values of " << key;
+    gauge.values.resize(kMaxLabelValues);
+  }
+  labeledGauges_.withWLock([&](auto& gauges) {
+    gauges[sanitizedMetricKey] = std::move(gauge);
+  });
 }
 
 std::string PrometheusStatsReporter::fetchMetrics() {
-  if (registeredMetricsMap_.empty()) {
-    return "";
+  return *fetchSerializedMetrics();
+}
+
+std::shared_ptr<const std::string>
+PrometheusStatsReporter::fetchSerializedMetrics() {
+  static const auto kEmpty = std::make_shared<const std::string>();
+  if (registeredMetricsMap_.empty() && labeledGauges_.rlock()->empty()) {
+    return kEmpty;
+  }
+  auto cache = scrapeCache_.lock();
+  const auto now = std::chrono::steady_clock::now();
+  if (scrapeCacheTtl_.count() == 0 || now - cache->time >= scrapeCacheTtl_ ||
+      cache->metrics == nullptr) {
+    const auto lastSize = cache->metrics ? cache->metrics->size() : 0;
+    auto metrics = std::make_shared<std::string>();
+    // The metrics are about as large as the last time.
+    metrics->reserve(lastSize + lastSize / 8);
+    serializeMetrics(*metrics, now);
+    cache->metrics = std::move(metrics);
+    cache->time = now;
   }
+  return cache->metrics;
+}
+
+void PrometheusStatsReporter::serializeMetrics(
+    std::string& out,
+    std::chrono::steady_clock::time_point now) {
+  StringAppendBuffer buffer(out);
+  std::ostream stream(&buffer);
   ::prometheus::TextSerializer serializer;
   // Registry::Collect() acquires lock on a mutex.
-  return serializer.Serialize(impl_->registry->Collect());
+  serializer.Serialize(stream, impl_->registry->Collect());
+  if (impl_->sharded) {
+    serializer.Serialize(stream, impl_->collectShardedMetrics(now));
+  }
+
+  std::vector<::prometheus::MetricFamily> labeledFamilies;
+  labeledGauges_.withRLock([&](const auto& gauges) {
+    for (const auto& [name, gauge] : gauges) {
+      ::prometheus::MetricFamily family{
+          name, "", ::prometheus::MetricType::Gauge, {}};
+      for (const auto& [labelValue, value] : gauge.values) {
+        auto metric = newClientMetric(impl_->labels);
+        metric.label.push_back({gauge.labelName, labelValue});
+        metric.gauge.value = value;
+        family.metric.push_back(std::move(metric));
+      }
+      labeledFamilies.push_back(std::move(family));
+    }
+  });
+  serializer.Serialize(stream, labeledFamilies);
 }
 
 }; // namespace facebook::presto::prometheus
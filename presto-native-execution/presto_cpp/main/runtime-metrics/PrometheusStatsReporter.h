@@ -12,7 +12,16 @@
  * limitations under the License.
  */
 
+#include <folly/Synchronized.h>
+#include <folly/container/F14Map.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <optional>
 #include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/common/LabeledStatsReporter.h"
 #include "velox/common/base/Exceptions.h"
 #include "velox/common/base/GTestMacros.h"
 #include "velox/common/base/StatsReporter.h"
@@ -22,6 +31,11 @@ namespace facebook::presto::prometheus {
 struct StatsInfo {
   velox::StatType statType;
   void* metricPtr;
+  /// The summary of a histogram registered with percentiles.
+  void* summaryPtr{nullptr};
+  /// Set if the metric is accumulated in per-thread shards, which is the slot
+  /// of the metric in the shards. 'metricPtr' is null then.
+  std::optional<size_t> slot;
 };
 
 /// Prometheus CPP library exposes following classes:
@@ -34,12 +48,38 @@ struct StatsInfo {
 /// For metric http_latency_ms labels could be {method="GET"}, {method="PUT"},
 /// {method="POST"} etc. Prometheus treats {<metric_name>, [labels]} as unique
 /// metric object.
-class PrometheusStatsReporter : public facebook::velox::BaseStatsReporter {
+///
+/// The metrics are resolved by the address of the keys passed as
+/// folly::StringPiece, which are the constant metric names like
+/// kCounterNumHTTPRequest. Recording such a metric does not hash or copy the
+/// key but probes a fixed table of interned key addresses.
+///
+/// If 'sharded' is set, the counters and histograms are accumulated in
+/// per-thread, cache line aligned shards instead of the Prometheus metrics,
+/// which are updated with atomic read-modify-writes and, for summaries, under
+/// a mutex per value. The shards are merged by fetchMetrics() and the summary
+/// quantiles are computed from the merged buckets, so they are accurate to the
+/// bucket width. Like the Prometheus summaries, the quantiles cover about the
+/// last 60s: fetchMetrics() keeps snapshots of the merged buckets and the
+/// quantiles cover the values since the newest snapshot at least 60s old. With
+/// scrapes further apart than that, they cover the time since the previous
+/// scrape. Gauges are set directly in either mode.
+///
+/// If 'scrapeCacheTtl' is set, the serialized metrics are reused by the
+/// fetchMetrics() calls within the TTL, so that frequent or concurrent scrapes
+/// do not each collect and serialize all metrics.
+///
+/// The labeled gauges of LabeledStatsReporter are exported with the labels of
+/// the reporter and their own label.
+class PrometheusStatsReporter : public facebook::velox::BaseStatsReporter,
+                                public LabeledStatsReporter {
   class PrometheusImpl;
 
  public:
   explicit PrometheusStatsReporter(
-      const std::map<std::string, std::string>& labels);
+      const std::map<std::string, std::string>& labels,
+      bool sharded = false,
+      std::chrono::milliseconds scrapeCacheTtl = std::chrono::milliseconds(0));
 
   void registerMetricExportType(const char* key, velox::StatType)
       const override;
@@ -75,8 +115,18 @@ class PrometheusStatsReporter : public facebook::velox::BaseStatsReporter {
   void addHistogramMetricValue(folly::StringPiece key, size_t value)
       const override;
 
+  void setLabeledGaugeValues(
+      folly::StringPiece key,
+      std::string_view labelName,
+      const std::vector<std::pair<std::string, int64_t>>& values)
+      const override;
+
   std::string fetchMetrics() override;
 
+  /// Like fetchMetrics() but shares the cached serialization instead of
+  /// copying it.
+  std::shared_ptr<const std::string> fetchSerializedMetrics();
+
   static std::unique_ptr<velox::BaseStatsReporter> createPrometheusReporter() {
     auto nodeConfig = NodeConfig::instance();
     const std::string cluster = nodeConfig->nodeEnvironment();
@@ -84,15 +134,74 @@ class PrometheusStatsReporter : public facebook::velox::BaseStatsReporter {
     const std::string worker = !hostName ? "" : hostName;
     std::map<std::string, std::string> labels{
         {"cluster", cluster}, {"worker", worker}};
-    return std::make_unique<PrometheusStatsReporter>(labels);
+    auto systemConfig = SystemConfig::instance();
+    return std::make_unique<PrometheusStatsReporter>(
+        labels,
+        systemConfig->runtimeMetricsShardedCollection(),
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            systemConfig->runtimeMetricsScrapeCacheTtl()));
   }
 
  private:
+  // A key interned by its address. 'state' is kEmpty, kWriting or kReady and
+  // the other fields are set before it becomes kReady.
+  struct InternedKey {
+    static constexpr uint8_t kEmpty = 0;
+    static constexpr uint8_t kWriting = 1;
+    static constexpr uint8_t kReady = 2;
+
+    std::atomic<uint8_t> state{kEmpty};
+    const char* data{nullptr};
+    const std::string* key{nullptr};
+    const StatsInfo* info{nullptr};
+  };
+
+  // The last serialized metrics.
+  struct ScrapeCache {
+    std::chrono::steady_clock::time_point time;
+    std::shared_ptr<const std::string> metrics;
+  };
+
+  struct LabeledGauge {
+    std::string labelName;
+    std::vector<std::pair<std::string, int64_t>> values;
+  };
+
+  static constexpr size_t kMaxInternedKeys = 2048;
+  static constexpr size_t kMaxInternedKeyProbes = 8;
+
+  // Returns the registered metric of 'key' or nullptr if not registered.
+  const StatsInfo* findMetric(folly::StringPiece key) const;
+
+  // Like findMetric() but looks up 'key' by its address first and interns it
+  // on the first call.
+  const StatsInfo* findInternedMetric(folly::StringPiece key) const;
+
+  void recordValue(const StatsInfo& info, size_t value) const;
+
+  void recordHistogramValue(const StatsInfo& info, size_t value) const;
+
+  // Serializes all metrics into 'out'. 'now' is the time of the scrape.
+  void serializeMetrics(
+      std::string& out,
+      std::chrono::steady_clock::time_point now);
+
   std::shared_ptr<PrometheusImpl> impl_;
   // A map of labels assigned to each metric which helps in filtering at client
-  // end.
-  mutable std::unordered_map<std::string, StatsInfo> registeredMetricsMap_;
+  // end. The metrics are registered at startup and never removed, so the
+  // interned keys can point into the nodes of the map.
+  mutable folly::F14NodeMap<std::string, StatsInfo> registeredMetricsMap_;
+  mutable std::array<InternedKey, kMaxInternedKeys> internedKeys_;
+  // The labeled gauges by sanitized name.
+  mutable folly::Synchronized<std::map<std::string, LabeledGauge>>
+      labeledGauges_;
+  const std::chrono::milliseconds scrapeCacheTtl_;
+  // Also held while serializing, so that concurrent scrapes wait for and reuse
+  // one serialization.
+  folly::Synchronized<ScrapeCache, std::mutex> scrapeCache_;
   VELOX_FRIEND_TEST(PrometheusReporterTest, testCountAndGauge);
   VELOX_FRIEND_TEST(PrometheusReporterTest, testHistogramSummary);
+  VELOX_FRIEND_TEST(PrometheusReporterTest, shardedCountAndHistogram);
+  VELOX_FRIEND_TEST(PrometheusReporterTest, shardedSummaryWindow);
 }; // class PrometheusReporter
 }; // namespace facebook::presto::prometheus
@@ -0,0 +1,126 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/runtime-metrics/PrometheusStatsReporter.h"
+
+using namespace facebook::presto;
+
+namespace {
+
+// Counters recorded on the exchange and http server hot paths.
+const std::vector<folly::StringPiece> kCounters{
+    kCounterNumHTTPRequest,
+    kCounterHttpClientPrestoExchangeNumOnBody,
+    kCounterHttpClientNumConnectionsCreated,
+    kCounterHttpResponseNumCompressed,
+    kCounterHttpFileResponseBytes,
+    kCounterHttpServerNumRejectedHighPriorityRequests,
+    kCounterHttpServerNumRejectedMediumPriorityRequests,
+    kCounterHttpServerNumRejectedLowPriorityRequests,
+};
+
+const std::vector<folly::StringPiece> kHistograms{
+    kCounterHttpClientPrestoExchangeOnBodyBytes,
+    kCounterExchangeDataResponseHandoffUs,
+    kCounterHttpServerResultsHandoffUs,
+};
+
+std::unique_ptr<prometheus::PrometheusStatsReporter> makeReporter(
+    bool sharded) {
+  auto reporter = std::make_unique<prometheus::PrometheusStatsReporter>(
+      std::map<std::string, std::string>{
+          {"cluster", "benchmark"}, {"worker", "worker"}},
+      sharded);
+  for (const auto& counter : kCounters) {
+    reporter->registerMetricExportType(
+        counter, facebook::velox::StatType::COUNT);
+  }
+  for (const auto& histogram : kHistograms) {
+    reporter->registerHistogramMetricExportType(
+        histogram, 1000, 0, 1'000'000, {50, 90, 95, 99, 100});
+  }
+  return reporter;
+}
+
+prometheus::PrometheusStatsReporter& reporter() {
+  static auto reporter = makeReporter(false);
+  return *reporter;
+}
+
+prometheus::PrometheusStatsReporter& shardedReporter() {
+  static auto reporter = makeReporter(true);
+  return *reporter;
+}
+
+// Returns 'keys' as std::string, which are looked up by hash.
+std::vector<std::string> toStrings(
+    const std::vector<folly::StringPiece>& keys) {
+  std::vector<std::string> strings;
+  for (const auto& key : keys) {
+    strings.push_back(key.str());
+  }
+  return strings;
+}
+
+} // namespace
+
+BENCHMARK(stringKey, n) {
+  static const auto keys = toStrings(kCounters);
+  for (uint32_t i = 0; i < n; ++i) {
+    reporter().addMetricValue(keys[i % keys.size()], i);
+  }
+}
+
+BENCHMARK_RELATIVE(internedKey, n) {
+  for (uint32_t i = 0; i < n; ++i) {
+    reporter().addMetricValue(kCounters[i % kCounters.size()], i);
+  }
+}
+
+BENCHMARK_RELATIVE(shardedInternedKey, n) {
+  for (uint32_t i = 0; i < n; ++i) {
+    shardedReporter().addMetricValue(kCounters[i % kCounters.size()], i);
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(stringHistogramKey, n) {
+  static const auto keys = toStrings(kHistograms);
+  for (uint32_t i = 0; i < n; ++i) {
+    reporter().addHistogramMetricValue(keys[i % keys.size()], i % 100'000);
+  }
+}
+
+BENCHMARK_RELATIVE(internedHistogramKey, n) {
+  for (uint32_t i = 0; i < n; ++i) {
+    reporter().addHistogramMetricValue(
+        kHistograms[i % kHistograms.size()], i % 100'000);
+  }
+}
+
+BENCHMARK_RELATIVE(shardedInternedHistogramKey, n) {
+  for (uint32_t i = 0; i < n; ++i) {
+    shardedReporter().addHistogramMetricValue(
+        kHistograms[i % kHistograms.size()], i % 100'000);
+  }
+}
+
+int main(int argc, char** argv) {
+  folly::Init init{&argc, &argv};
+  folly::runBenchmarks();
+  return 0;
+}
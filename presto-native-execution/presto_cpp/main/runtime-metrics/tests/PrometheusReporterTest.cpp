@@ -15,6 +15,7 @@
 #include "presto_cpp/main/runtime-metrics/PrometheusStatsReporter.h"
 
 #include <gtest/gtest.h>
+#include <thread>
 
 namespace facebook::presto::prometheus {
 class PrometheusReporterTest : public testing::Test {
@@ -151,4 +152,212 @@ TEST_F(PrometheusReporterTest, testHistogramSummary) {
       histSummaryKey + "_summary{" + labelsSerialized + ",quantile=\"1\"} 85"};
   verifySerializedResult(fullSerializedResult, histogramMetricsFormatted);
 }
+TEST_F(PrometheusReporterTest, internedKeys) {
+  constexpr folly::StringPiece kCountKey{"test.interned.count"};
+  constexpr folly::StringPiece kHistogramKey{"test.interned.histogram"};
+  reporter->registerMetricExportType(
+      kCountKey, facebook::velox::StatType::COUNT);
+  reporter->registerHistogramMetricExportType(kHistogramKey, 10, 0, 100, {50});
+  for (int i = 0; i < 10; ++i) {
+    reporter->addMetricValue(kCountKey, 2);
+    reporter->addHistogramMetricValue(kHistogramKey, 15);
+  }
+  // A key at the address of an interned key resolves by its contents.
+  std::string buffer = "test.interned.other";
+  reporter->registerMetricExportType(
+      buffer.c_str(), facebook::velox::StatType::AVG);
+  reporter->addMetricValue(folly::StringPiece(buffer), 7);
+  buffer = "test.interned.count";
+  reporter->addMetricValue(folly::StringPiece(buffer), 1);
+  buffer = "test.interned.unknown";
+  reporter->addMetricValue(folly::StringPiece(buffer), 1);
+
+  const auto serialized = reporter->fetchMetrics();
+  EXPECT_NE(
+      serialized.find("test_interned_count{" + labelsSerialized + "} 21"),
+      std::string::npos)
+      << serialized;
+  EXPECT_NE(
+      serialized.find("test_interned_other{" + labelsSerialized + "} 7"),
+      std::string::npos)
+      << serialized;
+  EXPECT_NE(
+      serialized.find(
+          "test_interned_histogram_count{" + labelsSerialized + "} 10"),
+      std::string::npos)
+      << serialized;
+  EXPECT_NE(
+      serialized.find(
+          "test_interned_histogram_summary_count{" + labelsSerialized +
+          "} 10"),
+      std::string::npos)
+      << serialized;
+  EXPECT_EQ(serialized.find("unknown"), std::string::npos);
+}
+
+TEST_F(PrometheusReporterTest, shardedCountAndHistogram) {
+  auto shardedReporter =
+      std::make_shared<PrometheusStatsReporter>(testLabels, true);
+  constexpr folly::StringPiece kCountKey{"test.sharded.count"};
+  constexpr folly::StringPiece kGaugeKey{"test.sharded.gauge"};
+  constexpr folly::StringPiece kHistogramKey{"test.sharded.histogram"};
+  shardedReporter->registerMetricExportType(
+      kCountKey, facebook::velox::StatType::COUNT);
+  shardedReporter->registerMetricExportType(
+      kGaugeKey, facebook::velox::StatType::AVG);
+  shardedReporter->registerHistogramMetricExportType(
+      kHistogramKey, 10, 0, 100, {50, 99, 100});
+  EXPECT_TRUE(shardedReporter->registeredMetricsMap_.find(kCountKey)
+                  ->second.slot.has_value());
+  EXPECT_FALSE(shardedReporter->registeredMetricsMap_.find(kGaugeKey)
+                   ->second.slot.has_value());
+
+  // Each thread records 20 x 20, 30 x 50 and 50 x 85 and exits before the
+  // fetch except for the values recorded by this thread.
+  constexpr int kNumThreads = 4;
+  auto record = [&]() {
+    for (int i = 0; i < 100; ++i) {
+      shardedReporter->addMetricValue(kCountKey, 2);
+      shardedReporter->addHistogramMetricValue(
+          kHistogramKey, i < 20 ? 20 : (i < 50 ? 50 : 85));
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads - 1; ++i) {
+    threads.emplace_back(record);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  record();
+  shardedReporter->addMetricValue(kGaugeKey, 7);
+
+  const auto serialized = shardedReporter->fetchMetrics();
+  const std::vector<std::string> expected = {
+      "test_sharded_count{" + labelsSerialized + "} 800",
+      "test_sharded_gauge{" + labelsSerialized + "} 7",
+      "test_sharded_histogram_count{" + labelsSerialized + "} 400",
+      "test_sharded_histogram_sum{" + labelsSerialized + "} 24600",
+      "test_sharded_histogram_bucket{" + labelsSerialized + ",le=\"10\"} 0",
+      "test_sharded_histogram_bucket{" + labelsSerialized + ",le=\"20\"} 80",
+      "test_sharded_histogram_bucket{" + labelsSerialized + ",le=\"50\"} 200",
+      "test_sharded_histogram_bucket{" + labelsSerialized + ",le=\"90\"} 400",
+      "test_sharded_histogram_bucket{" + labelsSerialized +
+          ",le=\"+Inf\"} 400",
+      "test_sharded_histogram_summary_count{" + labelsSerialized + "} 400",
+      "test_sharded_histogram_summary{" + labelsSerialized +
+          ",quantile=\"0.5\"} 50",
+      "test_sharded_histogram_summary{" + labelsSerialized +
+          ",quantile=\"0.99\"} 85",
+      "test_sharded_histogram_summary{" + labelsSerialized +
+          ",quantile=\"1\"} 85"};
+  for (const auto& line : expected) {
+    EXPECT_NE(serialized.find(line + "\n"), std::string::npos)
+        << line << " not in " << serialized;
+  }
+}
+
+TEST_F(PrometheusReporterTest, shardedSummaryWindow) {
+  auto shardedReporter =
+      std::make_shared<PrometheusStatsReporter>(testLabels, true);
+  constexpr folly::StringPiece kHistogramKey{"test.sharded.window"};
+  shardedReporter->registerHistogramMetricExportType(
+      kHistogramKey, 10, 0, 100, {50});
+  auto record = [&](size_t value) {
+    for (int i = 0; i < 100; ++i) {
+      shardedReporter->addHistogramMetricValue(kHistogramKey, value);
+    }
+  };
+  auto serialize = [&](std::chrono::steady_clock::time_point now) {
+    std::string serialized;
+    shardedReporter->serializeMetrics(serialized, now);
+    return serialized;
+  };
+  auto expectLine = [](const std::string& serialized,
+                       const std::string& line) {
+    EXPECT_NE(serialized.find(line + "\n"), std::string::npos)
+        << line << " not in " << serialized;
+  };
+  const auto median =
+      "test_sharded_window_summary{" + labelsSerialized + ",quantile=\"0.5\"} ";
+  const auto count =
+      "test_sharded_window_summary_count{" + labelsSerialized + "} ";
+
+  const auto start = std::chrono::steady_clock::now();
+  record(20);
+  expectLine(serialize(start), median + "20");
+
+  // No snapshot is a window old yet, so the quantiles cover all values.
+  record(85);
+  expectLine(serialize(start + std::chrono::seconds(30)), median + "20");
+
+  // The values before the first snapshot have left the window. The count and
+  // sum are not windowed.
+  const auto serialized = serialize(start + std::chrono::seconds(61));
+  expectLine(serialized, median + "85");
+  expectLine(serialized, count + "200");
+}
+
+TEST_F(PrometheusReporterTest, scrapeCache) {
+  auto cachingReporter = std::make_shared<PrometheusStatsReporter>(
+      testLabels, false, std::chrono::hours(1));
+  cachingReporter->registerMetricExportType(
+      "test.cached.count", facebook::velox::StatType::COUNT);
+  cachingReporter->addMetricValue("test.cached.count", 1);
+  const auto metrics = cachingReporter->fetchMetrics();
+  EXPECT_NE(
+      metrics.find("test_cached_count{" + labelsSerialized + "} 1\n"),
+      std::string::npos)
+      << metrics;
+
+  // The scrapes within the TTL see the cached metrics.
+  cachingReporter->addMetricValue("test.cached.count", 1);
+  EXPECT_EQ(cachingReporter->fetchMetrics(), metrics);
+  const auto shared = cachingReporter->fetchSerializedMetrics();
+  EXPECT_EQ(*shared, metrics);
+  EXPECT_EQ(cachingReporter->fetchSerializedMetrics(), shared);
+
+  // Without a TTL every scrape sees the latest values.
+  reporter->registerMetricExportType(
+      "test.cached.count", facebook::velox::StatType::COUNT);
+  reporter->addMetricValue("test.cached.count", 1);
+  EXPECT_EQ(reporter->fetchMetrics(), metrics);
+  reporter->addMetricValue("test.cached.count", 1);
+  EXPECT_NE(
+      reporter->fetchMetrics().find(
+          "test_cached_count{" + labelsSerialized + "} 2\n"),
+      std::string::npos);
+  const auto latest = reporter->fetchSerializedMetrics();
+  EXPECT_NE(reporter->fetchSerializedMetrics(), latest);
+}
+
+TEST_F(PrometheusReporterTest, labeledGauges) {
+  reporter->setLabeledGaugeValues(
+      "test.labeled.gauge", "query_id", {{"q1", 5}, {"q2", 3}});
+  auto serialized = reporter->fetchMetrics();
+  EXPECT_NE(
+      serialized.find("# TYPE test_labeled_gauge gauge\n"), std::string::npos)
+      << serialized;
+  EXPECT_NE(
+      serialized.find(
+          "test_labeled_gauge{" + labelsSerialized + ",query_id=\"q1\"} 5\n"),
+      std::string::npos)
+      << serialized;
+  EXPECT_NE(
+      serialized.find(
+          "test_labeled_gauge{" + labelsSerialized + ",query_id=\"q2\"} 3\n"),
+      std::string::npos)
+      << serialized;
+
+  // The label values not set again are no longer exported.
+  reporter->setLabeledGaugeValues(
+      "test.labeled.gauge", "query_id", {{"q3", 1}});
+  serialized = reporter->fetchMetrics();
+  EXPECT_EQ(serialized.find("q1"), std::string::npos) << serialized;
+  EXPECT_NE(
+      serialized.find(
+          "test_labeled_gauge{" + labelsSerialized + ",query_id=\"q3\"} 1\n"),
+      std::string::npos)
+      << serialized;
+}
 } // namespace facebook::presto::prometheus
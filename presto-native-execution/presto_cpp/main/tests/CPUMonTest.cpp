@@ -0,0 +1,160 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/CPUMon.h"
+#include <fmt/format.h>
+#include <folly/FileUtil.h>
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "velox/exec/tests/utils/TempDirectoryPath.h"
+
+namespace facebook::presto {
+namespace {
+
+class CPUMonTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = velox::exec::test::TempDirectoryPath::create();
+    procPath_ = dir_->getPath() + "/proc";
+    cgroupPath_ = dir_->getPath() + "/cgroup";
+    std::filesystem::create_directories(procPath_ + "/self");
+    std::filesystem::create_directories(cgroupPath_ + "/worker");
+  }
+
+  void writeFile(const std::string& path, const std::string& contents) {
+    ASSERT_TRUE(folly::writeFile(contents, path.c_str()));
+  }
+
+  // Writes /proc/stat with two cores. The host ticks are the sums of the
+  // core ticks.
+  void writeProcStat(
+      std::array<uint64_t, 2> busyTicks,
+      std::array<uint64_t, 2> idleTicks) {
+    writeFile(
+        procPath_ + "/stat",
+        fmt::format(
+            "cpu  {} 0 0 {} 0 0 0 0 0 0\n"
+            "cpu0 {} 0 0 {} 0 0 0 0 0 0\n"
+            "cpu1 {} 0 0 {} 0 0 0 0 0 0\n"
+            "intr 12345 0 0\n",
+            busyTicks[0] + busyTicks[1],
+            idleTicks[0] + idleTicks[1],
+            busyTicks[0],
+            idleTicks[0],
+            busyTicks[1],
+            idleTicks[1]));
+  }
+
+  void
+  writeCpuStat(uint64_t usageUs, uint64_t numThrottled, uint64_t throttledUs) {
+    writeFile(
+        cgroupPath_ + "/worker/cpu.stat",
+        fmt::format(
+            "usage_usec {}\nuser_usec 0\nsystem_usec 0\nnr_periods 10\n"
+            "nr_throttled {}\nthrottled_usec {}\n",
+            usageUs,
+            numThrottled,
+            throttledUs));
+  }
+
+  void writeCpuPressure(uint64_t someUs, uint64_t fullUs) {
+    writeFile(
+        cgroupPath_ + "/worker/cpu.pressure",
+        fmt::format(
+            "some avg10=0.00 avg60=0.00 avg300=0.00 total={}\n"
+            "full avg10=0.00 avg60=0.00 avg300=0.00 total={}\n",
+            someUs,
+            fullUs));
+  }
+
+  std::shared_ptr<velox::exec::test::TempDirectoryPath> dir_;
+  std::string procPath_;
+  std::string cgroupPath_;
+};
+
+TEST_F(CPUMonTest, coreLoads) {
+  CPUMon cpuMon(procPath_, cgroupPath_);
+  const auto start = std::chrono::steady_clock::now();
+  writeProcStat({100, 100}, {100, 100});
+  cpuMon.update(start);
+  ASSERT_EQ(cpuMon.getCPULoadPct(), 0);
+
+  // Core 0 is fully busy and core 1 is idle.
+  writeProcStat({200, 100}, {100, 200});
+  cpuMon.update(start + std::chrono::seconds(1));
+  const auto stats = cpuMon.stats();
+#ifdef __linux__
+  ASSERT_EQ(stats.cpuLoadPct, 50);
+  ASSERT_EQ(stats.coreLoadPct, std::vector<double>({100, 0}));
+  ASSERT_EQ(cpuMon.getCPULoadPct(), 50);
+  // Not in a cgroup.
+  ASSERT_FALSE(stats.cgroup.has_value());
+  ASSERT_EQ(cpuMon.getProcessCPULoadPct(), 50);
+#endif
+}
+
+TEST_F(CPUMonTest, cgroup) {
+  writeFile(procPath_ + "/self/cgroup", "0::/worker\n");
+  // The cgroup may use 1.5 cores.
+  writeFile(cgroupPath_ + "/worker/cpu.max", "150000 100000\n");
+  CPUMon cpuMon(procPath_, cgroupPath_);
+  const auto start = std::chrono::steady_clock::now();
+  writeProcStat({100, 100}, {100, 100});
+  writeCpuStat(1'000'000, 1, 1'000);
+  writeCpuPressure(5'000, 1'000);
+  cpuMon.update(start);
+
+  writeProcStat({200, 200}, {100, 100});
+  writeCpuStat(1'750'000, 4, 21'000);
+  writeCpuPressure(15'000, 3'000);
+  cpuMon.update(start + std::chrono::seconds(1));
+  const auto stats = cpuMon.stats();
+#ifdef __linux__
+  ASSERT_EQ(stats.cpuLoadPct, 100);
+  ASSERT_TRUE(stats.cgroup.has_value());
+  // 0.75 seconds of CPU in 1 second out of 1.5 cores.
+  ASSERT_EQ(stats.cgroup->cpuLimit, 1.5);
+  ASSERT_DOUBLE_EQ(stats.cgroup->cpuLoadPct, 50);
+  ASSERT_EQ(stats.cgroup->numThrottledPeriods, 3);
+  ASSERT_EQ(stats.cgroup->throttledUs, 20'000);
+  ASSERT_EQ(stats.cgroup->someStalledUs, 10'000);
+  ASSERT_EQ(stats.cgroup->fullStalledUs, 2'000);
+  ASSERT_DOUBLE_EQ(cpuMon.getProcessCPULoadPct(), 50);
+#endif
+}
+
+TEST_F(CPUMonTest, cgroupWithoutLimitOrPressure) {
+  writeFile(procPath_ + "/self/cgroup", "0::/worker\n");
+  writeFile(cgroupPath_ + "/worker/cpu.max", "max 100000\n");
+  CPUMon cpuMon(procPath_, cgroupPath_);
+  const auto start = std::chrono::steady_clock::now();
+  writeProcStat({100, 100}, {100, 100});
+  writeCpuStat(0, 0, 0);
+  cpuMon.update(start);
+
+  writeProcStat({200, 200}, {100, 100});
+  writeCpuStat(1'000'000, 0, 0);
+  cpuMon.update(start + std::chrono::seconds(1));
+  const auto stats = cpuMon.stats();
+#ifdef __linux__
+  ASSERT_TRUE(stats.cgroup.has_value());
+  // Without a limit the cgroup may use all the cores.
+  ASSERT_EQ(stats.cgroup->cpuLimit, 2);
+  ASSERT_DOUBLE_EQ(stats.cgroup->cpuLoadPct, 50);
+  ASSERT_FALSE(stats.cgroup->someStalledUs.has_value());
+  ASSERT_FALSE(stats.cgroup->fullStalledUs.has_value());
+#endif
+}
+
+} // namespace
+} // namespace facebook::presto
@@ -0,0 +1,146 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/CpuProfiler.h"
+#include <folly/String.h>
+#include <folly/system/ThreadName.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include "velox/common/base/tests/GTestUtils.h"
+#include "velox/common/process/ThreadDebugInfo.h"
+
+namespace facebook::presto {
+namespace {
+
+// Spins a thread named 'Spinner3' for the lifetime of the object. The thread
+// runs with the debug info of 'taskId' if not empty, as driver threads do.
+class Spinner {
+ public:
+  explicit Spinner(const std::string& taskId = "")
+      : thread_([this, taskId]() {
+          folly::setThreadName("Spinner3");
+          velox::process::ThreadDebugInfo debugInfo;
+          debugInfo.taskId_ = taskId;
+          std::optional<velox::process::ScopedThreadDebugInfo> scopedInfo;
+          if (!taskId.empty()) {
+            scopedInfo.emplace(debugInfo);
+          }
+          while (!stop_) {
+          }
+        }) {}
+
+  ~Spinner() {
+    stop_ = true;
+    thread_.join();
+  }
+
+ private:
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+// Returns the stacks of the folded 'profile' after checking its format.
+std::vector<std::string> parseFolded(const std::string& profile) {
+  std::vector<std::string> lines;
+  folly::split('\n', profile, lines, true);
+  std::vector<std::string> stacks;
+  for (const auto& line : lines) {
+    const auto space = line.rfind(' ');
+    EXPECT_NE(space, std::string::npos) << line;
+    EXPECT_GT(folly::to<uint64_t>(line.substr(space + 1)), 0) << line;
+    stacks.push_back(line.substr(0, space));
+  }
+  return stacks;
+}
+
+bool hasStackWithPrefix(
+    const std::vector<std::string>& stacks,
+    const std::string& prefix) {
+  return std::any_of(stacks.begin(), stacks.end(), [&](const auto& stack) {
+    return stack.rfind(prefix, 0) == 0;
+  });
+}
+} // namespace
+
+TEST(CpuProfilerTest, profile) {
+  Spinner spinner("test-task.0.0.1.0");
+  const auto stacks = parseFolded(
+      CpuProfiler::profile(std::chrono::milliseconds(500), 200));
+  ASSERT_FALSE(stacks.empty());
+  // The thread number is stripped and the task id follows the thread.
+  ASSERT_TRUE(hasStackWithPrefix(stacks, "Spinner;test-task.0.0.1.0;"));
+  ASSERT_FALSE(hasStackWithPrefix(stacks, "Spinner3"));
+}
+
+TEST(CpuProfilerTest, concurrentProfiles) {
+  std::thread profiler(
+      []() { CpuProfiler::profile(std::chrono::milliseconds(500), 100); });
+  // Wait for the first profile to start.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  VELOX_ASSERT_THROW(
+      CpuProfiler::profile(std::chrono::milliseconds(100), 100),
+      "A CPU profile is already in progress");
+  profiler.join();
+
+  VELOX_ASSERT_THROW(
+      CpuProfiler::profile(std::chrono::milliseconds(100), 0),
+      "CPU profiler frequency must be > 0");
+  VELOX_ASSERT_THROW(
+      CpuProfiler::profile(
+          std::chrono::milliseconds(100), CpuProfiler::kMaxFrequencyHz + 1),
+      "CPU profiler frequency is too high");
+}
+
+TEST(CpuProfilerTest, startAndFinish) {
+  CpuProfiler::startProfile(200);
+  // The second profile fails without waiting for the first one.
+  VELOX_ASSERT_THROW(
+      CpuProfiler::startProfile(100), "A CPU profile is already in progress");
+  std::string folded;
+  {
+    Spinner spinner;
+    folded = CpuProfiler::finishProfile(
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(500));
+  }
+  ASSERT_TRUE(hasStackWithPrefix(parseFolded(folded), "Spinner;"));
+
+  // The profile is stopped, another one can start.
+  CpuProfiler::startProfile(100);
+  CpuProfiler::finishProfile(std::chrono::steady_clock::now());
+}
+
+TEST(CpuProfilerTest, background) {
+  ASSERT_FALSE(CpuProfiler::backgroundEnabled());
+  CpuProfiler::setBackgroundFrequency(100);
+  ASSERT_TRUE(CpuProfiler::backgroundEnabled());
+  {
+    Spinner spinner;
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    CpuProfiler::collect();
+  }
+  auto stacks = parseFolded(CpuProfiler::backgroundProfile());
+  ASSERT_TRUE(hasStackWithPrefix(stacks, "Spinner;"));
+  ASSERT_FALSE(hasStackWithPrefix(stacks, "Spinner;test-task"));
+
+  // The profile is reset once fetched.
+  stacks = parseFolded(CpuProfiler::backgroundProfile());
+  ASSERT_FALSE(hasStackWithPrefix(stacks, "Spinner;"));
+
+  CpuProfiler::setBackgroundFrequency(0);
+  ASSERT_FALSE(CpuProfiler::backgroundEnabled());
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,151 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/InstrumentedExecutor.h"
+#include <folly/ScopeGuard.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/IOThreadPoolExecutor.h>
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <thread>
+
+namespace facebook::presto {
+
+TEST(InstrumentedExecutorTest, busyThreads) {
+  ExecutorStats::setTaskSampleRate(1);
+  SCOPE_EXIT {
+    ExecutorStats::setTaskSampleRate(0);
+  };
+  auto threadFactory =
+      std::make_shared<InstrumentedThreadFactory>("BusyThreadsTest");
+  auto* stats = threadFactory->stats().get();
+  InstrumentedExecutor<folly::CPUThreadPoolExecutor> executor(
+      threadFactory, 2);
+  ASSERT_EQ(executor.getName(), "BusyThreadsTest");
+
+  folly::Baton<> running[2];
+  folly::Baton<> release;
+  for (auto& baton : running) {
+    executor.add([&]() {
+      baton.post();
+      release.wait();
+    });
+  }
+  for (auto& baton : running) {
+    baton.wait();
+  }
+  auto sample = stats->sample();
+  ASSERT_EQ(sample.numThreads, 2);
+  ASSERT_EQ(sample.numBusyThreads, 2);
+
+  release.post();
+  executor.join();
+  sample = stats->sample();
+  ASSERT_EQ(sample.numThreads, 0);
+  ASSERT_EQ(sample.numBusyThreads, 0);
+}
+
+TEST(InstrumentedExecutorTest, taskStatsDisabled) {
+  ASSERT_EQ(ExecutorStats::taskSampleRate(), 0);
+  auto threadFactory =
+      std::make_shared<InstrumentedThreadFactory>("TaskStatsDisabledTest");
+  auto* stats = threadFactory->stats().get();
+  InstrumentedExecutor<folly::CPUThreadPoolExecutor> executor(
+      threadFactory, 1);
+
+  // The threads are sampled but the tasks are not counted.
+  folly::Baton<> running;
+  folly::Baton<> release;
+  executor.add([&]() {
+    running.post();
+    release.wait();
+  });
+  running.wait();
+  const auto sample = stats->sample();
+  ASSERT_EQ(sample.numThreads, 1);
+  ASSERT_EQ(sample.numBusyThreads, 0);
+  release.post();
+  executor.join();
+}
+
+TEST(InstrumentedExecutorTest, cpuUtilization) {
+  auto threadFactory =
+      std::make_shared<InstrumentedThreadFactory>("CpuUtilizationTest");
+  auto* stats = threadFactory->stats().get();
+  InstrumentedExecutor<folly::IOThreadPoolExecutor> executor(
+      threadFactory, 2);
+  stats->sample();
+
+  // Spin one of the two threads for 100ms. The event base runs the function
+  // directly, so only the CPU time of the thread shows the work.
+  folly::Baton<> done;
+  executor.getEventBase()->runInEventBaseThread([&]() {
+    const auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start <
+           std::chrono::milliseconds(100)) {
+    }
+    done.post();
+  });
+  done.wait();
+
+  // The other thread may not have started yet.
+  const auto sample = stats->sample();
+  ASSERT_GE(sample.numThreads, 1);
+#ifdef __linux__
+  ASSERT_GT(sample.maxThreadCpuUtilizationPct, 50);
+  ASSERT_LE(sample.cpuUtilizationPct, sample.maxThreadCpuUtilizationPct);
+#endif
+}
+
+TEST(InstrumentedExecutorTest, schedStats) {
+#ifdef __linux__
+  if (access("/proc/self/schedstat", R_OK) != 0) {
+    GTEST_SKIP() << "The kernel does not export the scheduler stats";
+  }
+  auto threadFactory =
+      std::make_shared<InstrumentedThreadFactory>("SchedStatsTest");
+  auto* stats = threadFactory->stats().get();
+  InstrumentedExecutor<folly::CPUThreadPoolExecutor> executor(
+      threadFactory, 1);
+  folly::Baton<> started;
+  executor.add([&]() { started.post(); });
+  started.wait();
+  stats->sample();
+
+  // Every sleep gives up the CPU.
+  folly::Baton<> done;
+  executor.add([&]() {
+    for (auto i = 0; i < 20; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    done.post();
+  });
+  done.wait();
+
+  const auto sample = stats->sample();
+  ASSERT_GE(sample.numVoluntaryContextSwitches, 20);
+  ASSERT_EQ(sample.threadRunQueueDelayUs.size(), 1);
+  ASSERT_GE(sample.runQueueDelayPct, 0);
+  ASSERT_LE(sample.runQueueDelayPct, 100);
+#endif
+}
+
+TEST(InstrumentedExecutorTest, sameStatsByName) {
+  auto first = std::make_shared<InstrumentedThreadFactory>("SameStatsTest");
+  auto second = std::make_shared<InstrumentedThreadFactory>("SameStatsTest");
+  ASSERT_EQ(first->stats(), second->stats());
+  ASSERT_EQ(ExecutorStats::get("SameStatsTest"), first->stats());
+}
+
+} // namespace facebook::presto
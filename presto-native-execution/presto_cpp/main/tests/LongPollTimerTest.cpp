@@ -0,0 +1,98 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/LongPollTimer.h"
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <gtest/gtest.h>
+
+namespace facebook::presto {
+
+class LongPollTimerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    executor_ = std::make_unique<folly::CPUThreadPoolExecutor>(4);
+    timer_ = std::make_unique<LongPollTimer>(
+        executor_.get(), std::chrono::milliseconds(10));
+  }
+
+  void TearDown() override {
+    timer_.reset();
+    executor_->join();
+  }
+
+  std::unique_ptr<folly::CPUThreadPoolExecutor> executor_;
+  std::unique_ptr<LongPollTimer> timer_;
+};
+
+TEST_F(LongPollTimerTest, batchedExpiry) {
+  constexpr int kNumCallbacks = 1'000;
+  std::atomic_int numExpired{0};
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kNumCallbacks; ++i) {
+    timer_->schedule(std::chrono::milliseconds(50), [&]() {
+      EXPECT_GE(
+          std::chrono::steady_clock::now() - start,
+          std::chrono::milliseconds(50));
+      ++numExpired;
+    });
+  }
+  // All the callbacks fall into at most a couple of buckets.
+  EXPECT_LE(timer_->numPendingBuckets(), 2);
+  EXPECT_EQ(timer_->numPendingCallbacks(), kNumCallbacks);
+
+  timer_->sleep(std::chrono::milliseconds(100)).wait();
+  EXPECT_EQ(numExpired, kNumCallbacks);
+  EXPECT_EQ(timer_->numPendingCallbacks(), 0);
+  EXPECT_EQ(timer_->numPendingBuckets(), 0);
+}
+
+TEST_F(LongPollTimerTest, onTimeout) {
+  // The future does not complete in time.
+  auto [promise, future] = folly::makePromiseContract<int>();
+  auto result = timer_->onTimeout(
+      std::move(future).via(executor_.get()),
+      std::chrono::milliseconds(20),
+      []() { return -1; });
+  EXPECT_EQ(std::move(result).get(std::chrono::seconds(5)), -1);
+  // Setting the value after the timeout is ignored.
+  promise.setValue(1);
+
+  // The future completes before the timeout.
+  auto [otherPromise, otherFuture] = folly::makePromiseContract<int>();
+  auto otherResult = timer_->onTimeout(
+      std::move(otherFuture).via(executor_.get()),
+      std::chrono::seconds(60),
+      []() { return -1; });
+  otherPromise.setValue(1);
+  EXPECT_EQ(std::move(otherResult).get(std::chrono::seconds(5)), 1);
+  EXPECT_EQ(timer_->numPendingCallbacks(), 1);
+}
+
+TEST_F(LongPollTimerTest, destroyWithPendingCallbacks) {
+  std::atomic_int numExpired{0};
+  timer_->schedule(std::chrono::seconds(60), [&]() { ++numExpired; });
+  auto sleepFuture = timer_->sleep(std::chrono::seconds(60));
+  auto [promise, future] = folly::makePromiseContract<int>();
+  auto result = timer_->onTimeout(
+      std::move(future).via(executor_.get()),
+      std::chrono::seconds(60),
+      []() { return -1; });
+
+  // The pending callbacks run early rather than breaking their promises.
+  timer_.reset();
+  EXPECT_EQ(numExpired, 1);
+  EXPECT_NO_THROW(std::move(sleepFuture).get(std::chrono::seconds(5)));
+  EXPECT_EQ(std::move(result).get(std::chrono::seconds(5)), -1);
+}
+
+} // namespace facebook::presto
@@ -45,6 +45,20 @@ class PeriodicMemoryCheckerTest : public testing::Test {
       mallocBytes_ = mallocBytes;
     }
 
+    void setSystemUsedMemoryBytes(int64_t systemUsedMemoryBytes) {
+      systemUsedMemoryBytes_ = systemUsedMemoryBytes;
+    }
+
+    void setCgroupMemoryStats(std::optional<CgroupMemoryStats> stats) {
+      cgroupMemoryStats_ = stats;
+    }
+
+    const std::vector<bool>& taskAdmissionPauses() const {
+      return taskAdmissionPauses_;
+    }
+
+    using PeriodicMemoryChecker::predictivePushback;
+
    protected:
     int64_t systemUsedMemoryBytes() override {
       return systemUsedMemoryBytes_;
@@ -69,11 +83,21 @@ class PeriodicMemoryCheckerTest : public testing::Test {
 
     void removeDumpFile(const std::string& filePath) const override {}
 
+    std::optional<CgroupMemoryStats> cgroupMemoryStats() override {
+      return cgroupMemoryStats_;
+    }
+
+    void pauseTaskAdmission(bool pause) override {
+      taskAdmissionPauses_.push_back(pause);
+    }
+
    private:
     int64_t systemUsedMemoryBytes_{0};
     int64_t mallocBytes_{0};
     std::function<void()> periodicCb_;
     std::function<bool(const std::string&)> heapDumpCb_;
+    std::optional<CgroupMemoryStats> cgroupMemoryStats_;
+    std::vector<bool> taskAdmissionPauses_;
   };
 };
 
@@ -224,4 +248,101 @@ TEST_F(PeriodicMemoryCheckerTest, pushbackMemory) {
   cache::AsyncDataCache::setInstance(nullptr);
   memory::MemoryManager::testingSetInstance({});
 }
+
+TEST_F(PeriodicMemoryCheckerTest, predictivePushback) {
+  memory::MemoryManager::testingSetInstance({});
+  constexpr int64_t kMB = 1L << 20;
+  // Limit of 1000MB, the pushback frees memory down to 900MB.
+  TestPeriodicMemoryChecker memChecker(PeriodicMemoryChecker::Config{
+      1'000,
+      true,
+      1'000 * kMB,
+      100 * kMB,
+      false,
+      5,
+      "",
+      "",
+      5,
+      512,
+      true,
+      10'000,
+      10});
+  auto actions = [&]() {
+    std::vector<std::string> actions;
+    for (const auto& event : memChecker.pushbackState()["events"]) {
+      actions.push_back(event["action"].asString());
+    }
+    return actions;
+  };
+
+  memChecker.setSystemUsedMemoryBytes(500 * kMB);
+  memChecker.predictivePushback(1'000);
+  ASSERT_TRUE(actions().empty());
+
+  // Growing by 50MB/s reaches 1050MB in 10s. A single prediction over the
+  // limit only shrinks the cache.
+  memChecker.setSystemUsedMemoryBytes(550 * kMB);
+  memChecker.predictivePushback(2'000);
+  ASSERT_EQ(actions(), std::vector<std::string>({"SHRINK_CACHE"}));
+  auto state = memChecker.pushbackState();
+  ASSERT_EQ(state["predictedBytes"].asInt(), 1'050 * kMB);
+  ASSERT_EQ(state["events"][0]["targetBytes"].asInt(), 150 * kMB);
+  ASSERT_EQ(state["events"][0]["freedBytes"].asInt(), 0);
+  ASSERT_FALSE(state["taskAdmissionPaused"].asBool());
+
+  // The growth stops, so the count of consecutive predictions restarts.
+  memChecker.predictivePushback(3'000);
+  ASSERT_EQ(actions().size(), 1);
+
+  // The third consecutive prediction over the limit escalates. There is no
+  // cache and nothing to spill, so the task admission gets paused.
+  for (int i = 1; i <= 3; ++i) {
+    memChecker.setSystemUsedMemoryBytes((550 + 50 * i) * kMB);
+    memChecker.predictivePushback(3'000 + 1'000 * i);
+  }
+  ASSERT_EQ(
+      actions(),
+      std::vector<std::string>(
+          {"SHRINK_CACHE",
+           "SHRINK_CACHE",
+           "SHRINK_CACHE",
+           "SHRINK_CACHE",
+           "SPILL",
+           "PAUSE_TASK_ADMISSION"}));
+  state = memChecker.pushbackState();
+  ASSERT_EQ(state["predictedBytes"].asInt(), 1'200 * kMB);
+  ASSERT_EQ(state["events"][4]["targetBytes"].asInt(), 300 * kMB);
+  ASSERT_TRUE(state["taskAdmissionPaused"].asBool());
+  ASSERT_EQ(memChecker.taskAdmissionPauses(), std::vector<bool>({true}));
+
+  // Still paused while the usage is predicted to exceed the limit.
+  memChecker.setSystemUsedMemoryBytes(750 * kMB);
+  memChecker.predictivePushback(7'000);
+  ASSERT_EQ(memChecker.taskAdmissionPauses(), std::vector<bool>({true}));
+  ASSERT_EQ(actions().size(), 8);
+
+  // Resumed once the usage stops growing.
+  memChecker.predictivePushback(8'000);
+  ASSERT_EQ(memChecker.taskAdmissionPauses(), std::vector<bool>({true, false}));
+  ASSERT_FALSE(memChecker.pushbackState()["taskAdmissionPaused"].asBool());
+  ASSERT_EQ(actions().size(), 8);
+
+  // High memory pressure only shrinks the cache by the shrink size.
+  memChecker.setCgroupMemoryStats(
+      PeriodicMemoryChecker::CgroupMemoryStats{750 * kMB, 0, 1'000'000});
+  memChecker.predictivePushback(9'000);
+  ASSERT_EQ(actions().size(), 8);
+  // Stalled 20% of the last second.
+  memChecker.setCgroupMemoryStats(
+      PeriodicMemoryChecker::CgroupMemoryStats{750 * kMB, 0, 1'200'000});
+  memChecker.predictivePushback(10'000);
+  state = memChecker.pushbackState();
+  ASSERT_EQ(state["stallPct"].asDouble(), 20);
+  ASSERT_EQ(state["events"].size(), 9);
+  ASSERT_EQ(state["events"][8]["action"].asString(), "SHRINK_CACHE");
+  ASSERT_EQ(state["events"][8]["targetBytes"].asInt(), 100 * kMB);
+  ASSERT_EQ(memChecker.taskAdmissionPauses(), std::vector<bool>({true, false}));
+
+  memory::MemoryManager::testingSetInstance({});
+}
 } // namespace facebook::presto
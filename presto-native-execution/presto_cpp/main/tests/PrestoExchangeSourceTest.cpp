@@ -13,6 +13,7 @@
  */
 #include <folly/init/Init.h>
 #include <folly/portability/GMock.h>
+#include <folly/system/ThreadName.h>
 #include <gtest/gtest.h>
 
 #include <boost/algorithm/string.hpp>
@@ -744,6 +745,59 @@ DEBUG_ONLY_TEST_P(
   serverWrapper.stop();
 }
 
+DEBUG_ONLY_TEST_P(PrestoExchangeSourceTest, ioThreadDataPath) {
+  SystemConfig::instance()->setValue(
+      std::string(SystemConfig::kExchangeIoThreadDataPath), "true");
+  std::mutex mutex;
+  std::vector<std::string> threadNames;
+  SCOPED_TESTVALUE_SET(
+      "facebook::presto::PrestoExchangeSource::handleDataResponse",
+      std::function<void(const PrestoExchangeSource*)>(
+          ([&](const auto* /*prestoExchangeSource*/) {
+            std::lock_guard<std::mutex> l(mutex);
+            threadNames.push_back(folly::getCurrentThreadName().value_or(""));
+          })));
+
+  const std::vector<std::string> pages = {"page1 - xx", "page2 - xxxxx"};
+  const auto useHttps = GetParam().useHttps;
+  auto producer = std::make_unique<Producer>();
+  for (const auto& page : pages) {
+    producer->enqueue(page);
+  }
+  producer->noMoreData();
+
+  auto producerServer = createHttpServer(useHttps);
+  producer->registerEndpoints(producerServer.get());
+  test::HttpServerWrapper serverWrapper(std::move(producerServer));
+  auto producerAddress = serverWrapper.start().get();
+
+  auto queue = makeSingleSourceQueue();
+  auto exchangeSource = makeExchangeSource(producerAddress, useHttps, 3, queue);
+  requestNextPage(queue, exchangeSource);
+  for (int i = 0; i < pages.size(); i++) {
+    auto page = waitForNextPage(queue);
+    ASSERT_EQ(toString(page.get()), pages[i]) << "at " << i;
+    requestNextPage(queue, exchangeSource);
+  }
+  waitForEndMarker(queue);
+  producer->waitForDeleteResults();
+  exchangeCpuExecutor_->stop();
+  serverWrapper.stop();
+  EXPECT_EQ(pool_->usedBytes(), 0);
+
+  // The responses which need a copy are still processed on the driver
+  // executor.
+  const bool onIoThread =
+      !GetParam().enableBufferCopy || GetParam().immediateBufferTransfer;
+  std::lock_guard<std::mutex> l(mutex);
+  ASSERT_GE(threadNames.size(), pages.size());
+  for (const auto& threadName : threadNames) {
+    ASSERT_EQ(
+        threadName.rfind(onIoThread ? "IOThreadPool" : "CPUThreadPool", 0), 0)
+        << threadName;
+  }
+}
+
 TEST_P(PrestoExchangeSourceTest, failedProducer) {
   SystemConfig::instance()->setValue(
       std::string(SystemConfig::kExchangeMaxErrorDuration), "3s");
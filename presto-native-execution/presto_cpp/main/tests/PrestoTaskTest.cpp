@@ -13,6 +13,7 @@
  */
 #include "presto_cpp/main/PrestoTask.h"
 #include <gtest/gtest.h>
+#include <functional>
 #include "velox/common/base/tests/GTestUtils.h"
 #include "velox/common/time/Timer.h"
 
@@ -76,3 +77,85 @@ TEST_F(PrestoTaskTest, basic) {
   std::this_thread::sleep_for(std::chrono::milliseconds(100));
   EXPECT_GE(task.timeSinceLastCoordinatorHeartbeatMs(), 100);
 }
+
+TEST_F(PrestoTaskTest, operatorStatsFingerprint) {
+  exec::OperatorStats stats;
+  stats.inputPositions = 10;
+  stats.addInputTiming.add(CpuWallTiming{1, 100, 50});
+  stats.memoryStats.userMemoryReservation = 1'000;
+  stats.runtimeStats["foo"] = RuntimeMetric(5);
+  const auto fingerprint = operatorStatsFingerprint(stats);
+
+  // Unchanged stats reuse the cached summary.
+  ASSERT_EQ(operatorStatsFingerprint(stats), fingerprint);
+  auto copy = stats;
+  ASSERT_EQ(operatorStatsFingerprint(copy), fingerprint);
+
+  // Any change of a field read by the conversion invalidates it.
+  const auto expectChanged =
+      [&](const std::function<void(exec::OperatorStats&)>& change) {
+        auto changed = stats;
+        change(changed);
+        EXPECT_NE(operatorStatsFingerprint(changed), fingerprint);
+      };
+  // Positions and bytes.
+  expectChanged([](auto& op) { ++op.outputPositions; });
+  expectChanged([](auto& op) { op.rawInputBytes += 10; });
+  // Timings, including wall and CPU time without a new call.
+  expectChanged([](auto& op) { op.addInputTiming.wallNanos += 10; });
+  expectChanged([](auto& op) { op.finishTiming.cpuNanos += 10; });
+  expectChanged([](auto& op) { op.blockedWallNanos += 10; });
+  // Memory.
+  expectChanged(
+      [](auto& op) { op.memoryStats.revocableMemoryReservation += 10; });
+  expectChanged([](auto& op) { op.memoryStats.systemMemoryReservation += 10; });
+  expectChanged(
+      [](auto& op) { op.memoryStats.peakUserMemoryReservation += 10; });
+  expectChanged(
+      [](auto& op) { op.memoryStats.peakSystemMemoryReservation += 10; });
+  // Spilling.
+  expectChanged([](auto& op) { ++op.spilledFiles; });
+  // Dynamic filters.
+  expectChanged(
+      [](auto& op) { op.dynamicFilterStats.producerNodeIds.insert("1"); });
+  // Runtime stats, including a new value without a new count.
+  expectChanged([](auto& op) { op.runtimeStats["foo"].sum += 1; });
+  expectChanged([](auto& op) { op.runtimeStats["bar"] = RuntimeMetric(1); });
+}
+
+TEST_F(PrestoTaskTest, capRuntimeStats) {
+  auto metric = [](protocol::RuntimeUnit unit, int64_t sum) {
+    protocol::RuntimeMetric metric;
+    metric.unit = unit;
+    metric.sum = sum;
+    metric.count = 1;
+    return metric;
+  };
+  const protocol::RuntimeStats runtimeStats{
+      {"wallNanos", metric(protocol::RuntimeUnit::NANO, 1'000'000'000)},
+      {"cpuNanos", metric(protocol::RuntimeUnit::NANO, 500'000'000)},
+      {"spillBytes", metric(protocol::RuntimeUnit::BYTE, 1'000)},
+      {"readBytes", metric(protocol::RuntimeUnit::BYTE, 2'000)},
+      {"numSplits", metric(protocol::RuntimeUnit::NONE, 3)}};
+
+  auto capped = [&](uint32_t maxRuntimeStats) {
+    auto stats = runtimeStats;
+    capRuntimeStats(stats, maxRuntimeStats);
+    std::vector<std::string> names;
+    for (const auto& [name, _] : stats) {
+      names.push_back(name);
+    }
+    return names;
+  };
+  ASSERT_EQ(capped(0).size(), 5);
+  ASSERT_EQ(capped(5).size(), 5);
+  // The largest metric of each unit is kept first, regardless of the sums of
+  // the other units.
+  ASSERT_EQ(
+      capped(3),
+      (std::vector<std::string>{"numSplits", "readBytes", "wallNanos"}));
+  ASSERT_EQ(
+      capped(4),
+      (std::vector<std::string>{
+          "cpuNanos", "numSplits", "readBytes", "wallNanos"}));
+}
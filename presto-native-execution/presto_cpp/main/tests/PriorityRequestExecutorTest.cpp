@@ -0,0 +1,85 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/PriorityRequestExecutor.h"
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/ManualExecutor.h>
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+
+namespace facebook::presto {
+
+using Priority = PriorityRequestExecutor::Priority;
+
+TEST(PriorityRequestExecutorTest, priorities) {
+  folly::CPUThreadPoolExecutor threadPool(
+      1, PriorityRequestExecutor::kNumPriorities);
+  PriorityRequestExecutor executor(&threadPool);
+
+  // Occupy the only thread so that the requests below queue up.
+  folly::Baton<> running;
+  folly::Baton<> release;
+  executor.executor(Priority::kHigh)->add([&]() {
+    running.post();
+    release.wait();
+  });
+  running.wait();
+
+  std::mutex mutex;
+  std::vector<Priority> order;
+  for (auto priority : {Priority::kLow, Priority::kMedium, Priority::kHigh}) {
+    executor.executor(priority)->add([&, priority]() {
+      std::lock_guard<std::mutex> l(mutex);
+      order.push_back(priority);
+    });
+  }
+  ASSERT_EQ(executor.numQueued(Priority::kLow), 1);
+  ASSERT_EQ(executor.numQueued(Priority::kMedium), 1);
+  ASSERT_EQ(executor.numQueued(Priority::kHigh), 1);
+
+  release.post();
+  threadPool.join();
+  ASSERT_EQ(
+      order,
+      std::vector<Priority>(
+          {Priority::kHigh, Priority::kMedium, Priority::kLow}));
+  ASSERT_EQ(executor.numQueued(Priority::kHigh), 0);
+}
+
+TEST(PriorityRequestExecutorTest, admission) {
+  folly::ManualExecutor manualExecutor;
+  PriorityRequestExecutor::Options options;
+  options.maxQueuedRequests = {0, 0, 2};
+  PriorityRequestExecutor executor(&manualExecutor, options);
+
+  int numRun{0};
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(executor.tryAdmit(Priority::kLow));
+    executor.executor(Priority::kLow)->add([&]() { ++numRun; });
+  }
+  ASSERT_FALSE(executor.tryAdmit(Priority::kLow));
+  // The limits are per priority and 0 is unlimited.
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(executor.tryAdmit(Priority::kHigh));
+    executor.executor(Priority::kHigh)->add([&]() { ++numRun; });
+  }
+  ASSERT_EQ(executor.numQueued(Priority::kHigh), 10);
+
+  // Executors without priorities run the requests in FIFO order.
+  manualExecutor.drain();
+  ASSERT_EQ(numRun, 12);
+  ASSERT_EQ(executor.numQueued(Priority::kLow), 0);
+  ASSERT_TRUE(executor.tryAdmit(Priority::kLow));
+}
+
+} // namespace facebook::presto
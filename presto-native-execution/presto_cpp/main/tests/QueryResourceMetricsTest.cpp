@@ -0,0 +1,64 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/QueryResourceMetrics.h"
+#include <gtest/gtest.h>
+
+namespace facebook::presto {
+
+using Usage = QueryResourceMetrics::Usage;
+
+TEST(QueryResourceMetricsTest, topQueries) {
+  QueryResourceMetrics metrics(2);
+  std::unordered_map<std::string, Usage> running{
+      {"q1", {100, 10, 1}},
+      {"q2", {300, 30, 3}},
+      {"q3", {200, 20, 2}},
+      {"q4", {50, 5, 0}},
+  };
+  // A finished task of a running query moves it into the top queries.
+  metrics.addFinishedTask("q1", {250, 25, 0});
+
+  auto usages = metrics.update(running);
+  ASSERT_EQ(usages.size(), 3);
+  EXPECT_EQ(usages[0].first, "q1");
+  EXPECT_EQ(usages[0].second.cpuTimeNanos, 350);
+  EXPECT_EQ(usages[0].second.exchangeInputBytes, 35);
+  EXPECT_EQ(usages[1].first, "q2");
+  EXPECT_EQ(usages[1].second.cpuTimeNanos, 300);
+  EXPECT_EQ(usages[2].first, QueryResourceMetrics::kOtherQueries);
+  EXPECT_EQ(usages[2].second.cpuTimeNanos, 250);
+  EXPECT_EQ(usages[2].second.exchangeInputBytes, 25);
+  EXPECT_EQ(usages[2].second.spilledBytes, 2);
+
+  // The finished tasks are kept while the query has running tasks.
+  usages = metrics.update(running);
+  EXPECT_EQ(usages[0].first, "q1");
+  EXPECT_EQ(usages[0].second.cpuTimeNanos, 350);
+}
+
+TEST(QueryResourceMetricsTest, finishedQueries) {
+  QueryResourceMetrics metrics(10);
+  metrics.addFinishedTask("q1", {100, 0, 0});
+  metrics.addFinishedTask("q1", {200, 0, 0});
+
+  // Reported once more after the last running task is gone.
+  auto usages = metrics.update({});
+  ASSERT_EQ(usages.size(), 1);
+  EXPECT_EQ(usages[0].first, "q1");
+  EXPECT_EQ(usages[0].second.cpuTimeNanos, 300);
+
+  EXPECT_TRUE(metrics.update({}).empty());
+}
+
+} // namespace facebook::presto
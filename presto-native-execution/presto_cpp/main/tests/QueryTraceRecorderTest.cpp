@@ -0,0 +1,127 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/QueryTraceRecorder.h"
+#include <fmt/format.h>
+#include <folly/json.h>
+#include <folly/system/ThreadName.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <thread>
+#include "velox/common/base/tests/GTestUtils.h"
+
+namespace facebook::presto {
+namespace {
+
+// Records a run of 'pool' on a new thread named 'threadName'.
+void recordRunOnThread(const char* pool, const std::string& threadName) {
+  std::thread([&]() {
+    folly::setThreadName(threadName);
+    const auto now = std::chrono::steady_clock::now();
+    QueryTraceRecorder::recordRun(
+        pool, now, now + std::chrono::milliseconds(2));
+  }).join();
+}
+
+// Returns the events of 'trace' with phase 'phase'.
+std::vector<folly::dynamic> events(
+    const folly::dynamic& trace,
+    const std::string& phase) {
+  std::vector<folly::dynamic> events;
+  for (const auto& event : trace["traceEvents"]) {
+    if (event["ph"] == phase) {
+      events.push_back(event);
+    }
+  }
+  return events;
+}
+} // namespace
+
+TEST(QueryTraceRecorderTest, runs) {
+  ASSERT_FALSE(QueryTraceRecorder::enabled());
+  // Not recorded, no query is traced.
+  recordRunOnThread("Untraced", "Untraced0");
+
+  QueryTraceRecorder::start("query1");
+  ASSERT_TRUE(QueryTraceRecorder::enabled());
+  ASSERT_EQ(
+      QueryTraceRecorder::tracedQueries(), std::vector<std::string>{"query1"});
+  recordRunOnThread("Driver", "Driver0");
+  recordRunOnThread("Driver", "Driver1");
+  QueryTraceRecorder::collect({});
+  recordRunOnThread("Spiller", "Spiller0");
+
+  const auto trace = folly::parseJson(QueryTraceRecorder::stop("query1"));
+  ASSERT_FALSE(QueryTraceRecorder::enabled());
+  ASSERT_EQ(trace["otherData"]["queryId"], "query1");
+  ASSERT_EQ(trace["otherData"]["droppedEvents"], 0);
+
+  const auto runs = events(trace, "X");
+  ASSERT_EQ(runs.size(), 3);
+  std::vector<std::string> pools;
+  for (const auto& run : runs) {
+    pools.push_back(run["name"].asString());
+    ASSERT_EQ(run["pid"], 0);
+    ASSERT_EQ(run["dur"], 2'000);
+  }
+  std::sort(pools.begin(), pools.end());
+  ASSERT_EQ(pools, (std::vector<std::string>{"Driver", "Driver", "Spiller"}));
+
+  std::vector<std::string> threadNames;
+  for (const auto& metadata : events(trace, "M")) {
+    if (metadata["name"] == "thread_name") {
+      threadNames.push_back(metadata["args"]["name"].asString());
+    }
+  }
+  std::sort(threadNames.begin(), threadNames.end());
+  ASSERT_EQ(
+      threadNames,
+      (std::vector<std::string>{"Driver0", "Driver1", "Spiller0"}));
+}
+
+TEST(QueryTraceRecorderTest, droppedRuns) {
+  QueryTraceRecorder::start("query1");
+  // Fills the ring of the thread and overflows it by 10 runs.
+  std::thread([]() {
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < QueryTraceRecorder::kMaxBufferedRuns + 10; ++i) {
+      QueryTraceRecorder::recordRun(
+          "Driver", now, now + std::chrono::milliseconds(1));
+    }
+  }).join();
+
+  const auto trace = folly::parseJson(QueryTraceRecorder::stop("query1"));
+  ASSERT_EQ(trace["otherData"]["droppedEvents"], 10);
+  ASSERT_EQ(events(trace, "X").size(), QueryTraceRecorder::kMaxBufferedRuns);
+}
+
+TEST(QueryTraceRecorderTest, errors) {
+  VELOX_ASSERT_THROW(
+      QueryTraceRecorder::stop("query1"), "Query query1 is not traced");
+
+  QueryTraceRecorder::start("query1");
+  VELOX_ASSERT_THROW(
+      QueryTraceRecorder::start("query1"), "Query query1 is already traced");
+  for (size_t i = 1; i < QueryTraceRecorder::kMaxTracedQueries; ++i) {
+    QueryTraceRecorder::start(fmt::format("query{}", i + 1));
+  }
+  VELOX_ASSERT_THROW(
+      QueryTraceRecorder::start("query0"), "Too many traced queries");
+
+  for (const auto& queryId : QueryTraceRecorder::tracedQueries()) {
+    QueryTraceRecorder::stop(queryId);
+  }
+  ASSERT_FALSE(QueryTraceRecorder::enabled());
+}
+
+} // namespace facebook::presto
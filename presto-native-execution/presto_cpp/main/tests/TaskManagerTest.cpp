@@ -20,6 +20,8 @@
 #include "presto_cpp/main/TaskResource.h"
 #include "presto_cpp/main/tests/HttpServerWrapper.h"
 #include "presto_cpp/main/tests/MultableConfigs.h"
+#include "presto_cpp/main/thrift/ThriftIO.h"
+#include "presto_cpp/main/thrift/gen-cpp2/PrestoThrift.h"
 #include "presto_cpp/main/types/PrestoToVeloxConnector.h"
 #include "velox/common/base/Fs.h"
 #include "velox/common/base/tests/GTestUtils.h"
@@ -256,12 +258,12 @@ class TaskManagerTest : public testing::Test {
     httpServerWrapper_ =
         std::make_unique<facebook::presto::test::HttpServerWrapper>(
             std::move(httpServer));
-    auto serverAddress = httpServerWrapper_->start().get();
+    serverAddress_ = httpServerWrapper_->start().get();
 
     taskManager_->setBaseUri(fmt::format(
         "http://{}:{}",
-        serverAddress.getAddressStr(),
-        serverAddress.getPort()));
+        serverAddress_.getAddressStr(),
+        serverAddress_.getPort()));
   }
 
   void TearDown() override {
@@ -647,6 +649,7 @@ class TaskManagerTest : public testing::Test {
   std::unique_ptr<TaskManager> taskManager_;
   std::unique_ptr<TaskResource> taskResource_;
   std::unique_ptr<facebook::presto::test::HttpServerWrapper> httpServerWrapper_;
+  folly::SocketAddress serverAddress_;
   std::shared_ptr<folly::CPUThreadPoolExecutor> exchangeCpuExecutor_ =
       std::make_shared<folly::CPUThreadPoolExecutor>(1);
   std::shared_ptr<folly::IOThreadPoolExecutor> exchangeIoExecutor_ =
@@ -1173,6 +1176,331 @@ TEST_F(TaskManagerTest, timeoutOutOfOrderRequests) {
           .getVia(eventBase));
 }
 
+// Tests that results are looked up on the IO thread only when that does not
+// wait for the task mutex.
+TEST_F(TaskManagerTest, tryGetResults) {
+  auto eventBase = exchangeIoExecutor_->getEventBase();
+  auto maxSize = protocol::DataSize("32MB");
+  auto maxWait = protocol::Duration("100ms");
+  protocol::TaskId taskId = "io-results.0.0.1.0";
+  auto tryGetResults = [&]() {
+    return taskManager_->tryGetResults(
+        taskId,
+        0,
+        0,
+        maxSize,
+        maxWait,
+        http::CallbackRequestHandlerState::create(),
+        eventBase);
+  };
+
+  // The task does not exist and is not created.
+  EXPECT_FALSE(tryGetResults().has_value());
+  EXPECT_EQ(taskManager_->tasks().count(taskId), 0);
+
+  // The task exists but has not started.
+  taskManager_->getTaskStatus(
+      taskId,
+      std::nullopt,
+      std::nullopt,
+      http::CallbackRequestHandlerState::create());
+  EXPECT_FALSE(tryGetResults().has_value());
+
+  // The exchange never receives no-more-splits, so the task keeps running.
+  auto planFragment = exec::test::PlanBuilder()
+                          .exchange(rowType_)
+                          .partitionedOutput({}, 1)
+                          .planFragment();
+  createOrUpdateTask(taskId, {}, planFragment);
+
+  // The task mutex is held, e.g. by a task update.
+  auto prestoTask = taskManager_->tasks().at(taskId);
+  {
+    std::lock_guard<std::mutex> l(prestoTask->mutex);
+    EXPECT_FALSE(tryGetResults().has_value());
+  }
+
+  auto results = tryGetResults();
+  ASSERT_TRUE(results.has_value());
+  auto result = std::move(results.value())
+                    .thenValue([eventBase](std::unique_ptr<Result> result) {
+                      EXPECT_TRUE(eventBase->isInEventBaseThread());
+                      return result;
+                    })
+                    .get(std::chrono::seconds(10));
+  EXPECT_FALSE(result->complete);
+  EXPECT_EQ(result->data->length(), 0);
+
+  taskManager_->deleteTask(taskId, true);
+}
+
+// Tests that long-poll status requests are completed by the task state change
+// notification and that the task numbers are updated incrementally.
+TEST_F(TaskManagerTest, taskStateChangeNotification) {
+  auto eventBase = folly::EventBaseManager::get()->getEventBase();
+  // The exchange never receives no-more-splits, so the task keeps running.
+  auto planFragment = exec::test::PlanBuilder()
+                          .exchange(rowType_)
+                          .partitionedOutput({}, 1)
+                          .planFragment();
+  protocol::TaskId taskId = "state-change.0.0.1.0";
+  createOrUpdateTask(taskId, {}, planFragment);
+
+  size_t numTasks{0};
+  auto taskNumbers = taskManager_->getTaskNumbers(numTasks);
+  EXPECT_EQ(numTasks, 1);
+  EXPECT_EQ(taskNumbers[exec::TaskState::kRunning], 1);
+
+  auto statusRequestState = http::CallbackRequestHandlerState::create();
+  auto taskStatus = taskManager_->getTaskStatus(
+      taskId,
+      protocol::TaskState::RUNNING,
+      protocol::Duration("300s"),
+      statusRequestState);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(taskStatus.isReady());
+
+  taskManager_->deleteTask(taskId, true);
+  auto status =
+      std::move(taskStatus).within(std::chrono::seconds(5)).getVia(eventBase);
+  EXPECT_EQ(status->state, protocol::TaskState::ABORTED);
+
+  taskNumbers = taskManager_->getTaskNumbers(numTasks);
+  EXPECT_EQ(numTasks, 1);
+  EXPECT_EQ(taskNumbers[exec::TaskState::kRunning], 0);
+  EXPECT_EQ(taskNumbers[exec::TaskState::kAborted], 1);
+
+  taskManager_->setOldTaskCleanUpMs(0);
+  waitForAllOldTasksToBeCleaned(taskManager_.get(), 3'000'000);
+  taskNumbers = taskManager_->getTaskNumbers(numTasks);
+  EXPECT_EQ(numTasks, 0);
+}
+
+TEST_F(TaskManagerTest, summarizedTaskInfo) {
+  auto vectors = makeVectors(3, 1'000);
+  duckDbQueryRunner_.createTable("tmp", vectors);
+  auto planFragment = exec::test::PlanBuilder()
+                          .values(vectors)
+                          .filter("c0 % 5 = 0")
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+  protocol::TaskId taskId = "summarize.0.0.1.0";
+  createOrUpdateTask(taskId, {}, planFragment);
+  assertResults(taskId, rowType_, "SELECT * FROM tmp WHERE c0 % 5 = 0");
+
+  auto getTaskInfo = [&](bool summarize) {
+    auto state = http::CallbackRequestHandlerState::create();
+    return taskManager_
+        ->getTaskInfo(taskId, summarize, std::nullopt, std::nullopt, state)
+        .get();
+  };
+
+  const auto fullInfo = getTaskInfo(false);
+  ASSERT_FALSE(fullInfo->stats.pipelines.empty());
+  ASSERT_GT(fullInfo->stats.runtimeStats.size(), 2);
+
+  const auto summarizedInfo = getTaskInfo(true);
+  EXPECT_TRUE(summarizedInfo->stats.pipelines.empty());
+  EXPECT_EQ(
+      summarizedInfo->stats.outputPositions, fullInfo->stats.outputPositions);
+  EXPECT_EQ(summarizedInfo->taskStatus.state, fullInfo->taskStatus.state);
+
+  // Cap the number of runtime metrics.
+  SystemConfig::instance()->setValue(
+      std::string(SystemConfig::kTaskInfoMaxRuntimeStats), "2");
+  const auto cappedInfo = getTaskInfo(false);
+  EXPECT_EQ(cappedInfo->stats.runtimeStats.size(), 2);
+  for (const auto& pipeline : cappedInfo->stats.pipelines) {
+    for (const auto& op : pipeline.operatorSummaries) {
+      EXPECT_LE(op.runtimeStats.size(), 2);
+    }
+  }
+  SystemConfig::instance()->setValue(
+      std::string(SystemConfig::kTaskInfoMaxRuntimeStats), "0");
+  EXPECT_GT(getTaskInfo(false)->stats.runtimeStats.size(), 2);
+}
+
+TEST_F(TaskManagerTest, taskStatuses) {
+  auto eventBase = folly::EventBaseManager::get()->getEventBase();
+  auto planFragment = exec::test::PlanBuilder()
+                          .exchange(rowType_)
+                          .partitionedOutput({}, 1)
+                          .planFragment();
+  const std::vector<protocol::TaskId> taskIds{
+      "statuses.0.0.1.0", "statuses.0.0.2.0"};
+  for (const auto& taskId : taskIds) {
+    createOrUpdateTask(taskId, {}, planFragment);
+  }
+
+  auto getTaskStatuses = [&](const std::vector<protocol::TaskId>& ids,
+                             const std::optional<std::string>& queryId,
+                             std::optional<uint64_t> version) {
+    return taskManager_->getTaskStatuses(
+        ids,
+        queryId,
+        version,
+        protocol::Duration("300s"),
+        http::CallbackRequestHandlerState::create());
+  };
+
+  auto batch = getTaskStatuses(taskIds, std::nullopt, std::nullopt).get();
+  ASSERT_EQ(batch->taskStatuses.size(), 2);
+  for (const auto& taskId : taskIds) {
+    EXPECT_EQ(
+        batch->taskStatuses.at(taskId).state, protocol::TaskState::RUNNING);
+  }
+  EXPECT_EQ(
+      getTaskStatuses({}, "statuses", std::nullopt).get()->taskStatuses.size(),
+      2);
+
+  // A stale version is answered right away.
+  EXPECT_TRUE(getTaskStatuses(taskIds, std::nullopt, batch->version - 1)
+                  .isReady());
+
+  // A current version waits for any of the tasks to change its state.
+  auto future = getTaskStatuses(taskIds, std::nullopt, batch->version);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(future.isReady());
+
+  taskManager_->deleteTask(taskIds[1], true);
+  auto newBatch =
+      std::move(future).within(std::chrono::seconds(5)).getVia(eventBase);
+  EXPECT_NE(newBatch->version, batch->version);
+  EXPECT_EQ(
+      newBatch->taskStatuses.at(taskIds[0]).state,
+      protocol::TaskState::RUNNING);
+  EXPECT_EQ(
+      newBatch->taskStatuses.at(taskIds[1]).state,
+      protocol::TaskState::ABORTED);
+
+  taskManager_->deleteTask(taskIds[0], true);
+}
+
+TEST_F(TaskManagerTest, taskStatusesEndpoint) {
+  auto planFragment = exec::test::PlanBuilder()
+                          .exchange(rowType_)
+                          .partitionedOutput({}, 1)
+                          .planFragment();
+  const std::vector<protocol::TaskId> taskIds{
+      "endpoint.0.0.1.0", "endpoint.0.0.2.0"};
+  for (const auto& taskId : taskIds) {
+    createOrUpdateTask(taskId, {}, planFragment);
+  }
+
+  auto client = std::make_shared<http::HttpClient>(
+      exchangeIoExecutor_->getEventBase(),
+      connPool_.get(),
+      proxygen::Endpoint(
+          serverAddress_.getAddressStr(), serverAddress_.getPort(), false),
+      serverAddress_,
+      std::chrono::seconds(10),
+      std::chrono::milliseconds(0),
+      leafPool_,
+      nullptr);
+  // Returns the status code and the body of the response.
+  auto sendGet = [&](const std::string& query,
+                     std::optional<std::string> maxWait = std::nullopt,
+                     bool thrift = false) {
+    http::RequestBuilder builder;
+    builder.method(proxygen::HTTPMethod::GET).url("/v1/task/status?" + query);
+    if (maxWait.has_value()) {
+      builder.header(protocol::PRESTO_MAX_WAIT_HTTP_HEADER, maxWait.value());
+    }
+    if (thrift) {
+      builder.header(
+          proxygen::HTTP_HEADER_ACCEPT, http::kMimeTypeApplicationThrift);
+    }
+    return builder.send(client.get()).via(exchangeIoExecutor_.get());
+  };
+  auto body = [](std::unique_ptr<http::HttpResponse> response) {
+    EXPECT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+    auto text = response->dumpBodyChain();
+    response->freeBuffers();
+    return text;
+  };
+
+  const auto taskIdsParam = folly::join(',', taskIds);
+  const auto batchJson =
+      json::parse(body(sendGet("taskIds=" + taskIdsParam).get()));
+  ASSERT_EQ(batchJson["taskStatuses"].size(), 2);
+  for (const auto& taskId : taskIds) {
+    protocol::TaskStatus status = batchJson["taskStatuses"][taskId];
+    EXPECT_EQ(status.state, protocol::TaskState::RUNNING);
+  }
+  const uint64_t version = batchJson["version"];
+  EXPECT_EQ(
+      json::parse(body(sendGet("queryId=endpoint").get()))["version"],
+      version);
+
+  // The thrift response has the same version and statuses.
+  auto thriftBatch = std::make_shared<thrift::TaskStatusBatch>();
+  thriftRead(
+      body(sendGet("taskIds=" + taskIdsParam, std::nullopt, true).get()),
+      thriftBatch);
+  EXPECT_EQ(*thriftBatch->version_ref(), version);
+  ASSERT_EQ(thriftBatch->taskStatuses_ref()->size(), 2);
+  for (const auto& taskId : taskIds) {
+    EXPECT_EQ(
+        *thriftBatch->taskStatuses_ref()->at(taskId).state_ref(),
+        thrift::TaskState::RUNNING);
+  }
+
+  // The versions of different sets of tasks do not alias.
+  const auto firstTaskJson =
+      json::parse(body(sendGet("taskIds=" + taskIds[0]).get()));
+  EXPECT_NE(firstTaskJson["version"], version);
+
+  // A stale version is answered right away, even with a max wait.
+  EXPECT_EQ(
+      json::parse(body(sendGet(
+                           fmt::format(
+                               "taskIds={}&version={}",
+                               taskIdsParam,
+                               version + 1),
+                           "60s")
+                           .get(std::chrono::seconds(10))))["version"],
+      version);
+
+  // Without a max wait the current version is answered right away.
+  EXPECT_EQ(
+      json::parse(body(
+          sendGet(fmt::format("taskIds={}&version={}", taskIdsParam, version))
+              .get(std::chrono::seconds(10))))["version"],
+      version);
+
+  // The current version with a max wait expires with the same version.
+  const auto versionQuery =
+      fmt::format("taskIds={}&version={}", taskIdsParam, version);
+  EXPECT_EQ(
+      json::parse(body(sendGet(versionQuery, "100ms")
+                           .get(std::chrono::seconds(10))))["version"],
+      version);
+
+  // The current version with a max wait waits for a state change.
+  auto future = sendGet(versionQuery, "60s");
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(future.isReady());
+  taskManager_->deleteTask(taskIds[1], true);
+  const auto newBatchJson =
+      json::parse(body(std::move(future).get(std::chrono::seconds(10))));
+  EXPECT_NE(newBatchJson["version"], version);
+  protocol::TaskStatus status = newBatchJson["taskStatuses"][taskIds[1]];
+  EXPECT_EQ(status.state, protocol::TaskState::ABORTED);
+
+  // Exactly one of the task ids and the query id must be set.
+  auto response =
+      sendGet("taskIds=" + taskIdsParam + "&queryId=endpoint").get();
+  EXPECT_EQ(response->headers()->getStatusCode(), http::kHttpBadRequest);
+  response->freeBuffers();
+
+  // A malformed version is a client error.
+  response = sendGet("taskIds=" + taskIdsParam + "&version=abc").get();
+  EXPECT_EQ(response->headers()->getStatusCode(), http::kHttpBadRequest);
+  response->freeBuffers();
+
+  taskManager_->deleteTask(taskIds[0], true);
+}
+
 TEST_F(TaskManagerTest, aggregationSpill) {
   // NOTE: we need to write more than one batches to each file (source split) to
   // trigger spill.
@@ -82,6 +82,11 @@ struct ExecutionFailureInfo {
   8: HostAddress remoteHost;
 }
 
+struct TaskStatusBatch {
+  1: i64 version;
+  2: map<string, TaskStatus> taskStatuses;
+}
+
 service PrestoThrift {
   void fake();
 }